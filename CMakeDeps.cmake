@@ -41,6 +41,8 @@
 # libs/basic/hex.h
 # libs/basic/intset.cpp
 # libs/basic/intset.h
+# libs/basic/intsetint.h
+# libs/basic/intsetsimd.cpp
 # libs/basic/list.h
 # libs/basic/math.h
 # libs/basic/pageheap.h
@@ -60,6 +62,7 @@
 # libs/core/appint.h
 # libs/core/core.h
 # libs/core/core.natvis
+# libs/core/coro.h
 # libs/core/crypt.cpp
 # libs/core/crypt.h
 # libs/core/log.cpp
@@ -127,6 +130,7 @@
 # libs/net/hpack.cpp
 # libs/net/hpack.h
 # libs/net/http.h
+# libs/net/http1conn.cpp
 # libs/net/httpconn.cpp
 # libs/net/httpint.h
 # libs/net/httpmsg.cpp
@@ -285,9 +289,15 @@
 # tests/svcctrl-t/pch.cpp
 # tests/svcctrl-t/pch.h
 # tests/svcctrl-t/svcctrl-t.cpp
+# tests/task-t/pch.cpp
+# tests/task-t/pch.h
+# tests/task-t/task-t.cpp
 # tests/time-t/pch.cpp
 # tests/time-t/pch.h
 # tests/time-t/time-t.cpp
+# tests/timer-t/pch.cpp
+# tests/timer-t/pch.h
+# tests/timer-t/timer-t.cpp
 # tests/tls-t/pch.cpp
 # tests/tls-t/pch.h
 # tests/tls-t/tls-t.cpp
@@ -312,6 +322,10 @@
 # tools/docgen/sitefiles.g.cpp
 # tools/docgen/sitegen.cpp
 # tools/docgen/util.cpp
+# tools/h2bench/README.adoc
+# tools/h2bench/h2bench.cpp
+# tools/h2bench/pch.cpp
+# tools/h2bench/pch.h
 # tools/h2srv/h2srv.cpp
 # tools/h2srv/pch.cpp
 # tools/h2srv/pch.h
@@ -1,4 +1,4 @@
-// Copyright Glen Knowles 2017 - 2025.
+// Copyright Glen Knowles 2017 - 2026.
 // Distributed under the Boost Software License, Version 1.0.
 //
 // logfile.cpp - dim app
@@ -444,7 +444,7 @@ bool JsonLogTail::LogJob::onFileRead(
     m_bld.end(); // end array of lines
     m_bld.end(); // end file object
     m_bld.end(); // end web admin object
-    if (m_res.headers()) {
+    if (!m_res.headers().empty()) {
         httpRouteReply(m_reqId, move(m_res));
     } else {
         httpRouteReply(m_reqId, move(m_res.body()), false);
@@ -1,4 +1,4 @@
-// Copyright Glen Knowles 2018 - 2024.
+// Copyright Glen Knowles 2018 - 2026.
 // Distributed under the Boost Software License, Version 1.0.
 //
 // resource.cpp - dim app
@@ -140,6 +140,49 @@ void ShutdownNotify::onShutdownConsole (bool firstTry) {
 }
 
 
+/****************************************************************************
+*
+*   Web site
+*
+***/
+
+namespace {
+
+struct Sidecar {
+    const char * fileExt;
+    const char * encoding;
+};
+
+} // namespace
+
+// Precompressed versions of a file, kept next to it with an added extension.
+const Sidecar s_sidecars[] = {
+    { ".br", "br"   },
+    { ".gz", "gzip" },
+};
+
+//===========================================================================
+static bool isSidecar(string_view name) {
+    for (auto && sc : s_sidecars) {
+        if (name.ends_with(sc.fileExt)) {
+            name.remove_suffix(strlen(sc.fileExt));
+            return s_files.find(name);
+        }
+    }
+    return false;
+}
+
+//===========================================================================
+static void addSidecars(string_view name, string_view route) {
+    string tmp;
+    for (auto && sc : s_sidecars) {
+        tmp.assign(name).append(sc.fileExt);
+        if (auto ent = s_files.find(tmp))
+            httpRouteAddFileEncodingRef(route, sc.encoding, ent->content);
+    }
+}
+
+
 /****************************************************************************
 *
 *   Public API
@@ -168,6 +211,9 @@ void Dim::resLoadWebSite(
     if (!prefix.empty() && prefix.back() == '/')
         prefix.pop_back();
     for (auto && [name, ent] : s_files) {
+        // Sidecars are added as encodings of the file they were made from.
+        if (isSidecar(name))
+            continue;
         auto rname = name;
         auto rcontent = ent.content;
         Path route(prefix);
@@ -202,10 +248,16 @@ void Dim::resLoadWebSite(
             rname = s_files.strDup(move(tmp));
         }
         auto mime = html ? "text/html"sv : ""sv;
+        // Sidecars no longer match content that was rewritten.
+        auto rewritten = rcontent.data() != ent.content.data();
         httpRouteAddFileRef(rname, ent.mtime, rcontent, mime);
+        if (!rewritten)
+            addSidecars(name, rname);
         if (dir) {
             rname.remove_suffix(1);
             httpRouteAddFileRef(rname, ent.mtime, rcontent, mime);
+            if (!rewritten)
+                addSidecars(name, rname);
         }
     }
 }
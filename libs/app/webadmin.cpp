@@ -1,4 +1,4 @@
-// Copyright Glen Knowles 2017 - 2024.
+// Copyright Glen Knowles 2017 - 2026.
 // Distributed under the Boost Software License, Version 1.0.
 //
 // webadmin.cpp - dim app
@@ -119,7 +119,7 @@ void WebFiles::onHttpRequest(unsigned reqId, HttpRequest & msg) {
         if (!fileDirExists(&found, path) && found)
             path /= "index.html";
         if (!fileExists(&found, path.view()) && found)
-            return httpRouteReplyWithFile(reqId, path);
+            return httpRouteReplyWithFile(reqId, msg, path);
     }
     httpRouteReplyNotFound(reqId, msg);
 }
@@ -403,7 +403,7 @@ void CrashFiles::onHttpRequest(unsigned reqId, HttpRequest & msg) {
         return httpRouteReplyNotFound(reqId, msg);
     bool found = false;
     if (auto ec = fileExists(&found, path); !ec && found) {
-        httpRouteReplyWithFile(reqId, path);
+        httpRouteReplyWithFile(reqId, msg, path);
     } else {
         httpRouteReplyNotFound(reqId, msg);
     }
@@ -1,4 +1,4 @@
-// Copyright Glen Knowles 2016 - 2025.
+// Copyright Glen Knowles 2016 - 2026.
 // Distributed under the Boost Software License, Version 1.0.
 //
 // hex.h - dim basic
@@ -24,8 +24,8 @@ constexpr bool isHex(unsigned char ch) {
     // return ch - '0' <= 9 || (ch | 0x20) - 'a' <= 5;
 
     switch (ch) {
-    case '0': case '1': case '2': case '3': case '5': case '6':
-    case '7': case '8': case '9':
+    case '0': case '1': case '2': case '3': case '4': case '5':
+    case '6': case '7': case '8': case '9':
     case 'A': case 'B': case 'C': case 'D': case 'E': case 'F':
     case 'a': case 'b': case 'c': case 'd': case 'e': case 'f':
         return true;
@@ -38,7 +38,7 @@ constexpr bool isHex(unsigned char ch) {
 // Converts hex character (0-9, a-f, A-F) to unsigned (0-15), other characters
 // produce random garbage.
 constexpr unsigned hexToNibbleUnsafe(char ch) {
-    return ((ch | 432) * 239'217'992 & 0xffff'ffff) >> 28;
+    return ((ch | 432u) * 239'217'992u & 0xffff'ffff) >> 28;
 }
 
 //===========================================================================
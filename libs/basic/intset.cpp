@@ -1,4 +1,4 @@
-// Copyright Glen Knowles 2017 - 2025.
+// Copyright Glen Knowles 2017 - 2026.
 // Distributed under the Boost Software License, Version 1.0.
 //
 // intset.cpp - dim basic
@@ -18,6 +18,77 @@ using Node = IntegralSet<T,A>::Node;
 *
 ***/
 
+// Portable format written by IntegralSet::save(), integers are big endian.
+//  Header
+//      uint32  magic number, "ISET"
+//      uint8   format version
+//      uint8   bits in a value
+//      uint8   bits in a leaf, the range of values an array or bitmap covers
+//      uint8   flags, a SerialFlags, all others must be zero
+//      uint64  number of values
+//      uint64  number of entries
+//  Entries, ordered by key and not overlapping
+//      uint64  key, first value covered shifted right by the leaf bits
+//      uint32  full: number of leaves covered, array or bitmap: offset of its
+//              values from start of payload
+//      uint16  type, a SerialType
+//      uint16  array or bitmap: number of values, full: zero
+//  Payload
+//      Bitmaps, with bits numbered as by BitView, at multiples of 8 bytes
+//      Arrays of uint16 offsets from the start of the leaf, ascending
+const uint32_t kSerialMagic = 0x49534554;
+const uint8_t kSerialVersion = 1;
+const size_t kSerialHeaderLen = 24;
+const size_t kSerialEntryLen = 16;
+
+// Runs the parts of parallel set operations, see intSetSetParallel().
+static atomic<IntSetParallelFn *> s_parallel;
+
+namespace {
+
+enum SerialFlags : uint8_t {
+    kSerialSigned = 1, // values are of a signed type
+};
+
+enum SerialType : uint16_t {
+    kSerialFull = 1,
+    kSerialArray = 2,
+    kSerialBitmap = 3,
+};
+
+struct SerialEntry {
+    uint64_t key;
+    uint32_t data;
+    uint16_t type;
+    uint16_t count;
+};
+
+struct SerialHeader {
+    uint64_t numValues;
+    size_t numEntries;
+    const char * entries;
+    const char * payload;
+};
+
+class SerialWriter {
+public:
+    explicit SerialWriter(size_t leafBits) : m_leafBits(leafBits) {}
+    void addFull(uint64_t key, uint64_t leaves);
+    void addArray(uint64_t key, const uint16_t * values, size_t count);
+    void addBitmap(uint64_t key, const void * bits, size_t bytes, size_t count);
+    void write(CharBuf * out, size_t valueBits, bool isSigned) const;
+
+private:
+    size_t m_leafBits;
+    vector<SerialEntry> m_entries;
+    string m_bitmaps;
+    string m_arrays;
+    uint64_t m_numValues = 0;
+};
+
+} // namespace
+
+
 template <std::integral T, typename A>
 class IntegralSet<T,A>::Impl {
 public:
@@ -30,6 +101,10 @@ public:
         (kBitWidth - kLeafBits + kStepBits - 1) / kStepBits;
     static_assert(kBaseBits + kLeafBits >= kBitWidth);
 
+    // Parallel operations keep splitting meta nodes into their children for
+    // as long as the nodes being combined have at least this many values.
+    constinit static const size_t kParallelMin = 1 << 16;
+
     constexpr static storage_type valueMask(size_t depth) {
         assert(depth <= kMaxDepth);
         size_t bits = kBitWidth -
@@ -85,6 +160,24 @@ public:
         return 64 * bitNumInt64s();
     }
 
+    // Contiguous values of a kRuns node, ordered by start and separated by at
+    // least one missing value.
+    struct Run {
+        storage_type start;
+        storage_type len;
+    };
+    constexpr static size_t runMaxRuns() {
+        return kDataSize / sizeof (Run);
+    }
+    constexpr static storage_type runFinal(const Run & run) {
+        return run.start + run.len - 1;
+    }
+
+    // The vector kernels (iIntSetVec*) only handle 32-bit values.
+    constexpr static bool vecKernels() {
+        return is_same_v<storage_type, uint32_t>;
+    }
+
     constexpr static value_type toValue(storage_type val) {
         if constexpr (is_signed_v<value_type>) {
             return (value_type) (val + numeric_limits<value_type>::min());
@@ -143,8 +236,23 @@ public:
     static void copy(A * alloc, Node * left, Node && right);
 
     static size_t nodePos(const Node & node, unsigned value);
-    static void grow(A * alloc, Node * node, size_t newCount);
+    static NodeType packedType(size_t depth, size_t values, size_t runs);
+    static size_t numRuns(
+        const storage_type * first,
+        const storage_type * last
+    );
+    static void convert(A * alloc, Node * node, size_t values, size_t runs);
     static bool convertMetaIf(A * alloc, Node * node, NodeType type);
+    static storage_type * metaCounts(const Node & node);
+    static void updateCount(Node * node, const Node & child);
+
+    // runs
+    static Run * runBegin(const Node & node);
+    static Run * runEnd(const Node & node);
+    static Run * runFind(const Node & node, storage_type key);
+    static Run * runReserve(A * alloc, Node * node, size_t count);
+    template <typename Fn>
+    static bool forEachRange(const Node & node, Fn fn);
 
     // init
     static void init(A * alloc, Node * node, bool full);
@@ -154,6 +262,7 @@ public:
     static void initVec(A * alloc, Node * node, bool full);
     static void initBit(A * alloc, Node * node, bool full);
     static void initMeta(A * alloc, Node * node, bool full);
+    static void initRuns(A * alloc, Node * node, bool full);
 
     static void init(A * alloc, Node * node, const Node & from);
     static void initEmpty(A * alloc, Node * node, const Node & from);
@@ -162,6 +271,7 @@ public:
     static void initVec(A * alloc, Node * node, const Node & from);
     static void initBit(A * alloc, Node * node, const Node & from);
     static void initMeta(A * alloc, Node * node, const Node & from);
+    static void initRuns(A * alloc, Node * node, const Node & from);
 
     // destroy
     static void destroy(A * alloc, Node * node);
@@ -205,6 +315,12 @@ public:
         const storage_type * first,
         const storage_type * last
     );
+    static bool insRuns(
+        A * alloc,
+        Node * node,
+        const storage_type * first,
+        const storage_type * last
+    );
 
     static bool insert(A *, Node * node, storage_type start, size_t len);
     static bool insEmpty(A *, Node * node, storage_type start, size_t len);
@@ -212,6 +328,7 @@ public:
     static bool insVec(A *, Node * node, storage_type start, size_t len);
     static bool insBit(A *, Node * node, storage_type start, size_t len);
     static bool insMeta(A *, Node * node, storage_type start, size_t len);
+    static bool insRuns(A *, Node * node, storage_type start, size_t len);
 
     static void insert(A * alloc, Node * left, const Node & right);
     static void insError(A * alloc, Node * left, const Node & right);
@@ -222,23 +339,20 @@ public:
     static void insLVec(A * alloc, Node * left, const Node & right);
     static void insBit(A * alloc, Node * left, const Node & right);
     static void insMeta(A * alloc, Node * left, const Node & right);
-    static void insArray(
-        A * alloc,
-        Node * left,
-        storage_type * li,
-        size_t maxValues,
-        const storage_type * ri,
-        const storage_type * re
-    );
+    static void insRRuns(A * alloc, Node * left, const Node & right);
+    static void insLRuns(A * alloc, Node * left, const Node & right);
 
     static void insert(A * alloc, Node * left, Node && right);
     static void insError(A * alloc, Node * left, Node && right);
     static void insRSmv(A * alloc, Node * left, Node && right);
     static void insLSmv(A * alloc, Node * left, Node && right);
+    static void insVec(A * alloc, Node * left, Node && right);
     static void insRVec(A * alloc, Node * left, Node && right);
     static void insLVec(A * alloc, Node * left, Node && right);
     static void insBit(A * alloc, Node * left, Node && right);
     static void insMeta(A * alloc, Node * left, Node && right);
+    static void insRRuns(A * alloc, Node * left, Node && right);
+    static void insLRuns(A * alloc, Node * left, Node && right);
 
     // erase
     static bool erase(A *, Node * node, storage_type start, size_t len);
@@ -247,6 +361,7 @@ public:
     static bool eraVec(A *, Node * node, storage_type start, size_t len);
     static bool eraBit(A *, Node * node, storage_type start, size_t len);
     static bool eraMeta(A *, Node * node, storage_type start, size_t len);
+    static bool eraRuns(A *, Node * node, storage_type start, size_t len);
 
     static void erase(A * alloc, Node * left, const Node & right);
     static void eraError(A * alloc, Node * left, const Node & right);
@@ -259,6 +374,7 @@ public:
     static void eraRVec(A * alloc, Node * left, const Node & right);
     static void eraBit(A * alloc, Node * left, const Node & right);
     static void eraMeta(A * alloc, Node * left, const Node & right);
+    static void eraRuns(A * alloc, Node * left, const Node & right);
     static void eraArray(
         A * alloc,
         Node * left,
@@ -287,6 +403,8 @@ public:
     static size_t cntVec(const Node & node);
     static size_t cntBit(const Node & node);
     static size_t cntMeta(const Node & node);
+    static size_t cntRuns(const Node & node);
+    static size_t recount(const Node & node);
 
     static size_t count(const Node & node, storage_type start, size_t len);
     static size_t cntEmpty(const Node & node, storage_type start, size_t len);
@@ -295,6 +413,20 @@ public:
     static size_t cntVec(const Node & node, storage_type start, size_t len);
     static size_t cntBit(const Node & node, storage_type start, size_t len);
     static size_t cntMeta(const Node & node, storage_type start, size_t len);
+    static size_t cntRuns(const Node & node, storage_type start, size_t len);
+
+    // rank
+    static size_t rank(const Node & node, storage_type key);
+
+    // select
+    static storage_type select(const Node & node, size_t pos);
+    static storage_type selEmpty(const Node & node, size_t pos);
+    static storage_type selFull(const Node & node, size_t pos);
+    static storage_type selSmv(const Node & node, size_t pos);
+    static storage_type selVec(const Node & node, size_t pos);
+    static storage_type selBit(const Node & node, size_t pos);
+    static storage_type selMeta(const Node & node, size_t pos);
+    static storage_type selRuns(const Node & node, size_t pos);
 
     // find
     static bool find(
@@ -339,6 +471,12 @@ public:
         const Node & node,
         storage_type key
     );
+    static bool findRuns(
+        const Node ** onode,
+        storage_type * ovalue,
+        const Node & node,
+        storage_type key
+    );
 
     // rfind
     static bool rfind(
@@ -371,6 +509,12 @@ public:
         const Node & node,
         storage_type key
     );
+    static bool rfindRuns(
+        const Node ** onode,
+        storage_type * ovalue,
+        const Node & node,
+        storage_type key
+    );
 
     // contig
     static bool contig(
@@ -409,6 +553,12 @@ public:
         const Node & node,
         storage_type key
     );
+    static bool contigRuns(
+        const Node ** onode,
+        storage_type * ovalue,
+        const Node & node,
+        storage_type key
+    );
 
     // rcontig
     static bool rcontig(
@@ -447,6 +597,12 @@ public:
         const Node & node,
         storage_type key
     );
+    static bool rcontigRuns(
+        const Node ** onode,
+        storage_type * ovalue,
+        const Node & node,
+        storage_type key
+    );
 
     // compare
     static int compare(const Node & left, const Node & right);
@@ -462,6 +618,8 @@ public:
     static int cmpMetaIf(const Node & left, const Node & right);
     static int cmpRBitIf(const Node & left, const Node & right);
     static int cmpRMetaIf(const Node & left, const Node & right);
+    static int cmpRunsIf(const Node & left, const Node & right);
+    static int cmpRRunsIf(const Node & left, const Node & right);
     static int cmpIter(const Node & left, const Node & right);
     static int cmpVec(const Node & left, const Node & right);
     static int cmpSmv(const Node & left, const Node & right);
@@ -469,6 +627,7 @@ public:
     static int cmpRSmv(const Node & left, const Node & right);
     static int cmpBit(const Node & left, const Node & right);
     static int cmpMeta(const Node & left, const Node & right);
+    static int cmpRuns(const Node & left, const Node & right);
     static int cmpBit(uint64_t left, uint64_t right);
     static int cmpArray(
         const storage_type * li,
@@ -488,6 +647,7 @@ public:
     static bool conSmv(const Node & left, const Node & right);
     static bool conBit(const Node & left, const Node & right);
     static bool conMeta(const Node & left, const Node & right);
+    static bool conRuns(const Node & left, const Node & right);
     static bool conRArray(
         const Node & left,
         const Node & right,
@@ -516,6 +676,7 @@ public:
     static bool isecSmv(const Node & left, const Node & right);
     static bool isecBit(const Node & left, const Node & right);
     static bool isecMeta(const Node & left, const Node & right);
+    static bool isecRuns(const Node & left, const Node & right);
     static bool isecArray(
         const storage_type * li,
         size_t lcount,
@@ -539,6 +700,8 @@ public:
     static void isecLVec(A * alloc, Node * left, const Node & right);
     static void isecBit(A * alloc, Node * left, const Node & right);
     static void isecMeta(A * alloc, Node * left, const Node & right);
+    static void isecRuns(A * alloc, Node * left, const Node & right);
+    static void isecLRuns(A * alloc, Node * left, const Node & right);
     static void isecArray(
         A * alloc,
         Node * left,
@@ -563,9 +726,283 @@ public:
     static void isecLVec(A * alloc, Node * left, Node && right);
     static void isecBit(A * alloc, Node * left, Node && right);
     static void isecMeta(A * alloc, Node * left, Node && right);
+    static void isecRuns(A * alloc, Node * left, Node && right);
+    static void isecLRuns(A * alloc, Node * left, Node && right);
+
+    // save
+    static void save(SerialWriter * out, const Node & node);
+    static void saveEmpty(SerialWriter * out, const Node & node);
+    static void saveFull(SerialWriter * out, const Node & node);
+    static void saveSmv(SerialWriter * out, const Node & node);
+    static void saveVec(SerialWriter * out, const Node & node);
+    static void saveBit(SerialWriter * out, const Node & node);
+    static void saveMeta(SerialWriter * out, const Node & node);
+    static void saveRuns(SerialWriter * out, const Node & node);
+    static void saveArray(
+        SerialWriter * out,
+        const storage_type * first,
+        const storage_type * last
+    );
+
+    // load
+    static bool load(A * alloc, Node * node, const SerialHeader & hdr);
+    static void loadBit(
+        A * alloc,
+        Node * node,
+        storage_type base,
+        const char * bits,
+        size_t count
+    );
+
+    // parallel
+    // Subtree to be combined with its sources by one of the parallel parts.
+    struct Split {
+        Node * node;
+        size_t first;   // position of its sources in Splits::srcs
+        size_t count;
+    };
+    struct Splits {
+        vector<Split> pieces;
+        vector<const Node *> srcs;
+        vector<Node *> metas; // nodes split into pieces, parents first
+    };
+    using BinaryFn = void(A * alloc, Node * left, const Node & right);
+    using AllFn = void(
+        Splits * out,
+        A * alloc,
+        Node * node,
+        const Node ** first,
+        const Node ** last
+    );
+    static void parallel(
+        A * alloc,
+        Node * left,
+        const Node & right,
+        BinaryFn * op,
+        bool grow
+    );
+    static void parallelAll(
+        A * alloc,
+        Node * node,
+        const Node ** first,
+        const Node ** last,
+        AllFn * fn
+    );
+    static void split(
+        Splits * out,
+        A * alloc,
+        Node * left,
+        const Node & right,
+        bool grow
+    );
+    static void splitAll(
+        Splits * out,
+        A * alloc,
+        Node * node,
+        const Node ** first,
+        const Node ** last,
+        AllFn * fn
+    );
+    static void addSplit(
+        Splits * out,
+        Node * node,
+        const Node * const * first,
+        const Node * const * last
+    );
+    template <typename Fn>
+    static void runSplits(A * alloc, const Splits & splits, Fn fn);
+    static void unionAll(
+        Splits * out,
+        A * alloc,
+        Node * node,
+        const Node ** first,
+        const Node ** last
+    );
+    static void isecAll(
+        Splits * out,
+        A * alloc,
+        Node * node,
+        const Node ** first,
+        const Node ** last
+    );
 };
 
 
+/****************************************************************************
+*
+*   Serialized format
+*
+***/
+
+//===========================================================================
+void SerialWriter::addFull(uint64_t key, uint64_t leaves) {
+    m_numValues += leaves << m_leafBits;
+    if (!m_entries.empty()) {
+        // Extend preceding full range if it's adjacent.
+        auto & prev = m_entries.back();
+        if (prev.type == kSerialFull && prev.key + prev.data == key) {
+            auto num = min<uint64_t>(leaves, UINT32_MAX - prev.data);
+            prev.data += (uint32_t) num;
+            key += num;
+            leaves -= num;
+        }
+    }
+    while (leaves) {
+        auto num = min<uint64_t>(leaves, UINT32_MAX);
+        m_entries.push_back({key, (uint32_t) num, kSerialFull, 0});
+        key += num;
+        leaves -= num;
+    }
+}
+
+//===========================================================================
+void SerialWriter::addArray(
+    uint64_t key,
+    const uint16_t * values,
+    size_t count
+) {
+    assert(count && count <= UINT16_MAX);
+    m_numValues += count;
+    m_entries.push_back({
+        key,
+        (uint32_t) m_arrays.size(),
+        kSerialArray,
+        (uint16_t) count
+    });
+    char buf[sizeof *values];
+    for (size_t i = 0; i < count; ++i) {
+        hton16(buf, values[i]);
+        m_arrays.append(buf, sizeof buf);
+    }
+}
+
+//===========================================================================
+void SerialWriter::addBitmap(
+    uint64_t key,
+    const void * bits,
+    size_t bytes,
+    size_t count
+) {
+    assert(count && count <= UINT16_MAX);
+    assert(bytes % sizeof (uint64_t) == 0);
+    m_numValues += count;
+    m_entries.push_back({
+        key,
+        (uint32_t) m_bitmaps.size(),
+        kSerialBitmap,
+        (uint16_t) count
+    });
+    m_bitmaps.append((const char *) bits, bytes);
+}
+
+//===========================================================================
+void SerialWriter::write(
+    CharBuf * out,
+    size_t valueBits,
+    bool isSigned
+) const {
+    assert(m_bitmaps.size() + m_arrays.size() <= UINT32_MAX);
+    char buf[kSerialHeaderLen];
+    hton32(buf, kSerialMagic);
+    buf[4] = kSerialVersion;
+    buf[5] = (char) valueBits;
+    buf[6] = (char) m_leafBits;
+    buf[7] = isSigned ? kSerialSigned : 0;
+    hton64(buf + 8, m_numValues);
+    hton64(buf + 16, m_entries.size());
+    out->append(buf, sizeof buf);
+
+    // Bitmaps go first in the payload, so they stay 8 byte aligned.
+    for (auto && ent : m_entries) {
+        auto data = ent.data;
+        if (ent.type == kSerialArray)
+            data += (uint32_t) m_bitmaps.size();
+        hton64(buf, ent.key);
+        hton32(buf + 8, data);
+        hton16(buf + 12, ent.type);
+        hton16(buf + 14, ent.count);
+        out->append(buf, kSerialEntryLen);
+    }
+    out->append(m_bitmaps);
+    out->append(m_arrays);
+}
+
+//===========================================================================
+static SerialEntry serialEntry(const char * entries, size_t pos) {
+    auto ptr = entries + pos * kSerialEntryLen;
+    return {ntoh64(ptr), ntoh32(ptr + 8), ntoh16(ptr + 12), ntoh16(ptr + 14)};
+}
+
+//===========================================================================
+// Checks the header and entries, but not the values in the payload.
+static bool parseSerial(
+    SerialHeader * out,
+    string_view src,
+    size_t valueBits,
+    bool isSigned,
+    size_t leafBits
+) {
+    if (src.size() < kSerialHeaderLen)
+        return false;
+    auto ptr = src.data();
+    if (ntoh32(ptr) != kSerialMagic
+        || ptr[4] != kSerialVersion
+        || (size_t) ptr[5] != valueBits
+        || (size_t) ptr[6] != leafBits
+        || ptr[7] != (isSigned ? kSerialSigned : 0)
+    ) {
+        return false;
+    }
+    out->numValues = ntoh64(ptr + 8);
+    auto numEntries = ntoh64(ptr + 16);
+    if (numEntries > (src.size() - kSerialHeaderLen) / kSerialEntryLen)
+        return false;
+    out->numEntries = (size_t) numEntries;
+    out->entries = ptr + kSerialHeaderLen;
+    out->payload = out->entries + out->numEntries * kSerialEntryLen;
+    auto payloadLen = (size_t) (src.data() + src.size() - out->payload);
+
+    auto leafValues = (uint64_t) 1 << leafBits;
+    auto bitmapLen = leafValues / 8;
+    auto numLeaves = (uint64_t) 1 << (valueBits - leafBits);
+    uint64_t nextKey = 0;
+    uint64_t numValues = 0;
+    for (size_t i = 0; i < out->numEntries; ++i) {
+        auto ent = serialEntry(out->entries, i);
+        if (ent.key < nextKey || ent.key >= numLeaves)
+            return false;
+        if (ent.type == kSerialFull) {
+            if (!ent.data || ent.count || ent.data > numLeaves - ent.key)
+                return false;
+            nextKey = ent.key + ent.data;
+            numValues += (uint64_t) ent.data << leafBits;
+            continue;
+        }
+        if (!ent.count || ent.count > leafValues)
+            return false;
+        if (ent.type == kSerialArray) {
+            if (ent.data > payloadLen
+                || payloadLen - ent.data < ent.count * sizeof (uint16_t)
+            ) {
+                return false;
+            }
+        } else if (ent.type == kSerialBitmap) {
+            if (ent.data % sizeof (uint64_t)
+                || ent.data > payloadLen
+                || payloadLen - ent.data < bitmapLen
+            ) {
+                return false;
+            }
+        } else {
+            return false;
+        }
+        nextKey = ent.key + 1;
+        numValues += ent.count;
+    }
+    return numValues == out->numValues;
+}
+
+
 /****************************************************************************
 *
 *   allocate / deallocate
@@ -765,21 +1202,68 @@ size_t IntegralSet<T,A>::Impl::nodePos(const Node & node, unsigned value) {
 }
 
 //===========================================================================
+// Type of the smallest node that can hold the values, given how many runs of
+// contiguous values they form. Runs are only preferred to a vector when they
+// take at most half the space.
+template <std::integral T, typename A>
+auto IntegralSet<T,A>::Impl::packedType(
+    size_t depth,
+    size_t values,
+    size_t runs
+) -> NodeType {
+    if (values <= smvMaxValues()) {
+        return kSmVector;
+    } else if (runs <= runMaxRuns()
+        && (values > vecMaxValues() || 2 * runs <= values)
+    ) {
+        return kRuns;
+    } else if (values <= vecMaxValues()) {
+        return kVector;
+    } else if (depth == kMaxDepth) {
+        return kBitmap;
+    } else {
+        return kMeta;
+    }
+}
+
+//===========================================================================
+template <std::integral T, typename A>
+size_t IntegralSet<T,A>::Impl::numRuns(
+    const storage_type * first,
+    const storage_type * last
+) {
+    if (first == last)
+        return 0;
+    size_t num = 1;
+    for (auto ptr = first + 1; ptr != last; ++ptr) {
+        if (*ptr != ptr[-1] + 1)
+            num += 1;
+    }
+    return num;
+}
+
+//===========================================================================
+// Changes node to the type that best fits the number of values and runs it is
+// about to have, moving the values it has now into it.
 template <std::integral T, typename A>
-void IntegralSet<T,A>::Impl::grow(A * alloc, Node * node, size_t len) {
+void IntegralSet<T,A>::Impl::convert(
+    A * alloc,
+    Node * node,
+    size_t values,
+    size_t runs
+) {
     Node tmp;
     memcpy(&tmp, node, sizeof tmp);
-    if (len <= smvMaxValues()) {
-        node->type = kSmVector;
-    } else if (len <= vecMaxValues()) {
-        node->type = kVector;
-    } else if (tmp.depth == kMaxDepth) {
-        node->type = kBitmap;
+    node->type = packedType(tmp.depth, values, runs);
+    assert(node->type != tmp.type);
+    init(alloc, node, false);
+    if (tmp.type == kRuns) {
+        // Insert the runs as ranges, inserting the node would swap it back in
+        // place of a smaller node.
+        insRRuns(alloc, node, tmp);
     } else {
-        node->type = kMeta;
+        insert(alloc, node, move(tmp));
     }
-    init(alloc, node, false);
-    insert(alloc, node, move(tmp));
     destroy(alloc, &tmp);
 }
 
@@ -804,6 +1288,111 @@ bool IntegralSet<T,A>::Impl::convertMetaIf(
     return true;
 }
 
+//===========================================================================
+// Number of values in each child of a meta node, kept in the same allocation
+// after the child nodes and the trailing kMetaParent node. A child's values
+// always fit, only the domain of the root can be larger than storage_type.
+template <std::integral T, typename A>
+auto IntegralSet<T,A>::Impl::metaCounts(const Node & node) -> storage_type * {
+    assert(node.type == kMeta);
+    return (storage_type *) (node.nodes + node.numValues + 1);
+}
+
+//===========================================================================
+// Refreshes the count kept by the meta node after one of its children has
+// changed.
+template <std::integral T, typename A>
+void IntegralSet<T,A>::Impl::updateCount(Node * node, const Node & child) {
+    auto pos = &child - node->nodes;
+    assert(pos >= 0 && pos < node->numValues);
+    metaCounts(*node)[pos] = (storage_type) count(child);
+}
+
+
+/****************************************************************************
+*
+*   Runs
+*
+***/
+
+//===========================================================================
+template <std::integral T, typename A>
+auto IntegralSet<T,A>::Impl::runBegin(const Node & node) -> Run * {
+    assert(node.type == kRuns);
+    return (Run *) node.values;
+}
+
+//===========================================================================
+template <std::integral T, typename A>
+auto IntegralSet<T,A>::Impl::runEnd(const Node & node) -> Run * {
+    return runBegin(node) + node.numValues;
+}
+
+//===========================================================================
+// Returns first run that ends at or after key, or runEnd() if there are none.
+template <std::integral T, typename A>
+auto IntegralSet<T,A>::Impl::runFind(
+    const Node & node,
+    storage_type key
+) -> Run * {
+    auto first = runBegin(node);
+    auto last = runEnd(node);
+    auto ptr = upper_bound(
+        first,
+        last,
+        key,
+        [](storage_type key, const Run & run) { return key < run.start; }
+    );
+    if (ptr != first && runFinal(ptr[-1]) >= key)
+        ptr -= 1;
+    return ptr;
+}
+
+//===========================================================================
+// Makes room for count runs, the space is doubled as needed so it only grows
+// as large as the runs require.
+template <std::integral T, typename A>
+auto IntegralSet<T,A>::Impl::runReserve(
+    A * alloc,
+    Node * node,
+    size_t count
+) -> Run * {
+    assert(count <= runMaxRuns());
+    if (auto bytes = count * sizeof (Run); bytes > node->numBytes) {
+        bytes = bit_ceil(bytes);
+        auto values = (storage_type *) allocate(alloc, bytes);
+        assert(values);
+        memcpy(values, node->values, node->numValues * sizeof (Run));
+        deallocate(alloc, node->values, node->numBytes);
+        node->values = values;
+        node->numBytes = (uint16_t) bytes;
+    }
+    return runBegin(*node);
+}
+
+//===========================================================================
+// Calls fn(start, len) for each range of contiguous values in the node, a
+// range that crosses into other child nodes of a meta node may be split.
+// Returns false if stopped early by fn returning false.
+template <std::integral T, typename A>
+template <typename Fn>
+bool IntegralSet<T,A>::Impl::forEachRange(const Node & node, Fn fn) {
+    const Node * onode;
+    storage_type first;
+    auto key = absBase(node);
+    for (;;) {
+        if (!find(&onode, &first, node, key))
+            return true;
+        auto last = first;
+        contig(&onode, &last, node, first);
+        if (!fn(first, (size_t) (last - first) + 1))
+            return false;
+        if (last == absFinal(node))
+            return true;
+        key = last + 1;
+    }
+}
+
 
 /****************************************************************************
 *
@@ -822,6 +1411,7 @@ void IntegralSet<T,A>::Impl::init(A * alloc, Node * node, bool full) {
         initVec,
         initBit,
         initMeta,
+        initRuns,
     };
     return functs[node->type](alloc, node, full);
 }
@@ -887,7 +1477,8 @@ template <std::integral T, typename A>
 void IntegralSet<T,A>::Impl::initMeta(A * alloc, Node * node, bool full) {
     assert(node->type == kMeta);
     node->numValues = (uint16_t) numNodes(node->depth + 1);
-    node->numBytes = (uint16_t) (node->numValues + 1) * sizeof *node->nodes;
+    node->numBytes = (uint16_t) ((node->numValues + 1) * sizeof *node->nodes
+        + node->numValues * sizeof (storage_type));
     node->nodes = (Node *) allocate(alloc, node->numBytes);
     assert(node->nodes);
     Node def;
@@ -911,6 +1502,19 @@ void IntegralSet<T,A>::Impl::initMeta(A * alloc, Node * node, bool full) {
     memset(nlast, 0, sizeof *nlast);
     nlast->type = kMetaParent;
     nlast->nodes = node;
+
+    fill_n(metaCounts(*node), node->numValues, full ? absSize(def) : 0);
+}
+
+//===========================================================================
+template <std::integral T, typename A>
+void IntegralSet<T,A>::Impl::initRuns(A * alloc, Node * node, bool full) {
+    assert(node->type == kRuns);
+    assert(!full);
+    node->numBytes = sizeof (Run);
+    node->numValues = 0;
+    node->values = (storage_type *) allocate(alloc, node->numBytes);
+    assert(node->values);
 }
 
 
@@ -935,6 +1539,7 @@ void IntegralSet<T,A>::Impl::init(
         initVec,
         initBit,
         initMeta,
+        initRuns,
     };
     return functs[node->type](alloc, node, from);
 }
@@ -1027,6 +1632,27 @@ void IntegralSet<T,A>::Impl::initMeta(
     // Copy and update kMetaParent node.
     memcpy(nlast, fptr, sizeof *nlast);
     nlast->nodes = node;
+
+    memcpy(
+        metaCounts(*node),
+        metaCounts(from),
+        node->numValues * sizeof (storage_type)
+    );
+}
+
+//===========================================================================
+template <std::integral T, typename A>
+void IntegralSet<T,A>::Impl::initRuns(
+    A * alloc,
+    Node * node,
+    const Node & from
+) {
+    assert(node->type == kRuns);
+    assert(from.type == kRuns);
+    memcpy(node, &from, sizeof *node);
+    node->values = (storage_type *) allocate(alloc, node->numBytes);
+    assert(node->values);
+    memcpy(node->values, from.values, node->numValues * sizeof (Run));
 }
 
 
@@ -1047,6 +1673,7 @@ void IntegralSet<T,A>::Impl::destroy(A * alloc, Node * node) {
         desFree,    // vector
         desFree,    // bitmap
         desMeta,    // meta
+        desFree,    // runs
     };
     functs[node->type](alloc, node);
 }
@@ -1102,6 +1729,7 @@ bool IntegralSet<T,A>::Impl::insert(
         insVec,     // vector
         insBit,     // bitmap
         insMeta,    // meta
+        insRuns,    // runs
     };
     return functs[node->type](alloc, node, first, last);
 }
@@ -1191,7 +1819,34 @@ bool IntegralSet<T,A>::Impl::insMeta(
         auto mid = first + 1;
         while (mid != last && *mid > *first && *mid <= final)
             mid += 1;
-        changed = insert(alloc, ptr, first, mid) || changed;
+        if (insert(alloc, ptr, first, mid)) {
+            changed = true;
+            updateCount(node, *ptr);
+        }
+        first = mid;
+    }
+    return changed;
+}
+
+//===========================================================================
+template <std::integral T, typename A>
+bool IntegralSet<T,A>::Impl::insRuns(
+    A * alloc,
+    Node * node,
+    const storage_type * first,
+    const storage_type * last
+) {
+    bool changed = false;
+    while (first != last) {
+        if (node->type != kRuns) {
+            return insert(alloc, node, first, last)
+                || changed;
+        }
+        // Insert each group of contiguous values as a single range.
+        auto mid = first + 1;
+        while (mid != last && *mid > mid[-1] && *mid - mid[-1] == 1)
+            mid += 1;
+        changed = insert(alloc, node, *first, mid - first) || changed;
         first = mid;
     }
     return changed;
@@ -1220,6 +1875,7 @@ bool IntegralSet<T,A>::Impl::insert(
         insVec,     // vector
         insBit,     // bitmap
         insMeta,    // meta
+        insRuns,    // runs
     };
     return functs[node->type](alloc, node, start, len);
 }
@@ -1236,7 +1892,7 @@ bool IntegralSet<T,A>::Impl::insEmpty(
     assert(len);
     assert(relBase(start, node->depth) == node->base);
     assert(len - 1 <= absFinal(*node) - start);
-    grow(alloc, node, len);
+    convert(alloc, node, len, 1);
     insert(alloc, node, start, len);
     return true;
 }
@@ -1264,7 +1920,8 @@ bool IntegralSet<T,A>::Impl::insSmv(
         return false;
     auto num = nBelow + len + nAbove;
     if (num > smvMaxValues()) {
-        grow(alloc, node, num);
+        auto runs = numRuns(node->localValues, last) + 1;
+        convert(alloc, node, num, runs);
         return insert(alloc, node, start, len);
     }
 
@@ -1302,7 +1959,8 @@ bool IntegralSet<T,A>::Impl::insVec(
         return false;
     auto num = nBelow + len + nAbove;
     if (num > vecMaxValues()) {
-        grow(alloc, node, num);
+        auto runs = numRuns(node->values, last) + 1;
+        convert(alloc, node, num, runs);
         return insert(alloc, node, start, len);
     }
 
@@ -1390,9 +2048,16 @@ bool IntegralSet<T,A>::Impl::insMeta(
             if (ptr->type != kFull) {
                 changed = true;
                 fill(alloc, ptr);
+                updateCount(node, *ptr);
             }
         } else if (insert(alloc, ptr, (storage_type) st, cnt)) {
             changed = true;
+            if (cnt == 1) {
+                // Single values are the common case, skip the recount.
+                metaCounts(*node)[ptr - node->nodes] += 1;
+            } else {
+                updateCount(node, *ptr);
+            }
             if (ptr->type != kFull)
                 maybeFull = false;
         }
@@ -1403,8 +2068,63 @@ bool IntegralSet<T,A>::Impl::insMeta(
     return changed;
 }
 
-
-/****************************************************************************
+//===========================================================================
+template <std::integral T, typename A>
+bool IntegralSet<T,A>::Impl::insRuns(
+    A * alloc,
+    Node * node,
+    storage_type start,
+    size_t len
+) {
+    assert(node->type == kRuns);
+    assert(len);
+    assert(relBase(start, node->depth) == node->base);
+    assert(len - 1 <= absFinal(*node) - start);
+    auto final = (storage_type) (start + len - 1);
+
+    // Runs from ptr to eptr overlap or are adjacent to the new range and get
+    // merged with it.
+    auto ptr = runFind(*node, start > absBase(*node) ? start - 1 : start);
+    auto last = runEnd(*node);
+    auto eptr = ptr;
+    while (eptr != last && (eptr->start <= final || eptr->start - final == 1))
+        eptr += 1;
+    auto num = eptr - ptr;
+    if (num == 1 && ptr->start <= start && runFinal(*ptr) >= final)
+        return false;
+    if (num) {
+        start = min(start, ptr->start);
+        final = max(final, runFinal(eptr[-1]));
+    }
+    if (num == node->numValues
+        && start == absBase(*node)
+        && final == absFinal(*node)
+    ) {
+        fill(alloc, node);
+        return true;
+    }
+
+    if (num) {
+        *ptr = {start, (storage_type) (final - start + 1)};
+        memmove(ptr + 1, eptr, (last - eptr) * sizeof *ptr);
+        node->numValues -= (uint16_t) (num - 1);
+        return true;
+    }
+    if (node->numValues == runMaxRuns()) {
+        // No room for another run.
+        convert(alloc, node, cntRuns(*node) + len, node->numValues + 1);
+        return insert(alloc, node, start, len);
+    }
+    auto pos = ptr - runBegin(*node);
+    ptr = runReserve(alloc, node, node->numValues + 1) + pos;
+    memmove(ptr + 1, ptr, (node->numValues - pos) * sizeof *ptr);
+    *ptr = {start, (storage_type) len};
+    node->numValues += 1;
+    return true;
+}
+
+
+/****************************************************************************
 *
 *   erase(A * alloc, Node * node, storage_type start, size_t len)
 *
@@ -1426,6 +2146,7 @@ bool IntegralSet<T,A>::Impl::erase(
         eraVec,     // vector
         eraBit,     // bitmap
         eraMeta,    // meta
+        eraRuns,    // runs
     };
     return functs[node->type](alloc, node, start, len);
 }
@@ -1441,14 +2162,24 @@ bool IntegralSet<T,A>::Impl::eraFull(
     assert(len);
     assert(relBase(start, node->depth) == node->base);
     assert(len - 1 <= absFinal(*node) - start);
+    auto final = (storage_type) (start + len - 1);
+
+    // What's left is at most a run on either side of the erased range.
     destroy(alloc, node);
-    if (node->depth == kMaxDepth) {
-        node->type = kBitmap;
-    } else {
-        node->type = kMeta;
+    node->type = kRuns;
+    init(alloc, node, false);
+    auto first = runReserve(alloc, node, 2);
+    auto ptr = first;
+    if (auto base = absBase(*node); start > base)
+        *ptr++ = {base, (storage_type) (start - base)};
+    if (auto nodeFinal = absFinal(*node); final < nodeFinal)
+        *ptr++ = {(storage_type) (final + 1), nodeFinal - final};
+    node->numValues = (uint16_t) (ptr - first);
+    if (!node->numValues) {
+        clear(alloc, node);
+    } else if (auto num = cntRuns(*node); num <= smvMaxValues()) {
+        convert(alloc, node, num, node->numValues);
     }
-    init(alloc, node, true);
-    erase(alloc, node, start, len);
     return true;
 }
 
@@ -1589,9 +2320,15 @@ bool IntegralSet<T,A>::Impl::eraMeta(
             if (ptr->type != kEmpty) {
                 changed = true;
                 clear(alloc, ptr);
+                updateCount(node, *ptr);
             }
         } else if (erase(alloc, ptr, (storage_type) st, cnt)) {
             changed = true;
+            if (cnt == 1) {
+                metaCounts(*node)[ptr - node->nodes] -= 1;
+            } else {
+                updateCount(node, *ptr);
+            }
             if (ptr->type != kEmpty)
                 maybeEmpty = false;
         }
@@ -1602,6 +2339,60 @@ bool IntegralSet<T,A>::Impl::eraMeta(
     return changed;
 }
 
+//===========================================================================
+template <std::integral T, typename A>
+bool IntegralSet<T,A>::Impl::eraRuns(
+    A * alloc,
+    Node * node,
+    storage_type start,
+    size_t len
+) {
+    assert(node->type == kRuns);
+    assert(len);
+    assert(relBase(start, node->depth) == node->base);
+    assert(len - 1 <= absFinal(*node) - start);
+    auto final = (storage_type) (start + len - 1);
+    auto ptr = runFind(*node, start);
+    auto last = runEnd(*node);
+    if (ptr == last || ptr->start > final)
+        return false;
+    auto eptr = ptr + 1;
+    while (eptr != last && eptr->start <= final)
+        eptr += 1;
+
+    // Keep the parts of the first and last overlapped runs that are outside
+    // of the erased range.
+    Run keep[2];
+    size_t numKeep = 0;
+    if (ptr->start < start)
+        keep[numKeep++] = {ptr->start, (storage_type) (start - ptr->start)};
+    if (auto efinal = runFinal(eptr[-1]); efinal > final)
+        keep[numKeep++] = {(storage_type) (final + 1), efinal - final};
+    size_t num = eptr - ptr;
+    auto count = node->numValues - num + numKeep;
+    if (!count) {
+        clear(alloc, node);
+        return true;
+    }
+    if (count > runMaxRuns()) {
+        // Splitting the run would leave too many.
+        convert(alloc, node, cntRuns(*node), count);
+        return erase(alloc, node, start, len);
+    }
+
+    auto pos = ptr - runBegin(*node);
+    size_t numAbove = last - eptr;
+    ptr = runReserve(alloc, node, count) + pos;
+    memmove(ptr + numKeep, ptr + num, numAbove * sizeof *ptr);
+    memcpy(ptr, keep, numKeep * sizeof *ptr);
+    node->numValues = (uint16_t) count;
+    if (count <= smvMaxValues()) {
+        if (auto values = cntRuns(*node); values <= smvMaxValues())
+            convert(alloc, node, values, count);
+    }
+    return true;
+}
+
 
 /****************************************************************************
 *
@@ -1620,6 +2411,7 @@ size_t IntegralSet<T,A>::Impl::count(const Node & node) {
         cntVec,     // vector
         cntBit,     // bitmap
         cntMeta,    // meta
+        cntRuns,    // runs
     };
     return functs[node.type](node);
 }
@@ -1659,11 +2451,35 @@ size_t IntegralSet<T,A>::Impl::cntBit(const Node & node) {
 //===========================================================================
 template <std::integral T, typename A>
 size_t IntegralSet<T,A>::Impl::cntMeta(const Node & node) {
+    auto counts = metaCounts(node);
+    return accumulate(counts, counts + node.numValues, (size_t) 0);
+}
+
+//===========================================================================
+template <std::integral T, typename A>
+size_t IntegralSet<T,A>::Impl::cntRuns(const Node & node) {
     size_t num = 0;
-    auto * ptr = node.nodes;
-    auto * last = ptr + node.numValues;
+    auto ptr = runBegin(node);
+    auto last = runEnd(node);
     for (; ptr != last; ++ptr)
-        num += count(*ptr);
+        num += ptr->len;
+    return num;
+}
+
+//===========================================================================
+// Counts the values without using the counts kept by meta nodes, asserting
+// along the way that they match.
+template <std::integral T, typename A>
+size_t IntegralSet<T,A>::Impl::recount(const Node & node) {
+    if (node.type != kMeta)
+        return count(node);
+    auto counts = metaCounts(node);
+    size_t num = 0;
+    for (unsigned i = 0; i < node.numValues; ++i) {
+        auto cnt = recount(node.nodes[i]);
+        assert(cnt == counts[i]);
+        num += cnt;
+    }
     return num;
 }
 
@@ -1689,6 +2505,7 @@ size_t IntegralSet<T,A>::Impl::count(
         cntVec,     // vector
         cntBit,     // bitmap
         cntMeta,    // meta
+        cntRuns,    // runs
     };
     return functs[node.type](node, start, len);
 }
@@ -1786,14 +2603,179 @@ size_t IntegralSet<T,A>::Impl::cntMeta(
     auto upper = node.nodes + finalPos;
     size_t num = 0;
     num += count(*lower, start, absFinal(*lower) - start + 1);
-    for (auto ptr = lower + 1; ptr < upper; ++ptr) {
-        num += count(*ptr);
+    auto counts = metaCounts(node);
+    num = accumulate(counts + pos + 1, counts + finalPos, num);
+    num += count(*upper, absBase(*upper), start + len - absBase(*upper));
+    return num;
+}
+
+//===========================================================================
+template <std::integral T, typename A>
+size_t IntegralSet<T,A>::Impl::cntRuns(
+    const Node & node,
+    storage_type start,
+    size_t len
+) {
+    assert(len);
+    assert(relBase(start, node.depth) == node.base);
+    assert(len - 1 <= absFinal(node) - start);
+    auto final = (storage_type) (start + len - 1);
+    auto ptr = runFind(node, start);
+    auto last = runEnd(node);
+    size_t num = 0;
+    for (; ptr != last && ptr->start <= final; ++ptr) {
+        auto low = max(ptr->start, start);
+        auto high = min(runFinal(*ptr), final);
+        num += (size_t) (high - low) + 1;
     }
-    num += count(*upper, absBase(*upper), start + len - 1);
     return num;
 }
 
 
+/****************************************************************************
+*
+*   rank(const Node & node, storage_type key)
+*
+*   Number of values less than key.
+*
+***/
+
+//===========================================================================
+template <std::integral T, typename A>
+size_t IntegralSet<T,A>::Impl::rank(const Node & node, storage_type key) {
+    assert(relBase(key, node.depth) == node.base);
+    if (node.type == kMeta) {
+        auto pos = nodePos(node, key);
+        auto counts = metaCounts(node);
+        return accumulate(counts, counts + pos, (size_t) 0)
+            + rank(node.nodes[pos], key);
+    }
+    auto base = absBase(node);
+    return key == base ? 0 : count(node, base, key - base);
+}
+
+
+/****************************************************************************
+*
+*   select(const Node & node, size_t pos)
+*
+*   Value at position pos, which must be less than count(node).
+*
+***/
+
+//===========================================================================
+template <std::integral T, typename A>
+auto IntegralSet<T,A>::Impl::select(
+    const Node & node,
+    size_t pos
+) -> storage_type {
+    using Fn = storage_type(const Node & node, size_t pos);
+    constinit static Fn * const functs[kNodeTypes] = {
+        selEmpty,   // empty
+        selFull,    // full
+        selSmv,     // small vector
+        selVec,     // vector
+        selBit,     // bitmap
+        selMeta,    // meta
+        selRuns,    // runs
+    };
+    return functs[node.type](node, pos);
+}
+
+//===========================================================================
+template <std::integral T, typename A>
+auto IntegralSet<T,A>::Impl::selEmpty(
+    const Node & node,
+    size_t pos
+) -> storage_type {
+    assert(!"select: position past end of node");
+    return absBase(node);
+}
+
+//===========================================================================
+template <std::integral T, typename A>
+auto IntegralSet<T,A>::Impl::selFull(
+    const Node & node,
+    size_t pos
+) -> storage_type {
+    assert(pos < absSize(node));
+    return absBase(node) + (storage_type) pos;
+}
+
+//===========================================================================
+template <std::integral T, typename A>
+auto IntegralSet<T,A>::Impl::selSmv(
+    const Node & node,
+    size_t pos
+) -> storage_type {
+    assert(pos < node.numValues);
+    return node.localValues[pos];
+}
+
+//===========================================================================
+template <std::integral T, typename A>
+auto IntegralSet<T,A>::Impl::selVec(
+    const Node & node,
+    size_t pos
+) -> storage_type {
+    assert(pos < node.numValues);
+    return node.values[pos];
+}
+
+//===========================================================================
+template <std::integral T, typename A>
+auto IntegralSet<T,A>::Impl::selBit(
+    const Node & node,
+    size_t pos
+) -> storage_type {
+    auto words = (const uint64_t *) node.values;
+    for (size_t i = 0; i < bitNumInt64s(); ++i) {
+        if (auto num = (size_t) popcount(words[i]); pos >= num) {
+            pos -= num;
+            continue;
+        }
+        // Bits are numbered from the high order bit of the big-endian word,
+        // same as BitView.
+        auto word = ntoh64(words + i);
+        for (; pos; --pos)
+            word &= ~bit_floor(word);
+        auto bit = i * BitView::kWordBits + countl_zero(word);
+        return absBase(node) + (storage_type) bit;
+    }
+    assert(!"select: position past end of node");
+    return absFinal(node);
+}
+
+//===========================================================================
+template <std::integral T, typename A>
+auto IntegralSet<T,A>::Impl::selMeta(
+    const Node & node,
+    size_t pos
+) -> storage_type {
+    auto counts = metaCounts(node);
+    auto ptr = node.nodes;
+    for (; pos >= *counts; ++ptr, ++counts) {
+        pos -= *counts;
+        assert(ptr + 1 != node.nodes + node.numValues);
+    }
+    return select(*ptr, pos);
+}
+
+//===========================================================================
+template <std::integral T, typename A>
+auto IntegralSet<T,A>::Impl::selRuns(
+    const Node & node,
+    size_t pos
+) -> storage_type {
+    auto ptr = runBegin(node);
+    for (; pos >= ptr->len; ++ptr) {
+        pos -= ptr->len;
+        assert(ptr + 1 != runEnd(node));
+    }
+    return ptr->start + (storage_type) pos;
+}
+
+
 /****************************************************************************
 *
 *   find(
@@ -1828,6 +2810,7 @@ bool IntegralSet<T,A>::Impl::find(
         findVec,     // vector
         findBit,     // bitmap
         findMeta,    // meta
+        findRuns,    // runs
     };
     return functs[node.type](onode, ovalue, node, key);
 }
@@ -1938,6 +2921,23 @@ bool IntegralSet<T,A>::Impl::findMeta(
     }
 }
 
+//===========================================================================
+template <std::integral T, typename A>
+bool IntegralSet<T,A>::Impl::findRuns(
+    const Node ** onode,
+    storage_type * ovalue,
+    const Node & node,
+    storage_type key
+) {
+    assert(relBase(key, node.depth) == node.base);
+    auto ptr = runFind(node, key);
+    if (ptr == runEnd(node))
+        return false;
+    *onode = &node;
+    *ovalue = max(key, ptr->start);
+    return true;
+}
+
 
 /****************************************************************************
 *
@@ -1973,6 +2973,7 @@ bool IntegralSet<T,A>::Impl::rfind(
         rfindVec,     // vector
         rfindBit,     // bitmap
         rfindMeta,    // meta
+        rfindRuns,    // runs
     };
     return functs[node.type](onode, ovalue, node, key);
 }
@@ -1993,7 +2994,7 @@ bool IntegralSet<T,A>::Impl::rfindSmv(
     } else {
         // base > *node.localValues
         auto last = node.localValues + node.numValues;
-        auto ptr = lower_bound(node.localValues + 1, last, key);
+        auto ptr = upper_bound(node.localValues + 1, last, key);
         *ovalue = ptr[-1];
     }
     *onode = &node;
@@ -2016,7 +3017,7 @@ bool IntegralSet<T,A>::Impl::rfindVec(
     } else {
         // base > *node.values
         auto last = node.values + node.numValues;
-        auto ptr = lower_bound(node.values + 1, last, key);
+        auto ptr = upper_bound(node.values + 1, last, key);
         *ovalue = ptr[-1];
     }
     *onode = &node;
@@ -2065,6 +3066,27 @@ bool IntegralSet<T,A>::Impl::rfindMeta(
     }
 }
 
+//===========================================================================
+template <std::integral T, typename A>
+bool IntegralSet<T,A>::Impl::rfindRuns(
+    const Node ** onode,
+    storage_type * ovalue,
+    const Node & node,
+    storage_type key
+) {
+    assert(relBase(key, node.depth) == node.base);
+    auto ptr = runFind(node, key);
+    if (ptr == runEnd(node) || ptr->start > key) {
+        // Not within a run, use the end of the preceding one.
+        if (ptr == runBegin(node))
+            return false;
+        ptr -= 1;
+    }
+    *onode = &node;
+    *ovalue = min(key, runFinal(*ptr));
+    return true;
+}
+
 
 /****************************************************************************
 *
@@ -2101,6 +3123,7 @@ bool IntegralSet<T,A>::Impl::contig(
         contigVec,      // vector
         contigBit,      // bitmap
         contigMeta,     // meta
+        contigRuns,     // runs
     };
     return functs[node.type](onode, ovalue, node, key);
 }
@@ -2232,6 +3255,28 @@ bool IntegralSet<T,A>::Impl::contigMeta(
     }
 }
 
+//===========================================================================
+template <std::integral T, typename A>
+bool IntegralSet<T,A>::Impl::contigRuns(
+    const Node ** onode,
+    storage_type * ovalue,
+    const Node & node,
+    storage_type key
+) {
+    assert(relBase(key, node.depth) == node.base);
+    auto ptr = runFind(node, key);
+    if (ptr == runEnd(node) || ptr->start > key) {
+        // Base not found, return that search is done, but leave output node and
+        // value unchanged.
+        return true;
+    }
+    *onode = &node;
+    *ovalue = runFinal(*ptr);
+
+    // May extend into following node.
+    return *ovalue != absFinal(node);
+}
+
 
 /****************************************************************************
 *
@@ -2268,6 +3313,7 @@ bool IntegralSet<T,A>::Impl::rcontig(
         rcontigVec,     // vector
         rcontigBit,     // bitmap
         rcontigMeta,    // meta
+        rcontigRuns,    // runs
     };
     return functs[node.type](onode, ovalue, node, key);
 }
@@ -2389,18 +3435,40 @@ bool IntegralSet<T,A>::Impl::rcontigMeta(
 ) {
     auto pos = nodePos(node, key);
     auto ptr = (const Node *) node.nodes + pos;
-    auto last = node.nodes + node.numValues;
     for (;;) {
         if (rcontig(onode, ovalue, *ptr, key))
             return true;
         *onode = ptr;
         *ovalue = absBase(*ptr);
-        if (++ptr == last)
+        if (ptr == node.nodes)
             return false;
+        ptr -= 1;
         key = absFinal(*ptr);
     }
 }
 
+//===========================================================================
+template <std::integral T, typename A>
+bool IntegralSet<T,A>::Impl::rcontigRuns(
+    const Node ** onode,
+    storage_type * ovalue,
+    const Node & node,
+    storage_type key
+) {
+    assert(relBase(key, node.depth) == node.base);
+    auto ptr = runFind(node, key);
+    if (ptr == runEnd(node) || ptr->start > key) {
+        // Base not found, return that search is done, but leave output node and
+        // value unchanged.
+        return true;
+    }
+    *onode = &node;
+    *ovalue = ptr->start;
+
+    // May extend into preceding node.
+    return ptr->start != absBase(node);
+}
+
 
 /****************************************************************************
 *
@@ -2428,12 +3496,21 @@ int IntegralSet<T,A>::Impl::compare(const Node & left, const Node & right) {
     static Fn * functs[][kNodeTypes] = {
 // LEFT                         RIGHT
 //         empty      full        sm vec     vector     bitmap     meta
-/*empty*/{ cmpEqual,  cmpLessIf,  cmpLessIf, cmpLessIf, cmpLessIf, cmpLessIf },
-/*full */{ cmpMoreIf, cmpEqual,   cmpSmvIf,  cmpVecIf,  cmpBitIf,  cmpMetaIf },
-/*smv  */{ cmpMoreIf, cmpRSmvIf,  cmpSmv,    cmpLSmv,   cmpIter,   cmpIter   },
-/*vec  */{ cmpMoreIf, cmpRVecIf,  cmpRSmv,   cmpVec,    cmpIter,   cmpIter   },
-/*bit  */{ cmpMoreIf, cmpRBitIf,  cmpIter,   cmpIter,   cmpBit,    cmpError  },
-/*meta */{ cmpMoreIf, cmpRMetaIf, cmpIter,   cmpIter,   cmpError,  cmpMeta   },
+//         runs
+/*empty*/{ cmpEqual,  cmpLessIf,  cmpLessIf, cmpLessIf, cmpLessIf, cmpLessIf,
+           cmpLessIf },
+/*full */{ cmpMoreIf, cmpEqual,   cmpSmvIf,  cmpVecIf,  cmpBitIf,  cmpMetaIf,
+           cmpRunsIf },
+/*smv  */{ cmpMoreIf, cmpRSmvIf,  cmpSmv,    cmpLSmv,   cmpIter,   cmpIter,
+           cmpRuns },
+/*vec  */{ cmpMoreIf, cmpRVecIf,  cmpRSmv,   cmpVec,    cmpIter,   cmpIter,
+           cmpRuns },
+/*bit  */{ cmpMoreIf, cmpRBitIf,  cmpIter,   cmpIter,   cmpBit,    cmpError,
+           cmpRuns },
+/*meta */{ cmpMoreIf, cmpRMetaIf, cmpIter,   cmpIter,   cmpError,  cmpMeta,
+           cmpRuns },
+/*runs */{ cmpMoreIf, cmpRRunsIf, cmpRuns,   cmpRuns,   cmpRuns,   cmpRuns,
+           cmpRuns },
     };
     return functs[left.type][right.type](left, right);
 }
@@ -2556,6 +3633,22 @@ int IntegralSet<T,A>::Impl::cmpRMetaIf(const Node & left, const Node & right) {
     return -cmpMetaIf(right, left);
 }
 
+//===========================================================================
+template <std::integral T, typename A>
+int IntegralSet<T,A>::Impl::cmpRunsIf(const Node & left, const Node & right) {
+    if (right.numValues == 1 && runBegin(right)->start == absBase(right)) {
+        return 2;
+    } else {
+        return -1;
+    }
+}
+
+//===========================================================================
+template <std::integral T, typename A>
+int IntegralSet<T,A>::Impl::cmpRRunsIf(const Node & left, const Node & right) {
+    return -cmpRunsIf(right, left);
+}
+
 //===========================================================================
 template <std::integral T, typename A>
 int IntegralSet<T,A>::Impl::cmpIter(const Node & left, const Node & right) {
@@ -2705,6 +3798,30 @@ int IntegralSet<T,A>::Impl::cmpMeta(const Node & left, const Node & right) {
     }
 }
 
+//===========================================================================
+// Compares a range at a time, like cmpIter it continues past the end of the
+// nodes to the end of their sets.
+template <std::integral T, typename A>
+int IntegralSet<T,A>::Impl::cmpRuns(const Node & left, const Node & right) {
+    auto li = range_iterator{iterator::makeFirst(&left)};
+    auto ri = range_iterator{iterator::makeFirst(&right)};
+    for (;; ++li, ++ri) {
+        if (!li)
+            return !ri ? 0 : -2;
+        if (!ri)
+            return 2;
+        if (li->first != ri->first)
+            return li->first > ri->first ? 1 : -1;
+        if (li->second != ri->second) {
+            // The shorter range is followed by a gap, making its set greater
+            // if it has any more values.
+            if (li->second < ri->second)
+                return ++li ? 1 : -2;
+            return ++ri ? -1 : 2;
+        }
+    }
+}
+
 
 /****************************************************************************
 *
@@ -2718,13 +3835,14 @@ bool IntegralSet<T,A>::Impl::contains(const Node & left, const Node & right) {
     using Fn = bool(const Node & left, const Node & right);
     static Fn * const functs[][kNodeTypes] = {
 // LEFT                       RIGHT
-//         empty  full  sm vec   vector   bitmap    meta
-/*empty*/{ yes,   no,   no,      no,      no,       no    },
-/*full */{ yes,   yes,  yes,     yes,     yes,      yes   },
-/*smv  */{ yes,   no,   conSmv,  conLSmv, conLSmv,  conLSmv  },
-/*vec  */{ yes,   no,   conRSmv, conVec,  conLVec,  conLVec  },
-/*bit  */{ yes,   no,   conRSmv, conRVec, conBit,   conError },
-/*meta */{ yes,   no,   conRSmv, conRVec, conError, conMeta  },
+//         empty full sm vec   vector   bitmap    meta      runs
+/*empty*/{ yes,  no,  no,      no,      no,       no,       no      },
+/*full */{ yes,  yes, yes,     yes,     yes,      yes,      yes     },
+/*smv  */{ yes,  no,  conSmv,  conLSmv, conLSmv,  conLSmv,  conLSmv },
+/*vec  */{ yes,  no,  conRSmv, conVec,  conLVec,  conLVec,  conLVec },
+/*bit  */{ yes,  no,  conRSmv, conRVec, conBit,   conError, conRuns },
+/*meta */{ yes,  no,  conRSmv, conRVec, conError, conMeta,  conRuns },
+/*runs */{ yes,  no,  conRSmv, conRVec, conRuns,  conRuns,  conRuns },
     };
     return functs[left.type][right.type](left, right);
 }
@@ -2745,6 +3863,20 @@ bool IntegralSet<T,A>::Impl::conRArray(
     const Node & right,
     const storage_type * ri
 ) {
+    if constexpr (vecKernels()) {
+        if (left.type == kBitmap) {
+            auto found = iIntSetVecProbe(
+                nullptr,
+                ri,
+                right.numValues,
+                (const uint64_t *) left.values,
+                absBase(left),
+                true
+            );
+            return found == right.numValues;
+        }
+    }
+
     auto re = ri + right.numValues;
     const Node * onode;
     storage_type ovalue;
@@ -2850,17 +3982,11 @@ bool IntegralSet<T,A>::Impl::conSmv(const Node& left, const Node& right) {
 //===========================================================================
 template <std::integral T, typename A>
 bool IntegralSet<T,A>::Impl::conBit(const Node & left, const Node & right) {
-    auto li = (uint64_t *) left.values;
-    auto le = li + kDataSize / sizeof *li;
-    auto ri = (uint64_t *) right.values;
-
-    for (;;) {
-        if (*ri != (*li & *ri))
-            return false;
-        if (++li == le)
-            return true;
-        ++ri;
-    }
+    return iIntSetBitContains(
+        (uint64_t *) left.values,
+        (uint64_t *) right.values,
+        bitNumInt64s()
+    );
 }
 
 //===========================================================================
@@ -2876,6 +4002,14 @@ bool IntegralSet<T,A>::Impl::conMeta(const Node & left, const Node & right) {
     return true;
 }
 
+//===========================================================================
+template <std::integral T, typename A>
+bool IntegralSet<T,A>::Impl::conRuns(const Node & left, const Node & right) {
+    return forEachRange(right, [&](storage_type start, size_t len) {
+        return count(left, start, len) == len;
+    });
+}
+
 
 /****************************************************************************
 *
@@ -2891,14 +4025,15 @@ bool IntegralSet<T,A>::Impl::intersects(
 ) {
     using Fn = bool(const Node & left, const Node & right);
     static Fn * const functs[][kNodeTypes] = {
-// LEFT                         RIGHT
-//         empty  full  sm vec    vector    bitmap     meta
-/*empty*/{ no,    no,   no,       no,       no,        no        },
-/*full */{ no,    yes,  yes,      yes,      yes,       yes       },
-/*smv  */{ no,    yes,  isecSmv,  isecLSmv, isecLSmv,  isecLSmv  },
-/*vec  */{ no,    yes,  isecRSmv, isecVec,  isecLVec,  isecLVec  },
-/*bit  */{ no,    yes,  isecRSmv, isecRVec, isecBit,   isecError },
-/*meta */{ no,    yes,  isecRSmv, isecRVec, isecError, isecMeta  },
+// LEFT                        RIGHT
+//         empty full sm vec    vector    bitmap     meta       runs
+/*empty*/{ no,   no,  no,       no,       no,        no,        no       },
+/*full */{ no,   yes, yes,      yes,      yes,       yes,       yes      },
+/*smv  */{ no,   yes, isecSmv,  isecLSmv, isecLSmv,  isecLSmv,  isecLSmv },
+/*vec  */{ no,   yes, isecRSmv, isecVec,  isecLVec,  isecLVec,  isecLVec },
+/*bit  */{ no,   yes, isecRSmv, isecRVec, isecBit,   isecError, isecRuns },
+/*meta */{ no,   yes, isecRSmv, isecRVec, isecError, isecMeta,  isecRuns },
+/*runs */{ no,   yes, isecRSmv, isecRVec, isecRuns,  isecRuns,  isecRuns },
     };
     return functs[left.type][right.type](left, right);
 }
@@ -2919,8 +4054,22 @@ bool IntegralSet<T,A>::Impl::isecRArray(
     const Node & right,
     const storage_type * ri
 ) {
-    auto re = ri + right.numValues;
-    const Node * onode;
+    if constexpr (vecKernels()) {
+        if (left.type == kBitmap) {
+            auto found = iIntSetVecProbe(
+                nullptr,
+                ri,
+                right.numValues,
+                (const uint64_t *) left.values,
+                absBase(left),
+                true
+            );
+            return found != 0;
+        }
+    }
+
+    auto re = ri + right.numValues;
+    const Node * onode;
     storage_type ovalue;
 
     for (;;) {
@@ -3012,17 +4161,11 @@ bool IntegralSet<T,A>::Impl::isecSmv(const Node & left, const Node & right) {
 //===========================================================================
 template <std::integral T, typename A>
 bool IntegralSet<T,A>::Impl::isecBit(const Node & left, const Node & right) {
-    auto li = (uint64_t *) left.values;
-    auto le = li + bitNumInt64s();
-    auto ri = (uint64_t *) right.values;
-
-    for (;;) {
-        if (*li & *ri)
-            return true;
-        if (++li == le)
-            return false;
-        ++ri;
-    }
+    return iIntSetBitIntersects(
+        (uint64_t *) left.values,
+        (uint64_t *) right.values,
+        bitNumInt64s()
+    );
 }
 
 //===========================================================================
@@ -3038,6 +4181,17 @@ bool IntegralSet<T,A>::Impl::isecMeta(const Node & left, const Node & right) {
     return false;
 }
 
+//===========================================================================
+template <std::integral T, typename A>
+bool IntegralSet<T,A>::Impl::isecRuns(const Node & left, const Node & right) {
+    // Go through the ranges of the runs node, there are fewer of them.
+    if (right.type != kRuns)
+        return isecRuns(right, left);
+    return !forEachRange(right, [&](storage_type start, size_t len) {
+        return !count(left, start, len);
+    });
+}
+
 
 /****************************************************************************
 *
@@ -3055,13 +4209,14 @@ void IntegralSet<T,A>::Impl::insert(
     using Fn = void(A * alloc, Node * left, const Node & right);
     static Fn * const functs[][kNodeTypes] = {
 // LEFT                         RIGHT
-//         empty  full  sm vec   vector   bitmap    meta
-/*empty*/{ skip,  fill, copy,    copy,    copy,     copy     },
-/*full */{ skip,  skip, skip,    skip,    skip,     skip     },
-/*smv  */{ skip,  fill, insRSmv, insLSmv, insLSmv,  insLSmv  },
-/*vec  */{ skip,  fill, insRSmv, insRVec, insLVec,  insLVec  },
-/*bit  */{ skip,  fill, insRSmv, insRVec, insBit,   insError },
-/*meta */{ skip,  fill, insRSmv, insRVec, insError, insMeta  },
+//         empty full  sm vec   vector   bitmap    meta      runs
+/*empty*/{ skip, fill, copy,    copy,    copy,     copy,     copy     },
+/*full */{ skip, skip, skip,    skip,    skip,     skip,     skip     },
+/*smv  */{ skip, fill, insRSmv, insLSmv, insLSmv,  insLSmv,  insLSmv  },
+/*vec  */{ skip, fill, insRSmv, insVec,  insLVec,  insLVec,  insLVec  },
+/*bit  */{ skip, fill, insRSmv, insRVec, insBit,   insError, insRRuns },
+/*meta */{ skip, fill, insRSmv, insRVec, insError, insMeta,  insRRuns },
+/*runs */{ skip, fill, insRSmv, insRVec, insLRuns, insLRuns, insRRuns },
     };
     functs[left->type][right.type](alloc, left, right);
 }
@@ -3078,81 +4233,6 @@ void IntegralSet<T,A>::Impl::insError(
     assert(!"insert: incompatible node types");
 }
 
-//===========================================================================
-// FIXME: insArray is buggy, fix and update insert() to use it via insVec.
-template <std::integral T, typename A>
-void IntegralSet<T,A>::Impl::insArray(
-    A * alloc,
-    Node * left,
-    storage_type * li,
-    size_t maxValues,
-    const storage_type * ri,
-    const storage_type * re
-) {
-    assert(left->type == kVector);
-    assert(left->numValues);
-    assert(ri < re);
-    auto rbase = ri;
-    auto rcount = (uint16_t) min<size_t>(
-        re - ri,
-        maxValues - left->numValues
-    );
-    if (rcount) {
-        // Copy from
-        // rbase       ri
-        //   a    b    c    d    e
-        //        |<------------ re
-        //
-        // Copy to
-        //       li
-        //  -    A    B    -    -    -
-        //  |<------- le
-        //       |<----------------- out
-        auto lfinal = li + left->numValues - 1;
-        auto le = lfinal;
-        auto out = le + rcount;
-        ri = re - rcount;
-        re -= 1;
-        for (;;) {
-            auto cmp = *le <=> *re;
-            if (cmp > 0) {
-                *out-- = *le--;
-                if (le < li) {
-                    // Remaining right values.
-                    auto ucnt = re - ri + 1;
-                    memcpy(li, ri, ucnt * sizeof *ri);
-                    // Move down already merged values.
-                    auto cnt = lfinal + rcount - out;
-                    if (li + ucnt != out + 1)
-                        memmove(li + ucnt, out + 1, cnt * sizeof *ri);
-                    // Set to new len.
-                    left->numValues = (uint16_t) (ucnt + cnt);
-                    break;
-                }
-            } else {
-                *out-- = *re--;
-                if (cmp == 0) {
-                    le -= 1;
-                } else if (le == out) {
-                    // Reached the end after copying all values; update len.
-                    left->numValues += rcount;
-                    break;
-                }
-                if (re < ri) {
-                    // Move down already merged values.
-                    auto cnt = (li + left->numValues - 1) + rcount - out;
-                    memmove(le + 1, out + 1, cnt * sizeof *ri);
-                    // Set to new len.
-                    left->numValues = (uint16_t) ((le + 1 - li) + cnt);
-                    break;
-                }
-            }
-        }
-    }
-    if (rbase != ri)
-        insert(alloc, left, rbase, ri);
-}
-
 //===========================================================================
 template <std::integral T, typename A>
 void IntegralSet<T,A>::Impl::insRSmv(
@@ -3190,9 +4270,23 @@ void IntegralSet<T,A>::Impl::insVec(
 ) {
     assert(left->type == kVector);
     assert(right.type == kVector);
-    auto ri = right.values;
-    auto re = ri + right.numValues;
-    insArray(alloc, left, left->values, vecMaxValues(), ri, re);
+    if constexpr (vecKernels()) {
+        storage_type tmp[2 * vecMaxValues() + kIntSetVecSlack];
+        auto num = iIntSetVecUnion(
+            tmp,
+            left->values,
+            left->numValues,
+            right.values,
+            right.numValues
+        );
+        if (num <= vecMaxValues()) {
+            memcpy(left->values, tmp, num * sizeof *tmp);
+            left->numValues = (uint16_t) num;
+            return;
+        }
+    }
+    // Too many to remain a vector, or no kernel for values of this size.
+    insRVec(alloc, left, right);
 }
 
 //===========================================================================
@@ -3230,19 +4324,14 @@ void IntegralSet<T,A>::Impl::insBit(
     Node * left,
     const Node & right
 ) {
-    auto li = (uint64_t *) left->values;
-    auto le = li + kDataSize / sizeof *li;
-    auto ri = (const uint64_t *) right.values;
-    left->numValues = 0;
-    for (; li != le; ++li, ++ri) {
-        if (*li |= *ri)
-            left->numValues += 1;
-    }
-    if (left->numValues == bitNumInt64s()) {
-        BitView bits((uint64_t *) left->values, bitNumInt64s());
-        if (bits.all())
-            fill(alloc, left, right);
-    }
+    auto info = iIntSetBitOr(
+        (uint64_t *) left->values,
+        (const uint64_t *) right.values,
+        bitNumInt64s()
+    );
+    left->numValues = (uint16_t) info.words;
+    if (info.bits == bitNumBits())
+        fill(alloc, left, right);
 }
 
 //===========================================================================
@@ -3257,6 +4346,7 @@ void IntegralSet<T,A>::Impl::insMeta(
     auto ri = right.nodes;
     for (; li != le; ++li, ++ri) {
         insert(alloc, li, *ri);
+        updateCount(left, *li);
         if (li->type != kFull)
             goto NOT_FULL;
     }
@@ -3266,8 +4356,39 @@ void IntegralSet<T,A>::Impl::insMeta(
 
 NOT_FULL:
     ++li, ++ri;
-    for (; li != le; ++li, ++ri)
+    for (; li != le; ++li, ++ri) {
         insert(alloc, li, *ri);
+        updateCount(left, *li);
+    }
+}
+
+//===========================================================================
+template <std::integral T, typename A>
+void IntegralSet<T,A>::Impl::insRRuns(
+    A * alloc,
+    Node * left,
+    const Node & right
+) {
+    assert(right.type == kRuns);
+    auto ri = runBegin(right);
+    auto re = runEnd(right);
+    for (; ri != re; ++ri)
+        insert(alloc, left, ri->start, ri->len);
+}
+
+//===========================================================================
+template <std::integral T, typename A>
+void IntegralSet<T,A>::Impl::insLRuns(
+    A * alloc,
+    Node * left,
+    const Node & right
+) {
+    assert(left->type == kRuns);
+    Node tmp;
+    copy(alloc, &tmp, right);
+    insRRuns(alloc, &tmp, move(*left));
+    swap(*left, tmp);
+    destroy(alloc, &tmp);
 }
 
 
@@ -3283,13 +4404,14 @@ void IntegralSet<T,A>::Impl::insert(A * alloc, Node * left, Node && right) {
     using Fn = void(A * alloc, Node * left, Node && right);
     static Fn * const functs[][kNodeTypes] = {
 // LEFT                     RIGHT
-//         empty  full  sm vec   vector   bitmap    meta
-/*empty*/{ skip,  fill, copy,    copy,    copy,     copy     },
-/*full */{ skip,  skip, skip,    skip,    skip,     skip     },
-/*smv  */{ skip,  fill, insRSmv, insLSmv, insLSmv,  insLSmv  },
-/*vec  */{ skip,  fill, insRSmv, insRVec, insLVec,  insLVec  },
-/*bit  */{ skip,  fill, insRSmv, insRVec, insBit,   insError },
-/*meta */{ skip,  fill, insRSmv, insRVec, insError, insMeta  },
+//         empty full  sm vec   vector   bitmap    meta      runs
+/*empty*/{ skip, fill, copy,    copy,    copy,     copy,     copy     },
+/*full */{ skip, skip, skip,    skip,    skip,     skip,     skip     },
+/*smv  */{ skip, fill, insRSmv, insLSmv, insLSmv,  insLSmv,  insLSmv  },
+/*vec  */{ skip, fill, insRSmv, insVec,  insLVec,  insLVec,  insLVec  },
+/*bit  */{ skip, fill, insRSmv, insRVec, insBit,   insError, insRRuns },
+/*meta */{ skip, fill, insRSmv, insRVec, insError, insMeta,  insRRuns },
+/*runs */{ skip, fill, insRSmv, insRVec, insLRuns, insLRuns, insRRuns },
     };
     functs[left->type][right.type](alloc, left, move(right));
 }
@@ -3313,6 +4435,12 @@ void IntegralSet<T,A>::Impl::insLSmv(A * alloc, Node * left, Node && right) {
     insRSmv(alloc, left, move(right));
 }
 
+//===========================================================================
+template <std::integral T, typename A>
+void IntegralSet<T,A>::Impl::insVec(A * alloc, Node * left, Node && right) {
+    insVec(alloc, left, right);
+}
+
 //===========================================================================
 template <std::integral T, typename A>
 void IntegralSet<T,A>::Impl::insRVec(A * alloc, Node * left, Node && right) {
@@ -3340,6 +4468,7 @@ void IntegralSet<T,A>::Impl::insMeta(A * alloc, Node * left, Node && right) {
     auto ri = right.nodes;
     for (; li != le; ++li, ++ri) {
         insert(alloc, li, move(*ri));
+        updateCount(left, *li);
         if (li->type != kFull)
             goto NOT_FULL;
     }
@@ -3348,8 +4477,23 @@ void IntegralSet<T,A>::Impl::insMeta(A * alloc, Node * left, Node && right) {
 
 NOT_FULL:
     ++li, ++ri;
-    for (; li != le; ++li, ++ri)
+    for (; li != le; ++li, ++ri) {
         insert(alloc, li, move(*ri));
+        updateCount(left, *li);
+    }
+}
+
+//===========================================================================
+template <std::integral T, typename A>
+void IntegralSet<T,A>::Impl::insRRuns(A * alloc, Node * left, Node && right) {
+    insRRuns(alloc, left, right);
+}
+
+//===========================================================================
+template <std::integral T, typename A>
+void IntegralSet<T,A>::Impl::insLRuns(A * alloc, Node * left, Node && right) {
+    swap(*left, right);
+    insRRuns(alloc, left, move(right));
 }
 
 
@@ -3369,13 +4513,14 @@ void IntegralSet<T,A>::Impl::erase(
     using Fn = void(A * alloc, Node * left, const Node & right);
     static Fn * const functs[][kNodeTypes] = {
 // LEFT                         RIGHT
-//         empty full   sm vec     vector     bitmap     meta
-/*empty*/{ skip, skip,  skip,      skip,      skip,      skip      },
-/*full */{ skip, clear, eraChange, eraChange, eraChange, eraChange },
-/*smv  */{ skip, clear, eraSmv,    eraLSmv,   eraLSmv,   eraLSmv   },
-/*vec  */{ skip, clear, eraRSmv,   eraVec,    eraLVec,   eraLVec   },
-/*bit  */{ skip, clear, eraRSmv,   eraRVec,   eraBit,    eraError  },
-/*meta */{ skip, clear, eraRSmv,   eraRVec,   eraError,  eraMeta   },
+//         empty full   sm vec     vector     bitmap     meta       runs
+/*empty*/{ skip, skip,  skip,      skip,      skip,      skip,      skip      },
+/*full */{ skip, clear, eraChange, eraChange, eraChange, eraChange, eraChange },
+/*smv  */{ skip, clear, eraSmv,    eraLSmv,   eraLSmv,   eraLSmv,   eraLSmv   },
+/*vec  */{ skip, clear, eraRSmv,   eraVec,    eraLVec,   eraLVec,   eraLVec   },
+/*bit  */{ skip, clear, eraRSmv,   eraRVec,   eraBit,    eraError,  eraRuns   },
+/*meta */{ skip, clear, eraRSmv,   eraRVec,   eraError,  eraMeta,   eraRuns   },
+/*runs */{ skip, clear, eraRSmv,   eraRVec,   eraRuns,   eraRuns,   eraRuns   },
     };
     functs[left->type][right.type](alloc, left, right);
 }
@@ -3403,7 +4548,7 @@ void IntegralSet<T,A>::Impl::eraChange(
     assert(ri);
 
     // Convert from full to either bitmap or meta, and only then erase the rest.
-    erase(alloc, left, *ri, 1);
+    erase(alloc, left, toStorage(*ri), 1);
     erase(alloc, left, right);
 }
 
@@ -3434,6 +4579,22 @@ void IntegralSet<T,A>::Impl::eraLArray(
     storage_type * li,
     const Node & right
 ) {
+    if constexpr (vecKernels()) {
+        if (right.type == kBitmap) {
+            left->numValues = (uint16_t) iIntSetVecProbe(
+                li,
+                li,
+                left->numValues,
+                (const uint64_t *) right.values,
+                absBase(right),
+                false
+            );
+            if (!left->numValues)
+                clear(alloc, left);
+            return;
+        }
+    }
+
     // Go through values of left vector and skip (aka remove) the ones that are
     // found in right node (values to be erased).
     auto base = li;
@@ -3546,14 +4707,12 @@ void IntegralSet<T,A>::Impl::eraBit(
     Node * left,
     const Node & right
 ) {
-    auto li = (uint64_t *) left->values;
-    auto le = li + kDataSize / sizeof *li;
-    auto ri = (uint64_t *) right.values;
-    left->numValues = 0;
-    for (; li != le; ++li, ++ri) {
-        if (*li &= ~*ri)
-            left->numValues += 1;
-    }
+    auto info = iIntSetBitAndNot(
+        (uint64_t *) left->values,
+        (const uint64_t *) right.values,
+        bitNumInt64s()
+    );
+    left->numValues = (uint16_t) info.words;
     if (!left->numValues)
         clear(alloc, left);
 }
@@ -3571,6 +4730,7 @@ void IntegralSet<T,A>::Impl::eraMeta(
     auto ri = right.nodes;
     for (; li != le; ++li, ++ri) {
         erase(alloc, li, *ri);
+        updateCount(left, *li);
         if (li->type != kEmpty)
             goto NOT_EMPTY;
     }
@@ -3579,8 +4739,23 @@ void IntegralSet<T,A>::Impl::eraMeta(
 
 NOT_EMPTY:
     ++li, ++ri;
-    for (; li != le; ++li, ++ri)
+    for (; li != le; ++li, ++ri) {
         erase(alloc, li, *ri);
+        updateCount(left, *li);
+    }
+}
+
+//===========================================================================
+template <std::integral T, typename A>
+void IntegralSet<T,A>::Impl::eraRuns(
+    A * alloc,
+    Node * left,
+    const Node & right
+) {
+    forEachRange(right, [&](storage_type start, size_t len) {
+        erase(alloc, left, start, len);
+        return left->type != kEmpty;
+    });
 }
 
 
@@ -3600,13 +4775,14 @@ void IntegralSet<T,A>::Impl::intersect(
     using Fn = void(A * alloc, Node * left, const Node & right);
     static Fn * const functs[][kNodeTypes] = {
 // LEFT                         RIGHT
-//         empty  full  sm vec    vector    bitmap     meta
-/*empty*/{ skip,  skip, skip,     skip,     skip,      skip      },
-/*full */{ clear, skip, copy,     copy,     copy,      copy      },
-/*smv  */{ clear, skip, isecSmv,  isecLSmv, isecLSmv,  isecLSmv  },
-/*vec  */{ clear, skip, isecRSmv, isecVec,  isecLVec,  isecLVec  },
-/*bit  */{ clear, skip, isecRSmv, isecRVec, isecBit,   isecError },
-/*meta */{ clear, skip, isecRSmv, isecRVec, isecError, isecMeta  },
+//         empty  full  sm vec    vector    bitmap     meta       runs
+/*empty*/{ skip,  skip, skip,     skip,     skip,      skip,      skip     },
+/*full */{ clear, skip, copy,     copy,     copy,      copy,      copy     },
+/*smv  */{ clear, skip, isecSmv,  isecLSmv, isecLSmv,  isecLSmv,  isecLSmv },
+/*vec  */{ clear, skip, isecRSmv, isecVec,  isecLVec,  isecLVec,  isecLVec },
+/*bit  */{ clear, skip, isecRSmv, isecRVec, isecBit,   isecError, isecRuns },
+/*meta */{ clear, skip, isecRSmv, isecRVec, isecError, isecMeta,  isecRuns },
+/*runs */{ clear, skip, isecRSmv, isecRVec, isecLRuns, isecLRuns, isecRuns },
     };
     functs[left->type][right.type](alloc, left, right);
 }
@@ -3632,12 +4808,25 @@ void IntegralSet<T,A>::Impl::isecArray(
     const Node & right,
     const storage_type * ri
 ) {
-    auto le = set_intersection(
-        li, li + left->numValues,
-        ri, ri + right.numValues,
-        li
-    );
-    left->numValues = uint16_t(le - li);
+    if constexpr (vecKernels()) {
+        storage_type tmp[vecMaxValues() + kIntSetVecSlack];
+        auto num = iIntSetVecIntersect(
+            tmp,
+            li,
+            left->numValues,
+            ri,
+            right.numValues
+        );
+        memcpy(li, tmp, num * sizeof *tmp);
+        left->numValues = uint16_t(num);
+    } else {
+        auto le = set_intersection(
+            li, li + left->numValues,
+            ri, ri + right.numValues,
+            li
+        );
+        left->numValues = uint16_t(le - li);
+    }
     if (!left->numValues)
         clear(alloc, left);
 }
@@ -3650,6 +4839,22 @@ void IntegralSet<T,A>::Impl::isecLArray(
     storage_type * li,
     const Node & right
 ) {
+    if constexpr (vecKernels()) {
+        if (right.type == kBitmap) {
+            left->numValues = (uint16_t) iIntSetVecProbe(
+                li,
+                li,
+                left->numValues,
+                (const uint64_t *) right.values,
+                absBase(right),
+                true
+            );
+            if (!left->numValues)
+                clear(alloc, left);
+            return;
+        }
+    }
+
     // Go through values of left vector and remove the ones that aren't found in
     // right node.
     auto base = li;
@@ -3751,14 +4956,12 @@ void IntegralSet<T,A>::Impl::isecBit(
     Node * left,
     const Node & right
 ) {
-    auto li = (uint64_t *) left->values;
-    auto le = li + kDataSize / sizeof *li;
-    auto ri = (uint64_t *) right.values;
-    left->numValues = 0;
-    for (; li != le; ++li, ++ri) {
-        if (*li &= *ri)
-            left->numValues += 1;
-    }
+    auto info = iIntSetBitAnd(
+        (uint64_t *) left->values,
+        (const uint64_t *) right.values,
+        bitNumInt64s()
+    );
+    left->numValues = (uint16_t) info.words;
     if (!left->numValues)
         clear(alloc, left);
 }
@@ -3775,6 +4978,7 @@ void IntegralSet<T,A>::Impl::isecMeta(
     auto ri = right.nodes;
     for (; li != le; ++li, ++ri) {
         intersect(alloc, li, *ri);
+        updateCount(left, *li);
         if (li->type != kEmpty)
             goto NOT_EMPTY;
     }
@@ -3783,8 +4987,51 @@ void IntegralSet<T,A>::Impl::isecMeta(
 
 NOT_EMPTY:
     ++li, ++ri;
-    for (; li != le; ++li, ++ri)
+    for (; li != le; ++li, ++ri) {
         intersect(alloc, li, *ri);
+        updateCount(left, *li);
+    }
+}
+
+//===========================================================================
+// Erases the gaps between the ranges of right from left.
+template <std::integral T, typename A>
+void IntegralSet<T,A>::Impl::isecRuns(
+    A * alloc,
+    Node * left,
+    const Node & right
+) {
+    auto next = absBase(right);
+    auto done = false;
+    forEachRange(right, [&](storage_type start, size_t len) {
+        if (start != next)
+            erase(alloc, left, next, start - next);
+        auto final = (storage_type) (start + len - 1);
+        if (final == absFinal(right)) {
+            done = true;
+            return false;
+        }
+        next = final + 1;
+        return left->type != kEmpty;
+    });
+    if (!done && left->type != kEmpty)
+        erase(alloc, left, next, absFinal(right) - next + 1);
+}
+
+//===========================================================================
+template <std::integral T, typename A>
+void IntegralSet<T,A>::Impl::isecLRuns(
+    A * alloc,
+    Node * left,
+    const Node & right
+) {
+    // Erase the few gaps of the runs from a copy of the other node instead,
+    // the other node may have a gap for nearly every value.
+    Node tmp;
+    copy(alloc, &tmp, right);
+    isecRuns(alloc, &tmp, *left);
+    swap(*left, tmp);
+    destroy(alloc, &tmp);
 }
 
 
@@ -3800,13 +5047,14 @@ void IntegralSet<T,A>::Impl::intersect(A * alloc, Node * left, Node && right) {
     using Fn = void(A * alloc, Node * left, Node && right);
     static Fn * const functs[][kNodeTypes] = {
 // LEFT                         RIGHT
-//         empty  full  sm vec    vector    bitmap     meta
-/*empty*/{ skip,  skip, clear,    clear,    clear,     clear     },
-/*full */{ clear, skip, copy,     copy,     copy,      copy      },
-/*smv  */{ clear, skip, isecSmv,  isecLSmv, isecLSmv,  isecLSmv  },
-/*vec  */{ clear, skip, isecRSmv, isecVec,  isecLVec,  isecLVec  },
-/*bit  */{ clear, skip, isecRSmv, isecRVec, isecBit,   isecError },
-/*meta */{ clear, skip, isecRSmv, isecRVec, isecError, isecMeta  },
+//         empty  full  sm vec    vector    bitmap     meta       runs
+/*empty*/{ skip,  skip, clear,    clear,    clear,     clear,     clear    },
+/*full */{ clear, skip, copy,     copy,     copy,      copy,      copy     },
+/*smv  */{ clear, skip, isecSmv,  isecLSmv, isecLSmv,  isecLSmv,  isecLSmv },
+/*vec  */{ clear, skip, isecRSmv, isecVec,  isecLVec,  isecLVec,  isecLVec },
+/*bit  */{ clear, skip, isecRSmv, isecRVec, isecBit,   isecError, isecRuns },
+/*meta */{ clear, skip, isecRSmv, isecRVec, isecError, isecMeta,  isecRuns },
+/*runs */{ clear, skip, isecRSmv, isecRVec, isecLRuns, isecLRuns, isecRuns },
     };
     functs[left->type][right.type](alloc, left, move(right));
 }
@@ -3819,66 +5067,597 @@ void IntegralSet<T,A>::Impl::isecError(A * alloc, Node * left, Node && right) {
 
 //===========================================================================
 template <std::integral T, typename A>
-void IntegralSet<T,A>::Impl::isecSmv(A * alloc, Node * left, Node && right) {
-    isecSmv(alloc, left, right);
+void IntegralSet<T,A>::Impl::isecSmv(A * alloc, Node * left, Node && right) {
+    isecSmv(alloc, left, right);
+}
+
+//===========================================================================
+template <std::integral T, typename A>
+void IntegralSet<T,A>::Impl::isecLSmv(A * alloc, Node * left, Node && right) {
+    isecLSmv(alloc, left, right);
+}
+
+//===========================================================================
+template <std::integral T, typename A>
+void IntegralSet<T,A>::Impl::isecRSmv(A * alloc, Node * left, Node && right) {
+    swap(*left, right);
+    isecLSmv(alloc, left, right);
+}
+
+//===========================================================================
+template <std::integral T, typename A>
+void IntegralSet<T,A>::Impl::isecVec(A * alloc, Node * left, Node && right) {
+    isecVec(alloc, left, right);
+}
+
+//===========================================================================
+template <std::integral T, typename A>
+void IntegralSet<T,A>::Impl::isecLVec(A * alloc, Node * left, Node && right) {
+    isecLVec(alloc, left, right);
+}
+
+//===========================================================================
+template <std::integral T, typename A>
+void IntegralSet<T,A>::Impl::isecRVec(A * alloc, Node * left, Node && right) {
+    swap(*left, right);
+    isecLVec(alloc, left, right);
+}
+
+//===========================================================================
+template <std::integral T, typename A>
+void IntegralSet<T,A>::Impl::isecBit(A * alloc, Node * left, Node && right) {
+    isecBit(alloc, left, right);
+}
+
+//===========================================================================
+template <std::integral T, typename A>
+void IntegralSet<T,A>::Impl::isecMeta(A * alloc, Node * left, Node && right) {
+    auto li = left->nodes;
+    auto le = li + left->numValues;
+    auto ri = right.nodes;
+    for (; li != le; ++li, ++ri) {
+        intersect(alloc, li, move(*ri));
+        updateCount(left, *li);
+        if (li->type != kEmpty)
+            goto NOT_EMPTY;
+    }
+    clear(alloc, left);
+    return;
+
+NOT_EMPTY:
+    ++li, ++ri;
+    for (; li != le; ++li, ++ri) {
+        intersect(alloc, li, move(*ri));
+        updateCount(left, *li);
+    }
+}
+
+//===========================================================================
+template <std::integral T, typename A>
+void IntegralSet<T,A>::Impl::isecRuns(A * alloc, Node * left, Node && right) {
+    isecRuns(alloc, left, right);
+}
+
+//===========================================================================
+template <std::integral T, typename A>
+void IntegralSet<T,A>::Impl::isecLRuns(A * alloc, Node * left, Node && right) {
+    // Erase the few gaps of the runs from the other node instead.
+    swap(*left, right);
+    isecRuns(alloc, left, right);
+}
+
+
+/****************************************************************************
+*
+*   save(SerialWriter * out, const Node & node)
+*
+***/
+
+//===========================================================================
+template <std::integral T, typename A>
+void IntegralSet<T,A>::Impl::save(SerialWriter * out, const Node & node) {
+    using Fn = void(SerialWriter * out, const Node & node);
+    constinit static Fn * const functs[kNodeTypes] = {
+        saveEmpty,  // empty
+        saveFull,   // full
+        saveSmv,    // small vector
+        saveVec,    // vector
+        saveBit,    // bitmap
+        saveMeta,   // meta
+        saveRuns,   // runs
+    };
+    functs[node.type](out, node);
+}
+
+//===========================================================================
+template <std::integral T, typename A>
+void IntegralSet<T,A>::Impl::saveEmpty(
+    SerialWriter * out,
+    const Node & node
+) {
+}
+
+//===========================================================================
+template <std::integral T, typename A>
+void IntegralSet<T,A>::Impl::saveFull(SerialWriter * out, const Node & node) {
+    auto leaves = (uint64_t) (valueMask(node.depth) >> kLeafBits) + 1;
+    out->addFull(absBase(node) >> kLeafBits, leaves);
+}
+
+//===========================================================================
+template <std::integral T, typename A>
+void IntegralSet<T,A>::Impl::saveSmv(SerialWriter * out, const Node & node) {
+    saveArray(out, node.localValues, node.localValues + node.numValues);
+}
+
+//===========================================================================
+template <std::integral T, typename A>
+void IntegralSet<T,A>::Impl::saveVec(SerialWriter * out, const Node & node) {
+    saveArray(out, node.values, node.values + node.numValues);
+}
+
+//===========================================================================
+template <std::integral T, typename A>
+void IntegralSet<T,A>::Impl::saveBit(SerialWriter * out, const Node & node) {
+    auto key = absBase(node) >> kLeafBits;
+    auto num = cntBit(node);
+    if (num == bitNumBits()) {
+        out->addFull(key, 1);
+    } else if (num * sizeof (uint16_t) > kDataSize) {
+        out->addBitmap(key, node.values, kDataSize, num);
+    } else {
+        // Sparse enough to be smaller as an array.
+        BitView bits{(uint64_t *) node.values, bitNumInt64s()};
+        uint16_t vals[kDataSize / sizeof (uint16_t)];
+        size_t count = 0;
+        auto pos = bits.find(0);
+        for (; pos != bits.npos; pos = bits.find(pos + 1))
+            vals[count++] = (uint16_t) pos;
+        out->addArray(key, vals, count);
+    }
+}
+
+//===========================================================================
+template <std::integral T, typename A>
+void IntegralSet<T,A>::Impl::saveMeta(SerialWriter * out, const Node & node) {
+    auto * ptr = node.nodes;
+    auto * last = ptr + node.numValues;
+    for (; ptr != last; ++ptr)
+        save(out, *ptr);
+}
+
+//===========================================================================
+// Runs are split into the leaves they cover, with the partially covered ones
+// written as arrays or bitmaps like saveBit() does.
+template <std::integral T, typename A>
+void IntegralSet<T,A>::Impl::saveRuns(SerialWriter * out, const Node & node) {
+    auto ptr = runBegin(node);
+    auto last = runEnd(node);
+    auto pos = ptr->start;
+    while (ptr != last) {
+        auto key = pos >> kLeafBits;
+        auto leafBase = absBase(pos, kMaxDepth);
+        auto leafFinal = absFinal(pos, kMaxDepth);
+        auto final = runFinal(*ptr);
+        if (pos == leafBase && final >= leafFinal) {
+            auto leaves = ((uint64_t) (final - pos) + 1) >> kLeafBits;
+            out->addFull(key, leaves);
+            auto width = (storage_type) ((leaves << kLeafBits) - 1);
+            if (final - pos != width) {
+                pos += width + 1;
+            } else if (++ptr != last) {
+                pos = ptr->start;
+            }
+            continue;
+        }
+
+        // Gather the values of all runs within the leaf.
+        uint16_t vals[bitNumBits()];
+        size_t count = 0;
+        for (;;) {
+            auto high = min(runFinal(*ptr), leafFinal);
+            for (;;) {
+                vals[count++] = (uint16_t) (pos - leafBase);
+                if (pos++ == high)
+                    break;
+            }
+            if (high != runFinal(*ptr) || ++ptr == last)
+                break;
+            pos = ptr->start;
+            if (pos > leafFinal)
+                break;
+        }
+        if (count * sizeof *vals <= kDataSize) {
+            out->addArray(key, vals, count);
+        } else {
+            uint64_t bits[bitNumInt64s()] = {};
+            BitSpan span{bits, bitNumInt64s()};
+            for (size_t i = 0; i < count; ++i)
+                span.set(vals[i]);
+            out->addBitmap(key, bits, kDataSize, count);
+        }
+    }
+}
+
+//===========================================================================
+// Values of vectors above the leaf depth may span many leaves.
+template <std::integral T, typename A>
+void IntegralSet<T,A>::Impl::saveArray(
+    SerialWriter * out,
+    const storage_type * first,
+    const storage_type * last
+) {
+    uint16_t vals[vecMaxValues()];
+    while (first != last) {
+        auto key = *first >> kLeafBits;
+        size_t count = 0;
+        for (; first != last && (*first >> kLeafBits) == key; ++first)
+            vals[count++] = (uint16_t) relValue(*first, kMaxDepth);
+        out->addArray(key, vals, count);
+    }
+}
+
+
+/****************************************************************************
+*
+*   load(A * alloc, Node * node, const SerialHeader & hdr)
+*
+***/
+
+//===========================================================================
+// Returns false if the values in the payload aren't as save() writes them.
+template <std::integral T, typename A>
+bool IntegralSet<T,A>::Impl::load(
+    A * alloc,
+    Node * node,
+    const SerialHeader & hdr
+) {
+    storage_type vals[bitNumBits()];
+    for (size_t i = 0; i < hdr.numEntries; ++i) {
+        auto ent = serialEntry(hdr.entries, i);
+        auto base = (storage_type) (ent.key << kLeafBits);
+        auto ptr = hdr.payload + ent.data;
+        if (ent.type == kSerialFull) {
+            insert(alloc, node, base, (size_t) ent.data << kLeafBits);
+        } else if (ent.type == kSerialArray) {
+            for (size_t j = 0; j < ent.count; ++j) {
+                auto val = ntoh16(ptr + j * sizeof (uint16_t));
+                if (val >= bitNumBits() || j && base + val <= vals[j - 1])
+                    return false;
+                vals[j] = base + val;
+            }
+            insert(alloc, node, vals, vals + ent.count);
+        } else {
+            assert(ent.type == kSerialBitmap);
+            BitView bits{(const uint64_t *) ptr, bitNumInt64s()};
+            if (bits.count() != ent.count)
+                return false;
+            loadBit(alloc, node, base, ptr, ent.count);
+        }
+    }
+    return true;
+}
+
+//===========================================================================
+template <std::integral T, typename A>
+void IntegralSet<T,A>::Impl::loadBit(
+    A * alloc,
+    Node * node,
+    storage_type base,
+    const char * bits,
+    size_t count
+) {
+    auto top = node;
+    if (count > vecMaxValues()) {
+        // Too many for a vector, so it ends up as a bitmap leaf under meta
+        // nodes, build them directly unless there's already something there.
+        Node * path[kMaxDepth];
+        size_t depth = 0;
+        for (;;) {
+            if (node->depth == kMaxDepth) {
+                if (node->type != kEmpty)
+                    break;
+                destroy(alloc, node);
+                node->type = kBitmap;
+                init(alloc, node, false);
+                memcpy(node->values, bits, kDataSize);
+                auto words = (uint64_t *) node->values;
+                for (size_t i = 0; i < bitNumInt64s(); ++i) {
+                    if (words[i])
+                        node->numValues += 1;
+                }
+                // Add the new values to the counts of the meta nodes above.
+                for (auto child = node; depth; child = path[depth])
+                    updateCount(path[--depth], *child);
+                return;
+            }
+            if (node->type == kEmpty) {
+                destroy(alloc, node);
+                node->type = kMeta;
+                init(alloc, node, false);
+            }
+            if (node->type != kMeta)
+                break;
+            path[depth++] = node;
+            node = node->nodes + nodePos(*node, base);
+        }
+    }
+
+    BitView view{(const uint64_t *) bits, bitNumInt64s()};
+    storage_type vals[bitNumBits()];
+    size_t num = 0;
+    for (auto pos = view.find(0); pos != view.npos; pos = view.find(pos + 1))
+        vals[num++] = base + (storage_type) pos;
+    insert(alloc, top, vals, vals + num);
+}
+
+
+/****************************************************************************
+*
+*   parallel(A *, Node * left, const Node & right, BinaryFn * op, bool)
+*
+*   Meta nodes that both sides have are split into their children, down to
+*   pieces too small to be worth splitting further, which are then combined
+*   by op in parallel. Each piece is a separate subtree, so only the counts
+*   of the meta nodes above them, updated afterwards, are shared.
+*
+***/
+
+//===========================================================================
+template <std::integral T, typename A>
+void IntegralSet<T,A>::Impl::parallel(
+    A * alloc,
+    Node * left,
+    const Node & right,
+    BinaryFn * op,
+    bool grow
+) {
+    Splits splits;
+    split(&splits, alloc, left, right, grow);
+    runSplits(alloc, splits, [&](const Split & piece) {
+        op(alloc, piece.node, *splits.srcs[piece.first]);
+    });
 }
 
 //===========================================================================
 template <std::integral T, typename A>
-void IntegralSet<T,A>::Impl::isecLSmv(A * alloc, Node * left, Node && right) {
-    isecLSmv(alloc, left, right);
+void IntegralSet<T,A>::Impl::parallelAll(
+    A * alloc,
+    Node * node,
+    const Node ** first,
+    const Node ** last,
+    AllFn * fn
+) {
+    Splits splits;
+    fn(&splits, alloc, node, first, last);
+    runSplits(alloc, splits, [&](const Split & piece) {
+        // Each piece has its own range of the sources, so they may be
+        // reordered in place.
+        auto srcs = splits.srcs.data() + piece.first;
+        fn(nullptr, alloc, piece.node, srcs, srcs + piece.count);
+    });
 }
 
 //===========================================================================
+// If grow is true an empty left is split as if it were an empty meta node,
+// as it must be for insert to give it any parallel work.
 template <std::integral T, typename A>
-void IntegralSet<T,A>::Impl::isecRSmv(A * alloc, Node * left, Node && right) {
-    swap(*left, right);
-    isecLSmv(alloc, left, right);
+void IntegralSet<T,A>::Impl::split(
+    Splits * out,
+    A * alloc,
+    Node * left,
+    const Node & right,
+    bool grow
+) {
+    if (right.type == kMeta && count(*left) + count(right) >= kParallelMin) {
+        if (left->type == kEmpty && grow) {
+            left->type = kMeta;
+            init(alloc, left, false);
+        }
+        if (left->type == kMeta) {
+            out->metas.push_back(left);
+            for (size_t i = 0; i < left->numValues; ++i)
+                split(out, alloc, left->nodes + i, right.nodes[i], grow);
+            return;
+        }
+    }
+    auto src = &right;
+    addSplit(out, left, &src, &src + 1);
 }
 
 //===========================================================================
+// Makes node, which must be empty, an empty meta node and passes each of its
+// children to fn along with the matching children of the sources, which must
+// all be meta nodes.
 template <std::integral T, typename A>
-void IntegralSet<T,A>::Impl::isecVec(A * alloc, Node * left, Node && right) {
-    isecVec(alloc, left, right);
+void IntegralSet<T,A>::Impl::splitAll(
+    Splits * out,
+    A * alloc,
+    Node * node,
+    const Node ** first,
+    const Node ** last,
+    AllFn * fn
+) {
+    assert(node->type == kEmpty);
+    node->type = kMeta;
+    init(alloc, node, false);
+    out->metas.push_back(node);
+    vector<const Node *> srcs(last - first);
+    for (size_t i = 0; i < node->numValues; ++i) {
+        for (size_t j = 0; j < srcs.size(); ++j) {
+            assert(first[j]->type == kMeta);
+            srcs[j] = first[j]->nodes + i;
+        }
+        fn(out, alloc, node->nodes + i, srcs.data(), srcs.data() + srcs.size());
+    }
 }
 
 //===========================================================================
 template <std::integral T, typename A>
-void IntegralSet<T,A>::Impl::isecLVec(A * alloc, Node * left, Node && right) {
-    isecLVec(alloc, left, right);
+void IntegralSet<T,A>::Impl::addSplit(
+    Splits * out,
+    Node * node,
+    const Node * const * first,
+    const Node * const * last
+) {
+    out->pieces.push_back({
+        .node = node,
+        .first = out->srcs.size(),
+        .count = (size_t) (last - first),
+    });
+    out->srcs.insert(out->srcs.end(), first, last);
 }
 
 //===========================================================================
+// Combines each piece with fn, then brings the counts of the meta nodes that
+// were split up to date, children before parents, collapsing any that were
+// left all empty or all full.
 template <std::integral T, typename A>
-void IntegralSet<T,A>::Impl::isecRVec(A * alloc, Node * left, Node && right) {
-    swap(*left, right);
-    isecLVec(alloc, left, right);
+template <typename Fn>
+void IntegralSet<T,A>::Impl::runSplits(
+    A * alloc,
+    const Splits & splits,
+    Fn fn
+) {
+    auto num = splits.pieces.size();
+    auto pfn = intSetParallel();
+    if (pfn && num > 1) {
+        pfn(num, [&](size_t pos) { fn(splits.pieces[pos]); });
+    } else {
+        for (auto && piece : splits.pieces)
+            fn(piece);
+    }
+
+    for (auto i = splits.metas.rbegin(); i != splits.metas.rend(); ++i) {
+        auto node = *i;
+        auto ptr = node->nodes;
+        auto last = ptr + node->numValues;
+        for (; ptr != last; ++ptr)
+            updateCount(node, *ptr);
+        if (!convertMetaIf(alloc, node, kEmpty))
+            convertMetaIf(alloc, node, kFull);
+    }
 }
 
+
+/****************************************************************************
+*
+*   unionAll(
+*       Splits * out,
+*       A * alloc,
+*       Node * node,
+*       const Node ** first,
+*       const Node ** last
+*   )
+*   isecAll(
+*       Splits * out,
+*       A * alloc,
+*       Node * node,
+*       const Node ** first,
+*       const Node ** last
+*   )
+*
+*   Sets node, which must be empty, to the union or intersection of the
+*   sources, which may be reordered. If out isn't null, meta nodes may be
+*   split and the rest of the work is added to it instead of being done.
+*
+***/
+
 //===========================================================================
 template <std::integral T, typename A>
-void IntegralSet<T,A>::Impl::isecBit(A * alloc, Node * left, Node && right) {
-    isecBit(alloc, left, right);
+void IntegralSet<T,A>::Impl::unionAll(
+    Splits * out,
+    A * alloc,
+    Node * node,
+    const Node ** first,
+    const Node ** last
+) {
+    assert(node->type == kEmpty);
+    size_t total = 0;
+    auto keep = first;
+    for (auto ptr = first; ptr != last; ++ptr) {
+        if ((*ptr)->type == kFull) {
+            fill(alloc, node);
+            return;
+        }
+        if ((*ptr)->type != kEmpty) {
+            total += count(**ptr);
+            *keep++ = *ptr;
+        }
+    }
+    last = keep;
+    if (first == last)
+        return;
+    if (last - first == 1) {
+        copy(alloc, node, **first);
+        return;
+    }
+    if (out) {
+        if (total >= kParallelMin
+            && all_of(first, last, [](auto ptr) { return ptr->type == kMeta; })
+        ) {
+            splitAll(out, alloc, node, first, last, unionAll);
+        } else {
+            addSplit(out, node, first, last);
+        }
+        return;
+    }
+
+    // Start with a copy of the largest, leaving the least to be inserted.
+    auto largest = max_element(first, last, [](auto a, auto b) {
+        return count(*a) < count(*b);
+    });
+    std::swap(*first, *largest);
+    copy(alloc, node, **first);
+    for (auto ptr = first + 1; ptr != last && node->type != kFull; ++ptr)
+        insert(alloc, node, **ptr);
 }
 
 //===========================================================================
 template <std::integral T, typename A>
-void IntegralSet<T,A>::Impl::isecMeta(A * alloc, Node * left, Node && right) {
-    auto li = left->nodes;
-    auto le = li + left->numValues;
-    auto ri = right.nodes;
-    for (; li != le; ++li, ++ri) {
-        intersect(alloc, li, move(*ri));
-        if (li->type != kEmpty)
-            goto NOT_EMPTY;
+void IntegralSet<T,A>::Impl::isecAll(
+    Splits * out,
+    A * alloc,
+    Node * node,
+    const Node ** first,
+    const Node ** last
+) {
+    assert(node->type == kEmpty);
+    size_t total = 0;
+    auto keep = first;
+    for (auto ptr = first; ptr != last; ++ptr) {
+        if ((*ptr)->type == kEmpty)
+            return;
+        if ((*ptr)->type != kFull) {
+            total += count(**ptr);
+            *keep++ = *ptr;
+        }
+    }
+    last = keep;
+    if (first == last) {
+        fill(alloc, node);
+        return;
+    }
+    if (last - first == 1) {
+        copy(alloc, node, **first);
+        return;
+    }
+    if (out) {
+        if (total >= kParallelMin
+            && all_of(first, last, [](auto ptr) { return ptr->type == kMeta; })
+        ) {
+            splitAll(out, alloc, node, first, last, isecAll);
+        } else {
+            addSplit(out, node, first, last);
+        }
+        return;
     }
-    clear(alloc, left);
-    return;
 
-NOT_EMPTY:
-    ++li, ++ri;
-    for (; li != le; ++li, ++ri)
-        intersect(alloc, li, move(*ri));
+    // Smallest first, so the result shrinks as quickly as possible.
+    sort(first, last, [](auto a, auto b) { return count(*a) < count(*b); });
+    copy(alloc, node, **first);
+    for (auto ptr = first + 1; ptr != last && node->type != kEmpty; ++ptr)
+        intersect(alloc, node, **ptr);
 }
 
 
@@ -4135,8 +5914,11 @@ void IntegralSet<T,A>::assign(string_view src) {
 //===========================================================================
 template <std::integral T, typename A>
 void IntegralSet<T,A>::insert(IntegralSet && other) {
-    if (this != &other)
+    if (this != &other) {
         Impl::insert(&m_alloc, &m_node, move(other.m_node));
+        // Nodes may have been taken from other without updating its counts.
+        other.clear();
+    }
 }
 
 //===========================================================================
@@ -4255,8 +6037,11 @@ auto IntegralSet<T,A>::pop_back() -> value_type {
 //===========================================================================
 template <std::integral T, typename A>
 void IntegralSet<T,A>::intersect(IntegralSet && other) {
-    if (this != &other)
+    if (this != &other) {
         Impl::intersect(&m_alloc, &m_node, move(other.m_node));
+        // Nodes may have been taken from other without updating its counts.
+        other.clear();
+    }
 }
 
 //===========================================================================
@@ -4266,6 +6051,75 @@ void IntegralSet<T,A>::intersect(const IntegralSet & other) {
         Impl::intersect(&m_alloc, &m_node, other.m_node);
 }
 
+//===========================================================================
+template <std::integral T, typename A>
+void IntegralSet<T,A>::parallelInsert(const IntegralSet & other) {
+    if (this != &other)
+        Impl::parallel(&m_alloc, &m_node, other.m_node, Impl::insert, true);
+}
+
+//===========================================================================
+template <std::integral T, typename A>
+void IntegralSet<T,A>::parallelErase(const IntegralSet & other) {
+    if (this != &other) {
+        Impl::parallel(&m_alloc, &m_node, other.m_node, Impl::erase, false);
+    } else {
+        clear();
+    }
+}
+
+//===========================================================================
+template <std::integral T, typename A>
+void IntegralSet<T,A>::parallelIntersect(const IntegralSet & other) {
+    if (this != &other) {
+        Impl::parallel(
+            &m_alloc,
+            &m_node,
+            other.m_node,
+            Impl::intersect,
+            false
+        );
+    }
+}
+
+//===========================================================================
+template <std::integral T, typename A>
+void IntegralSet<T,A>::unionAll(span<const IntegralSet * const> sets) {
+    vector<const Node *> srcs;
+    for (auto && set : sets)
+        srcs.push_back(&set->m_node);
+    IntegralSet out(m_alloc);
+    Impl::parallelAll(
+        &out.m_alloc,
+        &out.m_node,
+        srcs.data(),
+        srcs.data() + srcs.size(),
+        Impl::unionAll
+    );
+    swap(out);
+}
+
+//===========================================================================
+template <std::integral T, typename A>
+void IntegralSet<T,A>::intersectAll(span<const IntegralSet * const> sets) {
+    if (sets.empty()) {
+        clear();
+        return;
+    }
+    vector<const Node *> srcs;
+    for (auto && set : sets)
+        srcs.push_back(&set->m_node);
+    IntegralSet out(m_alloc);
+    Impl::parallelAll(
+        &out.m_alloc,
+        &out.m_node,
+        srcs.data(),
+        srcs.data() + srcs.size(),
+        Impl::isecAll
+    );
+    swap(out);
+}
+
 //===========================================================================
 template <std::integral T, typename A>
 void IntegralSet<T,A>::swap(IntegralSet & other) {
@@ -4330,6 +6184,20 @@ size_t IntegralSet<T,A>::count(value_type start, size_t len) const {
     return Impl::count(m_node, Impl::toStorage(start), len);
 }
 
+//===========================================================================
+template <std::integral T, typename A>
+size_t IntegralSet<T,A>::rank(value_type val) const {
+    return Impl::rank(m_node, Impl::toStorage(val));
+}
+
+//===========================================================================
+template <std::integral T, typename A>
+auto IntegralSet<T,A>::select(size_t pos) const -> iterator {
+    if (pos >= size())
+        return end();
+    return lowerBound(Impl::toValue(Impl::select(m_node, pos)));
+}
+
 //===========================================================================
 template <std::integral T, typename A>
 auto IntegralSet<T,A>::find(value_type val) const -> iterator {
@@ -4411,6 +6279,33 @@ auto IntegralSet<T,A>::lastContiguous(iterator where) const -> iterator {
     return where.lastContiguous();
 }
 
+//===========================================================================
+template <std::integral T, typename A>
+void IntegralSet<T,A>::save(CharBuf * out) const {
+    SerialWriter writer(Impl::kLeafBits);
+    Impl::save(&writer, m_node);
+    writer.write(out, kBitWidth, is_signed_v<T>);
+}
+
+//===========================================================================
+template <std::integral T, typename A>
+bool IntegralSet<T,A>::load(string_view src) {
+    SerialHeader hdr;
+    if (!parseSerial(&hdr, src, kBitWidth, is_signed_v<T>, Impl::kLeafBits))
+        return false;
+    IntegralSet tmp(m_alloc);
+    if (!Impl::load(&tmp.m_alloc, &tmp.m_node, hdr))
+        return false;
+    swap(tmp);
+    return true;
+}
+
+//===========================================================================
+template <std::integral T, typename A>
+void IntegralSet<T,A>::assertCounts() const {
+    assert(Impl::recount(m_node) == size());
+}
+
 //===========================================================================
 // Private
 //===========================================================================
@@ -4738,14 +6633,251 @@ auto IntegralSet<T,A>::RangeIter::operator--() -> RangeIter & {
 }
 
 
+/****************************************************************************
+*
+*   IntegralSetView
+*
+***/
+
+//===========================================================================
+template <std::integral T>
+bool IntegralSetView<T>::parse(string_view src) {
+    using Impl = IntegralSet<T>::Impl;
+    SerialHeader hdr;
+    auto bits = IntegralSet<T>::kBitWidth;
+    if (!parseSerial(&hdr, src, bits, is_signed_v<T>, Impl::kLeafBits))
+        return false;
+    m_entries = hdr.entries;
+    m_numEntries = hdr.numEntries;
+    m_payload = hdr.payload;
+    m_numValues = (size_t) hdr.numValues;
+    return true;
+}
+
+//===========================================================================
+template <std::integral T>
+void IntegralSetView<T>::clear() {
+    *this = {};
+}
+
+//===========================================================================
+template <std::integral T>
+auto IntegralSetView<T>::begin() const -> iterator {
+    Iter out(this);
+    out.seek(0, 0);
+    return out;
+}
+
+//===========================================================================
+template <std::integral T>
+auto IntegralSetView<T>::end() const -> iterator {
+    return Iter(this);
+}
+
+//===========================================================================
+// Returns position of the entry that would contain the value, or of the
+// entry after it if there's none.
+template <std::integral T>
+static size_t findEntry(
+    const char * entries,
+    size_t numEntries,
+    make_unsigned_t<T> svalue
+) {
+    using Impl = IntegralSet<T>::Impl;
+    auto key = (uint64_t) svalue >> Impl::kLeafBits;
+
+    // First entry with a key after the value's leaf.
+    size_t first = 0;
+    auto count = numEntries;
+    while (count) {
+        auto step = count / 2;
+        if (ntoh64(entries + (first + step) * kSerialEntryLen) <= key) {
+            first += step + 1;
+            count -= step + 1;
+        } else {
+            count = step;
+        }
+    }
+    if (first) {
+        auto ent = serialEntry(entries, first - 1);
+        auto leaves = ent.type == kSerialFull ? ent.data : 1;
+        if (key - ent.key < leaves)
+            return first - 1;
+    }
+    return first;
+}
+
+//===========================================================================
+template <std::integral T>
+bool IntegralSetView<T>::contains(value_type val) const {
+    using Impl = IntegralSet<T>::Impl;
+    auto svalue = Impl::toStorage(val);
+    auto pos = findEntry<T>(m_entries, m_numEntries, svalue);
+    if (pos == m_numEntries)
+        return false;
+    auto ent = serialEntry(m_entries, pos);
+    if (ent.key > (uint64_t) svalue >> Impl::kLeafBits)
+        return false;
+    if (ent.type == kSerialFull)
+        return true;
+    auto rel = Impl::relValue(svalue, Impl::kMaxDepth);
+    auto ptr = m_payload + ent.data;
+    if (ent.type == kSerialBitmap)
+        return ptr[rel / 8] & (0x80 >> rel % 8);
+
+    // Binary search the array.
+    size_t first = 0;
+    size_t count = ent.count;
+    while (count) {
+        auto step = count / 2;
+        auto mid = ntoh16(ptr + (first + step) * sizeof (uint16_t));
+        if (mid < rel) {
+            first += step + 1;
+            count -= step + 1;
+        } else if (mid > rel) {
+            count = step;
+        } else {
+            return true;
+        }
+    }
+    return false;
+}
+
+//===========================================================================
+template <std::integral T>
+auto IntegralSetView<T>::lowerBound(value_type val) const -> iterator {
+    using Impl = IntegralSet<T>::Impl;
+    auto svalue = Impl::toStorage(val);
+    Iter out(this);
+    auto pos = findEntry<T>(m_entries, m_numEntries, svalue);
+    if (pos != m_numEntries) {
+        auto ent = serialEntry(m_entries, pos);
+        auto base = ent.key << Impl::kLeafBits;
+        out.seek(pos, svalue > base ? svalue - base : 0);
+    }
+    return out;
+}
+
+//===========================================================================
+template <std::integral T>
+auto IntegralSetView<T>::upperBound(value_type val) const -> iterator {
+    return val < numeric_limits<value_type>::max()
+        ? lowerBound(val + 1)
+        : end();
+}
+
+
+/****************************************************************************
+*
+*   IntegralSetView::Iter
+*
+***/
+
+//===========================================================================
+template <std::integral T>
+IntegralSetView<T>::Iter::Iter(const IntegralSetView * view)
+    : m_view(view)
+{}
+
+//===========================================================================
+template <std::integral T>
+auto IntegralSetView<T>::Iter::operator++() -> Iter & {
+    using Impl = IntegralSet<T>::Impl;
+    assert(!m_endmark);
+    auto ent = serialEntry(m_view->m_entries, m_entry);
+    if (ent.type == kSerialArray && m_index + 1 < ent.count) {
+        // Next value in the same array, no need to search for it.
+        m_index += 1;
+        auto ptr = m_view->m_payload + ent.data;
+        m_pos = ntoh16(ptr + m_index * sizeof (uint16_t));
+        m_value = Impl::toValue(
+            (storage_type) ((ent.key << Impl::kLeafBits) + m_pos)
+        );
+    } else {
+        seek(m_entry, m_pos + 1);
+    }
+    return *this;
+}
+
+//===========================================================================
+template <std::integral T>
+bool IntegralSetView<T>::Iter::operator==(const Iter & right) const {
+    return m_view == right.m_view
+        && m_endmark == right.m_endmark
+        && (m_endmark || m_value == right.m_value);
+}
+
+//===========================================================================
+template <std::integral T>
+void IntegralSetView<T>::Iter::seek(size_t entry, uint64_t pos) {
+    using Impl = IntegralSet<T>::Impl;
+    auto leafValues = (uint64_t) Impl::bitNumBits();
+    for (; entry < m_view->m_numEntries; ++entry, pos = 0) {
+        auto ent = serialEntry(m_view->m_entries, entry);
+        auto ptr = m_view->m_payload + ent.data;
+        if (ent.type == kSerialFull) {
+            if (pos >= (uint64_t) ent.data * leafValues)
+                continue;
+        } else if (ent.type == kSerialBitmap) {
+            if (pos >= leafValues)
+                continue;
+            BitView bits{(const uint64_t *) ptr, Impl::bitNumInt64s()};
+            pos = bits.find(pos);
+            if (pos == bits.npos)
+                continue;
+        } else {
+            assert(ent.type == kSerialArray);
+            auto vals = (const uint16_t *) ptr;
+            size_t first = 0;
+            size_t count = ent.count;
+            while (count) {
+                auto step = count / 2;
+                if (ntoh16(vals + first + step) < pos) {
+                    first += step + 1;
+                    count -= step + 1;
+                } else {
+                    count = step;
+                }
+            }
+            if (first == ent.count)
+                continue;
+            m_index = first;
+            pos = ntoh16(vals + first);
+        }
+        m_entry = entry;
+        m_pos = pos;
+        m_value = Impl::toValue(
+            (storage_type) ((ent.key << Impl::kLeafBits) + pos)
+        );
+        m_endmark = false;
+        return;
+    }
+    m_endmark = true;
+}
+
+
 /****************************************************************************
 *
 *   Free functions
 *
 ***/
 
+//===========================================================================
+IntSetParallelFn * Dim::intSetParallel() {
+    return s_parallel.load(memory_order_relaxed);
+}
+
+//===========================================================================
+IntSetParallelFn * Dim::intSetSetParallel(IntSetParallelFn * fn) {
+    return s_parallel.exchange(fn);
+}
+
+
 template class IntegralSet<int>;
 template class IntegralSet<unsigned>;
 
 template class IntegralSet<unsigned,
     std::pmr::polymorphic_allocator<unsigned>>;
+
+template class IntegralSetView<int>;
+template class IntegralSetView<unsigned>;
@@ -1,4 +1,4 @@
-// Copyright Glen Knowles 2017 - 2025.
+// Copyright Glen Knowles 2017 - 2026.
 // Distributed under the Boost Software License, Version 1.0.
 //
 // intset.h - dim basic
@@ -7,15 +7,18 @@
 #include "cppconf/cppconf.h"
 
 #include "basic/algo.h"
+#include "basic/charbuf.h"
 #include "basic/types.h"
 
 #include <compare>
 #include <concepts>
 #include <cstdint>
+#include <functional>
 #include <initializer_list>
 #include <iterator>
 #include <memory_resource>
 #include <ostream>
+#include <span>
 #include <string_view>
 #include <type_traits> // std::is_convertible_v
 #include <utility> // std::declval, std::pair
@@ -61,13 +64,14 @@ public:
     static_assert(std::numeric_limits<T>::radix == 2);
     static_assert(std::numeric_limits<storage_type>::digits == kBitWidth);
 
-    enum NodeType : int {
+    enum NodeType : unsigned {
         kEmpty,         // contains no values
         kFull,          // contains all values in node's domain
         kSmVector,      // small vector of values embedded in node struct
         kVector,        // vector of values
         kBitmap,        // bitmap covering all of node's possible values
         kMeta,          // vector of nodes
+        kRuns,          // vector of [start, len] pairs of contiguous values
         kNodeTypes,
         kMetaParent,    // link to parent meta node
     };
@@ -131,6 +135,8 @@ public:
     void assign(std::initializer_list<value_type> il);
     void assign(value_type start, size_t len);
     void assign(std::string_view src); // space separated ranges
+    // Takes nodes from other instead of copying them where it can, other is
+    // always left empty.
     void insert(IntegralSet && other);
     void insert(const IntegralSet & other);
     bool insert(value_type val); // returns true if inserted
@@ -146,10 +152,26 @@ public:
     void erase(value_type start, size_t len);
     value_type pop_back();
     value_type pop_front();
+    // Takes nodes from other where it can and always leaves it empty.
     void intersect(IntegralSet && other);
     void intersect(const IntegralSet & other);
     void swap(IntegralSet & other);
 
+    // parallel
+    // Same as insert, erase, and intersect with another set, except that the
+    // subtrees of large sets are combined at the same time by the function
+    // set with intSetSetParallel(), so the allocator must be safe to use from
+    // multiple threads.
+    void parallelInsert(const IntegralSet & other);
+    void parallelErase(const IntegralSet & other);
+    void parallelIntersect(const IntegralSet & other);
+    // Replaces the contents with the union, or intersection, of the sets,
+    // which may include this one. Each subtree is built from all the sets at
+    // once, without intermediate sets, and large ones are split up the same
+    // way as by parallelInsert(). With no sets the result is empty.
+    void unionAll(std::span<const IntegralSet * const> sets);
+    void intersectAll(std::span<const IntegralSet * const> sets);
+
     // compare
     std::strong_ordering compare(const IntegralSet & other) const;
     std::strong_ordering operator<=>(const IntegralSet & other) const;
@@ -161,6 +183,11 @@ public:
     size_t count() const; // alias for size()
     size_t count(value_type val) const;
     size_t count(value_type start, size_t len) const;
+    // Number of values less than val, and the value at position pos, or
+    // end() if there aren't more than pos values. Both take time proportional
+    // to the depth of the tree, not the number of values skipped.
+    size_t rank(value_type val) const;
+    iterator select(size_t pos) const;
     bool contains(value_type val) const;
     bool contains(const IntegralSet & other) const;
     bool intersects(const IntegralSet & other) const;
@@ -178,6 +205,19 @@ public:
     iterator firstContiguous(iterator where) const;
     iterator lastContiguous(iterator where) const;
 
+    // serialize
+    // Appends the set in a portable binary format, which can be restored with
+    // load() or queried in place with IntegralSetView.
+    void save(CharBuf * out) const;
+    // Replaces the contents with the saved set. Returns false, leaving the
+    // set unchanged, if src isn't a set of this value type saved by save().
+    [[nodiscard]] bool load(std::string_view src);
+
+    // debug
+    // Asserts that the number of values kept for the children of each meta
+    // node matches a recount of them. Does nothing when asserts are disabled.
+    void assertCounts() const;
+
 private:
     friend std::ostream & operator<<(
         std::ostream & os,
@@ -339,6 +379,144 @@ private:
 };
 
 
+/****************************************************************************
+*
+*   IntegralSetView
+*
+*   Read-only set over the format written by IntegralSet::save(), such as a
+*   memory mapped file, that is queried without loading it. The data must
+*   outlive the view and should be 8 byte aligned.
+*
+***/
+
+template <std::integral T>
+class IntegralSetView {
+public:
+    class Iter;
+
+    using value_type = T;
+    using storage_type = std::make_unsigned_t<T>;
+    using iterator = Iter;
+    using size_type = size_t;
+
+public:
+    // Only the header and table of contents are checked, values are trusted
+    // to be as save() wrote them.
+    [[nodiscard]] bool parse(std::string_view src);
+    void clear();
+
+    // iterators
+    iterator begin() const;
+    iterator end() const;
+
+    // capacity
+    bool empty() const { return !m_numValues; }
+    size_t size() const { return m_numValues; }
+
+    // search
+    bool contains(value_type val) const;
+    iterator lowerBound(value_type val) const;  // greaterEqual
+    iterator upperBound(value_type val) const;  // greater
+
+private:
+    friend Iter;
+
+    const char * m_entries = nullptr;
+    size_t m_numEntries = 0;
+    const char * m_payload = nullptr;
+    size_t m_numValues = 0;
+};
+
+
+/****************************************************************************
+*
+*   IntegralSetView::Iter
+*
+***/
+
+template <std::integral T>
+class IntegralSetView<T>::Iter {
+public:
+    using iterator_category = std::forward_iterator_tag;
+    using value_type = IntegralSetView::value_type;
+    using difference_type = ptrdiff_t;
+    using pointer = const value_type*;
+    using reference = value_type;
+
+public:
+    Iter() = default;
+    Iter(const Iter & from) = default;
+    Iter & operator=(const Iter & from) = default;
+    Iter & operator++();
+    explicit operator bool() const { return !m_endmark; }
+    bool operator==(const Iter & right) const;
+    const value_type & operator*() const { return m_value; }
+    const value_type * operator->() const { return &m_value; }
+
+private:
+    friend IntegralSetView;
+    Iter(const IntegralSetView * view);
+
+    // Moves to first value, at or after pos within the entry, that's in the
+    // set.
+    void seek(size_t entry, uint64_t pos);
+
+    const IntegralSetView * m_view = nullptr;
+    size_t m_entry = 0;     // position in table of contents
+    uint64_t m_pos = 0;     // offset of value from start of entry
+    size_t m_index = 0;     // position in array of values, if array entry
+    value_type m_value = 0;
+    bool m_endmark = true;
+};
+
+
+/****************************************************************************
+*
+*   Set operation kernels
+*
+***/
+
+// Instruction sets the loops that combine bitmap and vector nodes can be
+// built on.
+enum class IntSetSimd {
+    kScalar,    // portable 64-bit word at a time
+    kSse42,     // 128-bit SSE4.2 and POPCNT
+    kAvx2,      // 256-bit AVX2
+};
+
+// Returns the instruction set in use, which defaults to the best one the CPU
+// supports.
+IntSetSimd intSetSimd();
+
+// Selects the instruction set to use, limited to what the CPU supports, and
+// returns the one actually selected. Meant for tests and benchmarks comparing
+// the kernels.
+IntSetSimd intSetSetSimd(IntSetSimd simd);
+
+
+/****************************************************************************
+*
+*   Parallel set operations
+*
+***/
+
+// Calls fn(i) for each i in [0, count), possibly at the same time on other
+// threads, and returns once every call has finished.
+using IntSetParallelFn = void(
+    size_t count,
+    const std::function<void(size_t)> & fn
+);
+
+// Returns the function used to run the parts of parallel set operations, or
+// null if they're run one after another by the calling thread.
+IntSetParallelFn * intSetParallel();
+
+// Sets the function used to run the parts of parallel set operations, and
+// returns the one it replaces. The task library sets one that runs them on
+// the compute queue.
+IntSetParallelFn * intSetSetParallel(IntSetParallelFn * fn);
+
+
 /****************************************************************************
 *
 *   Aliases
@@ -346,6 +524,7 @@ private:
 ***/
 
 using UnsignedSet = IntegralSet<unsigned>;
+using UnsignedSetView = IntegralSetView<unsigned>;
 
 extern template class IntegralSet<int>;
 extern template class IntegralSet<unsigned>;
@@ -353,4 +532,7 @@ extern template class IntegralSet<unsigned>;
 extern template class IntegralSet<unsigned,
     std::pmr::polymorphic_allocator<unsigned>>;
 
+extern template class IntegralSetView<int>;
+extern template class IntegralSetView<unsigned>;
+
 } // namespace
@@ -0,0 +1,89 @@
+// Copyright Glen Knowles 2026.
+// Distributed under the Boost Software License, Version 1.0.
+//
+// intsetint.h - dim basic
+#pragma once
+
+#include "cppconf/cppconf.h"
+
+#include <cstdint>
+
+namespace Dim {
+
+
+/****************************************************************************
+*
+*   IntegralSet node kernels
+*
+*   Word and value loops that IntegralSet uses to combine bitmap and vector
+*   nodes. Each dispatches to the implementation for the instruction set
+*   selected by intSetSetSimd().
+*
+***/
+
+// Extra room, in values, that the output of the vector kernels must have
+// beyond the largest possible result. Whole registers are stored even when
+// only some of their lanes are kept.
+constexpr size_t kIntSetVecSlack = 8;
+
+struct IntSetBitsInfo {
+    size_t words;   // non-zero words in the result
+    size_t bits;    // bits set in the result
+};
+
+// Combines src into dst, both bitmaps of count words.
+IntSetBitsInfo iIntSetBitAnd(uint64_t * dst, const uint64_t * src, size_t count);
+IntSetBitsInfo iIntSetBitOr(uint64_t * dst, const uint64_t * src, size_t count);
+IntSetBitsInfo iIntSetBitAndNot(
+    uint64_t * dst,
+    const uint64_t * src,
+    size_t count
+);
+
+// True if any bit is set in both.
+bool iIntSetBitIntersects(
+    const uint64_t * left,
+    const uint64_t * right,
+    size_t count
+);
+
+// True if every bit set in right is also set in left.
+bool iIntSetBitContains(
+    const uint64_t * left,
+    const uint64_t * right,
+    size_t count
+);
+
+// Left and right are sorted and without duplicates, out must not overlap
+// either of them and have room for lcount + rcount + kIntSetVecSlack values
+// (union) or min(lcount, rcount) + kIntSetVecSlack values (intersect).
+// Returns the number of values written.
+size_t iIntSetVecIntersect(
+    uint32_t * out,
+    const uint32_t * left,
+    size_t lcount,
+    const uint32_t * right,
+    size_t rcount
+);
+size_t iIntSetVecUnion(
+    uint32_t * out,
+    const uint32_t * left,
+    size_t lcount,
+    const uint32_t * right,
+    size_t rcount
+);
+
+// Keeps the values whose bit, at (value - base) in the bitmap as numbered by
+// BitView, is set when "present" is true or clear when it's false. The values
+// must all be within the bitmap. Returns the number kept, which are also
+// copied to out unless it's null. Out may be null or values itself.
+size_t iIntSetVecProbe(
+    uint32_t * out,
+    const uint32_t * values,
+    size_t count,
+    const uint64_t * bits,
+    uint32_t base,
+    bool present
+);
+
+} // namespace
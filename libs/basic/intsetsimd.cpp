@@ -0,0 +1,888 @@
+// Copyright Glen Knowles 2026.
+// Distributed under the Boost Software License, Version 1.0.
+//
+// intsetsimd.cpp - dim basic
+//
+// Bitmap and vector kernels for IntegralSet, with SSE4.2 and AVX2 versions
+// selected at runtime. The vector intersection and union kernels follow the
+// shuffle based approach described by Lemire, Boytsov, and Kurz in "SIMD
+// Compression and the Intersection of Sorted Integers".
+#include "pch.h"
+#pragma hdrstop
+
+using namespace std;
+using namespace Dim;
+
+
+/****************************************************************************
+*
+*   Declarations
+*
+***/
+
+#if defined(_M_X64) || defined(__x86_64__)
+#define INTSET_X86
+#endif
+
+// GCC and clang only emit instructions beyond the baseline for functions
+// that ask for them, MSVC emits any intrinsic it's given.
+#if defined(INTSET_X86) && (defined(__GNUC__) || defined(__clang__))
+#define INTSET_TARGET(isa) __attribute__((target(isa)))
+#else
+#define INTSET_TARGET(isa)
+#endif
+
+namespace {
+
+enum BitOp {
+    kAnd,
+    kOr,
+    kAndNot,
+};
+
+// Byte shuffles that move the selected 32-bit lanes of a 128-bit register
+// to the front, indexed by a bitmask of the lanes to keep.
+struct CompactTable {
+    alignas(16) uint8_t shuf[16][16];
+};
+
+} // namespace
+
+
+/****************************************************************************
+*
+*   Variables
+*
+***/
+
+//===========================================================================
+consteval static CompactTable makeCompactTable() {
+    CompactTable out = {};
+    for (unsigned mask = 0; mask < 16; ++mask) {
+        unsigned pos = 0;
+        for (unsigned lane = 0; lane < 4; ++lane) {
+            if (mask & (1 << lane)) {
+                for (unsigned i = 0; i < 4; ++i)
+                    out.shuf[mask][4 * pos + i] = uint8_t(4 * lane + i);
+                pos += 1;
+            }
+        }
+        for (; pos < 4; ++pos) {
+            for (unsigned i = 0; i < 4; ++i)
+                out.shuf[mask][4 * pos + i] = 0x80;
+        }
+    }
+    return out;
+}
+
+[[maybe_unused]] constinit static const CompactTable s_compact =
+    makeCompactTable();
+
+
+/****************************************************************************
+*
+*   Helpers
+*
+***/
+
+//===========================================================================
+static IntSetSimd detectSimd() {
+#if defined(INTSET_X86) && defined(_MSC_VER) && !defined(__clang__)
+    int info[4];
+    __cpuid(info, 0);
+    auto maxLeaf = info[0];
+    __cpuid(info, 1);
+    bool sse42 = info[2] & (1 << 20);
+    bool popcnt = info[2] & (1 << 23);
+    bool osxsave = info[2] & (1 << 27);
+    bool avx = info[2] & (1 << 28);
+    if (!sse42 || !popcnt)
+        return IntSetSimd::kScalar;
+    // AVX2 also requires that the OS saves the upper halves of the ymm
+    // registers on context switch.
+    if (maxLeaf >= 7 && osxsave && avx && (_xgetbv(0) & 6) == 6) {
+        __cpuidex(info, 7, 0);
+        if (info[1] & (1 << 5))
+            return IntSetSimd::kAvx2;
+    }
+    return IntSetSimd::kSse42;
+#elif defined(INTSET_X86)
+    __builtin_cpu_init();
+    if (!__builtin_cpu_supports("sse4.2") || !__builtin_cpu_supports("popcnt"))
+        return IntSetSimd::kScalar;
+    if (__builtin_cpu_supports("avx2"))
+        return IntSetSimd::kAvx2;
+    return IntSetSimd::kSse42;
+#else
+    return IntSetSimd::kScalar;
+#endif
+}
+
+//===========================================================================
+static IntSetSimd bestSimd() {
+    static const IntSetSimd s_best = detectSimd();
+    return s_best;
+}
+
+//===========================================================================
+static atomic<IntSetSimd> & currentSimd() {
+    static atomic<IntSetSimd> s_current = bestSimd();
+    return s_current;
+}
+
+//===========================================================================
+static IntSetSimd simd() {
+    return currentSimd().load(memory_order_relaxed);
+}
+
+
+/****************************************************************************
+*
+*   Scalar kernels
+*
+***/
+
+//===========================================================================
+template <BitOp Op>
+static uint64_t combine(uint64_t left, uint64_t right) {
+    if constexpr (Op == kAnd) {
+        return left & right;
+    } else if constexpr (Op == kOr) {
+        return left | right;
+    } else {
+        return left & ~right;
+    }
+}
+
+//===========================================================================
+template <BitOp Op>
+static void bitOpTail(
+    IntSetBitsInfo * info,
+    uint64_t * dst,
+    const uint64_t * src,
+    size_t count
+) {
+    for (size_t i = 0; i < count; ++i) {
+        auto word = combine<Op>(dst[i], src[i]);
+        dst[i] = word;
+        info->words += word != 0;
+        info->bits += popcount(word);
+    }
+}
+
+//===========================================================================
+template <BitOp Op>
+static IntSetBitsInfo bitOpScalar(
+    uint64_t * dst,
+    const uint64_t * src,
+    size_t count
+) {
+    IntSetBitsInfo info = {};
+    bitOpTail<Op>(&info, dst, src, count);
+    return info;
+}
+
+//===========================================================================
+static bool bitIntersectsScalar(
+    const uint64_t * left,
+    const uint64_t * right,
+    size_t count
+) {
+    for (size_t i = 0; i < count; ++i) {
+        if (left[i] & right[i])
+            return true;
+    }
+    return false;
+}
+
+//===========================================================================
+static bool bitContainsScalar(
+    const uint64_t * left,
+    const uint64_t * right,
+    size_t count
+) {
+    for (size_t i = 0; i < count; ++i) {
+        if (right[i] & ~left[i])
+            return false;
+    }
+    return true;
+}
+
+//===========================================================================
+// Appends the values found in both [li, le) and [ri, re) to out[n], returns
+// the new number of values in out.
+static size_t vecIntersectTail(
+    uint32_t * out,
+    size_t n,
+    const uint32_t * li,
+    const uint32_t * le,
+    const uint32_t * ri,
+    const uint32_t * re
+) {
+    while (li != le && ri != re) {
+        if (*li < *ri) {
+            ++li;
+        } else if (*ri < *li) {
+            ++ri;
+        } else {
+            out[n++] = *li;
+            ++li, ++ri;
+        }
+    }
+    return n;
+}
+
+//===========================================================================
+// Appends the values found in either [li, le) or [ri, re) to out[n], skipping
+// any that are equal to the value before them, returns the new number of
+// values in out.
+static size_t vecUnionTail(
+    uint32_t * out,
+    size_t n,
+    const uint32_t * li,
+    const uint32_t * le,
+    const uint32_t * ri,
+    const uint32_t * re
+) {
+    auto push = [&](uint32_t val) {
+        if (!n || out[n - 1] != val)
+            out[n++] = val;
+    };
+    while (li != le && ri != re) {
+        if (*li < *ri) {
+            push(*li++);
+        } else if (*ri < *li) {
+            push(*ri++);
+        } else {
+            push(*li++);
+            ++ri;
+        }
+    }
+    for (; li != le; ++li)
+        push(*li);
+    for (; ri != re; ++ri)
+        push(*ri);
+    return n;
+}
+
+//===========================================================================
+static size_t vecProbeTail(
+    uint32_t * out,
+    size_t n,
+    const uint32_t * values,
+    size_t count,
+    const uint64_t * bits,
+    uint32_t base,
+    bool present
+) {
+    auto bytes = (const uint8_t *) bits;
+    for (size_t i = 0; i < count; ++i) {
+        auto pos = values[i] - base;
+        bool found = (bytes[pos / 8] >> (7 - pos % 8)) & 1;
+        if (out)
+            out[n] = values[i];
+        n += found == present;
+    }
+    return n;
+}
+
+
+#ifdef INTSET_X86
+
+/****************************************************************************
+*
+*   SSE4.2 kernels
+*
+***/
+
+//===========================================================================
+// Stores the lanes of vals selected by mask to out, returns how many.
+INTSET_TARGET("sse4.2,popcnt")
+static size_t compactSse(uint32_t * out, __m128i vals, int mask) {
+    auto shuf = _mm_load_si128((const __m128i *) s_compact.shuf[mask]);
+    _mm_storeu_si128((__m128i *) out, _mm_shuffle_epi8(vals, shuf));
+    return _mm_popcnt_u32(mask);
+}
+
+//===========================================================================
+template <BitOp Op>
+INTSET_TARGET("sse4.2,popcnt")
+static IntSetBitsInfo bitOpSse(
+    uint64_t * dst,
+    const uint64_t * src,
+    size_t count
+) {
+    IntSetBitsInfo info = {};
+    size_t i = 0;
+    for (; i + 2 <= count; i += 2) {
+        auto left = _mm_loadu_si128((const __m128i *) (dst + i));
+        auto right = _mm_loadu_si128((const __m128i *) (src + i));
+        __m128i word;
+        if constexpr (Op == kAnd) {
+            word = _mm_and_si128(left, right);
+        } else if constexpr (Op == kOr) {
+            word = _mm_or_si128(left, right);
+        } else {
+            word = _mm_andnot_si128(right, left);
+        }
+        _mm_storeu_si128((__m128i *) (dst + i), word);
+        auto w0 = (uint64_t) _mm_cvtsi128_si64(word);
+        auto w1 = (uint64_t) _mm_extract_epi64(word, 1);
+        info.words += (w0 != 0) + (w1 != 0);
+        info.bits += _mm_popcnt_u64(w0) + _mm_popcnt_u64(w1);
+    }
+    bitOpTail<Op>(&info, dst + i, src + i, count - i);
+    return info;
+}
+
+//===========================================================================
+INTSET_TARGET("sse4.2,popcnt")
+static bool bitIntersectsSse(
+    const uint64_t * left,
+    const uint64_t * right,
+    size_t count
+) {
+    size_t i = 0;
+    for (; i + 2 <= count; i += 2) {
+        auto lw = _mm_loadu_si128((const __m128i *) (left + i));
+        auto rw = _mm_loadu_si128((const __m128i *) (right + i));
+        if (!_mm_testz_si128(lw, rw))
+            return true;
+    }
+    return bitIntersectsScalar(left + i, right + i, count - i);
+}
+
+//===========================================================================
+INTSET_TARGET("sse4.2,popcnt")
+static bool bitContainsSse(
+    const uint64_t * left,
+    const uint64_t * right,
+    size_t count
+) {
+    size_t i = 0;
+    for (; i + 2 <= count; i += 2) {
+        auto lw = _mm_loadu_si128((const __m128i *) (left + i));
+        auto rw = _mm_loadu_si128((const __m128i *) (right + i));
+        if (!_mm_testc_si128(lw, rw))
+            return false;
+    }
+    return bitContainsScalar(left + i, right + i, count - i);
+}
+
+//===========================================================================
+// Compares each block of four left values with all rotations of a block of
+// four right values, then advances past whichever block ends lower (or both
+// if they end at the same value).
+INTSET_TARGET("sse4.2,popcnt")
+static size_t vecIntersectSse(
+    uint32_t * out,
+    const uint32_t * left,
+    size_t lcount,
+    const uint32_t * right,
+    size_t rcount
+) {
+    size_t n = 0;
+    size_t li = 0;
+    size_t ri = 0;
+    auto lblocks = lcount & ~3;
+    auto rblocks = rcount & ~3;
+    while (li < lblocks && ri < rblocks) {
+        auto lv = _mm_loadu_si128((const __m128i *) (left + li));
+        auto rv = _mm_loadu_si128((const __m128i *) (right + ri));
+        auto eq = _mm_or_si128(
+            _mm_or_si128(
+                _mm_cmpeq_epi32(lv, rv),
+                _mm_cmpeq_epi32(lv, _mm_shuffle_epi32(rv, 0x39))
+            ),
+            _mm_or_si128(
+                _mm_cmpeq_epi32(lv, _mm_shuffle_epi32(rv, 0x4e)),
+                _mm_cmpeq_epi32(lv, _mm_shuffle_epi32(rv, 0x93))
+            )
+        );
+        n += compactSse(out + n, lv, _mm_movemask_ps(_mm_castsi128_ps(eq)));
+        auto lmax = left[li + 3];
+        auto rmax = right[ri + 3];
+        if (lmax <= rmax)
+            li += 4;
+        if (rmax <= lmax)
+            ri += 4;
+    }
+    return vecIntersectTail(
+        out,
+        n,
+        left + li,
+        left + lcount,
+        right + ri,
+        right + rcount
+    );
+}
+
+//===========================================================================
+// Merges two sorted blocks of four into the lowest four (lo) and highest four
+// (hi), both sorted, by repeatedly comparing one with rotations of the other.
+INTSET_TARGET("sse4.2,popcnt")
+static void mergeSse(__m128i a, __m128i b, __m128i * lo, __m128i * hi) {
+    auto tmp = _mm_min_epu32(a, b);
+    *hi = _mm_max_epu32(a, b);
+    for (auto i = 0; i < 3; ++i) {
+        tmp = _mm_alignr_epi8(tmp, tmp, 4);
+        *lo = _mm_min_epu32(tmp, *hi);
+        *hi = _mm_max_epu32(tmp, *hi);
+        tmp = *lo;
+    }
+    *lo = _mm_alignr_epi8(tmp, tmp, 4);
+}
+
+//===========================================================================
+// Stores the values of the sorted block that aren't equal to the one before
+// them, where the one before the first is the last value of prev.
+INTSET_TARGET("sse4.2,popcnt")
+static size_t storeUniqueSse(uint32_t * out, __m128i prev, __m128i vals) {
+    auto shifted = _mm_alignr_epi8(vals, prev, 12);
+    auto dups = _mm_movemask_ps(
+        _mm_castsi128_ps(_mm_cmpeq_epi32(shifted, vals))
+    );
+    return compactSse(out, vals, ~dups & 0xf);
+}
+
+//===========================================================================
+// Feeds blocks of four, always from the input whose next value is lower,
+// through the merge network. The low half of each merge is final and the
+// high half is carried into the next.
+INTSET_TARGET("sse4.2,popcnt")
+static size_t vecUnionSse(
+    uint32_t * out,
+    const uint32_t * left,
+    size_t lcount,
+    const uint32_t * right,
+    size_t rcount
+) {
+    if (lcount < 4 || rcount < 4) {
+        return vecUnionTail(
+            out,
+            0,
+            left,
+            left + lcount,
+            right,
+            right + rcount
+        );
+    }
+
+    __m128i lo;
+    __m128i hi;
+    mergeSse(
+        _mm_loadu_si128((const __m128i *) left),
+        _mm_loadu_si128((const __m128i *) right),
+        &lo,
+        &hi
+    );
+    size_t li = 4;
+    size_t ri = 4;
+    // Start with a previous value that can't match the first one.
+    auto prev = _mm_set1_epi32(_mm_cvtsi128_si32(lo) - 1);
+    auto n = storeUniqueSse(out, prev, lo);
+    prev = lo;
+    while (li + 4 <= lcount && ri + 4 <= rcount) {
+        __m128i next;
+        if (left[li] <= right[ri]) {
+            next = _mm_loadu_si128((const __m128i *) (left + li));
+            li += 4;
+        } else {
+            next = _mm_loadu_si128((const __m128i *) (right + ri));
+            ri += 4;
+        }
+        mergeSse(next, hi, &lo, &hi);
+        n += storeUniqueSse(out + n, prev, lo);
+        prev = lo;
+    }
+
+    // At least one side has less than a block left, fold it into the carried
+    // high half and then merge that with the rest of the other side.
+    alignas(16) uint32_t carry[4];
+    _mm_store_si128((__m128i *) carry, hi);
+    uint32_t tmp[8 + kIntSetVecSlack];
+    size_t tcount;
+    if (li + 4 > lcount) {
+        tcount = vecUnionTail(tmp, 0, carry, carry + 4, left + li,
+            left + lcount);
+        left = right + ri;
+        lcount = rcount - ri;
+    } else {
+        tcount = vecUnionTail(tmp, 0, carry, carry + 4, right + ri,
+            right + rcount);
+        left += li;
+        lcount -= li;
+    }
+    return vecUnionTail(out, n, tmp, tmp + tcount, left, left + lcount);
+}
+
+
+/****************************************************************************
+*
+*   AVX2 kernels
+*
+***/
+
+//===========================================================================
+// Adds the number of bits set in each 64-bit lane of word to the lanes of
+// total, using in register table lookups of the bits set in each nibble.
+INTSET_TARGET("avx2,popcnt")
+static __m256i popcountAvx2(__m256i total, __m256i word) {
+    auto table = _mm256_setr_epi8(
+        0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4,
+        0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4
+    );
+    auto nibble = _mm256_set1_epi8(0x0f);
+    auto lo = _mm256_shuffle_epi8(table, _mm256_and_si256(word, nibble));
+    auto hi = _mm256_shuffle_epi8(
+        table,
+        _mm256_and_si256(_mm256_srli_epi16(word, 4), nibble)
+    );
+    auto bytes = _mm256_add_epi8(lo, hi);
+    return _mm256_add_epi64(
+        total,
+        _mm256_sad_epu8(bytes, _mm256_setzero_si256())
+    );
+}
+
+//===========================================================================
+template <BitOp Op>
+INTSET_TARGET("avx2,popcnt")
+static IntSetBitsInfo bitOpAvx2(
+    uint64_t * dst,
+    const uint64_t * src,
+    size_t count
+) {
+    IntSetBitsInfo info = {};
+    auto zero = _mm256_setzero_si256();
+    auto bits = zero;
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        auto left = _mm256_loadu_si256((const __m256i *) (dst + i));
+        auto right = _mm256_loadu_si256((const __m256i *) (src + i));
+        __m256i word;
+        if constexpr (Op == kAnd) {
+            word = _mm256_and_si256(left, right);
+        } else if constexpr (Op == kOr) {
+            word = _mm256_or_si256(left, right);
+        } else {
+            word = _mm256_andnot_si256(right, left);
+        }
+        _mm256_storeu_si256((__m256i *) (dst + i), word);
+        auto empty = _mm256_movemask_pd(
+            _mm256_castsi256_pd(_mm256_cmpeq_epi64(word, zero))
+        );
+        info.words += 4 - _mm_popcnt_u32(empty);
+        bits = popcountAvx2(bits, word);
+    }
+    info.bits = _mm256_extract_epi64(bits, 0) + _mm256_extract_epi64(bits, 1)
+        + _mm256_extract_epi64(bits, 2) + _mm256_extract_epi64(bits, 3);
+    bitOpTail<Op>(&info, dst + i, src + i, count - i);
+    return info;
+}
+
+//===========================================================================
+INTSET_TARGET("avx2,popcnt")
+static bool bitIntersectsAvx2(
+    const uint64_t * left,
+    const uint64_t * right,
+    size_t count
+) {
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        auto lw = _mm256_loadu_si256((const __m256i *) (left + i));
+        auto rw = _mm256_loadu_si256((const __m256i *) (right + i));
+        if (!_mm256_testz_si256(lw, rw))
+            return true;
+    }
+    return bitIntersectsScalar(left + i, right + i, count - i);
+}
+
+//===========================================================================
+INTSET_TARGET("avx2,popcnt")
+static bool bitContainsAvx2(
+    const uint64_t * left,
+    const uint64_t * right,
+    size_t count
+) {
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        auto lw = _mm256_loadu_si256((const __m256i *) (left + i));
+        auto rw = _mm256_loadu_si256((const __m256i *) (right + i));
+        if (!_mm256_testc_si256(lw, rw))
+            return false;
+    }
+    return bitContainsScalar(left + i, right + i, count - i);
+}
+
+//===========================================================================
+// Same as vecIntersectSse, but with blocks of eight.
+INTSET_TARGET("avx2,popcnt")
+static size_t vecIntersectAvx2(
+    uint32_t * out,
+    const uint32_t * left,
+    size_t lcount,
+    const uint32_t * right,
+    size_t rcount
+) {
+    size_t n = 0;
+    size_t li = 0;
+    size_t ri = 0;
+    auto lblocks = lcount & ~7;
+    auto rblocks = rcount & ~7;
+    auto rotate = _mm256_setr_epi32(1, 2, 3, 4, 5, 6, 7, 0);
+    while (li < lblocks && ri < rblocks) {
+        auto lv = _mm256_loadu_si256((const __m256i *) (left + li));
+        auto rv = _mm256_loadu_si256((const __m256i *) (right + ri));
+        auto eq = _mm256_cmpeq_epi32(lv, rv);
+        for (auto i = 0; i < 7; ++i) {
+            rv = _mm256_permutevar8x32_epi32(rv, rotate);
+            eq = _mm256_or_si256(eq, _mm256_cmpeq_epi32(lv, rv));
+        }
+        auto mask = _mm256_movemask_ps(_mm256_castsi256_ps(eq));
+        n += compactSse(out + n, _mm256_castsi256_si128(lv), mask & 0xf);
+        n += compactSse(out + n, _mm256_extracti128_si256(lv, 1), mask >> 4);
+        auto lmax = left[li + 7];
+        auto rmax = right[ri + 7];
+        if (lmax <= rmax)
+            li += 8;
+        if (rmax <= lmax)
+            ri += 8;
+    }
+    return vecIntersectTail(
+        out,
+        n,
+        left + li,
+        left + lcount,
+        right + ri,
+        right + rcount
+    );
+}
+
+//===========================================================================
+// Gathers the 32-bit bitmap word holding each of a block of eight values and
+// tests its bit. BitView numbers bits from the high end of each byte, so
+// position p, loaded little endian, is bit (p % 32) ^ 7 of word p / 32.
+// Stores of the kept values never reach past the block just loaded, so out
+// may be the same as values.
+INTSET_TARGET("avx2,popcnt")
+static size_t vecProbeAvx2(
+    uint32_t * out,
+    const uint32_t * values,
+    size_t count,
+    const uint64_t * bits,
+    uint32_t base,
+    bool present
+) {
+    size_t n = 0;
+    size_t i = 0;
+    auto vbase = _mm256_set1_epi32(base);
+    auto low5 = _mm256_set1_epi32(31);
+    auto seven = _mm256_set1_epi32(7);
+    auto one = _mm256_set1_epi32(1);
+    auto flip = present ? 0 : 0xff;
+    for (; i + 8 <= count; i += 8) {
+        auto vals = _mm256_loadu_si256((const __m256i *) (values + i));
+        auto pos = _mm256_sub_epi32(vals, vbase);
+        auto words = _mm256_i32gather_epi32(
+            (const int *) bits,
+            _mm256_srli_epi32(pos, 5),
+            4
+        );
+        auto bit = _mm256_and_si256(
+            _mm256_srlv_epi32(
+                words,
+                _mm256_xor_si256(_mm256_and_si256(pos, low5), seven)
+            ),
+            one
+        );
+        auto mask = _mm256_movemask_ps(
+            _mm256_castsi256_ps(_mm256_cmpeq_epi32(bit, one))
+        ) ^ flip;
+        if (out) {
+            n += compactSse(out + n, _mm256_castsi256_si128(vals), mask & 0xf);
+            n += compactSse(
+                out + n,
+                _mm256_extracti128_si256(vals, 1),
+                mask >> 4
+            );
+        } else {
+            n += _mm_popcnt_u32(mask);
+        }
+    }
+    return vecProbeTail(
+        out,
+        n,
+        values + i,
+        count - i,
+        bits,
+        base,
+        present
+    );
+}
+
+#endif // INTSET_X86
+
+
+/****************************************************************************
+*
+*   Internal API
+*
+***/
+
+//===========================================================================
+template <BitOp Op>
+static IntSetBitsInfo bitOp(
+    uint64_t * dst,
+    const uint64_t * src,
+    size_t count
+) {
+#ifdef INTSET_X86
+    switch (simd()) {
+    case IntSetSimd::kAvx2: return bitOpAvx2<Op>(dst, src, count);
+    case IntSetSimd::kSse42: return bitOpSse<Op>(dst, src, count);
+    default: break;
+    }
+#endif
+    return bitOpScalar<Op>(dst, src, count);
+}
+
+//===========================================================================
+IntSetBitsInfo Dim::iIntSetBitAnd(
+    uint64_t * dst,
+    const uint64_t * src,
+    size_t count
+) {
+    return bitOp<kAnd>(dst, src, count);
+}
+
+//===========================================================================
+IntSetBitsInfo Dim::iIntSetBitOr(
+    uint64_t * dst,
+    const uint64_t * src,
+    size_t count
+) {
+    return bitOp<kOr>(dst, src, count);
+}
+
+//===========================================================================
+IntSetBitsInfo Dim::iIntSetBitAndNot(
+    uint64_t * dst,
+    const uint64_t * src,
+    size_t count
+) {
+    return bitOp<kAndNot>(dst, src, count);
+}
+
+//===========================================================================
+bool Dim::iIntSetBitIntersects(
+    const uint64_t * left,
+    const uint64_t * right,
+    size_t count
+) {
+#ifdef INTSET_X86
+    switch (simd()) {
+    case IntSetSimd::kAvx2: return bitIntersectsAvx2(left, right, count);
+    case IntSetSimd::kSse42: return bitIntersectsSse(left, right, count);
+    default: break;
+    }
+#endif
+    return bitIntersectsScalar(left, right, count);
+}
+
+//===========================================================================
+bool Dim::iIntSetBitContains(
+    const uint64_t * left,
+    const uint64_t * right,
+    size_t count
+) {
+#ifdef INTSET_X86
+    switch (simd()) {
+    case IntSetSimd::kAvx2: return bitContainsAvx2(left, right, count);
+    case IntSetSimd::kSse42: return bitContainsSse(left, right, count);
+    default: break;
+    }
+#endif
+    return bitContainsScalar(left, right, count);
+}
+
+//===========================================================================
+size_t Dim::iIntSetVecIntersect(
+    uint32_t * out,
+    const uint32_t * left,
+    size_t lcount,
+    const uint32_t * right,
+    size_t rcount
+) {
+#ifdef INTSET_X86
+    switch (simd()) {
+    case IntSetSimd::kAvx2:
+        return vecIntersectAvx2(out, left, lcount, right, rcount);
+    case IntSetSimd::kSse42:
+        return vecIntersectSse(out, left, lcount, right, rcount);
+    default:
+        break;
+    }
+#endif
+    return vecIntersectTail(
+        out,
+        0,
+        left,
+        left + lcount,
+        right,
+        right + rcount
+    );
+}
+
+//===========================================================================
+size_t Dim::iIntSetVecUnion(
+    uint32_t * out,
+    const uint32_t * left,
+    size_t lcount,
+    const uint32_t * right,
+    size_t rcount
+) {
+#ifdef INTSET_X86
+    // The merge network has no wider AVX2 form worth its extra shuffles, so
+    // both levels use the 128-bit one.
+    if (simd() != IntSetSimd::kScalar)
+        return vecUnionSse(out, left, lcount, right, rcount);
+#endif
+    return vecUnionTail(out, 0, left, left + lcount, right, right + rcount);
+}
+
+//===========================================================================
+size_t Dim::iIntSetVecProbe(
+    uint32_t * out,
+    const uint32_t * values,
+    size_t count,
+    const uint64_t * bits,
+    uint32_t base,
+    bool present
+) {
+#ifdef INTSET_X86
+    // Without gather SSE4.2 has nothing to add over the scalar loop.
+    if (simd() == IntSetSimd::kAvx2)
+        return vecProbeAvx2(out, values, count, bits, base, present);
+#endif
+    return vecProbeTail(out, 0, values, count, bits, base, present);
+}
+
+
+/****************************************************************************
+*
+*   Public API
+*
+***/
+
+//===========================================================================
+IntSetSimd Dim::intSetSimd() {
+    return simd();
+}
+
+//===========================================================================
+IntSetSimd Dim::intSetSetSimd(IntSetSimd level) {
+    level = min(level, bestSimd());
+    currentSimd().store(level, memory_order_relaxed);
+    return level;
+}
@@ -1,4 +1,4 @@
-// Copyright Glen Knowles 2015 - 2025.
+// Copyright Glen Knowles 2015 - 2026.
 // Distributed under the Boost Software License, Version 1.0.
 //
 // pch.h - dim basic
@@ -32,5 +32,13 @@
 #include <vector>
 
 // Platform headers
+#if defined(_M_X64) || defined(__x86_64__)
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
 // External library internal headers
 // Internal headers
+#include "basic/intsetint.h"
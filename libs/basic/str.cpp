@@ -676,6 +676,22 @@ string Dim::toUpper(string_view src) {
     return out;
 }
 
+//===========================================================================
+bool Dim::equalNoCase(string_view a, string_view b) {
+    if (a.size() != b.size())
+        return false;
+    for (size_t i = 0; i < a.size(); ++i) {
+        unsigned char ca = a[i];
+        unsigned char cb = b[i];
+        if (ca == cb)
+            continue;
+        // Same letter in the other case only differs by the 0x20 bit.
+        if ((ca ^ cb) != 0x20 || (ca | 0x20) < 'a' || (ca | 0x20) > 'z')
+            return false;
+    }
+    return true;
+}
+
 
 /****************************************************************************
 *
@@ -382,6 +382,10 @@ char * toUpper(char src[], size_t srclen);
 std::string toLower(std::string_view src);
 std::string toUpper(std::string_view src);
 
+// Compares only ASCII letters without regard to case, for protocol tokens
+// such as header values that aren't subject to the locale.
+bool equalNoCase(std::string_view a, std::string_view b);
+
 
 /****************************************************************************
 *
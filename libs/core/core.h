@@ -9,6 +9,7 @@
 
 #include "cppconf/cppconf.h"
 
+#include "coro.h"
 #include "crypt.h"
 #include "log.h"
 #include "memory.h"
@@ -0,0 +1,225 @@
+// Copyright Glen Knowles 2026.
+// Distributed under the Boost Software License, Version 1.0.
+//
+// coro.h - dim core
+//
+// Coroutine types and awaitables layered over the task queue and timer
+// callback interfaces.
+#pragma once
+
+#include "cppconf/cppconf.h"
+
+#include "basic/tempheap.h"
+#include "core/task.h"
+#include "core/time.h"
+#include "core/timer.h"
+
+#include <coroutine>
+#include <cstddef>
+#include <exception> // std::terminate
+#include <memory> // std::allocator_arg_t
+#include <new>
+
+namespace Dim {
+
+
+/****************************************************************************
+*
+*   CoTask
+*
+*   Return type of fire and forget coroutines. The coroutine starts running
+*   immediately, on the calling thread, and its frame is freed when it
+*   completes. Exceptions escaping the coroutine terminate the program.
+*
+*   Frames are allocated with new, unless the coroutine's parameters start
+*   with (std::allocator_arg_t, IHeap *), in which case the frame comes from
+*   that heap. For example, a TempHeap owned by a connection lets all of the
+*   connection's handlers run without touching the global allocator. The
+*   heap must outlive the coroutine.
+*
+***/
+
+class CoTask {
+public:
+    class promise_type;
+};
+
+class CoTask::promise_type {
+public:
+    CoTask get_return_object() noexcept { return {}; }
+    std::suspend_never initial_suspend() noexcept { return {}; }
+    std::suspend_never final_suspend() noexcept { return {}; }
+    void return_void() noexcept {}
+    void unhandled_exception() noexcept { std::terminate(); }
+
+    static void * operator new(size_t bytes);
+    template <typename... Args>
+    static void * operator new(
+        size_t bytes,
+        std::allocator_arg_t,
+        IHeap * heap,
+        Args &...
+    );
+    // Member function coroutines, where the object comes first.
+    template <typename C, typename... Args>
+    static void * operator new(
+        size_t bytes,
+        C &,
+        std::allocator_arg_t,
+        IHeap * heap,
+        Args &...
+    );
+    static void operator delete(void * ptr, size_t bytes);
+
+private:
+    // Precedes each frame to record which heap, if any, it came from. Sized
+    // to keep the frame itself at the default new alignment.
+    struct alignas(__STDCPP_DEFAULT_NEW_ALIGNMENT__) Header {
+        IHeap * heap;
+    };
+
+    static void * alloc(size_t bytes, IHeap * heap);
+};
+
+//===========================================================================
+inline void * CoTask::promise_type::alloc(size_t bytes, IHeap * heap) {
+    bytes += sizeof(Header);
+    auto ptr = heap
+        ? heap->allocate(bytes, alignof(Header))
+        : ::operator new(bytes);
+    auto hdr = new(ptr) Header{heap};
+    return hdr + 1;
+}
+
+//===========================================================================
+inline void * CoTask::promise_type::operator new(size_t bytes) {
+    return alloc(bytes, nullptr);
+}
+
+//===========================================================================
+template <typename... Args>
+inline void * CoTask::promise_type::operator new(
+    size_t bytes,
+    std::allocator_arg_t,
+    IHeap * heap,
+    Args &...
+) {
+    return alloc(bytes, heap);
+}
+
+//===========================================================================
+template <typename C, typename... Args>
+inline void * CoTask::promise_type::operator new(
+    size_t bytes,
+    C &,
+    std::allocator_arg_t,
+    IHeap * heap,
+    Args &...
+) {
+    return alloc(bytes, heap);
+}
+
+//===========================================================================
+inline void CoTask::promise_type::operator delete(void * ptr, size_t bytes) {
+    auto hdr = static_cast<Header *>(ptr) - 1;
+    bytes += sizeof(Header);
+    if (auto heap = hdr->heap) {
+        heap->deallocate(hdr, bytes, alignof(Header));
+    } else {
+        ::operator delete(hdr, bytes);
+    }
+}
+
+
+/****************************************************************************
+*
+*   CoResumeTask
+*
+*   Task that resumes a suspended coroutine, intended to be embedded in
+*   awaiters so that hopping between queues allocates nothing.
+*
+***/
+
+class CoResumeTask : public ITaskNotify {
+public:
+    std::coroutine_handle<> handle;
+
+private:
+    void onTask() override { handle.resume(); }
+};
+
+
+/****************************************************************************
+*
+*   taskOn
+*
+*   co_await taskOn(q) - continues the coroutine on a thread of the queue.
+*
+***/
+
+class TaskOnAwaiter {
+public:
+    explicit TaskOnAwaiter(TaskQueueHandle q) : m_q{q} {}
+
+    bool await_ready() const noexcept { return false; }
+    void await_suspend(std::coroutine_handle<> h) {
+        m_task.handle = h;
+        taskPush(m_q, &m_task);
+    }
+    void await_resume() const noexcept {}
+
+private:
+    TaskQueueHandle m_q;
+    CoResumeTask m_task;
+};
+
+//===========================================================================
+inline TaskOnAwaiter taskOn(TaskQueueHandle q) {
+    return TaskOnAwaiter{q};
+}
+
+
+/****************************************************************************
+*
+*   timerSleep
+*
+*   co_await timerSleep(wait, q) - continues the coroutine on a thread of
+*   the queue (the event queue by default) after the wait has elapsed.
+*
+***/
+
+class TimerSleepAwaiter : ITimerNotify {
+public:
+    TimerSleepAwaiter(Duration wait, TaskQueueHandle q)
+        : m_wait{wait}
+        , m_q{q ? q : taskEventQueue()}
+    {}
+
+    bool await_ready() const noexcept { return m_wait <= Duration::zero(); }
+    void await_suspend(std::coroutine_handle<> h) {
+        m_task.handle = h;
+        timerUpdate(this, m_wait);
+    }
+    void await_resume() const noexcept {}
+
+private:
+    // Resumes through the queue, so the coroutine may continue and destroy
+    // the awaiter on another thread before this returns. That's safe only
+    // because ~ITimerNotify calls timerCloseWait(), which blocks until the
+    // callback has finished with the notifier.
+    Duration onTimer(TimePoint /* now */) override {
+        taskPush(m_q, &m_task);
+        return kTimerInfinite;
+    }
+
+    Duration m_wait;
+    TaskQueueHandle m_q;
+    CoResumeTask m_task;
+};
+
+//===========================================================================
+inline TimerSleepAwaiter timerSleep(Duration wait, TaskQueueHandle q = {}) {
+    return TimerSleepAwaiter{wait, q};
+}
+
+} // namespace
@@ -1,4 +1,4 @@
-// Copyright Glen Knowles 2015 - 2023.
+// Copyright Glen Knowles 2015 - 2026.
 // Distributed under the Boost Software License, Version 1.0.
 //
 // log.cpp - dim core
@@ -51,7 +51,7 @@ static thread_local bool t_inProgress;
 *
 ***/
 
-static atomic<int> * s_perfs[] = {
+static PerfCounter<int> * s_perfs[] = {
     nullptr, // log invalid
     &iperf("log.debug"),
     &iperf("log.info"),
@@ -16,7 +16,9 @@
 #include <cassert>
 #include <cerrno>
 #include <charconv>
+#include <cmath>
 #include <condition_variable>
+#include <deque>
 #include <functional>
 #include <iomanip>
 #include <iostream>
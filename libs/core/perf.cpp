@@ -1,4 +1,4 @@
-// Copyright Glen Knowles 2017 - 2024.
+// Copyright Glen Knowles 2017 - 2026.
 // Distributed under the Boost Software License, Version 1.0.
 //
 // perf.cpp - dim core
@@ -28,6 +28,17 @@ struct PerfBase {
     string m_name;
 };
 
+// Integral counters are sharded, floats are rarely updated and stay a single
+// atomic value.
+template<typename T>
+struct PerfStorage {
+    using type = atomic<T>;
+};
+template<integral T>
+struct PerfStorage<T> {
+    using type = PerfCounter<T>;
+};
+
 template<typename T, PerfFormat Fmt>
 struct PerfAtomic final : PerfBase {
     PerfType type() const override;
@@ -35,7 +46,7 @@ struct PerfAtomic final : PerfBase {
     double toDouble() const override;
     void toString(string * out, bool pretty) const override;
 
-    atomic<T> m_val;
+    typename PerfStorage<T>::type m_val;
 };
 
 template<typename T, PerfFormat Fmt>
@@ -48,6 +59,18 @@ struct PerfFunc final : PerfBase {
     function<T()> m_fn;
 };
 
+// One of the values reported for a histogram, either the count or the
+// requested percentile.
+struct PerfHistStat final : PerfBase {
+    PerfType type() const override;
+    PerfFormat format() const override;
+    double toDouble() const override;
+    void toString(string * out, bool pretty) const override;
+
+    shared_ptr<PerfHistogram> m_hist;
+    double m_fraction{}; // percentile, or zero for count
+};
+
 struct PerfInfo {
     // mutex only needed for the vector itself.
     shared_mutex mut;
@@ -82,7 +105,7 @@ static PerfInfo & getInfo () {
 
 //===========================================================================
 template <typename T, PerfFormat Fmt>
-static atomic<T> & perf(string_view name) {
+static typename PerfStorage<T>::type & perf(string_view name) {
     auto & info = getInfo();
     unique_lock lk{info.mut};
     info.counters.push_back(make_unique<PerfAtomic<T, Fmt>>());
@@ -108,7 +131,7 @@ template <typename T>
 static PerfType perfType() {
     if constexpr (is_same_v<T, int>) {
         return PerfType::kInt;
-    } else if constexpr (is_same_v<T, unsigned>) {
+    } else if constexpr (is_same_v<T, unsigned> || is_same_v<T, uint64_t>) {
         return PerfType::kUnsigned;
     } else if constexpr (is_same_v<T, float>) {
         return PerfType::kFloat;
@@ -352,6 +375,110 @@ inline PerfType PerfFunc<T, Fmt>::type () const {
 }
 
 
+/****************************************************************************
+*
+*   PerfHistogram
+*
+***/
+
+//===========================================================================
+// static
+uint64_t PerfHistogram::bucketMax(unsigned pos) {
+    if (pos < kSubBuckets)
+        return pos;
+    auto shift = pos / kSubBuckets - 1;
+    auto base = uint64_t{kSubBuckets + pos % kSubBuckets} << shift;
+    return base + (uint64_t{1} << shift) - 1;
+}
+
+//===========================================================================
+uint64_t PerfHistogram::count() const {
+    uint64_t num = 0;
+    for (auto && shard : m_shards) {
+        for (auto && cnt : shard.counts)
+            num += cnt.load(memory_order_relaxed);
+    }
+    return num;
+}
+
+//===========================================================================
+uint64_t PerfHistogram::overflow() const {
+    uint64_t num = 0;
+    for (auto && shard : m_shards)
+        num += shard.counts[kOverflow].load(memory_order_relaxed);
+    return num;
+}
+
+//===========================================================================
+Duration PerfHistogram::percentile(double fraction) const {
+    uint64_t counts[kNumBuckets] = {};
+    uint64_t num = 0;
+    for (auto && shard : m_shards) {
+        for (unsigned i = 0; i < kNumBuckets; ++i) {
+            auto cnt = shard.counts[i].load(memory_order_relaxed);
+            counts[i] += cnt;
+            num += cnt;
+        }
+    }
+    if (!num)
+        return {};
+
+    // Rank of the value wanted, counting from one.
+    auto rank = (uint64_t) ceil(fraction * num);
+    rank = clamp<uint64_t>(rank, 1, num);
+    uint64_t seen = 0;
+    for (unsigned i = 0; i < kOverflow; ++i) {
+        seen += counts[i];
+        if (seen >= rank)
+            return Duration{(Duration::rep) bucketMax(i)};
+    }
+    return Duration::max();
+}
+
+
+/****************************************************************************
+*
+*   PerfHistStat
+*
+***/
+
+//===========================================================================
+PerfType PerfHistStat::type() const {
+    return m_fraction ? PerfType::kFloat : PerfType::kUnsigned;
+}
+
+//===========================================================================
+PerfFormat PerfHistStat::format() const {
+    return m_fraction ? PerfFormat::kDuration : PerfFormat::kDefault;
+}
+
+//===========================================================================
+double PerfHistStat::toDouble() const {
+    if (!m_fraction)
+        return (double) m_hist->count();
+    return chrono::duration<double>(m_hist->percentile(m_fraction)).count();
+}
+
+//===========================================================================
+void PerfHistStat::toString(string * out, bool pretty) const {
+    if (!m_fraction) {
+        auto val = m_hist->count();
+        if (pretty) {
+            PerfPrint<uint64_t, PerfFormat::kDefault>().format(out, val);
+        } else {
+            PerfPrint<uint64_t, PerfFormat::kMachine>().format(out, val);
+        }
+        return;
+    }
+    auto val = (float) toDouble();
+    if (pretty) {
+        PerfPrint<float, PerfFormat::kDuration>().format(out, val);
+    } else {
+        PerfPrint<float, PerfFormat::kMachine>().format(out, val);
+    }
+}
+
+
 /****************************************************************************
 *
 *   Internal API
@@ -382,7 +509,7 @@ void Dim::iPerfDestroy() {
 
 //===========================================================================
 template<typename T>
-static atomic<T> & perf(string_view name, PerfFormat fmt) {
+static typename PerfStorage<T>::type & perf(string_view name, PerfFormat fmt) {
     using enum PerfFormat;
     switch (fmt) {
     default:
@@ -396,12 +523,12 @@ static atomic<T> & perf(string_view name, PerfFormat fmt) {
 }
 
 //===========================================================================
-atomic<int> & Dim::iperf(string_view name, PerfFormat fmt) {
+PerfCounter<int> & Dim::iperf(string_view name, PerfFormat fmt) {
     return perf<int>(name, fmt);
 }
 
 //===========================================================================
-atomic<unsigned> & Dim::uperf(string_view name, PerfFormat fmt) {
+PerfCounter<unsigned> & Dim::uperf(string_view name, PerfFormat fmt) {
     return perf<unsigned>(name, fmt);
 }
 
@@ -410,6 +537,11 @@ atomic<float> & Dim::fperf(string_view name, PerfFormat fmt) {
     return perf<float>(name, fmt);
 }
 
+//===========================================================================
+PerfCounter<uint64_t> & Dim::u64perf(string_view name, PerfFormat fmt) {
+    return perf<uint64_t>(name, fmt);
+}
+
 //===========================================================================
 template<typename T>
 static function<T()> & perf(
@@ -456,6 +588,33 @@ function<float()> & Dim::fperf(
     return perf<float>(name, move(fn), fmt);
 }
 
+//===========================================================================
+PerfHistogram & Dim::hperf(string_view name) {
+    // The stats share ownership, so the histogram lives until the last of
+    // them is destroyed.
+    auto hist = make_shared<PerfHistogram>();
+    struct {
+        string_view suffix;
+        double fraction;
+    } const stats[] = {
+        { " (count)", 0 },
+        { " (p50)", 0.5 },
+        { " (p99)", 0.99 },
+        { " (p999)", 0.999 },
+    };
+    auto & info = getInfo();
+    unique_lock lk{info.mut};
+    for (auto && st : stats) {
+        auto cnt = make_unique<PerfHistStat>();
+        cnt->m_name = name;
+        cnt->m_name += st.suffix;
+        cnt->m_hist = hist;
+        cnt->m_fraction = st.fraction;
+        info.counters.push_back(move(cnt));
+    }
+    return *hist;
+}
+
 //===========================================================================
 void Dim::perfGetValues (vector<PerfValue> * outptr, bool pretty) {
     auto & out = *outptr;
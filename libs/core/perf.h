@@ -1,4 +1,4 @@
-// Copyright Glen Knowles 2017 - 2024.
+// Copyright Glen Knowles 2017 - 2026.
 // Distributed under the Boost Software License, Version 1.0.
 //
 // perf.h - dim core
@@ -6,7 +6,12 @@
 
 #include "cppconf/cppconf.h"
 
+#include "core/time.h"
+
 #include <atomic>
+#include <bit>
+#include <concepts>
+#include <cstdint>
 #include <functional>
 #include <string>
 #include <string_view>
@@ -36,17 +41,171 @@ enum class PerfFormat {
 };
 
 
+// Number of copies kept of each counter and histogram, threads update the
+// copy assigned to them so that they don't fight over cache lines.
+constexpr unsigned kPerfShards = 16;
+
+namespace Detail {
+
+//===========================================================================
+inline unsigned perfShard() {
+    static std::atomic<unsigned> s_next;
+    thread_local unsigned t_shard =
+        s_next.fetch_add(1, std::memory_order_relaxed) % kPerfShards;
+    return t_shard;
+}
+
+} // namespace
+
+
+/****************************************************************************
+*
+*   PerfCounter
+*
+*   Integral counter split into per thread shards, that are summed when the
+*   value is read. Updates are relaxed and don't synchronize with anything.
+*
+*   The sum is only a snapshot, an update doesn't see the total it produced.
+*   There are no ++ and -- operators so "if (!--counter)" can't be mistaken
+*   for an atomic decrement and test, use a std::atomic for latches.
+*
+***/
+
+template <std::integral T>
+class PerfCounter {
+public:
+    // Replaces the total, concurrent updates from other threads may be lost.
+    PerfCounter & operator=(T val);
+    PerfCounter & operator+=(T val);
+    PerfCounter & operator-=(T val);
+
+    T load() const;
+    operator T() const { return load(); }
+
+private:
+    struct alignas(64) Shard {
+        std::atomic<T> val;
+    };
+    Shard m_shards[kPerfShards] = {};
+};
+
+//===========================================================================
+template <std::integral T>
+PerfCounter<T> & PerfCounter<T>::operator=(T val) {
+    m_shards[0].val.store(val, std::memory_order_relaxed);
+    for (unsigned i = 1; i < kPerfShards; ++i)
+        m_shards[i].val.store(0, std::memory_order_relaxed);
+    return *this;
+}
+
+//===========================================================================
+template <std::integral T>
+PerfCounter<T> & PerfCounter<T>::operator+=(T val) {
+    m_shards[Detail::perfShard()].val.fetch_add(
+        val,
+        std::memory_order_relaxed
+    );
+    return *this;
+}
+
+//===========================================================================
+template <std::integral T>
+PerfCounter<T> & PerfCounter<T>::operator-=(T val) {
+    m_shards[Detail::perfShard()].val.fetch_sub(
+        val,
+        std::memory_order_relaxed
+    );
+    return *this;
+}
+
+//===========================================================================
+template <std::integral T>
+T PerfCounter<T>::load() const {
+    // Shards of a gauge can individually wrap, sum them unsigned so the total
+    // comes out right.
+    std::make_unsigned_t<T> sum = 0;
+    for (auto && shard : m_shards)
+        sum += shard.val.load(std::memory_order_relaxed);
+    return (T) sum;
+}
+
+
+/****************************************************************************
+*
+*   PerfHistogram
+*
+*   Latency histogram with logarithmic buckets, each power of two is split
+*   into eight linear sub-buckets, so reported values are within 12.5% of
+*   the true value. Durations of up to about seven minutes are tracked at a
+*   resolution of one clock tick (100ns), longer ones are only counted, in a
+*   separate overflow bucket.
+*
+***/
+
+class PerfHistogram {
+public:
+    void add(Duration val);
+
+    uint64_t count() const;
+
+    // Number of recorded values that were too large to be tracked.
+    uint64_t overflow() const;
+
+    // Returns the smallest value that is greater than or equal to the
+    // fraction (e.g. 0.99 for p99) of recorded values, zero if nothing has
+    // been recorded, or Duration::max() if it's in the overflow bucket.
+    Duration percentile(double fraction) const;
+
+private:
+    static constexpr unsigned kSubBits = 3;
+    static constexpr unsigned kSubBuckets = 1 << kSubBits;
+    static constexpr unsigned kValueBits = 32;
+    static constexpr unsigned kOverflow =
+        (kValueBits - kSubBits + 1) * kSubBuckets;
+    static constexpr unsigned kNumBuckets = kOverflow + 1;
+
+    static unsigned bucket(uint64_t val);
+    static uint64_t bucketMax(unsigned pos);
+
+    struct alignas(64) Shard {
+        std::atomic<uint64_t> counts[kNumBuckets];
+    };
+    Shard m_shards[kPerfShards] = {};
+};
+
+//===========================================================================
+// static
+inline unsigned PerfHistogram::bucket(uint64_t val) {
+    if (val < kSubBuckets)
+        return (unsigned) val;
+    if (val >= uint64_t{1} << kValueBits)
+        return kOverflow;
+    auto shift = std::bit_width(val) - kSubBits - 1;
+    return (unsigned) ((shift + 1) * kSubBuckets
+        + ((val >> shift) & (kSubBuckets - 1)));
+}
+
+//===========================================================================
+inline void PerfHistogram::add(Duration val) {
+    auto pos = bucket(val.count() < 0 ? 0 : val.count());
+    m_shards[Detail::perfShard()].counts[pos].fetch_add(
+        1,
+        std::memory_order_relaxed
+    );
+}
+
+
 /****************************************************************************
 *
 *   Register performance counters
 *
 ***/
 
-std::atomic<int> & iperf(
+PerfCounter<int> & iperf(
     std::string_view name,
     PerfFormat fmt = PerfFormat::kDefault
 );
-std::atomic<unsigned> & uperf(
+PerfCounter<unsigned> & uperf(
     std::string_view name,
     PerfFormat fmt = PerfFormat::kDefault
 );
@@ -55,6 +214,13 @@ std::atomic<float> & fperf(
     PerfFormat fmt = PerfFormat::kDefault
 );
 
+// For totals, such as bytes sent, that could wrap an unsigned. Reported as
+// PerfType::kUnsigned.
+PerfCounter<uint64_t> & u64perf(
+    std::string_view name,
+    PerfFormat fmt = PerfFormat::kDefault
+);
+
 std::function<int()> & iperf(
     std::string_view name,
     std::function<int()> fn,
@@ -71,6 +237,10 @@ std::function<float()> & fperf(
     PerfFormat fmt = PerfFormat::kDefault
 );
 
+// Reported as the separate counters "<name> (count)", "<name> (p50)",
+// "<name> (p99)", and "<name> (p999)".
+PerfHistogram & hperf(std::string_view name);
+
 
 /****************************************************************************
 *
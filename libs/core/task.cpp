@@ -15,27 +15,84 @@ using namespace Dim;
 *
 ***/
 
+namespace {
+
+// Per thread deque of a work stealing queue. The owning thread pushes and
+// pops at the back (LIFO) for locality, idle threads steal from the front
+// (FIFO) to take the oldest, and usually largest, pieces of work.
+struct TaskWorker {
+    mutex mut;
+    deque<ITaskNotify *> tasks;
+};
+
+} // namespace
+
 class Dim::TaskQueue : public HandleContent {
 public:
     static void push(TaskQueue * q, ITaskNotify & task);
-    static void pop(TaskQueue * q);
+
+    // Removes and returns the first task, or if ends is false the first that
+    // isn't a request for a thread to end. Requires mut.
+    static ITaskNotify * pop(TaskQueue * q, bool ends = true);
+
+    // Records when a sample of tasks were queued, and how long they waited
+    // before being run.
+    static void stamp(ITaskNotify * tasks[], size_t numTasks);
+    static void run(ITaskNotify & task);
 
 public:
     TaskQueueHandle hq;
     string name;
 
     // current threads have been created, haven't exited, but may not have
-    // run yet.
+    // run yet. Protected by s_mut.
     int curThreads{0};
     int wantThreads{0};
 
+    // Each queue has its own lock, so pushes and pops to unrelated queues
+    // never contend with each other.
+    mutex mut;
+    condition_variable cv;
     ITaskNotify * first{};
     ITaskNotify * last{};
 
-    condition_variable cv;
+    // Threads parked waiting on cv, pushers only notify when there are some.
+    atomic<int> idleThreads{0};
+
+    // Number of queued tasks, including those in worker deques. Read without
+    // mut by threads spinning before they park.
+    atomic<size_t> numTasks{0};
+
+    // Number of the queued tasks that are requests for threads to end,
+    // protected by mut. Threads waiting on a task group don't run them, so
+    // they park once nothing but these is left.
+    size_t numEnds{0};
+
+    // If stealing, each thread has its own deque of tasks and the first/last
+    // list only holds tasks pushed while there were no threads and requests
+    // for threads to end.
+    bool stealing{false};
+    shared_mutex workerMut;
+    vector<TaskWorker *> workers;
+    atomic<unsigned> nextWorker{0};
 };
 
 
+/****************************************************************************
+*
+*   Tuning parameters
+*
+***/
+
+// Number of times an idle queue thread yields, while checking for new tasks,
+// before parking on the condition variable.
+constexpr unsigned kSpinCount = 64;
+
+// One in this many pushes, by each thread, has its tasks timed for the queue
+// wait histogram. The rest skip reading the clock when pushed and run.
+constexpr unsigned kWaitSampleInterval = 64;
+
+
 /****************************************************************************
 *
 *   Private declarations
@@ -59,6 +116,23 @@ public:
     explicit RunOnceTask(string_view name, function<void()> && fn);
 };
 
+struct ParallelFor {
+    ITaskRangeNotify * notify;
+    size_t first;
+    size_t last;
+    size_t grain;
+    size_t numRanges;
+    atomic<size_t> nextRange;
+    TaskGroup * group;
+};
+
+class ParallelForTask : public ITaskNotify {
+public:
+    ParallelFor * pf{};
+private:
+    void onTask() override;
+};
+
 } // namespace
 
 
@@ -68,18 +142,34 @@ public:
 *
 ***/
 
+// The queue map is only modified when queues are created and destroyed, so
+// the frequent lookups by taskPush() take a shared lock.
+static shared_mutex s_queueMut;
 static HandleMap<TaskQueueHandle, TaskQueue> s_queues;
-static int s_numThreads;
+
+// Protects thread counts, never held while a queue's own mutex is acquired
+// by a queue thread.
 static mutex s_mut;
+static int s_numThreads;
 static condition_variable s_destroyed;
 static int s_numDestroyed;
 static int s_numEnded;
 
 static TaskQueueHandle s_eventQ;
-thread_local bool t_inEventThread;
+static mutex s_loopMut;
+static TaskQueueHandle s_eventLoops[kTaskMaxEventLoops];
+static atomic_uint s_numEventLoops;
+thread_local int t_eventLoop{-1};
 static TaskQueueHandle s_computeQ;
 static atomic_bool s_running;
 
+// Queue that the current thread belongs to, if any, and the thread's deque
+// if that queue is work stealing.
+thread_local TaskQueue * t_queue;
+thread_local TaskWorker * t_worker;
+
+static auto & s_perfWait = hperf("task.queue wait");
+
 
 /****************************************************************************
 *
@@ -87,32 +177,175 @@ static atomic_bool s_running;
 *
 ***/
 
+//===========================================================================
+static void threadEnded(TaskQueue & q) {
+    unique_lock lk{s_mut};
+    q.curThreads -= 1;
+    s_numThreads -= 1;
+
+    if (!s_numThreads) {
+        s_numDestroyed += 1;
+        lk.unlock();
+        s_destroyed.notify_one();
+    }
+}
+
+//===========================================================================
+// Wakes parked threads after numTasks tasks were made available by a push
+// that didn't notify while holding the queue lock.
+static void wakeThreads(TaskQueue & q, size_t numTasks) {
+    // Threads that aren't parked are either running tasks or spinning and
+    // will find the new ones without being woken.
+    auto idle = q.idleThreads.load();
+    if (!idle)
+        return;
+
+    // Threads check numTasks and park while holding the lock, so passing
+    // through it guarantees they're waiting and will see the notify.
+    { scoped_lock lk{q.mut}; }
+    if (numTasks > 1 && idle > 1) {
+        q.cv.notify_all();
+    } else {
+        q.cv.notify_one();
+    }
+}
+
+//===========================================================================
+static ITaskNotify * popWorker(TaskQueue & q, TaskWorker & w, bool steal) {
+    scoped_lock lk{w.mut};
+    if (w.tasks.empty())
+        return nullptr;
+    ITaskNotify * task;
+    if (steal) {
+        task = w.tasks.front();
+        w.tasks.pop_front();
+    } else {
+        task = w.tasks.back();
+        w.tasks.pop_back();
+    }
+    q.numTasks -= 1;
+    return task;
+}
+
+//===========================================================================
+static ITaskNotify * findStealingTask(
+    TaskQueue & q,
+    TaskWorker & self,
+    bool ends = true
+) {
+    // Newest of our own tasks.
+    if (auto task = popWorker(q, self, false))
+        return task;
+
+    // Tasks pushed while there were no threads, or requests to end.
+    {
+        scoped_lock lk{q.mut};
+        if (auto task = q.pop(&q, ends))
+            return task;
+    }
+
+    // Oldest task of another thread, starting with a different victim each
+    // time so thieves spread out.
+    shared_lock lk{q.workerMut};
+    auto num = q.workers.size();
+    auto start = q.nextWorker++;
+    for (unsigned i = 0; i < num; ++i) {
+        auto w = q.workers[(start + i) % num];
+        if (w == &self)
+            continue;
+        if (auto task = popWorker(q, *w, true))
+            return task;
+    }
+    return nullptr;
+}
+
+//===========================================================================
+static void taskStealingThread(TaskQueue & q) {
+    TaskWorker self;
+    {
+        scoped_lock lk{q.workerMut};
+        q.workers.push_back(&self);
+    }
+    t_worker = &self;
+
+    for (;;) {
+        auto task = findStealingTask(q, self);
+        if (!task) {
+            for (unsigned i = 0; i < kSpinCount && !q.numTasks; ++i)
+                this_thread::yield();
+            if (q.numTasks)
+                continue;
+            unique_lock lk{q.mut};
+            q.idleThreads += 1;
+            while (!q.numTasks)
+                q.cv.wait(lk);
+            q.idleThreads -= 1;
+            continue;
+        }
+        bool more = !dynamic_cast<EndThreadTask *>(task);
+        q.run(*task);
+        if (!more)
+            break;
+    }
+
+    // Once removed from the list of workers nothing more can be pushed to
+    // our deque, hand what's left to the remaining threads.
+    t_queue = nullptr;
+    t_worker = nullptr;
+    {
+        scoped_lock lk{q.workerMut};
+        erase(q.workers, &self);
+    }
+    if (!self.tasks.empty()) {
+        auto num = self.tasks.size();
+        {
+            scoped_lock lk{q.mut};
+            for (auto && task : self.tasks) {
+                q.push(&q, *task);
+                q.numTasks -= 1;
+            }
+        }
+        wakeThreads(q, num);
+    }
+
+    threadEnded(q);
+}
+
 //===========================================================================
 static void taskQueueThread(TaskQueue * ptr) {
     iThreadInitialize();
     TaskQueue & q{*ptr};
     iThreadSetName(q.name);
+    t_queue = &q;
+    if (q.stealing)
+        return taskStealingThread(q);
+
     bool more{true};
-    unique_lock lk{s_mut};
+    unique_lock lk{q.mut};
     while (more) {
-        while (!q.first)
-            q.cv.wait(lk);
+        if (!q.first) {
+            // Bursts of tasks often arrive faster than a parked thread can be
+            // woken, so briefly spin before giving up the processor.
+            lk.unlock();
+            for (unsigned i = 0; i < kSpinCount && !q.numTasks; ++i)
+                this_thread::yield();
+            lk.lock();
+            while (!q.first) {
+                q.idleThreads += 1;
+                q.cv.wait(lk);
+                q.idleThreads -= 1;
+            }
+        }
 
-        auto task = q.first;
-        q.pop(&q);
+        auto task = q.pop(&q);
         more = !dynamic_cast<EndThreadTask *>(task);
         lk.unlock();
-        task->onTask();
+        q.run(*task);
         lk.lock();
     }
-    q.curThreads -= 1;
-    s_numThreads -= 1;
+    lk.unlock();
 
-    if (!s_numThreads) {
-        s_numDestroyed += 1;
-        lk.unlock();
-        s_destroyed.notify_one();
-    }
+    threadEnded(q);
 }
 
 //===========================================================================
@@ -132,15 +365,132 @@ static void setThreads_LK(
             thr.detach();
         }
     } else if (num < 0) {
+        scoped_lock qlk{q->mut};
         for (int i = 0; i > num; --i) {
             s_numEnded += 1;
             auto task = new EndThreadTask;
             q->push(q, *task);
+            q->numEnds += 1;
         }
         q->cv.notify_all();
     }
 }
 
+//===========================================================================
+static TaskQueue * findQueue(TaskQueueHandle hq) {
+    shared_lock lk{s_queueMut};
+    auto q = s_queues.find(hq);
+    assert(q);
+    return q;
+}
+
+//===========================================================================
+static TaskQueueHandle createQueue(
+    string_view name,
+    int threads,
+    bool stealing
+) {
+    assert(s_running);
+    assert(threads);
+    auto q = new TaskQueue;
+    q->name = name;
+    q->stealing = stealing;
+    {
+        scoped_lock qlk{s_queueMut};
+        q->hq = s_queues.insert(q);
+    }
+
+    unique_lock lk{s_mut};
+    setThreads_LK(lk, q, threads);
+    return q->hq;
+}
+
+//===========================================================================
+// Tasks pushed by a thread of the queue go to the back of its own deque,
+// others are spread evenly across the deques of all of the queue's threads.
+//
+// They're added to numTasks before going into the deques, where a thief may
+// take and uncount them right away, so the count never drops below zero.
+static void pushStealing(
+    TaskQueue * q,
+    ITaskNotify * tasks[],
+    size_t numTasks
+) {
+    if (t_queue == q) {
+        q->numTasks += numTasks;
+        scoped_lock lk{t_worker->mut};
+        t_worker->tasks.insert(t_worker->tasks.end(), tasks, tasks + numTasks);
+    } else {
+        shared_lock lk{q->workerMut};
+        auto num = q->workers.size();
+        if (!num) {
+            // No threads, they'll take them from the shared list when they
+            // start.
+            lk.unlock();
+            scoped_lock qlk{q->mut};
+            for (size_t i = 0; i < numTasks; ++i)
+                q->push(q, *tasks[i]);
+            return;
+        }
+        q->numTasks += numTasks;
+        auto per = (numTasks + num - 1) / num;
+        auto pos = q->nextWorker.fetch_add((unsigned) min(num, numTasks));
+        for (size_t i = 0; i < numTasks; i += per, ++pos) {
+            auto w = q->workers[pos % num];
+            auto cnt = min(per, numTasks - i);
+            scoped_lock wlk{w->mut};
+            w->tasks.insert(w->tasks.end(), tasks + i, tasks + i + cnt);
+        }
+    }
+    wakeThreads(*q, numTasks);
+}
+
+
+//===========================================================================
+// Runs one task from the queue on behalf of a waiting thread that belongs to
+// it. Returns false if the thread doesn't belong to the queue or there was
+// nothing it could run.
+static bool runQueuedTask(TaskQueue * q) {
+    if (t_queue != q)
+        return false;
+
+    // Requests for threads to end are passed over, they're left for the
+    // thread's own loop once the wait is over. Tasks behind them are still
+    // taken, the group's may be among them.
+    ITaskNotify * task = nullptr;
+    if (q->stealing) {
+        task = findStealingTask(*q, *t_worker, false);
+    } else {
+        scoped_lock lk{q->mut};
+        task = q->pop(q, false);
+    }
+    if (!task)
+        return false;
+    q->run(*task);
+    return true;
+}
+
+//===========================================================================
+static void runRanges(ParallelFor & pf) {
+    for (;;) {
+        auto i = pf.nextRange++;
+        if (i >= pf.numRanges)
+            return;
+        auto first = pf.first + i * pf.grain;
+        auto last = min(pf.last, first + pf.grain);
+        pf.notify->onTaskRange(first, last);
+    }
+}
+
+//===========================================================================
+// Runs the parts of large IntegralSet operations on the compute queue.
+static void intSetParallelFor(
+    size_t count,
+    const function<void(size_t)> & fn
+) {
+    taskParallelFor(0, count, 1, fn);
+}
+
 
 /****************************************************************************
 *
@@ -158,14 +508,59 @@ void TaskQueue::push(TaskQueue * q, ITaskNotify & task) {
         q->last->m_taskNext = &task;
     }
     q->last = &task;
+    q->numTasks += 1;
 }
 
 //===========================================================================
 // static
-void TaskQueue::pop(TaskQueue * q) {
+ITaskNotify * TaskQueue::pop(TaskQueue * q, bool ends) {
+    ITaskNotify * prev = nullptr;
     auto task = q->first;
-    q->first = task->m_taskNext;
+    for (; task; prev = task, task = task->m_taskNext) {
+        if (!dynamic_cast<EndThreadTask *>(task))
+            break;
+        if (ends) {
+            q->numEnds -= 1;
+            break;
+        }
+    }
+    if (!task)
+        return nullptr;
+
+    if (!prev) {
+        q->first = task->m_taskNext;
+    } else {
+        prev->m_taskNext = task->m_taskNext;
+        if (q->last == task)
+            q->last = prev;
+    }
     task->m_taskNext = nullptr;
+    q->numTasks -= 1;
+    return task;
+}
+
+//===========================================================================
+// static
+void TaskQueue::stamp(ITaskNotify * tasks[], size_t numTasks) {
+    thread_local unsigned t_pushes;
+    if (++t_pushes % kWaitSampleInterval)
+        return;
+    auto now = timeNow();
+    for (size_t i = 0; i < numTasks; ++i)
+        tasks[i]->m_taskPushed = now;
+}
+
+//===========================================================================
+// static
+void TaskQueue::run(ITaskNotify & task) {
+    // Only sampled tasks are stamped, and not those queued internally, such
+    // as requests for threads to end. Clear the stamp so it isn't counted
+    // again if the task is pushed again.
+    if (!empty(task.m_taskPushed)) {
+        s_perfWait.add(timeNow() - task.m_taskPushed);
+        task.m_taskPushed = {};
+    }
+    task.onTask();
 }
 
 
@@ -203,6 +598,102 @@ RunOnceTask::RunOnceTask(string_view name, function<void()> && fn)
 }
 
 
+/****************************************************************************
+*
+*   ParallelForTask
+*
+***/
+
+//===========================================================================
+void ParallelForTask::onTask() {
+    runRanges(*pf);
+    pf->group->done();
+}
+
+
+/****************************************************************************
+*
+*   TaskGroup
+*
+***/
+
+//===========================================================================
+TaskGroup::TaskGroup(TaskQueueHandle q)
+    : m_q{q ? q : s_computeQ}
+{}
+
+//===========================================================================
+TaskGroup::~TaskGroup() {
+    assert(!m_pending);
+}
+
+//===========================================================================
+void TaskGroup::push(ITaskNotify * task) {
+    ITaskNotify * list[] = {task};
+    push(list, size(list));
+}
+
+//===========================================================================
+void TaskGroup::push(ITaskNotify * tasks[], size_t numTasks) {
+    {
+        scoped_lock lk{m_mut};
+        m_pending += numTasks;
+    }
+    taskPush(m_q, tasks, numTasks);
+}
+
+//===========================================================================
+void TaskGroup::done() {
+    // Notify while still holding the lock, once it's released the waiter may
+    // return and destroy the group.
+    scoped_lock lk{m_mut};
+    assert(m_pending);
+    if (--m_pending)
+        return;
+    m_cv.notify_all();
+    if (m_helpers) {
+        // Waiters that belong to the queue are parked on the queue's
+        // condition variable instead.
+        auto q = findQueue(m_q);
+        scoped_lock qlk{q->mut};
+        q->cv.notify_all();
+    }
+}
+
+//===========================================================================
+void TaskGroup::wait() {
+    auto q = findQueue(m_q);
+    unique_lock lk{m_mut};
+    while (m_pending) {
+        lk.unlock();
+        bool ran = runQueuedTask(q);
+        lk.lock();
+        if (ran)
+            continue;
+        if (t_queue != q) {
+            m_cv.wait(lk);
+            continue;
+        }
+
+        // The remaining tasks are being run by other threads, but they may
+        // push more that we can help with. Park with the idle threads of the
+        // queue so that either a push or the last done() wakes us. Requests
+        // for threads to end don't count, they're not ours to run.
+        lk.unlock();
+        m_helpers += 1;
+        {
+            unique_lock qlk{q->mut};
+            q->idleThreads += 1;
+            while (q->numTasks == q->numEnds && m_pending)
+                q->cv.wait(qlk);
+            q->idleThreads -= 1;
+        }
+        m_helpers -= 1;
+        lk.lock();
+    }
+}
+
+
 /****************************************************************************
 *
 *   Internal API
@@ -213,24 +704,34 @@ RunOnceTask::RunOnceTask(string_view name, function<void()> && fn)
 void Dim::iTaskInitialize() {
     s_running = true;
     s_eventQ = taskCreateQueue("Event", 1);
-    taskPush(s_eventQ, [](){ t_inEventThread = true; });
-    s_computeQ = taskCreateQueue("Compute", 5);
+    taskPush(s_eventQ, [](){ t_eventLoop = 0; });
+    s_eventLoops[0] = s_eventQ;
+    s_numEventLoops = 1;
+    s_computeQ = createQueue("Compute", 5, true);
+    intSetSetParallel(intSetParallelFor);
 }
 
 //===========================================================================
 void Dim::iTaskDestroy() {
+    intSetSetParallel(nullptr);
     s_running = false;
+    s_numEventLoops = 0;
+    ranges::fill(s_eventLoops, TaskQueueHandle{});
     unique_lock lk{s_mut};
 
     // send shutdown task to all task threads
-    for (auto && q : s_queues)
-        setThreads_LK(lk, q.second, 0);
+    {
+        shared_lock qlk{s_queueMut};
+        for (auto && q : s_queues)
+            setThreads_LK(lk, q.second, 0);
+    }
 
     // wait for all threads to stop
     while (s_numThreads)
         s_destroyed.wait(lk);
 
     // delete task queues
+    scoped_lock qlk{s_queueMut};
     for (auto && q : s_queues)
         s_queues.erase(q.first);
 }
@@ -264,7 +765,54 @@ TaskQueueHandle Dim::taskEventQueue() {
 
 //===========================================================================
 bool Dim::taskInEventThread() {
-    return t_inEventThread;
+    return t_eventLoop == 0;
+}
+
+//===========================================================================
+void Dim::taskSetEventLoops(unsigned count) {
+    count = clamp(count, 1u, kTaskMaxEventLoops);
+    scoped_lock lk{s_loopMut};
+    for (auto i = s_numEventLoops.load(); i < count; ++i) {
+        if (s_eventLoops[i])
+            continue;
+        auto name = "Event "s.append(toChars(i).view());
+        auto q = taskCreateQueue(name, 1);
+        taskPush(q, [i](){ t_eventLoop = (int) i; });
+        s_eventLoops[i] = q;
+    }
+    s_numEventLoops = count;
+}
+
+//===========================================================================
+unsigned Dim::taskEventLoops() {
+    return s_numEventLoops;
+}
+
+//===========================================================================
+TaskQueueHandle Dim::taskEventLoopQueue(unsigned loop) {
+    assert(loop < kTaskMaxEventLoops && s_eventLoops[loop]);
+    return s_eventLoops[loop];
+}
+
+//===========================================================================
+void Dim::taskPushEventLoops(const function<void()> & fn) {
+    // Loops above the current count still have the sockets they were given
+    // before it was lowered.
+    scoped_lock lk{s_loopMut};
+    for (auto && q : s_eventLoops) {
+        if (q)
+            taskPush(q, function<void()>(fn));
+    }
+}
+
+//===========================================================================
+int Dim::taskEventLoop() {
+    return t_eventLoop;
+}
+
+//===========================================================================
+bool Dim::taskInEventLoop() {
+    return t_eventLoop >= 0;
 }
 
 //===========================================================================
@@ -289,23 +837,15 @@ TaskQueueHandle Dim::taskComputeQueue() {
 
 //===========================================================================
 TaskQueueHandle Dim::taskCreateQueue(string_view name, int threads) {
-    assert(s_running);
-    assert(threads);
-    auto q = new TaskQueue;
-    q->name = name;
-
-    unique_lock lk{s_mut};
-    q->hq = s_queues.insert(q);
-    setThreads_LK(lk, q, threads);
-    return q->hq;
+    return createQueue(name, threads, false);
 }
 
 //===========================================================================
 void Dim::taskSetQueueThreads(TaskQueueHandle hq, int threads) {
     assert(s_running);
+    auto q = findQueue(hq);
 
     unique_lock lk{s_mut};
-    auto q = s_queues.find(hq);
     setThreads_LK(lk, q, threads);
 }
 
@@ -331,18 +871,75 @@ void Dim::taskPush(
     if (!numTasks)
         return;
 
-    scoped_lock lk{s_mut};
-    auto q = s_queues.find(hq);
+    auto q = findQueue(hq);
+    q->stamp(tasks, numTasks);
+    if (q->stealing)
+        return pushStealing(q, tasks, numTasks);
+
+    unique_lock lk{q->mut};
     for (auto i = 0; (size_t) i < numTasks; ++tasks, ++i)
         q->push(q, **tasks);
+    auto idle = q->idleThreads.load();
+    lk.unlock();
 
-    if (numTasks > 1 && q->curThreads > 1) {
+    // Threads that aren't parked are either running tasks or spinning and
+    // will find the new ones without being woken.
+    if (!idle)
+        return;
+    if (numTasks > 1 && idle > 1) {
         q->cv.notify_all();
     } else {
         q->cv.notify_one();
     }
 }
 
+//===========================================================================
+void Dim::taskParallelFor(
+    size_t first,
+    size_t last,
+    size_t grain,
+    ITaskRangeNotify * notify,
+    TaskQueueHandle hq
+) {
+    if (first >= last)
+        return;
+    if (!grain)
+        grain = 1;
+    TaskGroup group(hq);
+    ParallelFor pf = {
+        .notify = notify,
+        .first = first,
+        .last = last,
+        .grain = grain,
+        .numRanges = (last - first - 1) / grain + 1,
+        .nextRange = 0,
+        .group = &group,
+    };
+
+    // One helper per queue thread, but no more than there are ranges beyond
+    // the first, which the calling thread takes.
+    auto q = findQueue(group.queue());
+    size_t threads;
+    {
+        scoped_lock lk{s_mut};
+        threads = q->wantThreads;
+    }
+    auto helpers = min(threads, pf.numRanges - 1);
+    if (helpers) {
+        vector<ParallelForTask> tasks(helpers);
+        vector<ITaskNotify *> ptrs(helpers);
+        for (size_t i = 0; i < helpers; ++i) {
+            tasks[i].pf = &pf;
+            ptrs[i] = &tasks[i];
+        }
+        group.push(ptrs.data(), ptrs.size());
+        runRanges(pf);
+        group.wait();
+    } else {
+        runRanges(pf);
+    }
+}
+
 //===========================================================================
 void Dim::taskPushOnce(string_view name, function<void()> && fn) {
     new RunOnceTask(name, move(fn));
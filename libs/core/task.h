@@ -1,4 +1,4 @@
-// Copyright Glen Knowles 2015 - 2025.
+// Copyright Glen Knowles 2015 - 2026.
 // Distributed under the Boost Software License, Version 1.0.
 //
 // task.h - dim core
@@ -7,10 +7,17 @@
 #include "cppconf/cppconf.h"
 
 #include "basic/handle.h"
+#include "core/time.h"
 
+#include <atomic>
+#include <concepts>
+#include <condition_variable>
 #include <functional>
+#include <mutex>
+#include <optional>
 #include <string>
 #include <utility> // std::move
+#include <vector>
 
 namespace Dim {
 
@@ -33,6 +40,7 @@ public:
 private:
     friend class TaskQueue;
     ITaskNotify * m_taskNext{};
+    TimePoint m_taskPushed; // if sampled for the queue wait time histogram
 };
 
 class TaskProxy : public ITaskNotify {
@@ -58,6 +66,26 @@ void taskPushEvent(ITaskNotify * tasks[], size_t numTasks);
 TaskQueueHandle taskEventQueue();
 bool taskInEventThread();
 
+// The event thread is event loop 0, more loops may be added so that sockets
+// can be spread across cores. Each loop is a queue with a single thread, so
+// whatever belongs to a loop, such as an accepted socket and the state built
+// on it, is only ever touched by that thread and needs no locking.
+constexpr unsigned kTaskMaxEventLoops = 64;
+
+// Lowering the count only stops new sockets from being given to the loops
+// above it, those already there stay until they're closed.
+void taskSetEventLoops(unsigned count);
+unsigned taskEventLoops();
+TaskQueueHandle taskEventLoopQueue(unsigned loop);
+
+// Pushes a copy of the function to each of the event loops, including any
+// above taskEventLoops() that were left running when the count was lowered.
+void taskPushEventLoops(const std::function<void()> & fn);
+
+// Event loop of the current thread, or -1 if it isn't running one.
+int taskEventLoop();
+bool taskInEventLoop();
+
 void taskPushCompute(std::function<void()> && fn);
 void taskPushCompute(ITaskNotify * task);
 void taskPushCompute(ITaskNotify * tasks[], size_t numTasks);
@@ -77,4 +105,144 @@ void taskPush(TaskQueueHandle q, ITaskNotify * tasks[], size_t numTasks);
 // this shouldn't be used for anything that runs repeatedly.
 void taskPushOnce(std::string_view name, std::function<void()> && fn);
 
+
+/****************************************************************************
+*
+*   Task group
+*
+*   Counts tasks pushed to a queue that haven't yet finished and allows
+*   waiting for them. Each task pushed through the group must call done()
+*   exactly once when it finishes.
+*
+*   A thread belonging to the queue that waits on a group helps by running
+*   queued tasks, and only blocks while the queue has none, so groups may be
+*   nested without exhausting the queue's threads.
+*
+***/
+
+class TaskGroup {
+public:
+    // Defaults to the compute queue.
+    explicit TaskGroup(TaskQueueHandle q = {});
+    ~TaskGroup();
+
+    TaskQueueHandle queue() const { return m_q; }
+
+    void push(ITaskNotify * task);
+    void push(ITaskNotify * tasks[], size_t numTasks);
+    void done();
+
+    // Returns once all pushed tasks have called done().
+    void wait();
+
+private:
+    TaskQueueHandle m_q;
+    std::mutex m_mut;
+    std::condition_variable m_cv;
+    std::atomic<size_t> m_pending{0};
+
+    // Threads of the queue that are waiting on the group while parked with
+    // the queue's idle threads.
+    std::atomic<int> m_helpers{0};
+};
+
+
+/****************************************************************************
+*
+*   Parallel algorithms
+*
+*   The range [first, last) is split into subranges of at most grain values
+*   that are claimed in order, by the calling thread and by helper tasks
+*   pushed as a single batch to the queue (the compute queue by default).
+*   Returns once every subrange has been processed, fn must not throw.
+*
+***/
+
+class ITaskRangeNotify {
+public:
+    virtual ~ITaskRangeNotify() = default;
+    virtual void onTaskRange(size_t first, size_t last) = 0;
+};
+
+void taskParallelFor(
+    size_t first,
+    size_t last,
+    size_t grain,
+    ITaskRangeNotify * notify,
+    TaskQueueHandle q = {}
+);
+
+//===========================================================================
+// Calls fn(first, last) for each subrange if it accepts two arguments,
+// otherwise fn(i) for each value.
+template <typename Fn>
+requires std::invocable<Fn &, size_t, size_t>
+    || std::invocable<Fn &, size_t>
+void taskParallelFor(
+    size_t first,
+    size_t last,
+    size_t grain,
+    Fn && fn,
+    TaskQueueHandle q = {}
+) {
+    class Adapter : public ITaskRangeNotify {
+    public:
+        explicit Adapter(Fn & fn) : m_fn{fn} {}
+        void onTaskRange(size_t first, size_t last) override {
+            if constexpr (std::invocable<Fn &, size_t, size_t>) {
+                m_fn(first, last);
+            } else {
+                for (; first < last; ++first)
+                    m_fn(first);
+            }
+        }
+    private:
+        Fn & m_fn;
+    };
+    Adapter notify{fn};
+    taskParallelFor(first, last, grain, &notify, q);
+}
+
+//===========================================================================
+// Combines, with op, the results of fn(first, last) for each subrange if fn
+// accepts two arguments, otherwise of fn(i) for each value. Partial results
+// are combined in range order, so op need not be commutative.
+template <typename T, typename Fn, typename Op = std::plus<>>
+requires std::invocable<Fn &, size_t, size_t>
+    || std::invocable<Fn &, size_t>
+T taskParallelReduce(
+    size_t first,
+    size_t last,
+    size_t grain,
+    T init,
+    Fn && fn,
+    Op && op = {},
+    TaskQueueHandle q = {}
+) {
+    if (first >= last)
+        return init;
+    if (!grain)
+        grain = 1;
+    std::vector<std::optional<T>> partials((last - first - 1) / grain + 1);
+    taskParallelFor(
+        first,
+        last,
+        grain,
+        [&](size_t a, size_t b) {
+            auto & out = partials[(a - first) / grain];
+            if constexpr (std::invocable<Fn &, size_t, size_t>) {
+                out.emplace(fn(a, b));
+            } else {
+                out.emplace(fn(a));
+                while (++a < b)
+                    *out = op(std::move(*out), fn(a));
+            }
+        },
+        q
+    );
+    for (auto && val : partials)
+        init = op(std::move(init), std::move(*val));
+    return init;
+}
+
 } // namespace
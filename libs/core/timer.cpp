@@ -1,4 +1,4 @@
-// Copyright Glen Knowles 2015 - 2024.
+// Copyright Glen Knowles 2015 - 2026.
 // Distributed under the Boost Software License, Version 1.0.
 //
 // timer.cpp - dim app
@@ -15,7 +15,11 @@ using namespace Dim;
 *
 ***/
 
-class Dim::Timer {
+class Dim::Timer
+    : public ListLink<>
+    , public enable_shared_from_this<Timer>
+    , public ITaskNotify
+{
 public:
     static TimePoint update(
         ITimerNotify * notify,
@@ -26,14 +30,24 @@ public:
 
     explicit Timer(ITimerNotify * notify);
 
-    // is the notify still pointing back at this timer?
+    // has the timer been closed?
     bool connected() const;
 
     ITimerNotify * notify{};
     TimePoint expiration{TimePoint::max()};
-    unsigned instance{0};
+    unsigned slot; // position in timer wheel, or kNoSlot
+
+    // Timers of event loops other than the event thread have their
+    // callbacks pushed to the loop, and are held by self until it runs.
+    unsigned loop;
+    bool queued{false};
+    shared_ptr<Timer> self;
+    thread::id runThread; // thread running the callback on the loop, if any
 
     bool bugged{false};
+
+private:
+    void onTask() override;
 };
 
 
@@ -45,15 +59,52 @@ public:
 
 namespace {
 
-struct TimerQueueNode {
-    shared_ptr<Timer> timer;
-    TimePoint expiration;
-    unsigned instance;
+// Each slot of the lowest level of the wheel covers one tick, each slot of
+// the next level covers all the slots of the level below it, and so on.
+// Timers beyond the range of the top level wait there and are placed again
+// each time they come around.
+constexpr Duration kTickDuration = 1ms;
+constexpr unsigned kSlotBits = 6;
+constexpr unsigned kNumSlots = 1 << kSlotBits;
+constexpr unsigned kNumLevels = 6;
+static_assert(kNumSlots == 64, "slot bitmaps are uint64_t");
+
+constexpr unsigned kNoSlot = kNumLevels * kNumSlots;
+constexpr unsigned kExpiredSlot = kNoSlot + 1;
+
+// Hierarchical timing wheel, timers are inserted, removed, and rescheduled
+// in constant time. Expiration is rounded up to the next tick, so timers
+// fire up to one tick late but never early.
+class TimerWheel {
+public:
+    ~TimerWheel() { clear(); }
+
+    bool empty() const { return !m_count; }
+
+    void insert(Timer * timer, TimePoint now);
+    void remove(Timer * timer);
+    void clear();
+
+    // Returns the next timer expired as of now, or null if there are none.
+    Timer * popExpired(TimePoint now);
 
-    explicit TimerQueueNode(shared_ptr<Timer> & timer);
-    bool operator<(const TimerQueueNode & right) const;
-    bool operator>(const TimerQueueNode & right) const;
-    bool operator==(const TimerQueueNode & right) const;
+    // Returns time of the next expiration, or the earlier time at which
+    // timers from an upper level must be moved down.
+    TimePoint nextExpiration() const;
+
+private:
+    void link(Timer * timer);
+    void advance(uint64_t tick);
+
+    // Returns the first tick with timers to expire or move down, or max if
+    // there aren't any.
+    uint64_t nextTick() const;
+
+    List<Timer> m_slots[kNumLevels * kNumSlots];
+    uint64_t m_used[kNumLevels] = {}; // bitmap of non-empty slots by level
+    List<Timer> m_expired;
+    uint64_t m_tick{}; // last tick that has been processed
+    size_t m_count{};
 };
 
 } // namespace
@@ -69,18 +120,204 @@ static mutex s_mut;
 static condition_variable s_modeCv; // when run mode changes to stopped
 static RunMode s_mode{kRunStopped};
 static condition_variable s_queueCv; // when wait for next timer is reduced
-static priority_queue<
-    TimerQueueNode,
-    vector<TimerQueueNode>,
-    greater<TimerQueueNode>
-> s_timers;
+static TimerWheel s_timers;
 static bool s_processing; // dispatch task has been queued and isn't done
 
+// Time the dispatch thread is waiting for, updates to timers expiring
+// earlier must wake it.
+static TimePoint s_wakeTime{TimePoint::max()};
+
 static thread::id s_processingThread; // thread running any current callback
 static condition_variable s_processingCv; // when running callback completes
 static ITimerNotify * s_processingNotify; // callback currently in progress
 
 
+/****************************************************************************
+*
+*   Helpers
+*
+***/
+
+//===========================================================================
+static uint64_t floorTick(TimePoint time) {
+    return time.time_since_epoch() / kTickDuration;
+}
+
+//===========================================================================
+static uint64_t ceilTick(TimePoint time) {
+    return (time.time_since_epoch() + kTickDuration - Duration{1})
+        / kTickDuration;
+}
+
+//===========================================================================
+static TimePoint tickTime(uint64_t tick) {
+    return TimePoint{tick * kTickDuration};
+}
+
+
+/****************************************************************************
+*
+*   TimerWheel
+*
+***/
+
+//===========================================================================
+void TimerWheel::insert(Timer * timer, TimePoint now) {
+    assert(timer->slot == kNoSlot);
+    if (!m_count) {
+        // Nothing to process, skip ahead.
+        m_tick = max(m_tick, floorTick(now));
+    }
+    m_count += 1;
+    if (timer->expiration <= now) {
+        timer->slot = kExpiredSlot;
+        m_expired.link(timer);
+    } else {
+        link(timer);
+    }
+}
+
+//===========================================================================
+void TimerWheel::link(Timer * timer) {
+    auto tick = ceilTick(timer->expiration);
+    if (tick <= m_tick) {
+        timer->slot = kExpiredSlot;
+        m_expired.link(timer);
+        return;
+    }
+    auto delta = tick - m_tick;
+    auto level = (unsigned) (bit_width(delta) - 1) / kSlotBits;
+    if (level >= kNumLevels) {
+        level = kNumLevels - 1;
+        tick = m_tick + (uint64_t{1} << kNumLevels * kSlotBits) - 1;
+    }
+    auto pos = (tick >> level * kSlotBits) & (kNumSlots - 1);
+    timer->slot = unsigned(level * kNumSlots + pos);
+    m_slots[timer->slot].link(timer);
+    m_used[level] |= uint64_t{1} << pos;
+}
+
+//===========================================================================
+void TimerWheel::remove(Timer * timer) {
+    auto slot = timer->slot;
+    assert(slot != kNoSlot);
+    if (slot == kExpiredSlot) {
+        m_expired.unlink(timer);
+    } else {
+        auto & list = m_slots[slot];
+        list.unlink(timer);
+        if (list.empty())
+            m_used[slot / kNumSlots] &= ~(uint64_t{1} << slot % kNumSlots);
+    }
+    timer->slot = kNoSlot;
+    m_count -= 1;
+}
+
+//===========================================================================
+void TimerWheel::clear() {
+    auto unlinkAll = [](List<Timer> & list) {
+        while (auto timer = list.unlinkFront())
+            timer->slot = kNoSlot;
+    };
+    for (auto && list : m_slots)
+        unlinkAll(list);
+    unlinkAll(m_expired);
+    ranges::fill(m_used, 0);
+    m_count = 0;
+}
+
+//===========================================================================
+void TimerWheel::advance(uint64_t tick) {
+    while (m_tick < tick) {
+        if (!m_used[0]) {
+            // Nothing in the lowest level, skip ahead to when timers next
+            // have to be moved down from above.
+            auto next = nextTick();
+            if (next > tick) {
+                m_tick = tick;
+                return;
+            }
+            m_tick = next - 1;
+        }
+        m_tick += 1;
+
+        // Move timers down from each upper level whose current slot has
+        // just come around.
+        for (unsigned level = 1; level < kNumLevels; ++level) {
+            auto shift = level * kSlotBits;
+            if (m_tick & ((uint64_t{1} << shift) - 1))
+                break;
+            auto pos = (m_tick >> shift) & (kNumSlots - 1);
+            auto bit = uint64_t{1} << pos;
+            if (m_used[level] & bit) {
+                // Timers always land in a lower level, or for those beyond
+                // the range of the top level, a different slot.
+                m_used[level] &= ~bit;
+                auto & list = m_slots[level * kNumSlots + pos];
+                while (auto timer = list.unlinkFront())
+                    link(timer);
+            }
+        }
+
+        // Everything in the lowest level slot for this tick has expired.
+        auto pos = m_tick & (kNumSlots - 1);
+        auto bit = uint64_t{1} << pos;
+        if (m_used[0] & bit) {
+            m_used[0] &= ~bit;
+            auto & list = m_slots[pos];
+            while (auto timer = list.unlinkFront()) {
+                timer->slot = kExpiredSlot;
+                m_expired.link(timer);
+            }
+        }
+    }
+}
+
+//===========================================================================
+Timer * TimerWheel::popExpired(TimePoint now) {
+    if (m_expired.empty())
+        advance(floorTick(now));
+    auto timer = m_expired.unlinkFront();
+    if (timer) {
+        timer->slot = kNoSlot;
+        m_count -= 1;
+    }
+    return timer;
+}
+
+//===========================================================================
+TimePoint TimerWheel::nextExpiration() const {
+    if (!m_expired.empty())
+        return TimePoint::min();
+    auto next = nextTick();
+    return next == numeric_limits<uint64_t>::max()
+        ? TimePoint::max()
+        : tickTime(next);
+}
+
+//===========================================================================
+uint64_t TimerWheel::nextTick() const {
+    auto next = numeric_limits<uint64_t>::max();
+    for (unsigned level = 0; level < kNumLevels; ++level) {
+        auto used = m_used[level];
+        if (!used)
+            continue;
+        // First used slot after the current one, wrapping around to the
+        // current one last.
+        auto shift = level * kSlotBits;
+        auto cur = (m_tick >> shift) & (kNumSlots - 1);
+        auto from = (cur + 1) % kNumSlots;
+        auto pos = (from + countr_zero(rotr(used, (int) from))) % kNumSlots;
+        auto span = uint64_t{1} << (shift + kSlotBits);
+        auto tick = (m_tick & ~(span - 1)) + (pos << shift);
+        if (tick <= m_tick)
+            tick += span;
+        next = min(next, tick);
+    }
+    return next;
+}
+
+
 /****************************************************************************
 *
 *   Queue and run timers
@@ -106,22 +343,36 @@ void RunTimers::onTask() {
     s_processingThread = this_thread::get_id();
     for (;;) {
         // find next expired timer with notifier to call
-        wait = s_timers.empty()
-            ? kTimerInfinite
-            : s_timers.top().expiration - now;
-        if (wait > 0ms)
+        auto timer = s_timers.popExpired(now);
+        if (!timer) {
+            wait = s_timers.empty()
+                ? kTimerInfinite
+                : s_timers.nextExpiration() - now;
             break;
-        TimerQueueNode node = s_timers.top();
-        s_timers.pop();
-        if (node.instance != node.timer->instance)
+        }
+
+        if (timer->loop) {
+            // Belongs to another event loop, so run it there. If its last
+            // callback is still waiting to run that one serves for both.
+            timer->expiration = TimePoint::max();
+            if (timer->queued)
+                continue;
+            timer->queued = true;
+            timer->self = timer->shared_from_this();
+            lk.unlock();
+            taskPush(taskEventLoopQueue(timer->loop), timer);
+            lk.lock();
             continue;
+        }
 
-        // call notifier
-        Timer * timer = node.timer.get();
+        // call notifier, holding a reference so the timer survives being
+        // closed by the callback
+        auto notify = timer->notify;
+        auto hold = timer->shared_from_this();
         timer->expiration = TimePoint::max();
-        s_processingNotify = timer->notify;
+        s_processingNotify = notify;
         lk.unlock();
-        wait = timer->notify->onTimer(now);
+        wait = notify->onTimer(now);
 
         // update timer
         lk.lock();
@@ -135,13 +386,15 @@ void RunTimers::onTask() {
             continue;
         TimePoint expire = now + wait;
         if (expire < timer->expiration) {
+            if (timer->slot != kNoSlot)
+                s_timers.remove(timer);
             timer->expiration = expire;
-            timer->instance += 1;
-            s_timers.push(TimerQueueNode{node.timer});
+            s_timers.insert(timer, now);
         }
     }
     s_processingThread = {};
     s_processing = false;
+    s_wakeTime = TimePoint::max();
     lk.unlock();
 
     if (wait != kTimerInfinite)
@@ -153,19 +406,25 @@ static void timerDispatchThread() {
     unique_lock lk{s_mut};
     for (;;) {
         if (s_mode == kRunStopping) {
-            while (!s_timers.empty())
-                s_timers.pop();
+            s_timers.clear();
             s_mode = kRunStopped;
             s_modeCv.notify_one();
             return;
         }
-        if (s_processing || s_timers.empty()) {
+        if (s_processing) {
             s_queueCv.wait(lk);
             continue;
         }
-        Duration wait = s_timers.top().expiration - timeNow();
+        if (s_timers.empty()) {
+            s_wakeTime = TimePoint::max();
+            s_queueCv.wait(lk);
+            continue;
+        }
+        s_wakeTime = s_timers.nextExpiration();
+        Duration wait = s_wakeTime - timeNow();
         if (wait <= 0ms) {
             s_processing = true;
+            s_wakeTime = TimePoint::min();
             lk.unlock();
             taskPushEvent(&s_runTimers);
             lk.lock();
@@ -184,39 +443,14 @@ static void timerDispatchThread() {
 ***/
 
 //===========================================================================
-ITimerNotify::~ITimerNotify() {
-    if (m_timer)
-        timerCloseWait(this);
-}
-
-
-/****************************************************************************
-*
-*   TimerQueueNode
-*
-***/
-
-//===========================================================================
-TimerQueueNode::TimerQueueNode(shared_ptr<Timer> & timer)
-    : timer{timer}
-    , expiration{timer->expiration}
-    , instance{timer->instance}
+ITimerNotify::ITimerNotify()
+    : m_loop(max(taskEventLoop(), 0))
 {}
 
 //===========================================================================
-bool TimerQueueNode::operator<(const TimerQueueNode & right) const {
-    return expiration < right.expiration;
-}
-
-//===========================================================================
-bool TimerQueueNode::operator>(const TimerQueueNode & right) const {
-    return expiration > right.expiration;
-}
-
-//===========================================================================
-bool TimerQueueNode::operator==(const TimerQueueNode & right) const {
-    return expiration == right.expiration && timer == right.timer
-        && instance == right.instance;
+ITimerNotify::~ITimerNotify() {
+    if (m_timer)
+        timerCloseWait(this);
 }
 
 
@@ -240,17 +474,17 @@ TimePoint Timer::update(
         scoped_lock lk{s_mut};
         if (!notify->m_timer)
             new Timer(notify);
-        auto & timer = notify->m_timer;
+        auto timer = notify->m_timer.get();
         if (onlyIfSooner && !(expire < timer->expiration))
             return timer->expiration;
+        if (timer->slot != kNoSlot)
+            s_timers.remove(timer);
         timer->expiration = expire;
-        timer->instance += 1;
-        if (expire != TimePoint::max()) {
-            TimerQueueNode node(timer);
-            s_timers.push(node);
-            if (!(node == s_timers.top()))
-                return expire;
-        }
+        if (expire == TimePoint::max())
+            return expire;
+        s_timers.insert(timer, now);
+        if (!(expire < s_wakeTime))
+            return expire;
     }
 
     s_queueCv.notify_one();
@@ -266,23 +500,30 @@ void Timer::closeWait(ITimerNotify * notify) {
     // if we've stopped just remove the timer, this could be a call from the
     // destructor of a static notify so s_mut may already be destroyed.
     if (s_mode == kRunStopped) {
+        if (notify->m_timer->slot != kNoSlot)
+            s_timers.remove(notify->m_timer.get());
         notify->m_timer.reset();
         return;
     }
 
     unique_lock lk{s_mut};
     shared_ptr<Timer> timer{move(notify->m_timer)};
-    timer->instance += 1;
-    if (this_thread::get_id() == s_processingThread)
+    if (timer->slot != kNoSlot)
+        s_timers.remove(timer.get());
+    timer->notify = nullptr;
+    auto id = this_thread::get_id();
+    if (id == s_processingThread || id == timer->runThread)
         return;
 
-    while (notify == s_processingNotify)
+    while (notify == s_processingNotify || timer->runThread != thread::id{})
         s_processingCv.wait(lk);
 }
 
 //===========================================================================
 Timer::Timer(ITimerNotify * a_notify)
     : notify(a_notify)
+    , slot(kNoSlot)
+    , loop(a_notify->m_loop)
 {
     assert(!notify->m_timer);
     notify->m_timer.reset(this);
@@ -290,7 +531,43 @@ Timer::Timer(ITimerNotify * a_notify)
 
 //===========================================================================
 bool Timer::connected() const {
-    return this == notify->m_timer.get();
+    return notify;
+}
+
+//===========================================================================
+// Runs the callback on the timer's event loop, then reschedules it the same
+// way as for those run by the event thread.
+void Timer::onTask() {
+    unique_lock lk{s_mut};
+    auto hold = move(self);
+    queued = false;
+    if (!connected())
+        return;
+    auto cb = notify;
+    runThread = this_thread::get_id();
+    lk.unlock();
+    auto wait = cb->onTimer(timeNow());
+
+    lk.lock();
+    runThread = {};
+    if (!connected()) {
+        s_processingCv.notify_all();
+        return;
+    }
+    if (wait == kTimerInfinite)
+        return;
+    auto now = timeNow();
+    TimePoint expire = now + wait;
+    if (!(expire < expiration))
+        return;
+    if (slot != kNoSlot)
+        s_timers.remove(this);
+    expiration = expire;
+    s_timers.insert(this, now);
+    if (!(expire < s_wakeTime))
+        return;
+    lk.unlock();
+    s_queueCv.notify_one();
 }
 
 
@@ -1,4 +1,4 @@
-// Copyright Glen Knowles 2015 - 2025.
+// Copyright Glen Knowles 2015 - 2026.
 // Distributed under the Boost Software License, Version 1.0.
 //
 // timer.h - dim core
@@ -34,6 +34,9 @@ class Timer;
 
 class ITimerNotify {
 public:
+    // Callbacks are made on the event loop of the thread that creates the
+    // notifier, or on the event thread if it isn't running one.
+    ITimerNotify();
     virtual ~ITimerNotify();
     virtual Duration onTimer(TimePoint now) = 0;
     ITimerNotify & operator=(const ITimerNotify & other) = default;
@@ -41,6 +44,7 @@ public:
 private:
     friend class Timer;
     std::shared_ptr<Timer> m_timer;
+    unsigned m_loop;
 };
 
 class TimerProxy : public ITimerNotify {
@@ -1,4 +1,4 @@
-// Copyright Glen Knowles 2015 - 2025.
+// Copyright Glen Knowles 2015 - 2026.
 // Distributed under the Boost Software License, Version 1.0.
 //
 // file.h - dim file
@@ -10,9 +10,11 @@
 
 #include "basic/handle.h"
 #include "basic/types.h"
+#include "core/coro.h"
 #include "core/task.h"
 #include "core/time.h"
 
+#include <coroutine>
 #include <cstdint>
 #include <memory>
 #include <string_view>
@@ -540,4 +542,125 @@ std::error_code fileExtendView(
     int64_t length
 );
 
+
+
+/****************************************************************************
+*
+*   Coroutine awaitables
+*
+*   co_await fileReadAsync(...) - reads up to outBufLen bytes at the offset
+*   and returns the FileReadData, with data referencing outBuf.
+*
+*   co_await fileWriteAsync(...) - writes the buffer at the offset and
+*   returns the FileWriteData.
+*
+*   The coroutine continues on a thread of the queue (the event queue by
+*   default), directly from the completion callback.
+*
+***/
+
+class FileReadAwaiter : IFileReadNotify {
+public:
+    FileReadAwaiter(
+        void * outBuf,
+        size_t outBufLen,
+        FileHandle f,
+        int64_t offset,
+        TaskQueueHandle hq
+    )
+        : m_buf{outBuf}
+        , m_bufLen{outBufLen}
+        , m_hq{hq}
+    {
+        m_data.f = f;
+        m_data.offset = offset;
+    }
+
+    bool await_ready() const noexcept { return !m_bufLen; }
+    void await_suspend(std::coroutine_handle<> h) {
+        m_handle = h;
+        fileRead(
+            this,
+            m_buf,
+            m_bufLen,
+            m_data.f,
+            m_data.offset,
+            (int64_t) m_bufLen,
+            m_hq
+        );
+    }
+    const FileReadData & await_resume() const noexcept { return m_data; }
+
+private:
+    bool onFileRead(size_t * bytesUsed, const FileReadData & data) override {
+        *bytesUsed = data.data.size();
+        m_data = data;
+        m_data.more = false;
+        // Returning false ends the read, after which the file layer no
+        // longer references this notifier, so the coroutine may destroy it.
+        m_handle.resume();
+        return false;
+    }
+
+    void * m_buf;
+    size_t m_bufLen;
+    TaskQueueHandle m_hq;
+    FileReadData m_data{};
+    std::coroutine_handle<> m_handle;
+};
+
+//===========================================================================
+inline FileReadAwaiter fileReadAsync(
+    void * outBuf,
+    size_t outBufLen,
+    FileHandle f,
+    int64_t offset = 0,
+    TaskQueueHandle hq = {}
+) {
+    return FileReadAwaiter{outBuf, outBufLen, f, offset, hq};
+}
+
+class FileWriteAwaiter : IFileWriteNotify {
+public:
+    FileWriteAwaiter(
+        FileHandle f,
+        int64_t offset,
+        std::string_view data,
+        TaskQueueHandle hq
+    )
+        : m_hq{hq}
+    {
+        m_data.f = f;
+        m_data.offset = offset;
+        m_data.data = data;
+    }
+
+    bool await_ready() const noexcept { return false; }
+    void await_suspend(std::coroutine_handle<> h) {
+        m_handle = h;
+        fileWrite(this, m_data.f, m_data.offset, m_data.data, m_hq);
+    }
+    const FileWriteData & await_resume() const noexcept { return m_data; }
+
+private:
+    void onFileWrite(const FileWriteData & data) override {
+        m_data = data;
+        m_handle.resume();
+    }
+
+    TaskQueueHandle m_hq;
+    FileWriteData m_data{};
+    std::coroutine_handle<> m_handle;
+};
+
+//===========================================================================
+inline FileWriteAwaiter fileWriteAsync(
+    FileHandle f,
+    int64_t offset,
+    std::string_view data,
+    TaskQueueHandle hq = {}
+) {
+    return FileWriteAwaiter{f, offset, data, hq};
+}
+
 } // namespace
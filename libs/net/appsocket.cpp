@@ -1,4 +1,4 @@
-// Copyright Glen Knowles 2017 - 2025.
+// Copyright Glen Knowles 2017 - 2026.
 // Distributed under the Boost Software License, Version 1.0.
 //
 // appsocket.cpp - dim net
@@ -91,6 +91,13 @@ private:
     size_t m_bufferUsed{0};
 };
 
+// Sockets that haven't yet sent enough to pick a protocol. Each event loop
+// keeps its own, so only the loop that owns them ever touches them.
+struct UnmatchedList {
+    List<IAppSocket::UnmatchedInfo> sockets;
+    IAppSocket::UnmatchedTimer timer;
+};
+
 } // namespace
 
 
@@ -102,10 +109,11 @@ private:
 
 static vector<MatchKey> s_matchers;
 static vector<SockAddrInfo> s_sockAddrs;
+// Changed by the event thread, read by all event loops.
+static shared_mutex s_sockAddrMut;
 
-static List<IAppSocket::UnmatchedInfo> s_unmatched;
-static IAppSocket::UnmatchedTimer s_unmatchedTimer;
-static bool s_disableNoDataTimeout;
+static atomic_size_t s_numUnmatched;
+static atomic_bool s_disableNoDataTimeout;
 
 static auto & s_perfRequest = uperf("sock.disconnect (app request)");
 static auto & s_perfNoData = uperf("sock.disconnect (no data)");
@@ -114,6 +122,21 @@ static auto & s_perfCrypt = uperf("sock.disconnect (crypt error)");
 static auto & s_perfInactive = uperf("sock.disconnect (inactivity)");
 
 
+/****************************************************************************
+*
+*   Helpers
+*
+***/
+
+//===========================================================================
+// Unmatched sockets of the current thread's event loop. Created on first use
+// by the loop, so the timer's callbacks are also made there.
+static UnmatchedList & unmatched() {
+    thread_local UnmatchedList t_unmatched;
+    return t_unmatched;
+}
+
+
 /****************************************************************************
 *
 *   IAppSocket::UnmatchedInfo
@@ -122,7 +145,13 @@ static auto & s_perfInactive = uperf("sock.disconnect (inactivity)");
 
 //===========================================================================
 IAppSocket::UnmatchedInfo::UnmatchedInfo() {
-    s_unmatched.link(this);
+    unmatched().sockets.link(this);
+    s_numUnmatched += 1;
+}
+
+//===========================================================================
+IAppSocket::UnmatchedInfo::~UnmatchedInfo() {
+    s_numUnmatched -= 1;
 }
 
 
@@ -134,8 +163,9 @@ IAppSocket::UnmatchedInfo::UnmatchedInfo() {
 
 //===========================================================================
 Duration IAppSocket::UnmatchedTimer::onTimer(TimePoint now) {
-    while (!s_unmatched.empty()) {
-        auto info = s_unmatched.front();
+    auto & sockets = unmatched().sockets;
+    while (!sockets.empty()) {
+        auto info = sockets.front();
         auto wait = info->notify->checkTimeout(now);
         if (wait > 0s)
             return max(wait, kUnmatchedMinWait);
@@ -262,10 +292,10 @@ bool IAppSocket::notifyAccept(const AppSocketConnectInfo & info) {
     auto ui = new UnmatchedInfo;
     ui->notify = this;
     ui->expiration = expiration;
-    m_pos = s_unmatched.back();
+    m_pos = ui;
 
     if (!s_disableNoDataTimeout)
-        timerUpdate(&s_unmatchedTimer, kUnmatchedTimeout, true);
+        timerUpdate(&unmatched().timer, kUnmatchedTimeout, true);
     return true;
 }
 
@@ -382,6 +412,9 @@ bool IAppSocket::notifyRead(AppSocketData & data) {
     if (!m_pos->socketData.empty())
         view = m_pos->socketData.append(view);
 
+    // Held until the notifier is created, so the factory can't be removed,
+    // and its owner destroyed, between being found and being used.
+    shared_lock lk{s_sockAddrMut};
     IFactory<IAppSocketNotify> * fact;
     if (!findFactory(&m_accept.fam, &fact, m_accept.localAddr, view)) {
         if (m_pos->socketData.empty())
@@ -401,6 +434,7 @@ bool IAppSocket::notifyRead(AppSocketData & data) {
     }
 
     setNotify(fact->onFactoryCreate().release());
+    lk.unlock();
 
     // set notifier from registered factory
     if (!notifyAccept(m_accept))
@@ -575,6 +609,75 @@ AppSocket::MatchType RawMatch::onMatch(
 }
 
 
+/****************************************************************************
+*
+*   AppSocketCoNotify
+*
+***/
+
+//===========================================================================
+bool AppSocketCoNotify::onSocketRead(AppSocketData & data) {
+    if (auto reader = m_reader) {
+        // Resume the waiting coroutine directly with the socket's buffer, it
+        // returns here when it next suspends.
+        m_reader = nullptr;
+        reader->m_data = {data.data, (size_t) data.bytes};
+        reader->m_handle.resume();
+        return true;
+    }
+
+    // Nobody waiting, hold onto the data and stop reading until it's taken.
+    m_unread.append(data.data, data.bytes);
+    m_paused = true;
+    return false;
+}
+
+//===========================================================================
+void AppSocketCoNotify::onSocketDisconnect() {
+    m_disconnected = true;
+    if (auto reader = m_reader) {
+        m_reader = nullptr;
+        reader->m_data = {};
+        reader->m_handle.resume();
+    }
+}
+
+
+/****************************************************************************
+*
+*   AppSocketCoNotify::ReadAwaiter
+*
+***/
+
+//===========================================================================
+bool AppSocketCoNotify::ReadAwaiter::await_ready() {
+    auto & sock = *m_notify;
+    if (!sock.m_unread.empty()) {
+        // Keep the buffered data alive until the next read.
+        sock.m_taken.swap(sock.m_unread);
+        sock.m_unread.clear();
+        m_data = sock.m_taken;
+        if (sock.m_paused && !sock.m_disconnected) {
+            sock.m_paused = false;
+            socketRead(&sock);
+        }
+        return true;
+    }
+    if (sock.m_disconnected) {
+        m_data = {};
+        return true;
+    }
+    return false;
+}
+
+//===========================================================================
+void AppSocketCoNotify::ReadAwaiter::await_suspend(coroutine_handle<> h) {
+    assert(!m_notify->m_reader);
+    m_handle = h;
+    m_notify->m_reader = this;
+}
+
+
 /****************************************************************************
 *
 *   Configuration monitor
@@ -590,11 +693,11 @@ static AppXmlNotify s_appXml;
 
 //===========================================================================
 void AppXmlNotify::onConfigChange(const XDocument & doc) {
-    s_disableNoDataTimeout = configNumber(doc, "DisableNoDataTimeout");
-    timerUpdate(
-        &s_unmatchedTimer,
-        s_disableNoDataTimeout ? kTimerInfinite : 0ms
-    );
+    bool disable = configNumber(doc, "DisableNoDataTimeout");
+    s_disableNoDataTimeout = disable;
+    taskPushEventLoops([disable]() {
+        timerUpdate(&unmatched().timer, disable ? kTimerInfinite : 0ms);
+    });
 }
 
 
@@ -624,10 +727,12 @@ void ShutdownNotify::onShutdownConsole(bool firstTry) {
         assert(!info.listeners && !info.consoles);
 
     if (firstTry) {
-        for (auto && info : s_unmatched)
-            info.notify->disconnect(AppSocket::Disconnect::kAppRequest);
+        taskPushEventLoops([]() {
+            for (auto && info : unmatched().sockets)
+                info.notify->disconnect(AppSocket::Disconnect::kAppRequest);
+        });
     }
-    if (!s_unmatched.empty())
+    if (s_numUnmatched)
         shutdownIncomplete();
 }
 
@@ -750,6 +855,7 @@ static bool addFactory(
     const SockAddr & end,
     AppSocket::Family fam
 ) {
+    scoped_lock lk{s_sockAddrMut};
     auto info = findInfo(end, true);
     bool addNew = flags.any(fListener) && ++info->listeners == 1;
     if (flags.any(fConsole))
@@ -782,6 +888,7 @@ void Dim::socketCloseWait(
     const SockAddr & end,
     AppSocket::Family fam
 ) {
+    unique_lock lk{s_sockAddrMut};
     for (;;) {
         auto info = findInfo(end, false);
         if (!info)
@@ -816,6 +923,7 @@ void Dim::socketCloseWait(
                 );
             }
         }
+        lk.unlock();
         if (noListeners)
             socketCloseWait<RawSocket>(end);
         return;
@@ -7,11 +7,15 @@
 #include "cppconf/cppconf.h"
 
 #include "basic/charbuf.h"
+#include "basic/tempheap.h"
 #include "basic/types.h"
+#include "core/coro.h"
 #include "core/time.h"
 
+#include <coroutine>
 #include <functional>
 #include <memory>
+#include <string>
 #include <string_view>
 #include <type_traits>
 
@@ -208,4 +212,63 @@ inline void socketAddFilter(const SockAddr & addr, AppSocket::Family fam) {
 // Add socket filter to already created socket
 void socketAddFilter(IAppSocketNotify * notify, AppSocket::Family fam);
 
+
+
+/****************************************************************************
+*
+*   AppSocket coroutines
+*
+*   Notifier for connections that are handled by coroutines rather than by
+*   overriding onSocketRead. Data that arrives while no coroutine is waiting
+*   for it is buffered and further reads are paused until it's consumed.
+*
+*   co_await socketReadAsync(notify) - returns the next block of data, which
+*   is only valid until the coroutine suspends again. Returns an empty view
+*   once the socket has disconnected.
+*
+***/
+
+class AppSocketCoNotify : public IAppSocketNotify {
+public:
+    class ReadAwaiter;
+
+    // Arena for the frames of the connection's coroutines, started as
+    // CoTask coroutines whose parameters begin with:
+    //  (std::allocator_arg_t, IHeap * heap, ...)
+    TempHeap & heap() { return m_heap; }
+
+    bool onSocketRead(AppSocketData & data) override;
+    void onSocketDisconnect() override;
+
+private:
+    TempHeap m_heap;
+    std::string m_unread;
+    std::string m_taken;
+    bool m_paused{false};
+    bool m_disconnected{false};
+    ReadAwaiter * m_reader{};
+};
+
+class AppSocketCoNotify::ReadAwaiter {
+public:
+    explicit ReadAwaiter(AppSocketCoNotify * notify) : m_notify{notify} {}
+
+    bool await_ready();
+    void await_suspend(std::coroutine_handle<> h);
+    std::string_view await_resume() const noexcept { return m_data; }
+
+private:
+    friend class AppSocketCoNotify;
+    AppSocketCoNotify * m_notify;
+    std::string_view m_data;
+    std::coroutine_handle<> m_handle;
+};
+
+//===========================================================================
+inline AppSocketCoNotify::ReadAwaiter socketReadAsync(
+    AppSocketCoNotify * notify
+) {
+    return AppSocketCoNotify::ReadAwaiter{notify};
+}
+
 } // namespace
@@ -1,4 +1,4 @@
-// Copyright Glen Knowles 2017 - 2025.
+// Copyright Glen Knowles 2017 - 2026.
 // Distributed under the Boost Software License, Version 1.0.
 //
 // appsockint.h - dim net
@@ -111,6 +111,7 @@ struct IAppSocket::UnmatchedInfo : ListLink<> {
     IAppSocket * notify = {};
 
     UnmatchedInfo();
+    ~UnmatchedInfo();
 };
 
 class IAppSocket::UnmatchedTimer : public ITimerNotify {
@@ -1,13 +1,7 @@
-// Copyright Glen Knowles 2016 - 2024.
+// Copyright Glen Knowles 2016 - 2026.
 // Distributed under the Boost Software License, Version 1.0.
 //
 // hpack.cpp - dim http
-//
-// TODO:
-//  * padding strictly longer than 7 bits MUST be treated as a decoding
-//    error
-//  * padding not corresponding to the most significant bits of the code for
-//    the EOS symbol MUST be treated as a decoding error
 
 #include "pch.h"
 #pragma hdrstop
@@ -29,12 +23,27 @@ struct EncodeItem {
     int bits;
 };
 
-constexpr int16_t kDecodeUnused = numeric_limits<int16_t>::max();
+enum DecodeFlags : uint8_t {
+    // Number of symbols, zero to two, completed by the byte.
+    fDecodeCountMask = 3,
+
+    // Ending the string here leaves a valid padding, fewer than eight bits
+    // that are all ones, or no padding at all.
+    fDecodeAccept = 4,
 
+    // The byte completes EOS, which must never appear in a string.
+    fDecodeFail = 8,
+};
+
+// Transition of the decoder, from one state and on one byte of input. The
+// states are the interior nodes of the code tree, with the root as state 0,
+// so there are as many as there are symbols less one.
 struct DecodeItem {
-    int16_t zero{kDecodeUnused};
-    int16_t one{kDecodeUnused};
+    uint8_t next;
+    uint8_t flags;
+    char symbols[2];
 };
+
 class HuffDecoder {
 public:
     HuffDecoder(const EncodeItem items[], size_t count);
@@ -42,13 +51,12 @@ public:
     bool decode(
         const char ** out,
         IHeap * heap,
-        size_t unusedBits,
         const char src[],
         size_t count
     ) const;
 
 private:
-    int m_prefixBits{0};
+    // Indexed by state * 256 + input byte.
     vector<DecodeItem> m_decodeTable;
 };
 
@@ -396,6 +404,21 @@ const EncodeItem kEncodeTable[] = {
 };
 static_assert(size(kEncodeTable) == 257);
 
+// Header names whose values are seldom repeated on a connection, the default
+// policy doesn't spend dynamic table space on them.
+const string_view kUnindexedNames[] = {
+    ":path",
+    "age",
+    "content-length",
+    "content-range",
+    "etag",
+    "if-modified-since",
+    "if-none-match",
+    "last-modified",
+    "location",
+    "set-cookie",
+};
+
 
 /****************************************************************************
 *
@@ -405,6 +428,14 @@ static_assert(size(kEncodeTable) == 257);
 
 const HuffDecoder s_decode{kEncodeTable, size(kEncodeTable)};
 
+// Index of the first static table entry with each name.
+static const unordered_map<string_view, size_t> s_staticNames = [] {
+    unordered_map<string_view, size_t> names;
+    for (auto i = size(kStaticTable) - 1; i > 0; --i)
+        names[kStaticTable[i].name] = i;
+    return names;
+}();
+
 
 /****************************************************************************
 *
@@ -430,18 +461,77 @@ static size_t fieldSize(const HpackDynField & fld) {
 ***/
 
 //===========================================================================
-HpackEncode::HpackEncode(size_t tableSize) {
-    setTableSize(tableSize);
+// Length, in bytes, of the Huffman encoding of the string.
+static size_t huffmanLen(string_view str) {
+    size_t bits = 0;
+    for (unsigned char ch : str)
+        bits += kEncodeTable[ch].bits;
+    return (bits + 7) / 8;
 }
 
+//===========================================================================
+static void huffmanEncode(CharBuf * out, string_view str) {
+    char buf[256];
+    char * optr = buf;
+    char * eptr = buf + size(buf);
+    // Only the low (pending + 30) bits are significant, the rest are allowed
+    // to shift out the top.
+    uint64_t acc = 0;
+    int pending = 0;
+    for (unsigned char ch : str) {
+        auto & item = kEncodeTable[ch];
+        acc = (acc << item.bits) | item.code;
+        pending += item.bits;
+        while (pending >= 8) {
+            pending -= 8;
+            *optr++ = (char) (acc >> pending);
+        }
+        if (eptr - optr < 8) {
+            out->append(buf, optr - buf);
+            optr = buf;
+        }
+    }
+    if (pending) {
+        // Pad with the most significant bits of EOS, which are all ones.
+        *optr++ = (char) ((acc << (8 - pending)) | (0xff >> pending));
+    }
+    out->append(buf, optr - buf);
+}
+
+//===========================================================================
+HpackEncode::HpackEncode(size_t tableSize)
+    : m_dynSize{tableSize}
+{}
+
 //===========================================================================
 void HpackEncode::setTableSize(size_t tableSize) {
+    if (tableSize == m_dynSize && !m_sizeChanged)
+        return;
+    if (!m_sizeChanged) {
+        m_sizeChanged = true;
+        m_minDynSize = tableSize;
+    } else {
+        m_minDynSize = min(m_minDynSize, tableSize);
+    }
     m_dynSize = tableSize;
+    pruneDynTable();
+}
+
+//===========================================================================
+void HpackEncode::setIndexPolicy(HpackIndexPolicy policy) {
+    m_policy = policy;
 }
 
 //===========================================================================
 void HpackEncode::startBlock(CharBuf * out) {
     m_out = out;
+    if (m_sizeChanged) {
+        // (0x20) - dynamic table size update
+        if (m_minDynSize < m_dynSize)
+            write(m_minDynSize, 0x20, 5);
+        write(m_dynSize, 0x20, 5);
+        m_sizeChanged = false;
+    }
 }
 
 //===========================================================================
@@ -453,11 +543,55 @@ void HpackEncode::header(
     const char value[],
     EnumFlags<HpackFlags> flags
 ) {
-    // (0x00) - literal header field without indexing (new name)
-    // (0x10) - literal header field never indexed (new name)
-    m_out->append(1, flags.any(fNeverIndexed) ? 0x10 : 0x00);
-    write(name);
-    write(value);
+    string_view nameView = name;
+    string_view valueView = value;
+
+    // Find the field, or failing that just its name, preferring the static
+    // table for names so the reference stays valid as the dynamic table
+    // turns over.
+    size_t nameIndex = 0;
+    if (auto i = s_staticNames.find(nameView); i != s_staticNames.end()) {
+        nameIndex = i->second;
+        for (auto j = nameIndex; j < size(kStaticTable); ++j) {
+            auto & fld = kStaticTable[j];
+            if (nameView != fld.name)
+                break;
+            if (valueView == fld.value && !flags.any(fNeverIndexed)) {
+                // (0x80) - indexed header field
+                write(j, (char) 0x80, 7);
+                return;
+            }
+        }
+    }
+    for (size_t i = 0; i < size(m_dynTable); ++i) {
+        auto & fld = m_dynTable[i];
+        if (fld.name != nameView)
+            continue;
+        if (fld.value == valueView && !flags.any(fNeverIndexed)) {
+            write(size(kStaticTable) + i, (char) 0x80, 7);
+            return;
+        }
+        if (!nameIndex)
+            nameIndex = size(kStaticTable) + i;
+    }
+
+    auto fldSize = size(nameView) + size(valueView) + 32;
+    if (flags.any(fNeverIndexed)) {
+        // (0x10) - literal header field never indexed
+        write(nameIndex, 0x10, 4);
+    } else if (shouldIndex(nameView, valueView, fldSize)) {
+        // (0x40) - literal header field with incremental indexing
+        write(nameIndex, 0x40, 6);
+        pruneDynTable(fldSize);
+        m_dynTable.push_front({string(nameView), string(valueView)});
+        m_dynUsed += fldSize;
+    } else {
+        // (0x00) - literal header field without indexing
+        write(nameIndex, 0x00, 4);
+    }
+    if (!nameIndex)
+        write(nameView);
+    write(valueView);
 }
 
 //===========================================================================
@@ -470,16 +604,51 @@ void HpackEncode::header(
 }
 
 //===========================================================================
-void HpackEncode::write(const char str[]) {
-    size_t len = strlen(str);
-    write(str, len);
+bool HpackEncode::shouldIndex(
+    string_view name,
+    string_view value,
+    size_t fieldSize
+) const {
+    switch (m_policy) {
+    case kHpackIndexNone:
+        return false;
+    case kHpackIndexAll:
+        return fieldSize <= m_dynSize;
+    case kHpackIndexDefault:
+        break;
+    }
+
+    // Don't let a single field flush most of the table.
+    if (fieldSize > m_dynSize / 2)
+        return false;
+    for (auto && unindexed : kUnindexedNames) {
+        if (name == unindexed)
+            return false;
+    }
+    return true;
+}
+
+//===========================================================================
+// Evicts entries until there is room for 'reserve' more bytes, which may
+// mean evicting everything.
+void HpackEncode::pruneDynTable(size_t reserve) {
+    while (!m_dynTable.empty() && m_dynUsed + reserve > m_dynSize) {
+        m_dynUsed -= fieldSize(m_dynTable.back());
+        m_dynTable.pop_back();
+    }
 }
 
 //===========================================================================
-void HpackEncode::write(const char str[], size_t len) {
-    // high bit 0 - encode as raw bytes (not Huffman)
-    write(len, 0x00, 7);
-    m_out->append(str, len);
+void HpackEncode::write(string_view str) {
+    // high bit set - Huffman encoded, only used when it's shorter
+    auto hlen = huffmanLen(str);
+    if (hlen < size(str)) {
+        write(hlen, (char) 0x80, 7);
+        huffmanEncode(m_out, str);
+    } else {
+        write(size(str), 0x00, 7);
+        m_out->append(data(str), size(str));
+    }
 }
 
 //===========================================================================
@@ -512,119 +681,102 @@ void HpackEncode::write(size_t val, char prefix, int prefixBits) {
 // HuffDecoder
 //===========================================================================
 HuffDecoder::HuffDecoder(const EncodeItem items[], size_t count) {
-    int shortest = numeric_limits<int>::max();
-    int longest = 0;
-    const EncodeItem *ptr = items, *term = ptr + count;
-    for (; ptr != term; ++ptr) {
-        shortest = min(shortest, ptr->bits);
-        longest = max(longest, ptr->bits);
-    }
-    assert(shortest > 0 && longest < 32);
-    m_prefixBits = shortest - 1;
-    m_decodeTable.resize(1ull << m_prefixBits);
-
-    ptr = items;
-    int16_t val = 0;
-    for (; ptr != term; ++ptr, ++val) {
-        int pos = ptr->code >> (ptr->bits - m_prefixBits);
-        int mask = 1 << (ptr->bits - m_prefixBits - 1);
-
-        for (;;) {
-            assert(pos >= 0 && (size_t) pos < size(m_decodeTable));
-            DecodeItem & item = m_decodeTable[pos];
-            int16_t & key = (~ptr->code & mask) ? item.zero : item.one;
-            mask >>= 1;
-            if (!mask) {
-                assert(key == kDecodeUnused);
-                key = -val;
-                break;
+    // Build the code tree, children that are leaves are stored as the
+    // negation of their symbol.
+    struct Node {
+        int child[2];
+        int depth;
+        bool allOnes;
+    };
+    const int kUnused = numeric_limits<int>::max();
+    vector<Node> nodes = {{{kUnused, kUnused}, 0, true}};
+    for (auto i = 0; i < count; ++i) {
+        auto & item = items[i];
+        assert(item.bits > 0 && item.bits < 32);
+        int pos = 0;
+        for (auto bit = item.bits - 1; bit >= 0; --bit) {
+            int one = (item.code >> bit) & 1;
+            int & key = nodes[pos].child[one];
+            if (!bit) {
+                assert(key == kUnused);
+                key = -i;
+            } else if (key != kUnused) {
+                assert(key > 0);
+                pos = key;
             } else {
-                if (key != kDecodeUnused) {
+                key = (int) size(nodes);
+                Node child = {
+                    {kUnused, kUnused},
+                    nodes[pos].depth + 1,
+                    nodes[pos].allOnes && one
+                };
+                pos = key;
+                nodes.push_back(child);
+            }
+        }
+    }
+    assert(size(nodes) == count - 1);
+    assert(size(nodes) <= numeric_limits<uint8_t>::max() + 1);
+
+    // Walk every byte from every state.
+    auto eos = (int) count - 1;
+    m_decodeTable.resize(size(nodes) * 256);
+    for (auto state = 0; state < size(nodes); ++state) {
+        for (auto byte = 0; byte < 256; ++byte) {
+            auto & di = m_decodeTable[state * 256 + byte];
+            di = {};
+            int pos = state;
+            int emitted = 0;
+            for (auto bit = 7; bit >= 0; --bit) {
+                int key = nodes[pos].child[(byte >> bit) & 1];
+                assert(key != kUnused);
+                if (key > 0) {
                     pos = key;
-                } else {
-                    pos = (int)size(m_decodeTable);
-                    key = (int16_t)pos;
-                    m_decodeTable.resize(pos + 1);
+                    continue;
                 }
+                if (-key == eos) {
+                    di.flags |= fDecodeFail;
+                    break;
+                }
+                assert(emitted < 2);
+                di.symbols[emitted++] = (char) -key;
+                pos = 0;
             }
+            di.next = (uint8_t) pos;
+            di.flags |= emitted;
+            if (nodes[pos].allOnes && nodes[pos].depth < 8)
+                di.flags |= fDecodeAccept;
         }
     }
 }
 
-//===========================================================================
-static bool read(
-    int * out,
-    int bits,
-    int & availBits,
-    const char *& ptr,
-    const char * eptr
-) {
-    if (ptr == eptr) {
-        assert(availBits == 8);
-        return false;
-    }
-
-    int val;
-
-    while (bits > availBits) {
-        val = *ptr;
-        val &= (1 << availBits) - 1;
-        *out = (*out << availBits) + val;
-        if (++ptr == eptr)
-            return false;
-        bits -= availBits;
-        availBits = 8;
-    }
-
-    availBits -= bits;
-    if (!availBits) {
-        val = *ptr;
-        availBits = 8;
-        ptr += 1;
-    } else {
-        val = *ptr >> availBits;
-    }
-    val &= (1 << bits) - 1;
-    *out = (*out << bits) + val;
-    return true;
-}
-
 //===========================================================================
 bool HuffDecoder::decode(
     const char ** out,
     IHeap * heap,
-    size_t unusedBits,
     const char src[],
     size_t count
 ) const {
-    assert(count);
-    int avail = (int)unusedBits;
-    const char * ptr = src;
-    const char * eptr = src + count;
-    char * optr = heap->alloc<char>(2 * count);
+    // Every byte completes at most two symbols, and both are always
+    // written, so the output needs room for two per byte.
+    char * optr = heap->alloc<char>(2 * count + 1);
     *out = optr;
-    int val;
-    for (;;) {
-        int key = 0;
-        if (!read(&key, m_prefixBits, avail, ptr, eptr))
-            goto DONE;
-        for (;;) {
-            auto & di = m_decodeTable[key];
-            if (!read(&key, 1, avail, ptr, eptr))
-                goto DONE;
-            val = (key & 1) ? di.one : di.zero;
-            if (val <= 0)
-                break;
-            key = val;
-        }
-        if (val < -255)
+    const DecodeItem * table = m_decodeTable.data();
+    unsigned state = 0;
+    unsigned flags = fDecodeAccept;
+    const char * eptr = src + count;
+    for (; src != eptr; ++src) {
+        auto & di = table[state * 256 + (unsigned char) *src];
+        flags = di.flags;
+        if (flags & fDecodeFail)
             return false;
-        *optr++ = (char)-val;
+        optr[0] = di.symbols[0];
+        optr[1] = di.symbols[1];
+        optr += flags & fDecodeCountMask;
+        state = di.next;
     }
-
-DONE:
     *optr = 0;
-    return true;
+    return flags & fDecodeAccept;
 }
 
 //===========================================================================
@@ -847,7 +999,7 @@ bool HpackDecode::read(
     if (!huffman) {
         *out = heap->strDup(string_view(src, len));
     } else {
-        if (!s_decode.decode(out, heap, 8, src, len))
+        if (!s_decode.decode(out, heap, src, len))
             return false;
     }
 
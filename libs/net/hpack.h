@@ -1,4 +1,4 @@
-// Copyright Glen Knowles 2016 - 2025.
+// Copyright Glen Knowles 2016 - 2026.
 // Distributed under the Boost Software License, Version 1.0.
 //
 // hpack.h - dim http
@@ -14,6 +14,7 @@
 
 #include <deque>
 #include <string>
+#include <string_view>
 
 namespace Dim {
 
@@ -34,6 +35,14 @@ struct HpackDynField {
     std::string value;
 };
 
+// Which literal fields the encoder adds to its dynamic table. Fields marked
+// fNeverIndexed are never added, regardless of policy.
+enum HpackIndexPolicy {
+    kHpackIndexNone,    // static table references and literals only
+    kHpackIndexDefault, // all but fields whose values seldom repeat
+    kHpackIndexAll,     // every field that fits in the table
+};
+
 
 /****************************************************************************
 *
@@ -44,7 +53,11 @@ struct HpackDynField {
 class HpackEncode {
 public:
     HpackEncode(size_t tableSize);
+
+    // Changes to the table size are announced to the decoder at the start
+    // of the next header block.
     void setTableSize(size_t tableSize);
+    void setIndexPolicy(HpackIndexPolicy policy);
 
     void startBlock(CharBuf * out);
     void endBlock();
@@ -59,13 +72,29 @@ public:
         const char value[],
         EnumFlags<HpackFlags> flags = {}
     );
+    auto & dynamicTable() const { return m_dynTable; }
 
 private:
-    void write(const char str[]);
-    void write(const char str[], size_t len);
+    bool shouldIndex(
+        std::string_view name,
+        std::string_view value,
+        size_t fieldSize
+    ) const;
+    void pruneDynTable(size_t reserve = 0);
+
+    void write(std::string_view str);
     void write(size_t val, char prefix, int prefixBits);
 
     size_t m_dynSize{};
+    std::deque<HpackDynField> m_dynTable;
+    size_t m_dynUsed{};
+    HpackIndexPolicy m_policy{kHpackIndexDefault};
+
+    // Smallest table size set since the last block, if it was changed at
+    // all. Both it and the final size must be sent if they differ.
+    size_t m_minDynSize{};
+    bool m_sizeChanged{};
+
     CharBuf * m_out{};
 };
 
@@ -1,4 +1,4 @@
-// Copyright Glen Knowles 2015 - 2025.
+// Copyright Glen Knowles 2015 - 2026.
 // Distributed under the Boost Software License, Version 1.0.
 //
 // http.h - dim http
@@ -6,6 +6,9 @@
 // implements http/2, as defined by:
 //  rfc7540 - Hypertext Transfer Protocol Version 2 (HTTP/2)
 //  rfc7541 - HPACK: Header Compression for HTTP/2
+//
+// and the server side of http/1.1, as defined by:
+//  rfc9112 - HTTP/1.1
 
 #pragma once
 
@@ -14,10 +17,12 @@
 #include "basic/charbuf.h"
 #include "basic/handle.h"
 #include "basic/tempheap.h"
-#include "basic/types.h" // ForwardListIterator
+#include "basic/types.h" // EnumFlags
 #include "net/url.h"
 
+#include <cstdint>
 #include <memory>
+#include <span>
 #include <string_view>
 #include <vector>
 
@@ -181,20 +186,52 @@ const char * toReasonPhrase(HttpStatus status);
 *
 ***/
 
+// Heap for the header names and values of messages. Whole blocks come from,
+// and are returned to, a free list kept by each thread, so once warm a
+// connection parsing or building messages doesn't touch the global
+// allocator for them.
+class HttpMsgHeap : public IHeap {
+public:
+    HttpMsgHeap() = default;
+    HttpMsgHeap(HttpMsgHeap && from) noexcept;
+    ~HttpMsgHeap();
+    HttpMsgHeap & operator=(const HttpMsgHeap & from) = delete;
+    HttpMsgHeap & operator=(HttpMsgHeap && from) noexcept;
+
+    void clear();
+    void swap(HttpMsgHeap & from);
+
+private:
+    // Inherited via std::pmr::memory_resource -- private members of base!
+    void * do_allocate(size_t bytes, size_t alignment) override;
+    void do_deallocate(void * ptr, size_t bytes, size_t alignment) override;
+
+    void * m_buffer{};
+};
+
 class HttpMsg {
 public:
-    struct HdrList;
-    struct HdrName;
-    struct HdrValue;
+    struct HdrField {
+        HttpHdr m_id{kHttpInvalid};
+        const char * m_name{};
+        const char * m_value{};
+
+        explicit operator bool() const { return m_name; }
+    };
 
 public:
     HttpMsg (int stream = 0) : m_stream{stream} {}
-    HttpMsg (HttpMsg && from) = default;
+    HttpMsg (HttpMsg && from) noexcept;
     virtual ~HttpMsg() = default;
-    HttpMsg & operator= (HttpMsg && from) = default;
+    HttpMsg & operator= (HttpMsg && from) noexcept;
     void clear();
     virtual void swap(HttpMsg & other);
 
+    // Allocated from per thread lists of freed messages, so replacing one
+    // that's been processed with the next doesn't go to the global heap.
+    static void * operator new(size_t bytes);
+    static void operator delete(void * ptr, size_t bytes);
+
     void addHeader(HttpHdr id, const char value[]);
     void addHeader(HttpHdr id, std::string_view value);
     void addHeader(const char name[], const char value[]);
@@ -210,17 +247,19 @@ public:
 
     const char * addRef(TimePoint time);
 
-    // Returns true if header removed, false if header wasn't found.
+    // Returns true if header removed, false if header wasn't found. All
+    // values of the header are removed.
     bool removeHeader(HttpHdr id);
     bool removeHeader(const char name[]);
 
-    HdrList headers();
-    const HdrList headers() const;
+    // All header fields, pseudo-headers first and the values of each header
+    // next to each other, otherwise in the order they were added.
+    std::span<const HdrField> headers() const;
 
-    HdrName headers(HttpHdr header);
-    const HdrName headers(HttpHdr header) const;
-    HdrName headers(const char name[]);
-    const HdrName headers(const char name[]) const;
+    // First field of the header, it converts to false if there isn't one.
+    // Any further values immediately follow it in headers().
+    HdrField headers(HttpHdr header) const;
+    HdrField headers(const char name[]) const;
 
     bool hasHeader(HttpHdr header) const;
     bool hasHeader(const char name[]) const;
@@ -243,51 +282,29 @@ protected:
     );
     virtual bool removeHeader(HttpHdr id, const char name[]);
 
-    enum Flags : unsigned {
-        fFlagHasStatus = 0x01,
-        fFlagHasMethod = 0x02,
-        fFlagHasScheme = 0x04,
-        fFlagHasAuthority = 0x08,
-        fFlagHasPath = 0x10,
-        fFlagHasHeader = 0x20,
-    };
-    EnumFlags<Flags> m_flags = {};
-    Flags toHasFlag(HttpHdr id) const;
-
 private:
-    CharBuf m_data;
-    TempHeap m_heap;
-    HdrName * m_firstHeader{};
-    int m_stream{};
-};
-
-struct HttpMsg::HdrValue {
-    const char * m_value{};
-    HdrValue * m_next{};
-    HdrValue * m_prev{};
-};
+    static constexpr unsigned kInlineFields = 16;
+    static_assert(kHttps <= 64);
 
-struct HttpMsg::HdrName {
-    HttpHdr m_id{kHttpInvalid};
-    const char * m_name{};
-    HdrName * m_next{};
-    HdrValue m_value;
+    void swapBase(HttpMsg & other);
+    const HdrField * findField(HttpHdr id, const char name[]) const;
 
-    ForwardListIterator<HdrValue> begin();
-    ForwardListIterator<HdrValue> end();
-    ForwardListIterator<const HdrValue> begin() const;
-    ForwardListIterator<const HdrValue> end() const;
-};
+    CharBuf m_data;
+    HttpMsgHeap m_heap;
 
-struct HttpMsg::HdrList {
-    HdrName * m_firstHeader{};
+    // Header fields, kept in m_inline until there are too many and then
+    // in arrays allocated from m_heap.
+    HdrField * m_fields{m_inline};
+    unsigned m_numFields{};
+    unsigned m_maxFields{kInlineFields};
+    unsigned m_numPseudo{};
 
-    ForwardListIterator<HdrName> begin();
-    ForwardListIterator<HdrName> end();
-    ForwardListIterator<const HdrName> begin() const;
-    ForwardListIterator<const HdrName> end() const;
+    // Bit for each HttpHdr that has at least one field, kHttpInvalid's bit
+    // is set if there are any headers without an id.
+    uint64_t m_ids{};
 
-    explicit operator bool() const { return m_firstHeader; }
+    int m_stream{};
+    HdrField m_inline[kInlineFields];
 };
 
 
@@ -336,6 +353,13 @@ private:
 
 class HttpConn;
 
+// Payload that belongs in the output at pos, referenced in place instead of
+// being copied there. Only valid while the data passed in is.
+struct HttpDataRef {
+    size_t pos;
+    std::string_view data;
+};
+
 std::shared_ptr<HttpConn> httpConnect(CharBuf * out);
 std::shared_ptr<HttpConn> httpAccept();
 
@@ -380,6 +404,16 @@ bool httpReply(
     const HttpMsg & msg,
     bool more = false
 );
+// Payload of data frames that can be sent immediately is added to refs
+// instead of being copied to out.
+bool httpReply(
+    CharBuf * out,
+    std::vector<HttpDataRef> * refs,
+    std::shared_ptr<HttpConn> conn,
+    int stream,
+    const HttpMsg & msg,
+    bool more = false
+);
 
 // Sends more data on a stream, a stream ends after request, push promise,
 // reply, or data is called with more false. Returns false if the stream has
@@ -398,6 +432,33 @@ bool httpData(
     std::string_view data,
     bool more = false
 );
+// Payload that can be sent immediately is added to refs instead of being
+// copied to out.
+bool httpData(
+    CharBuf * out,
+    std::vector<HttpDataRef> * refs,
+    std::shared_ptr<HttpConn> conn,
+    int stream,
+    const CharBuf & data,
+    bool more = false
+);
+bool httpData(
+    CharBuf * out,
+    std::vector<HttpDataRef> * refs,
+    std::shared_ptr<HttpConn> conn,
+    int stream,
+    std::string_view data,
+    bool more = false
+);
+
+// Bytes of data queued on the stream, waiting for the remote end to open
+// its flow control window or for its turn to be written.
+size_t httpUnsent(std::shared_ptr<HttpConn> conn, int stream);
+
+// Data is framed a turn at a time, the rest is queued. This writes the next
+// turn, taking from the queued streams in priority order, and returns true
+// if there's more that flow control allows. Call it as the socket drains.
+bool httpWriteUnsent(CharBuf * out, std::shared_ptr<HttpConn> conn);
 
 // Resets stream with either INTERNAL_ERROR or CANCEL
 void httpResetStream(
@@ -408,6 +469,90 @@ void httpResetStream(
 );
 
 
+/****************************************************************************
+*
+*   Http/1.1 connection
+*
+***/
+
+// Requests are reported with the same pseudo headers an http/2 connection
+// would produce, and are each given their own stream id. Replies may be made
+// in any order, they are sent in the order the requests were received.
+class Http1Conn;
+
+std::shared_ptr<Http1Conn> http1Accept();
+
+void http1Close(std::shared_ptr<Http1Conn> conn);
+std::string_view http1GetError(std::shared_ptr<Http1Conn> conn);
+
+// True once the last reply the connection will send, either because it
+// isn't being kept alive or because the input was invalid, has been
+// serialized. The socket should be disconnected after sending it.
+bool http1Closed(std::shared_ptr<Http1Conn> conn);
+
+// True while so many requests are waiting for their replies to be sent, or
+// so much of the replies is held back behind earlier ones, that no more
+// requests are parsed. The input that follows is kept, and the socket should
+// stop reading until it's false again, then call http1Recv() with no data to
+// parse what was kept.
+bool http1Paused(std::shared_ptr<Http1Conn> conn);
+
+// Returns false when no more data will be accepted, either by request
+// of the input or due to error.
+// Even after an error, out and msgs should be processed.
+//  - out: data to send to the remote address is appended
+//  - msgs: zero or more requests are appended
+bool http1Recv(
+    CharBuf * out,
+    std::vector<std::unique_ptr<HttpMsg>> * msgs,
+    std::shared_ptr<Http1Conn> conn,
+    const void * src,
+    size_t srcLen
+);
+
+// Serializes a reply to the request with the specified stream id, returns
+// false if the request already has a reply or isn't waiting for one. A
+// reply with a line break in its status or a field, or a field name that
+// isn't a token, is replaced by a 500 and the connection closed.
+bool http1Reply(
+    CharBuf * out,
+    std::shared_ptr<Http1Conn> conn,
+    int stream,
+    const HttpMsg & msg,
+    bool more = false
+);
+
+// Sends more of the body of a reply, the reply ends when data is called
+// with more false.
+bool http1Data(
+    CharBuf * out,
+    std::shared_ptr<Http1Conn> conn,
+    int stream,
+    const CharBuf & data,
+    bool more = false
+);
+bool http1Data(
+    CharBuf * out,
+    std::shared_ptr<Http1Conn> conn,
+    int stream,
+    std::string_view data,
+    bool more = false
+);
+
+// Bytes of the reply held until the replies before it are complete.
+size_t http1Unsent(std::shared_ptr<Http1Conn> conn, int stream);
+
+// HTTP/1.1 has no way to cancel a single reply, so the connection is closed
+// once the replies before this one are sent. If the reply hasn't started a
+// 500 Internal Server Error is sent first, whether or not internal is true.
+void http1ResetStream(
+    CharBuf * out,
+    std::shared_ptr<Http1Conn> conn,
+    int stream,
+    bool internal
+);
+
+
 /****************************************************************************
 *
 *   Headers
@@ -416,4 +561,21 @@ void httpResetStream(
 
 bool httpParse(TimePoint * time, std::string_view val);
 
+// Returns true if any of the comma separated entity tags, such as the value
+// of If-None-Match, matches. Weak comparison is used, so "W/" prefixes are
+// ignored, and "*" matches anything.
+bool httpMatchEtag(std::string_view tags, std::string_view etag);
+
+// Parses a Range header with a single "bytes=first-last", "bytes=first-",
+// or "bytes=-suffix" range of a representation with size bytes. Returns
+// false if there isn't one that can be served, multiple ranges included,
+// in which case the whole representation is sent. Sets *first to at least
+// size if the range can't be satisfied.
+bool httpParseRange(
+    uint64_t * first,
+    uint64_t * last,
+    std::string_view val,
+    uint64_t size
+);
+
 } // namespace
@@ -0,0 +1,908 @@
+// Copyright Glen Knowles 2026.
+// Distributed under the Boost Software License, Version 1.0.
+//
+// http1conn.cpp - dim http
+#include "pch.h"
+#pragma hdrstop
+
+using namespace std;
+using namespace Dim;
+
+
+/****************************************************************************
+*
+*   Tuning parameters
+*
+***/
+
+// Longest request line and header block accepted, and longest trailer
+// section of a chunked body.
+const size_t kMaxHeaderLen = 64 * 1024;
+
+// Largest request body accepted.
+const size_t kMaxBodyLen = 16 * 1024 * 1024;
+
+// Longest chunk size line, including any chunk extensions.
+const size_t kMaxChunkLineLen = 1024;
+
+// Requests waiting for their replies to be sent, and bytes of reply held
+// back for earlier replies to complete, at which no more requests are parsed
+// until some of the replies go out.
+const size_t kMaxPendingReplies = 16;
+const size_t kMaxHeldReplyBytes = 1024 * 1024;
+
+
+/****************************************************************************
+*
+*   Private declarations
+*
+***/
+
+enum class Http1Conn::InputMode : int {
+    kHeaders,
+    kBody,
+    kChunkSize,
+    kChunkData,
+    kChunkEnd,
+    kTrailers,
+    kClosed,    // no more requests will be accepted
+};
+
+
+/****************************************************************************
+*
+*   Variables
+*
+***/
+
+static auto & s_perfConns = uperf("http.http1 connections (current)");
+static auto & s_perfPipelined = uperf("http.http1 requests pipelined");
+
+
+/****************************************************************************
+*
+*   Helpers
+*
+***/
+
+//===========================================================================
+// Returns length of the line, including the LF that ends it, or 0 if the
+// line isn't complete. The line itself is returned without the CRLF, a bare
+// LF is also accepted as the end of a line.
+static size_t getLine(string_view * line, string_view src) {
+    auto pos = src.find('\n');
+    if (pos == string_view::npos)
+        return 0;
+    *line = src.substr(0, pos);
+    if (!line->empty() && line->back() == '\r')
+        line->remove_suffix(1);
+    return pos + 1;
+}
+
+//===========================================================================
+// Returns length of the header block, through the empty line that ends it,
+// or 0 if it isn't complete. The search starts at 'from' so it can resume
+// where it left off when more data arrives.
+static size_t findHeaderEnd(string_view src, size_t from) {
+    for (;;) {
+        auto pos = src.find('\n', from);
+        if (pos == string_view::npos)
+            return 0;
+        from = pos + 1;
+        if (from < src.size() && src[from] == '\n')
+            return from + 1;
+        if (from + 1 < src.size() && src[from] == '\r' && src[from + 1] == '\n')
+            return from + 2;
+    }
+}
+
+//===========================================================================
+static bool isTchar(unsigned char ch) {
+    return isalnum(ch) || ch && strchr("!#$%&'*+-.^_`|~", ch);
+}
+
+//===========================================================================
+static bool isToken(string_view src) {
+    if (src.empty())
+        return false;
+    for (unsigned char ch : src) {
+        if (!isTchar(ch))
+            return false;
+    }
+    return true;
+}
+
+//===========================================================================
+static string_view trimOws(string_view src) {
+    while (!src.empty() && (src.front() == ' ' || src.front() == '\t'))
+        src.remove_prefix(1);
+    while (!src.empty() && (src.back() == ' ' || src.back() == '\t'))
+        src.remove_suffix(1);
+    return src;
+}
+
+//===========================================================================
+// True if the text can go between the delimiters of a status or field line
+// without ending the line early.
+static bool isLineText(string_view src) {
+    return src.find_first_of("\r\n") == string_view::npos;
+}
+
+//===========================================================================
+// Hop-by-hop fields that describe the HTTP/1.1 connection rather than the
+// request, they are consumed here and not passed on.
+static bool isConnectionField(string_view name) {
+    return name == "keep-alive"
+        || name == "proxy-connection"
+        || name == "te"
+        || name == "upgrade";
+}
+
+
+/****************************************************************************
+*
+*   Http1Conn
+*
+***/
+
+//===========================================================================
+Http1Conn::Http1Conn()
+    : m_inputMode{InputMode::kHeaders}
+{}
+
+//===========================================================================
+bool Http1Conn::recv(
+    CharBuf * out,
+    vector<unique_ptr<HttpMsg>> * msgs,
+    const void * src,
+    size_t srcLen
+) {
+    string_view data{static_cast<const char *>(src), srcLen};
+    size_t used = 0;
+    bool result;
+    if (m_input.empty()) {
+        // Parse straight from the caller's buffer, only the incomplete
+        // request at the end, if any, is copied.
+        result = parse(out, msgs, data, &used);
+        if (result)
+            m_input.assign(data.substr(used));
+    } else {
+        m_input.append(data);
+        result = parse(out, msgs, m_input, &used);
+        m_input.erase(0, used);
+    }
+    if (!result)
+        m_input.clear();
+    return result;
+}
+
+//===========================================================================
+bool Http1Conn::parse(
+    CharBuf * out,
+    vector<unique_ptr<HttpMsg>> * msgs,
+    string_view src,
+    size_t * used
+) {
+    string_view line;
+    size_t len;
+    for (;;) {
+        auto avail = src.substr(*used);
+        switch (m_inputMode) {
+        case InputMode::kClosed:
+            *used = src.size();
+            return false;
+
+        case InputMode::kHeaders:
+            // The rest of the input waits for the replies to catch up.
+            if (paused())
+                return true;
+            if (!m_scanned) {
+                // Empty lines before the request line are ignored.
+                while ((len = getLine(&line, avail)) && line.empty()) {
+                    *used += len;
+                    avail.remove_prefix(len);
+                }
+            }
+            if (avail.empty())
+                return true;
+            len = findHeaderEnd(avail, m_scanned);
+            if (!len) {
+                if (avail.size() > kMaxHeaderLen) {
+                    return replyError(
+                        out,
+                        kHttpStatusRequestHeaderFieldsTooLarge,
+                        "request header too large"
+                    );
+                }
+                m_scanned = max(avail.size(), (size_t) 2) - 2;
+                return true;
+            }
+            m_scanned = 0;
+            if (len > kMaxHeaderLen) {
+                return replyError(
+                    out,
+                    kHttpStatusRequestHeaderFieldsTooLarge,
+                    "request header too large"
+                );
+            }
+            *used += len;
+            if (!onHeaders(out, avail.substr(0, len)))
+                return false;
+            if (m_inputMode == InputMode::kHeaders)
+                onRequest(msgs);
+            break;
+
+        case InputMode::kBody:
+        case InputMode::kChunkData:
+            len = min(m_remaining, avail.size());
+            if (!len)
+                return true;
+            m_msg->body().append(avail.data(), len);
+            *used += len;
+            m_remaining -= len;
+            if (!m_remaining) {
+                if (m_inputMode == InputMode::kBody) {
+                    onRequest(msgs);
+                } else {
+                    m_inputMode = InputMode::kChunkEnd;
+                }
+            }
+            break;
+
+        case InputMode::kChunkSize:
+            // chunk-size [ chunk-ext ] CRLF
+            len = getLine(&line, avail);
+            if (!len) {
+                if (avail.size() > kMaxChunkLineLen) {
+                    return replyError(
+                        out,
+                        kHttpStatusBadRequest,
+                        "chunk size line too long"
+                    );
+                }
+                return true;
+            }
+            *used += len;
+            {
+                // Digits past the largest allowed size are still counted, so
+                // an oversized chunk is told apart from a malformed one.
+                size_t chunk = 0;
+                size_t pos = 0;
+                for (; pos < line.size() && isHex(line[pos]); ++pos) {
+                    if (chunk <= kMaxBodyLen)
+                        chunk = chunk * 16 + hexToNibbleUnsafe(line[pos]);
+                }
+                if (!pos
+                    || pos < line.size()
+                        && line[pos] != ' '
+                        && line[pos] != '\t'
+                        && line[pos] != ';'
+                ) {
+                    return replyError(
+                        out,
+                        kHttpStatusBadRequest,
+                        "invalid chunk size"
+                    );
+                }
+                if (chunk > kMaxBodyLen - m_msg->body().size()) {
+                    return replyError(
+                        out,
+                        kHttpStatusPayloadTooLarge,
+                        "request body too large"
+                    );
+                }
+                if (chunk) {
+                    m_remaining = chunk;
+                    m_inputMode = InputMode::kChunkData;
+                } else {
+                    m_trailerLen = 0;
+                    m_inputMode = InputMode::kTrailers;
+                }
+            }
+            break;
+
+        case InputMode::kChunkEnd:
+            len = getLine(&line, avail);
+            if (!len && avail.size() < 2)
+                return true;
+            if (!len || !line.empty()) {
+                return replyError(
+                    out,
+                    kHttpStatusBadRequest,
+                    "chunk data not followed by CRLF"
+                );
+            }
+            *used += len;
+            m_inputMode = InputMode::kChunkSize;
+            break;
+
+        case InputMode::kTrailers:
+            // Trailer fields are read and discarded.
+            len = getLine(&line, avail);
+            if (!len || m_trailerLen + len > kMaxHeaderLen) {
+                if (m_trailerLen + avail.size() > kMaxHeaderLen) {
+                    return replyError(
+                        out,
+                        kHttpStatusRequestHeaderFieldsTooLarge,
+                        "request trailers too large"
+                    );
+                }
+                return true;
+            }
+            *used += len;
+            m_trailerLen += len;
+            if (line.empty())
+                onRequest(msgs);
+            break;
+        }
+    }
+}
+
+//===========================================================================
+bool Http1Conn::onHeaders(CharBuf * out, string_view src) {
+    string_view line;
+    src.remove_prefix(getLine(&line, src));
+
+    // request-line = method SP request-target SP HTTP-version
+    auto sp1 = line.find(' ');
+    auto sp2 = line.rfind(' ');
+    if (sp1 == string_view::npos || sp1 == sp2)
+        return replyError(out, kHttpStatusBadRequest, "invalid request line");
+    auto method = line.substr(0, sp1);
+    auto target = line.substr(sp1 + 1, sp2 - sp1 - 1);
+    auto version = line.substr(sp2 + 1);
+    if (!isToken(method))
+        return replyError(out, kHttpStatusBadRequest, "invalid method");
+    if (target.empty())
+        return replyError(out, kHttpStatusBadRequest, "invalid target");
+    for (unsigned char ch : target) {
+        if (ch <= ' ' || ch == 0x7f)
+            return replyError(out, kHttpStatusBadRequest, "invalid target");
+    }
+    if (version == "HTTP/1.1") {
+        m_http10 = false;
+    } else if (version == "HTTP/1.0") {
+        m_http10 = true;
+    } else {
+        return replyError(
+            out,
+            kHttpStatusHttpVersionNotSupported,
+            "unsupported version"
+        );
+    }
+
+    m_msg = make_unique<HttpRequest>(m_nextStream);
+    m_keepAlive = !m_http10;
+    m_head = method == "HEAD";
+    m_msg->addHeader(kHttp_Method, method);
+    m_msg->addHeaderRef(kHttp_Scheme, "http");
+    bool hasHost = false;
+    bool absForm = false;
+    if (auto pos = target.find("://"); pos != string_view::npos
+        && target[0] != '/'
+    ) {
+        // absolute-form, the authority replaces any host field
+        auto auth = target.substr(pos + 3);
+        pos = auth.find('/');
+        target = pos == string_view::npos ? "/" : auth.substr(pos);
+        m_msg->addHeader(kHttp_Authority, auth.substr(0, pos));
+        absForm = true;
+    }
+    m_msg->addHeader(kHttp_Path, target);
+
+    auto & heap = m_msg->heap();
+    bool chunked = false;
+    bool hasLength = false;
+    size_t length = 0;
+    bool expectContinue = false;
+    for (;;) {
+        src.remove_prefix(getLine(&line, src));
+        if (line.empty())
+            break;
+
+        // field-line = field-name ":" OWS field-value OWS
+        if (line[0] == ' ' || line[0] == '\t') {
+            return replyError(
+                out,
+                kHttpStatusBadRequest,
+                "obsolete line folding"
+            );
+        }
+        auto colon = line.find(':');
+        if (colon == string_view::npos || !isToken(line.substr(0, colon))) {
+            return replyError(
+                out,
+                kHttpStatusBadRequest,
+                "invalid header field"
+            );
+        }
+        auto value = trimOws(line.substr(colon + 1));
+        for (unsigned char ch : value) {
+            if (ch < ' ' && ch != '\t' || ch == 0x7f) {
+                return replyError(
+                    out,
+                    kHttpStatusBadRequest,
+                    "invalid header value"
+                );
+            }
+        }
+        auto name = heap.alloc<char>(colon + 1);
+        memcpy(name, line.data(), colon);
+        name[colon] = 0;
+        toLower(name, colon);
+
+        auto id = httpHdrFromString(name);
+        switch (id) {
+        case kHttpHost:
+            if (hasHost) {
+                return replyError(
+                    out,
+                    kHttpStatusBadRequest,
+                    "multiple host fields"
+                );
+            }
+            hasHost = true;
+            if (!absForm)
+                m_msg->addHeader(kHttp_Authority, value);
+            continue;
+        case kHttpConnection:
+            for (;;) {
+                auto pos = value.find(',');
+                auto opt = trimOws(value.substr(0, pos));
+                if (equalNoCase(opt, "close")) {
+                    m_keepAlive = false;
+                } else if (equalNoCase(opt, "keep-alive") && m_http10) {
+                    m_keepAlive = true;
+                }
+                if (pos == string_view::npos)
+                    break;
+                value.remove_prefix(pos + 1);
+            }
+            continue;
+        case kHttpContentLength:
+            {
+                size_t val;
+                if (!Dim::parse(&val, value) || hasLength && val != length) {
+                    return replyError(
+                        out,
+                        kHttpStatusBadRequest,
+                        "invalid content-length"
+                    );
+                }
+                hasLength = true;
+                length = val;
+            }
+            break;
+        case kHttpTransferEncoding:
+            if (!equalNoCase(value, "chunked")) {
+                return replyError(
+                    out,
+                    kHttpStatusNotImplemented,
+                    "unsupported transfer coding"
+                );
+            }
+            chunked = true;
+            continue;
+        case kHttpExpect:
+            if (!equalNoCase(value, "100-continue")) {
+                return replyError(
+                    out,
+                    kHttpStatusExpectationFailed,
+                    "unsupported expectation"
+                );
+            }
+            expectContinue = true;
+            continue;
+        default:
+            if (isConnectionField(name))
+                continue;
+            break;
+        }
+        auto val = heap.strDup(value);
+        if (id) {
+            m_msg->addHeaderRef(id, val);
+        } else {
+            m_msg->addHeaderRef(name, val);
+        }
+    }
+
+    if (!hasHost && !m_http10)
+        return replyError(out, kHttpStatusBadRequest, "missing host field");
+    if (chunked && (hasLength || m_http10)) {
+        // Either could be used to smuggle a request past an intermediary
+        // that frames the message differently.
+        return replyError(
+            out,
+            kHttpStatusBadRequest,
+            "ambiguous message framing"
+        );
+    }
+    if (length > kMaxBodyLen) {
+        return replyError(
+            out,
+            kHttpStatusPayloadTooLarge,
+            "request body too large"
+        );
+    }
+
+    m_nextStream += 1;
+    if (!m_replies.empty())
+        s_perfPipelined += 1;
+    if (chunked) {
+        m_inputMode = InputMode::kChunkSize;
+    } else if (length) {
+        m_remaining = length;
+        m_inputMode = InputMode::kBody;
+    } else {
+        // No body, request is complete
+        return true;
+    }
+    if (expectContinue && m_replies.empty())
+        out->append("HTTP/1.1 100 Continue\r\n\r\n");
+    return true;
+}
+
+//===========================================================================
+void Http1Conn::onRequest(vector<unique_ptr<HttpMsg>> * msgs) {
+    auto & rep = m_replies.emplace_back();
+    rep.stream = m_msg->stream();
+    rep.head = m_head;
+    rep.http10 = m_http10;
+    rep.keepAlive = m_keepAlive;
+    msgs->push_back(move(m_msg));
+    m_inputMode = m_keepAlive ? InputMode::kHeaders : InputMode::kClosed;
+}
+
+//===========================================================================
+bool Http1Conn::replyError(
+    CharBuf * out,
+    HttpStatus status,
+    string_view msg
+) {
+    m_errmsg = msg;
+    m_msg.reset();
+    m_inputMode = InputMode::kClosed;
+
+    // Queued behind any replies still pending, with stream 0 so it can't
+    // be found by the application.
+    auto & rep = m_replies.emplace_back();
+    rep.started = true;
+    rep.noBody = true;
+    auto buf = target(out, &rep);
+    buf->append("HTTP/1.1 ")
+        .append(toChars((int) status).view())
+        .append(" ")
+        .append(toReasonPhrase(status))
+        .append("\r\nconnection: close\r\ncontent-length: 0\r\n\r\n");
+    endReply(out, &rep);
+    return false;
+}
+
+//===========================================================================
+Http1Conn::Reply * Http1Conn::find(int stream) {
+    if (stream) {
+        for (auto && rep : m_replies) {
+            if (rep.stream == stream)
+                return &rep;
+        }
+    }
+    return nullptr;
+}
+
+//===========================================================================
+// Output for replies behind one that's still in progress is held until
+// they reach the front of the line.
+CharBuf * Http1Conn::target(CharBuf * out, Reply * rep) {
+    return rep == &m_replies.front() ? out : &rep->unsent;
+}
+
+//===========================================================================
+bool Http1Conn::reply(
+    CharBuf * out,
+    int stream,
+    const HttpMsg & msg,
+    bool more
+) {
+    auto rep = find(stream);
+    if (!rep || rep->started)
+        return false;
+
+    const char * st = "500";
+    if (auto hdr = msg.headers(kHttp_Status))
+        st = hdr.m_value;
+
+    // The status and fields are copied into the reply as is, so a line break
+    // in one would split the reply and let the rest pass as more fields, or
+    // as another reply entirely. Fail it instead.
+    bool valid = isLineText(st);
+    for (auto && hdr : msg.headers()) {
+        if ((hdr.m_name[0] != ':' && !isToken(hdr.m_name))
+            || !isLineText(hdr.m_value)
+        ) {
+            valid = false;
+        }
+    }
+    if (!valid) {
+        resetStream(out, stream, true);
+        return false;
+    }
+    rep->started = true;
+    auto status = strToInt(st);
+    bool noContent = status < 200
+        || status == kHttpStatusNoContent
+        || status == kHttpStatusNotModified;
+    rep->noBody = rep->head || noContent;
+
+    auto buf = target(out, rep);
+    buf->append("HTTP/1.1 ")
+        .append(st)
+        .append(" ")
+        .append(toReasonPhrase((HttpStatus) status))
+        .append("\r\n");
+    bool hasLength = false;
+    for (auto && hdr : msg.headers()) {
+        if (hdr.m_name[0] == ':'
+            || hdr.m_id == kHttpConnection
+            || hdr.m_id == kHttpTransferEncoding
+        ) {
+            continue;
+        }
+        if (hdr.m_id == kHttpContentLength)
+            hasLength = true;
+        buf->append(hdr.m_name)
+            .append(": ")
+            .append(hdr.m_value)
+            .append("\r\n");
+    }
+    auto & body = msg.body();
+    if (!hasLength && !noContent) {
+        // The reply to HEAD gets the length the body would have had, if
+        // it's known.
+        if (!more) {
+            buf->append("content-length: ")
+                .append(toChars(body.size()).view())
+                .append("\r\n");
+        } else if (rep->head) {
+            // No body, so no framing needed.
+        } else if (!rep->http10) {
+            rep->chunked = true;
+            buf->append("transfer-encoding: chunked\r\n");
+        } else {
+            // Without a length or chunking the end of the body can only be
+            // marked by closing the connection.
+            rep->keepAlive = false;
+        }
+    }
+    if (!rep->keepAlive) {
+        buf->append("connection: close\r\n");
+    } else if (rep->http10) {
+        buf->append("connection: keep-alive\r\n");
+    }
+    buf->append("\r\n");
+
+    for (auto && view : body.views())
+        writeBody(out, rep, view);
+    if (!more)
+        endReply(out, rep);
+    return true;
+}
+
+//===========================================================================
+bool Http1Conn::addData(
+    CharBuf * out,
+    int stream,
+    string_view data,
+    bool more
+) {
+    auto rep = find(stream);
+    if (!rep || !rep->started || rep->done)
+        return false;
+    writeBody(out, rep, data);
+    if (!more)
+        endReply(out, rep);
+    return true;
+}
+
+//===========================================================================
+bool Http1Conn::addData(
+    CharBuf * out,
+    int stream,
+    const CharBuf & data,
+    bool more
+) {
+    auto rep = find(stream);
+    if (!rep || !rep->started || rep->done)
+        return false;
+    for (auto && view : data.views())
+        writeBody(out, rep, view);
+    if (!more)
+        endReply(out, rep);
+    return true;
+}
+
+//===========================================================================
+void Http1Conn::writeBody(CharBuf * out, Reply * rep, string_view data) {
+    if (rep->noBody || data.empty())
+        return;
+    auto buf = target(out, rep);
+    if (rep->chunked) {
+        buf->append(toHexChars(data.size()).view())
+            .append("\r\n")
+            .append(data)
+            .append("\r\n");
+    } else {
+        buf->append(data);
+    }
+}
+
+//===========================================================================
+void Http1Conn::endReply(CharBuf * out, Reply * rep) {
+    if (rep->chunked)
+        target(out, rep)->append("0\r\n\r\n");
+    rep->done = true;
+    writeQueued(out);
+}
+
+//===========================================================================
+void Http1Conn::writeQueued(CharBuf * out) {
+    while (!m_replies.empty()) {
+        auto & rep = m_replies.front();
+        if (!rep.unsent.empty()) {
+            out->append(rep.unsent);
+            rep.unsent.clear();
+        }
+        if (!rep.done)
+            return;
+        if (!rep.keepAlive) {
+            m_closed = true;
+            m_inputMode = InputMode::kClosed;
+            m_replies.clear();
+            return;
+        }
+        m_replies.pop_front();
+    }
+}
+
+//===========================================================================
+void Http1Conn::resetStream(CharBuf * out, int stream, bool /* internal */) {
+    auto rep = find(stream);
+    if (!rep || rep->done)
+        return;
+    if (!rep->started) {
+        // Nothing has been sent for it yet, so the client can at least be
+        // told why the connection is going away.
+        rep->started = true;
+        target(out, rep)->append(
+            "HTTP/1.1 500 Internal Server Error\r\n"
+            "connection: close\r\n"
+            "content-length: 0\r\n"
+            "\r\n"
+        );
+    }
+    rep->chunked = false;
+    rep->keepAlive = false;
+    m_inputMode = InputMode::kClosed;
+    endReply(out, rep);
+}
+
+//===========================================================================
+size_t Http1Conn::unsent(int stream) {
+    auto rep = find(stream);
+    return rep ? rep->unsent.size() : 0;
+}
+
+//===========================================================================
+bool Http1Conn::paused() const {
+    if (m_replies.size() >= kMaxPendingReplies)
+        return true;
+    size_t held = 0;
+    for (auto && rep : m_replies)
+        held += rep.unsent.size();
+    return held >= kMaxHeldReplyBytes;
+}
+
+
+/****************************************************************************
+*
+*   Public API
+*
+***/
+
+//===========================================================================
+std::shared_ptr<Http1Conn> Dim::http1Accept() {
+    s_perfConns += 1;
+    return shared_ptr<Http1Conn>(new Http1Conn, [](Http1Conn * conn) {
+        s_perfConns -= 1;
+        delete conn;
+    });
+}
+
+//===========================================================================
+void Dim::http1Close(std::shared_ptr<Http1Conn> conn) {
+    conn.reset();
+}
+
+//===========================================================================
+string_view Dim::http1GetError(std::shared_ptr<Http1Conn> conn) {
+    if (conn)
+        return conn->errmsg();
+    return {};
+}
+
+//===========================================================================
+bool Dim::http1Closed(std::shared_ptr<Http1Conn> conn) {
+    return !conn || conn->closed();
+}
+
+//===========================================================================
+bool Dim::http1Paused(std::shared_ptr<Http1Conn> conn) {
+    return conn && conn->paused();
+}
+
+//===========================================================================
+bool Dim::http1Recv(
+    CharBuf * out,
+    vector<unique_ptr<HttpMsg>> * msgs,
+    std::shared_ptr<Http1Conn> conn,
+    const void * src,
+    size_t srcLen
+) {
+    if (conn)
+        return conn->recv(out, msgs, src, srcLen);
+    return false;
+}
+
+//===========================================================================
+bool Dim::http1Reply(
+    CharBuf * out,
+    std::shared_ptr<Http1Conn> conn,
+    int stream,
+    const HttpMsg & msg,
+    bool more
+) {
+    if (conn)
+        return conn->reply(out, stream, msg, more);
+    return false;
+}
+
+//===========================================================================
+bool Dim::http1Data(
+    CharBuf * out,
+    std::shared_ptr<Http1Conn> conn,
+    int stream,
+    const CharBuf & data,
+    bool more
+) {
+    if (conn)
+        return conn->addData(out, stream, data, more);
+    return false;
+}
+
+//===========================================================================
+bool Dim::http1Data(
+    CharBuf * out,
+    std::shared_ptr<Http1Conn> conn,
+    int stream,
+    string_view data,
+    bool more
+) {
+    if (conn)
+        return conn->addData(out, stream, data, more);
+    return false;
+}
+
+//===========================================================================
+size_t Dim::http1Unsent(std::shared_ptr<Http1Conn> conn, int stream) {
+    return conn ? conn->unsent(stream) : 0;
+}
+
+//===========================================================================
+void Dim::http1ResetStream(
+    CharBuf * out,
+    std::shared_ptr<Http1Conn> conn,
+    int stream,
+    bool internal
+) {
+    if (conn)
+        conn->resetStream(out, stream, internal);
+}
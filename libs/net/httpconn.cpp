@@ -1,4 +1,4 @@
-// Copyright Glen Knowles 2016 - 2025.
+// Copyright Glen Knowles 2016 - 2026.
 // Distributed under the Boost Software License, Version 1.0.
 //
 // httpconn.cpp - dim http
@@ -20,6 +20,10 @@ const unsigned kDefaultHeaderTableSize = 4096;
 
 const int kMaximumWindowSize = 0x7fff'ffff;
 
+// Most data frame payload written per turn, the rest waits to be asked for
+// as the socket drains so replies that come later can cut in.
+const size_t kDataQuantum = 16'384;
+
 
 /****************************************************************************
 *
@@ -40,6 +44,7 @@ enum class FrameType : int8_t {
     kGoAway = 7,
     kWindowUpdate = 8,
     kContinuation = 9,
+    kPriorityUpdate = 16, // RFC 9218
 };
 
 enum FrameParam : int16_t {
@@ -125,18 +130,49 @@ constexpr Duration kMaxResetStreamAge = 10s;
 constexpr Duration kMinResetStreamCheckInterval = 2s;
 
 namespace {
-class ResetStreamTimer : public ITimerNotify {
+// Streams reset by the connections of one event loop, ordered by when they
+// were closed.
+class ResetStreams : public ITimerNotify {
+public:
+    void add(
+        weak_ptr<HttpConn> conn,
+        int stream,
+        shared_ptr<HttpStream> sm
+    );
+
+private:
     Duration onTimer(TimePoint now) override;
+
+    deque<ResetStream> m_streams;
 };
 } // namespace
-static deque<ResetStream> s_resetStreams;
-static ResetStreamTimer s_resetTimer;
 
 //===========================================================================
-Duration ResetStreamTimer::onTimer(TimePoint now) {
+// Constructed on first use by each event loop, so that its timer fires on
+// the loop that owns the connections.
+static ResetStreams & resetStreams() {
+    thread_local ResetStreams t_resetStreams;
+    return t_resetStreams;
+}
+
+//===========================================================================
+void ResetStreams::add(
+    weak_ptr<HttpConn> conn,
+    int stream,
+    shared_ptr<HttpStream> sm
+) {
+    auto & rs = m_streams.emplace_back();
+    rs.conn = move(conn);
+    rs.stream = stream;
+    rs.sm = move(sm);
+    timerUpdate(this, kMaxResetStreamAge, true);
+}
+
+//===========================================================================
+Duration ResetStreams::onTimer(TimePoint now) {
     auto expire = now - kMaxResetStreamAge;
-    while (!empty(s_resetStreams)) {
-        auto & rs = s_resetStreams.front();
+    while (!empty(m_streams)) {
+        auto & rs = m_streams.front();
         if (auto sleep = rs.sm->m_closed - expire; sleep > 0s)
             return min(sleep, kMinResetStreamCheckInterval);
 
@@ -149,7 +185,7 @@ Duration ResetStreamTimer::onTimer(TimePoint now) {
             assert(rs.sm->m_localState == HttpStream::kDeleted);
         }
 
-        s_resetStreams.pop_front();
+        m_streams.pop_front();
     }
 
     return kTimerInfinite;
@@ -458,16 +494,12 @@ static bool removePriority(
     unsigned tmp = ntoh32(hdr);
     out->exclusive = tmp & 0x80000000;
     out->stream = tmp & 0x7fffffff;
-    out->weight = (unsigned)hdr[4] + 1;
+    out->weight = (uint8_t) hdr[4] + 1;
     if (out->stream == stream)
         return false;
     return true;
 }
 
-//===========================================================================
-static void updatePriority() {
-}
-
 //===========================================================================
 bool HttpConn::recv(
     CharBuf * out,
@@ -587,11 +619,11 @@ void HttpConn::resetStream(CharBuf * out, int stream, FrameError error) {
     sm->m_localState = HttpStream::kClosed;
     sm->m_remoteState = HttpStream::kClosed;
     sm->m_closed = timeNow();
-    auto & rs = s_resetStreams.emplace_back();
-    rs.conn = weak_from_this();
-    rs.stream = stream;
-    rs.sm = sm;
-    timerUpdate(&s_resetTimer, kMaxResetStreamAge, true);
+    // Nothing more is sent on a stream after resetting it. With nothing left
+    // to send, nextUnsent() drops it from m_unsentStreams if it's there.
+    sm->m_unsent.clear();
+    sm->m_unsentEnd = false;
+    resetStreams().add(weak_from_this(), stream, move(sm));
 }
 
 //===========================================================================
@@ -617,7 +649,7 @@ HttpStream * HttpConn::findAlways(CharBuf * out, int stream) {
     }
 
     m_lastInputStream = stream;
-    ib.first->second = make_shared<HttpStream>();
+    ib.first->second = allocate_shared<HttpStream>(HttpAlloc<HttpStream>());
     auto sm = ib.first->second.get();
     sm->m_flowWindow = m_initialFlowWindow;
     return sm;
@@ -662,6 +694,8 @@ bool HttpConn::onFrame(
         return onPing(out, msgs, src, stream, flags);
     case FrameType::kPriority:
         return onPriority(out, msgs, src, stream, flags);
+    case FrameType::kPriorityUpdate:
+        return onPriorityUpdate(out, msgs, src, stream, flags);
     case FrameType::kPushPromise:
         return onPushPromise(out, msgs, src, stream, flags);
     case FrameType::kRstStream:
@@ -790,16 +824,15 @@ bool HttpConn::onHeaders(
     }
 
     // parse priority
-    if (flags.any(fPriority)) {
-        PriorityData pri;
-        if (!removePriority(&pri, stream, ud.hdr, hdrLen)) {
-            return replyGoAway(
-                out,
-                FrameError::kProtocolError,
-                "headers frame with invalid priority"
-            );
-        }
-        updatePriority();
+    PriorityData pri;
+    if (flags.any(fPriority)
+        && !removePriority(&pri, stream, ud.hdr, hdrLen)
+    ) {
+        return replyGoAway(
+            out,
+            FrameError::kProtocolError,
+            "headers frame with invalid priority"
+        );
     }
 
     // find stream
@@ -861,6 +894,9 @@ bool HttpConn::onHeaders(
         );
     }
 
+    if (flags.any(fPriority))
+        updatePriority(stream, sm, pri.stream, pri.weight, pri.exclusive);
+
     if (!flags.any(fEndHeaders))
         m_frameMode = FrameMode::kContinuation;
 
@@ -875,11 +911,20 @@ bool HttpConn::onHeaders(
     }
     if (!mdec) {
         resetStream(out, stream, mdec.error());
-    } else if (flags.any(fEndHeaders) && !sm->m_msg->checkPseudoHeaders()) {
-        resetStream(out, stream, FrameError::kProtocolError);
-    } else if (sm->m_remoteState == HttpStream::kClosed) {
-        msgs->push_back(move(sm->m_msg));
+        return true;
+    }
+    if (flags.any(fEndHeaders)) {
+        if (!msg->checkPseudoHeaders()) {
+            resetStream(out, stream, FrameError::kProtocolError);
+            return true;
+        }
+        if (msg->isRequest()) {
+            if (auto hdr = msg->headers("priority"))
+                updatePriority(sm, hdr.m_value);
+        }
     }
+    if (sm->m_remoteState == HttpStream::kClosed)
+        msgs->push_back(move(sm->m_msg));
     return true;
 }
 
@@ -924,6 +969,64 @@ bool HttpConn::onPriority(
         );
     }
 
+    // Priority of streams that haven't been opened yet is ignored.
+    if (auto it = m_streams.find(stream); it != m_streams.end()) {
+        updatePriority(
+            stream,
+            it->second.get(),
+            pri.stream,
+            pri.weight,
+            pri.exclusive
+        );
+    }
+    return true;
+}
+
+//===========================================================================
+bool HttpConn::onPriorityUpdate(
+    CharBuf * out,
+    vector<unique_ptr<HttpMsg>> * msgs,
+    const char src[],
+    int stream,
+    EnumFlags<FrameFlags> flags
+) {
+    // PriorityUpdate frame (RFC 9218)
+    //  reserved : 1
+    //  prioritized stream : 31
+    //  priority field value[]
+
+    if (m_frameMode != FrameMode::kNormal || stream || m_outgoing) {
+        return replyGoAway(
+            out,
+            FrameError::kProtocolError,
+            "priority update frame unexpected"
+        );
+    }
+    if (m_inputFrameLen < 4) {
+        return replyGoAway(
+            out,
+            FrameError::kFrameSizeError,
+            "priority update frame size must be at least 4"
+        );
+    }
+
+    int id = ntoh31(src + kFrameHeaderLen);
+    if (!id) {
+        return replyGoAway(
+            out,
+            FrameError::kProtocolError,
+            "priority update of stream 0"
+        );
+    }
+
+    // Updates that arrive ahead of the request they're for are dropped,
+    // rather than held for a stream that may never be opened.
+    if (auto it = m_streams.find(id); it != m_streams.end()) {
+        updatePriority(
+            it->second.get(),
+            string_view(src + kFrameHeaderLen + 4, m_inputFrameLen - 4)
+        );
+    }
     return true;
 }
 
@@ -1027,6 +1130,11 @@ bool HttpConn::onSettings(
         unsigned identifier = ntoh16(src + kFrameHeaderLen + pos);
         unsigned value = ntoh32(src + kFrameHeaderLen + pos + 2);
         switch (identifier) {
+        case kSettingsHeaderTableSize:
+            // The peer's limit on the table we encode against, never grow
+            // it past the default to bound per connection memory.
+            m_encoder.setTableSize(min(value, kDefaultHeaderTableSize));
+            break;
         case kSettingsInitialWindowSize:
             if (!setInitialWindowSize(out, value))
                 return false;
@@ -1035,6 +1143,9 @@ bool HttpConn::onSettings(
     }
 
     startFrame(out, 0, FrameType::kSettings, 0, fAck);
+
+    // data may have been waiting for a larger initial window
+    writeUnsent(out, kDataQuantum);
     return true;
 }
 
@@ -1047,8 +1158,8 @@ bool HttpConn::setInitialWindowSize(CharBuf * out, unsigned value) {
             "initial window size too large"
         );
     }
-    m_initialFlowWindow = (int) value;
     auto diff = (int) value - m_initialFlowWindow;
+    m_initialFlowWindow = (int) value;
     for (auto & sm : m_streams) {
         auto & win = sm.second->m_flowWindow;
         if (diff > 0 && win > kMaximumWindowSize - diff) {
@@ -1226,11 +1337,7 @@ bool HttpConn::onWindowUpdate(
             );
         }
         m_flowWindow += increment;
-        for (auto && [id, sm] : m_streams) {
-            if (!m_flowWindow)
-                break;
-            writeUnsent(out, id, sm.get());
-        }
+        writeUnsent(out, kDataQuantum);
         return true;
     }
 
@@ -1254,7 +1361,7 @@ bool HttpConn::onWindowUpdate(
         return true;
     }
     sm->m_flowWindow += increment;
-    writeUnsent(out, stream, sm);
+    writeUnsent(out, kDataQuantum);
     return true;
 }
 
@@ -1288,15 +1395,104 @@ bool HttpConn::onContinuation(
 }
 
 
+/****************************************************************************
+*
+*   Stream priority
+*
+***/
+
+//===========================================================================
+// Moves the stream under a new parent (RFC 7540 5.3.3). A parent that is
+// itself a descendant of the stream first takes the stream's old place in
+// the tree.
+void HttpConn::updatePriority(
+    int stream,
+    HttpStream * sm,
+    int parent,
+    int weight,
+    bool exclusive
+) {
+    auto depth = size(m_streams);
+    for (auto id = parent; id && depth; --depth) {
+        auto it = m_streams.find(id);
+        if (it == m_streams.end())
+            break;
+        id = it->second->m_parent;
+        if (id == stream) {
+            m_streams[parent]->m_parent = sm->m_parent;
+            break;
+        }
+    }
+    if (exclusive) {
+        for (auto && kv : m_streams) {
+            if (kv.second->m_parent == parent)
+                kv.second->m_parent = stream;
+        }
+    }
+    sm->m_parent = parent;
+    sm->m_weight = weight;
+}
+
+//===========================================================================
+// Applies an RFC 9218 priority field value, such as "u=1, i", from either
+// the priority header or a PRIORITY_UPDATE frame. Missing parameters take
+// their defaults and unknown or malformed ones are ignored.
+void HttpConn::updatePriority(HttpStream * sm, string_view value) {
+    sm->m_urgency = 3;
+    sm->m_incremental = false;
+    vector<string_view> members;
+    split(&members, value, ',');
+    for (auto && mem : members) {
+        mem = trim(mem.substr(0, mem.find(';')));
+        if (mem.size() == 3 && mem.starts_with("u=")
+            && mem[2] >= '0' && mem[2] <= '7'
+        ) {
+            sm->m_urgency = mem[2] - '0';
+        } else if (mem == "i" || mem == "i=?1") {
+            sm->m_incremental = true;
+        } else if (mem == "i=?0") {
+            sm->m_incremental = false;
+        }
+    }
+}
+
+
 /****************************************************************************
 *
 *   Sending data
 *
 ***/
 
+//===========================================================================
+// Payload bytes copied, either to the output or to be held while waiting
+// on flow control, and referenced in place for the caller to send.
+static auto & s_perfCopied = u64perf(
+    "http.data bytes copied",
+    PerfFormat::kSiUnits
+);
+static auto & s_perfReferenced = u64perf(
+    "http.data bytes referenced",
+    PerfFormat::kSiUnits
+);
+static auto & s_perfReplies = uperf("http.replies framed");
+static auto & s_perfCopiedPerReply = uperf(
+    "http.data bytes copied per reply",
+    []() -> unsigned {
+        return (unsigned) (s_perfCopied / max(s_perfReplies.load(), 1u));
+    }
+);
+
+//===========================================================================
+// Position in the round-robin that sending the bytes is worth, inversely
+// proportional to the stream's weight.
+static uint64_t sendCost(size_t bytes, int weight) {
+    return (bytes + kFrameHeaderLen) * 256 / weight;
+}
+
 //===========================================================================
 bool HttpConn::writeMsg(
     CharBuf * out,
+    vector<HttpDataRef> * refs,
     int stream,
     HttpStream * sm,
     const HttpMsg & msg,
@@ -1316,32 +1512,30 @@ bool HttpConn::writeMsg(
     out->append((char *)frameHdr, size(frameHdr));
     m_encoder.startBlock(out);
     for (auto && hdr : msg.headers()) {
-        for (auto && hv : hdr) {
-            if (hdr.m_id) {
-                m_encoder.header(hdr.m_id, hv.m_value);
-            } else {
-                m_encoder.header(hdr.m_name, hv.m_value);
-            }
-            while (size(*out) > maxEndPos) {
-                setFrameHeader(
-                    frameHdr,
-                    stream,
-                    ftype,
-                    m_maxOutputFrame,
-                    flags
-                );
-                out->replace(
-                    framePos,
-                    size(frameHdr),
-                    (char *)frameHdr,
-                    size(frameHdr)
-                );
-                ftype = FrameType::kContinuation;
-                flags = {};
-                framePos = maxEndPos;
-                maxEndPos += m_maxOutputFrame + kFrameHeaderLen;
-                out->insert(framePos, (char *)frameHdr, size(frameHdr));
-            }
+        if (hdr.m_id) {
+            m_encoder.header(hdr.m_id, hdr.m_value);
+        } else {
+            m_encoder.header(hdr.m_name, hdr.m_value);
+        }
+        while (size(*out) > maxEndPos) {
+            setFrameHeader(
+                frameHdr,
+                stream,
+                ftype,
+                m_maxOutputFrame,
+                flags
+            );
+            out->replace(
+                framePos,
+                size(frameHdr),
+                (char *)frameHdr,
+                size(frameHdr)
+            );
+            ftype = FrameType::kContinuation;
+            flags = {};
+            framePos = maxEndPos;
+            maxEndPos += m_maxOutputFrame + kFrameHeaderLen;
+            out->insert(framePos, (char *)frameHdr, size(frameHdr));
         }
     }
     setFrameHeader(
@@ -1368,13 +1562,16 @@ bool HttpConn::writeMsg(
         return false;
     }
 
-    return headersOnly || addData(out, stream, sm, body, more);
+    if (!msg.isRequest())
+        s_perfReplies += 1;
+    return headersOnly || addData(out, refs, stream, sm, body, more);
 }
 
 //===========================================================================
 template<typename T>
 bool HttpConn::addData(
     CharBuf * out,
+    vector<HttpDataRef> * refs,
     int stream,
     HttpStream * sm,
     const T & data,
@@ -1387,38 +1584,6 @@ bool HttpConn::addData(
         sm = it->second.get();
     }
 
-    size_t dataLen = size(data);
-    size_t count = dataLen;
-    if (!sm->m_unsent.empty()) {
-        count = 0;
-    } else {
-        auto windowAvail = min(m_flowWindow, sm->m_flowWindow);
-        if (windowAvail < dataLen)
-            count = (windowAvail < 0) ? 0 : windowAvail;
-    }
-    size_t pos = 0;
-    while (pos + m_maxOutputFrame < count) {
-        startFrame(out, stream, FrameType::kData, m_maxOutputFrame, {});
-        out->append(data, pos, m_maxOutputFrame);
-        pos += m_maxOutputFrame;
-    }
-    if (pos != count || !more && count == dataLen) {
-        startFrame(
-            out,
-            stream,
-            FrameType::kData,
-            int(count - pos),
-            (!more && count == dataLen) ? fEndStream : (FrameFlags) 0
-        );
-        out->append(data, pos, count - pos);
-        pos = count;
-    }
-
-    m_flowWindow -= (int) count;
-    sm->m_flowWindow -= (int) count;
-    if (auto unsent = dataLen - count)
-        sm->m_unsent.append(data, pos, unsent);
-
     switch (sm->m_localState) {
     case HttpStream::kOpen:
         if (!more)
@@ -1429,71 +1594,196 @@ bool HttpConn::addData(
         return false;
     }
 
-    // erase if fully closed and no pending data frames
-    if (sm->m_localState == HttpStream::kClosed
-        && sm->m_unsent.empty()
-        && sm->m_remoteState == HttpStream::kClosed
-    ) {
-        m_streams.erase(stream);
+    size_t dataLen = size(data);
+    size_t pos = 0;
+    size_t count = 0;
+    if (m_unsentStreams.empty()) {
+        // Nothing else is waiting to be sent, so frame directly from the
+        // data for as much of this turn as the flow control windows allow.
+        auto windowAvail = min(m_flowWindow, sm->m_flowWindow);
+        count = min({dataLen, (size_t) max(windowAvail, 0), kDataQuantum});
+        bool end = !more && count == dataLen;
+        while (pos < count || end) {
+            auto len = min(count - pos, (size_t) m_maxOutputFrame);
+            bool last = end && pos + len == count;
+            startFrame(
+                out,
+                stream,
+                FrameType::kData,
+                len,
+                last ? fEndStream : (FrameFlags) 0
+            );
+            if (!refs) {
+                out->append(data, pos, len);
+                s_perfCopied += len;
+            } else if constexpr (is_same_v<T, string_view>) {
+                if (len)
+                    refs->push_back({out->size(), data.substr(pos, len)});
+                s_perfReferenced += len;
+            } else {
+                for (auto && v : data.views(pos, len))
+                    refs->push_back({out->size(), v});
+                s_perfReferenced += len;
+            }
+            pos += len;
+            if (last)
+                break;
+        }
+        m_flowWindow -= (int) count;
+        sm->m_flowWindow -= (int) count;
+        sm->m_vtime = max(sm->m_vtime, m_vtime);
+        m_vtime = sm->m_vtime;
+        sm->m_vtime += sendCost(count, sm->m_weight);
+
+        if (end) {
+            // erase if fully closed
+            if (sm->m_remoteState == HttpStream::kClosed)
+                m_streams.erase(stream);
+            return true;
+        }
+    }
+
+    // Queue the rest to be sent, in turn with any other waiting streams, as
+    // the socket drains and the flow control windows open up.
+    if (auto unsent = dataLen - pos) {
+        sm->m_unsent.append(data, pos, unsent);
+        s_perfCopied += unsent;
+    }
+    if (!more)
+        sm->m_unsentEnd = true;
+    if (!sm->m_unsent.empty() || sm->m_unsentEnd) {
+        queueUnsent(stream, sm);
+        writeUnsent(out, kDataQuantum - count);
     }
     return true;
 }
 
 //===========================================================================
-void HttpConn::writeUnsent(
-    CharBuf * out,
-    int stream,
-    HttpStream * sm
-) {
-    bool more = sm->m_localState != HttpStream::kClosed;
+void HttpConn::queueUnsent(int stream, HttpStream * sm) {
+    if (sm->m_queued)
+        return;
+    sm->m_queued = true;
+    sm->m_vtime = max(sm->m_vtime, m_vtime);
+    m_unsentStreams.push_back(stream);
+}
 
-    size_t dataLen = size(sm->m_unsent);
-    size_t count = dataLen;
-    auto windowAvail = min(m_flowWindow, sm->m_flowWindow);
-    if (windowAvail < dataLen) {
-        if (windowAvail < m_maxOutputFrame)
-            return;
-        count = windowAvail;
-    }
-    size_t pos = 0;
-    while (pos + m_maxOutputFrame < count) {
-        startFrame(out, stream, FrameType::kData, m_maxOutputFrame, {});
-        out->append(sm->m_unsent, pos, m_maxOutputFrame);
-        pos += m_maxOutputFrame;
+//===========================================================================
+// Returns the stream the next data frame should be sent on, or null if
+// there is none that flow control allows. The choice is made by, in order:
+//  - lowest RFC 9218 urgency
+//  - not having an RFC 7540 ancestor that could send instead
+//  - non-incremental streams, one at a time in the order opened
+//  - incremental streams in weighted round-robin
+HttpStream * HttpConn::nextUnsent(int * stream) {
+    auto canSend = [this](const HttpStream & sm) {
+        return sm.m_unsent.empty()
+            ? sm.m_unsentEnd
+            : min(m_flowWindow, sm.m_flowWindow) > 0;
+    };
+
+    // Drop streams that have been reset or have nothing left to send.
+    erase_if(m_unsentStreams, [this](int id) {
+        auto it = m_streams.find(id);
+        if (it == m_streams.end())
+            return true;
+        auto sm = it->second.get();
+        if (!sm->m_unsent.empty() || sm->m_unsentEnd)
+            return false;
+        sm->m_queued = false;
+        return true;
+    });
+
+    HttpStream * best = nullptr;
+    for (auto && id : m_unsentStreams) {
+        auto sm = m_streams[id].get();
+        if (!canSend(*sm))
+            continue;
+        if (best) {
+            auto key = [](int id, const HttpStream & sm) {
+                return tuple(
+                    sm.m_urgency,
+                    sm.m_incremental,
+                    sm.m_incremental ? sm.m_vtime : 0,
+                    id
+                );
+            };
+            if (key(*stream, *best) < key(id, *sm))
+                continue;
+        }
+
+        // Skip streams with an ancestor that is itself able to send.
+        bool blocked = false;
+        auto depth = size(m_streams);
+        for (auto pid = sm->m_parent; pid && depth; --depth) {
+            auto it = m_streams.find(pid);
+            if (it == m_streams.end())
+                break;
+            auto & parent = *it->second;
+            if (parent.m_queued && canSend(parent)) {
+                blocked = true;
+                break;
+            }
+            pid = parent.m_parent;
+        }
+        if (blocked)
+            continue;
+
+        best = sm;
+        *stream = id;
     }
-    if (pos != count || !more && count == dataLen) {
+    return best;
+}
+
+//===========================================================================
+// Sends data frames, one at a time from whichever stream is next, until
+// quantum bytes of payload have been sent or there are none left that flow
+// control allows. Returns true if there are more that could be sent.
+bool HttpConn::writeUnsent(CharBuf * out, size_t quantum) {
+    int stream;
+    while (auto sm = nextUnsent(&stream)) {
+        if (!quantum && !sm->m_unsent.empty())
+            return true;
+        auto count = min({
+            size(sm->m_unsent),
+            (size_t) m_maxOutputFrame,
+            (size_t) max(min(m_flowWindow, sm->m_flowWindow), 0),
+            quantum
+        });
+        bool last = sm->m_unsentEnd && count == size(sm->m_unsent);
         startFrame(
             out,
             stream,
             FrameType::kData,
-            int(count - pos),
-            (!more && count == dataLen) ? fEndStream : (FrameFlags) 0
+            count,
+            last ? fEndStream : (FrameFlags) 0
         );
-        out->append(sm->m_unsent, pos, count - pos);
-        pos = count;
-    }
-
-    m_flowWindow -= (int) count;
-    sm->m_flowWindow -= (int) count;
-    sm->m_unsent.erase(0, count);
-
-    // erase if fully closed and no pending data frames
-    if (sm->m_localState == HttpStream::kClosed
-        && sm->m_unsent.empty()
-        && sm->m_remoteState == HttpStream::kClosed
-    ) {
-        m_streams.erase(stream);
+        out->append(sm->m_unsent, 0, count);
+        s_perfCopied += count;
+        sm->m_unsent.erase(0, count);
+        m_flowWindow -= (int) count;
+        sm->m_flowWindow -= (int) count;
+        m_vtime = sm->m_vtime;
+        sm->m_vtime += sendCost(count, sm->m_weight);
+        quantum -= count;
+
+        if (last) {
+            sm->m_unsentEnd = false;
+            // erase if fully closed
+            if (sm->m_remoteState == HttpStream::kClosed)
+                m_streams.erase(stream);
+        }
     }
+    return false;
 }
 
 //===========================================================================
 // Serializes a request and returns the stream id used
 int HttpConn::request(CharBuf * out, const HttpMsg & msg, bool more) {
-    auto sm = make_shared<HttpStream>();
+    auto sm = allocate_shared<HttpStream>(HttpAlloc<HttpStream>());
     unsigned id = m_nextOutputStream;
     m_nextOutputStream += 2;
     m_streams[id] = sm;
-    writeMsg(out, id, sm.get(), msg, more);
+    writeMsg(out, nullptr, id, sm.get(), msg, more);
     return id;
 }
 
@@ -1508,6 +1798,7 @@ int HttpConn::pushPromise(CharBuf * out, const HttpMsg & msg, bool more) {
 // Serializes a reply on the specified stream
 bool HttpConn::reply(
     CharBuf * out,
+    vector<HttpDataRef> * refs,
     int stream,
     const HttpMsg & msg,
     bool more
@@ -1517,7 +1808,7 @@ bool HttpConn::reply(
         return false;
     HttpStream * sm = it->second.get();
 
-    return writeMsg(out, stream, sm, msg, more);
+    return writeMsg(out, refs, stream, sm, msg, more);
 }
 
 //===========================================================================
@@ -1530,6 +1821,12 @@ void HttpConn::deleteStream(int stream, HttpStream * sm) {
     }
 }
 
+//===========================================================================
+size_t HttpConn::unsent(int stream) const {
+    auto it = m_streams.find(stream);
+    return it == m_streams.end() ? 0 : it->second->m_unsent.size();
+}
+
 
 /****************************************************************************
 *
@@ -1607,9 +1904,21 @@ bool Dim::httpReply(
     int stream,
     const HttpMsg & msg,
     bool more
+) {
+    return httpReply(out, nullptr, conn, stream, msg, more);
+}
+
+//===========================================================================
+bool Dim::httpReply(
+    CharBuf * out,
+    vector<HttpDataRef> * refs,
+    std::shared_ptr<HttpConn> conn,
+    int stream,
+    const HttpMsg & msg,
+    bool more
 ) {
     if (conn)
-        return conn->reply(out, stream, msg, more);
+        return conn->reply(out, refs, stream, msg, more);
     return false;
 }
 
@@ -1620,25 +1929,59 @@ bool Dim::httpData(
     int stream,
     const CharBuf & data,
     bool more
+) {
+    return httpData(out, nullptr, conn, stream, data, more);
+}
+
+//===========================================================================
+bool Dim::httpData(
+    CharBuf * out,
+    std::shared_ptr<HttpConn> conn,
+    int stream,
+    string_view data,
+    bool more
+) {
+    return httpData(out, nullptr, conn, stream, data, more);
+}
+
+//===========================================================================
+bool Dim::httpData(
+    CharBuf * out,
+    vector<HttpDataRef> * refs,
+    std::shared_ptr<HttpConn> conn,
+    int stream,
+    const CharBuf & data,
+    bool more
 ) {
     if (conn)
-        return conn->addData(out, stream, nullptr, data, more);
+        return conn->addData(out, refs, stream, nullptr, data, more);
     return false;
 }
 
 //===========================================================================
 bool Dim::httpData(
     CharBuf * out,
+    vector<HttpDataRef> * refs,
     std::shared_ptr<HttpConn> conn,
     int stream,
     string_view data,
     bool more
 ) {
     if (conn)
-        return conn->addData(out, stream, nullptr, data, more);
+        return conn->addData(out, refs, stream, nullptr, data, more);
     return false;
 }
 
+//===========================================================================
+size_t Dim::httpUnsent(std::shared_ptr<HttpConn> conn, int stream) {
+    return conn ? conn->unsent(stream) : 0;
+}
+
+//===========================================================================
+bool Dim::httpWriteUnsent(CharBuf * out, std::shared_ptr<HttpConn> conn) {
+    return conn ? conn->writeUnsent(out, kDataQuantum) : false;
+}
+
 //===========================================================================
 void Dim::httpResetStream(
     CharBuf * out,
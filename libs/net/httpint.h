@@ -1,17 +1,62 @@
-// Copyright Glen Knowles 2016 - 2025.
+// Copyright Glen Knowles 2016 - 2026.
 // Distributed under the Boost Software License, Version 1.0.
 //
 // httpint.h - dim http
 #pragma once
 
+#include <cstddef>
+#include <deque>
 #include <list>
 #include <memory>
+#include <string>
+#include <string_view>
 #include <unordered_map>
 #include <vector>
 
 namespace Dim {
 
 
+/****************************************************************************
+*
+*   Allocation
+*
+***/
+
+// Small blocks, once freed, are kept on per thread lists by size. The
+// messages, streams, and stream map nodes created for every request are
+// allocated from them, so a busy connection reuses the memory of the ones
+// it's done with instead of going to the global heap.
+void * iHttpAlloc(size_t bytes);
+void iHttpFree(void * ptr, size_t bytes);
+
+template <typename T>
+struct HttpAlloc {
+    using value_type = T;
+
+    HttpAlloc() = default;
+    template <typename U> HttpAlloc(const HttpAlloc<U> &) {}
+
+    T * allocate(size_t num);
+    void deallocate(T * ptr, size_t num);
+
+    template <typename U>
+    bool operator==(const HttpAlloc<U> &) const { return true; }
+};
+
+//===========================================================================
+template <typename T>
+T * HttpAlloc<T>::allocate(size_t num) {
+    static_assert(alignof(T) <= alignof(std::max_align_t));
+    return static_cast<T *>(iHttpAlloc(num * sizeof(T)));
+}
+
+//===========================================================================
+template <typename T>
+void HttpAlloc<T>::deallocate(T * ptr, size_t num) {
+    iHttpFree(ptr, num * sizeof(T));
+}
+
+
 /****************************************************************************
 *
 *   Http connection
@@ -35,6 +80,21 @@ struct HttpStream {
     std::unique_ptr<HttpMsg> m_msg;
     int m_flowWindow{0};
     CharBuf m_unsent;
+    bool m_unsentEnd{false};    // end of stream follows the unsent data
+
+    // Priority, RFC 9218 urgency (0 is most urgent) and incremental flag
+    // along with the RFC 7540 dependency and weight. Streams without an
+    // RFC 9218 signal share bandwidth with their siblings, as they would
+    // under RFC 7540.
+    int m_urgency{3};
+    bool m_incremental{true};
+    int m_parent{0};
+    int m_weight{16};
+
+    // Position in the connection's weighted round-robin of streams with
+    // unsent data, advanced in proportion to bytes sent over weight.
+    uint64_t m_vtime{0};
+    bool m_queued{false};
 
     HttpStream();
     ~HttpStream();
@@ -73,13 +133,21 @@ public:
     // Serializes a push promise
     int pushPromise(CharBuf * out, const HttpMsg & msg, bool more);
 
-    // Serializes a reply on the specified stream
-    bool reply(CharBuf * out, int stream, const HttpMsg & msg, bool more);
+    // Serializes a reply on the specified stream, if refs is not null the
+    // payload of data frames is referenced there instead of copied.
+    bool reply(
+        CharBuf * out,
+        std::vector<HttpDataRef> * refs,
+        int stream,
+        const HttpMsg & msg,
+        bool more
+    );
 
     // Serializes additional data on the stream
     template<typename T>
     bool addData(
         CharBuf * out,
+        std::vector<HttpDataRef> * refs,
         int stream,
         HttpStream * strm,
         const T & data,
@@ -90,6 +158,13 @@ public:
 
     void deleteStream(int stream, HttpStream * sm);
 
+    // Bytes of data on the stream waiting for flow control window.
+    size_t unsent(int stream) const;
+
+    // Sends up to quantum bytes of the queued data, returns true if there's
+    // more that flow control would allow.
+    bool writeUnsent(CharBuf * out, size_t quantum);
+
     std::string_view errmsg() const { return m_errmsg; }
 
 private:
@@ -113,13 +188,23 @@ private:
     HttpStream * findAlways(CharBuf * out, int stream);
     bool writeMsg(
         CharBuf * out,
+        std::vector<HttpDataRef> * refs,
         int stream,
         HttpStream * strm,
         const HttpMsg & msg,
         bool more
     );
-    void writeUnsent(CharBuf * out, int stream, HttpStream * strm);
+    void queueUnsent(int stream, HttpStream * strm);
+    HttpStream * nextUnsent(int * stream);
     bool setInitialWindowSize(CharBuf * out, unsigned value);
+    void updatePriority(
+        int stream,
+        HttpStream * strm,
+        int parent,
+        int weight,
+        bool exclusive
+    );
+    void updatePriority(HttpStream * strm, std::string_view value);
 
     bool onFrame(
         CharBuf * out,
@@ -168,6 +253,13 @@ private:
         int stream,
         EnumFlags<FrameFlags> flags
     );
+    bool onPriorityUpdate(
+        CharBuf * out,
+        std::vector<std::unique_ptr<HttpMsg>> * msgs,
+        const char src[],
+        int stream,
+        EnumFlags<FrameFlags> flags
+    );
     bool onPushPromise(
         CharBuf * out,
         std::vector<std::unique_ptr<HttpMsg>> * msgs,
@@ -218,10 +310,113 @@ private:
     int m_flowWindow{kDefaultWindowSize};
     int m_initialFlowWindow{kDefaultWindowSize};
 
-    std::unordered_map<int, std::shared_ptr<HttpStream>> m_streams;
+    // Streams with unsent data frames, in no particular order, and the
+    // virtual time of the last one scheduled.
+    std::vector<int> m_unsentStreams;
+    uint64_t m_vtime{0};
+
+    std::unordered_map<
+        int,
+        std::shared_ptr<HttpStream>,
+        std::hash<int>,
+        std::equal_to<int>,
+        HttpAlloc<std::pair<const int, std::shared_ptr<HttpStream>>>
+    > m_streams;
     HpackEncode m_encoder;
     HpackDecode m_decoder;
     std::string m_errmsg;
 };
 
+
+/****************************************************************************
+*
+*   Http/1.1 connection
+*
+***/
+
+class Http1Conn : public std::enable_shared_from_this<Http1Conn> {
+public:
+    Http1Conn();
+
+    // Returns false when no more data will be accepted, either because the
+    // connection isn't being kept alive or due to error.
+    bool recv(
+        CharBuf * out,
+        std::vector<std::unique_ptr<HttpMsg>> * msgs,
+        const void * src,
+        size_t srcLen
+    );
+
+    // Serializes a reply to the request
+    bool reply(CharBuf * out, int stream, const HttpMsg & msg, bool more);
+
+    // Serializes additional data of the reply
+    bool addData(CharBuf * out, int stream, std::string_view data, bool more);
+    bool addData(CharBuf * out, int stream, const CharBuf & data, bool more);
+
+    void resetStream(CharBuf * out, int stream, bool internal);
+
+    // Bytes of the reply held for earlier replies to complete.
+    size_t unsent(int stream);
+
+    // True while too many replies are pending, or too much of them is held
+    // back, for more requests to be parsed.
+    bool paused() const;
+
+    bool closed() const { return m_closed; }
+    std::string_view errmsg() const { return m_errmsg; }
+
+private:
+    enum class InputMode : int;
+
+    // Reply to a received request, replies are kept in request order and
+    // sent as those before them complete.
+    struct Reply {
+        int stream{};
+        bool head{};        // HEAD request, reply has no body
+        bool http10{};      // request was HTTP/1.0
+        bool keepAlive{};   // connection continues after the reply
+        bool started{};     // status line and headers serialized
+        bool noBody{};      // body is never sent (HEAD, 1xx, 204, 304)
+        bool chunked{};     // body sent with chunked transfer coding
+        bool done{};        // reply complete
+        CharBuf unsent;     // waiting for earlier replies to complete
+    };
+
+    bool parse(
+        CharBuf * out,
+        std::vector<std::unique_ptr<HttpMsg>> * msgs,
+        std::string_view src,
+        size_t * used
+    );
+    bool onHeaders(CharBuf * out, std::string_view src);
+    void onRequest(std::vector<std::unique_ptr<HttpMsg>> * msgs);
+
+    // Always returns false
+    bool replyError(CharBuf * out, HttpStatus status, std::string_view msg);
+
+    Reply * find(int stream);
+    CharBuf * target(CharBuf * out, Reply * rep);
+    void writeBody(CharBuf * out, Reply * rep, std::string_view data);
+    void endReply(CharBuf * out, Reply * rep);
+    void writeQueued(CharBuf * out);
+
+    // input parsing
+    InputMode m_inputMode;
+    std::string m_input;
+    size_t m_scanned{0};
+    size_t m_remaining{0};
+    size_t m_trailerLen{0};
+    std::unique_ptr<HttpRequest> m_msg;
+    bool m_http10{false};
+    bool m_keepAlive{true};
+    bool m_head{false};
+    int m_nextStream{1};
+
+    // output
+    std::deque<Reply> m_replies;
+    bool m_closed{false};
+    std::string m_errmsg;
+};
+
 } // namespace
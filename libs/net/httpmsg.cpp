@@ -1,4 +1,4 @@
-// Copyright Glen Knowles 2016 - 2024.
+// Copyright Glen Knowles 2016 - 2026.
 // Distributed under the Boost Software License, Version 1.0.
 //
 // httpmsg.cpp - dim http
@@ -15,6 +15,18 @@ using namespace Dim;
 *
 ***/
 
+// Size of the blocks that header names and values are allocated from, and
+// the most of them each thread keeps on its free list for reuse.
+const unsigned kHeapBlockSize = 4096;
+const unsigned kMaxFreeHeapBlocks = 64;
+
+// Blocks allocated by iHttpAlloc are rounded up to a multiple of the
+// granularity, those larger than the max aren't pooled. Each thread keeps
+// at most kMaxFreePoolBlocks of every size.
+const unsigned kPoolGranularity = 16;
+const unsigned kMaxPoolBlockSize = 1024;
+const unsigned kMaxFreePoolBlocks = 256;
+
 
 /****************************************************************************
 *
@@ -22,6 +34,35 @@ using namespace Dim;
 *
 ***/
 
+namespace {
+
+struct HeapBlock {
+    HeapBlock * m_next;
+    unsigned m_avail;
+    unsigned m_reserve;
+};
+
+struct HeapFreeList {
+    HeapBlock * m_first{};
+    unsigned m_count{};
+
+    ~HeapFreeList();
+};
+
+struct PoolBlock {
+    PoolBlock * m_next;
+};
+
+struct PoolFreeList {
+    static constexpr unsigned kSizes = kMaxPoolBlockSize / kPoolGranularity;
+    PoolBlock * m_first[kSizes]{};
+    unsigned m_count[kSizes]{};
+
+    ~PoolFreeList();
+};
+
+} // namespace
+
 
 /****************************************************************************
 *
@@ -109,55 +150,174 @@ const TokenTable s_methodNameTbl(s_methodNames);
 
 /****************************************************************************
 *
-*   HttpMsg::HdrList
+*   Variables
+*
+***/
+
+static thread_local HeapFreeList t_freeBlocks;
+static thread_local PoolFreeList t_pool;
+
+static auto & s_perfAllocs = uperf("http.allocs (global heap)");
+static auto & s_perfReused = uperf("http.allocs (reused)");
+static auto & s_perfFree = uperf("http.allocs (free blocks)");
+
+
+/****************************************************************************
+*
+*   Helpers
 *
 ***/
 
 //===========================================================================
-auto HttpMsg::HdrList::begin() -> ForwardListIterator<HdrName> {
-    return ForwardListIterator<HdrName>{m_firstHeader};
+static uint64_t idBit(HttpHdr id) {
+    return uint64_t{1} << id;
 }
 
 //===========================================================================
-auto HttpMsg::HdrList::end() -> ForwardListIterator<HdrName> {
-    return ForwardListIterator<HdrName>{nullptr};
+static char * alignPtr(HeapBlock * blk, size_t bytes, size_t alignment) {
+    void * ptr = (char *) blk + blk->m_reserve - blk->m_avail;
+    size_t avail = blk->m_avail;
+    if (align(alignment, bytes, ptr, avail)) {
+        blk->m_avail = unsigned(avail - bytes);
+        return (char *) ptr;
+    }
+    return nullptr;
 }
 
+
+/****************************************************************************
+*
+*   HeapFreeList
+*
+***/
+
 //===========================================================================
-auto HttpMsg::HdrList::begin() const -> ForwardListIterator<const HdrName> {
-    return ForwardListIterator<const HdrName>{m_firstHeader};
+HeapFreeList::~HeapFreeList() {
+    while (auto blk = m_first) {
+        m_first = blk->m_next;
+        free(blk);
+    }
+    s_perfFree -= m_count;
 }
 
+
+/****************************************************************************
+*
+*   PoolFreeList
+*
+***/
+
 //===========================================================================
-auto HttpMsg::HdrList::end() const -> ForwardListIterator<const HdrName> {
-    return ForwardListIterator<const HdrName>{nullptr};
+PoolFreeList::~PoolFreeList() {
+    for (auto i = 0; i < kSizes; ++i) {
+        while (auto blk = m_first[i]) {
+            m_first[i] = blk->m_next;
+            ::operator delete(blk);
+        }
+        s_perfFree -= m_count[i];
+    }
 }
 
 
 /****************************************************************************
 *
-*   HttpMsg::HdrName
+*   HttpMsgHeap
 *
 ***/
 
 //===========================================================================
-auto HttpMsg::HdrName::begin() -> ForwardListIterator<HdrValue> {
-    return ForwardListIterator<HdrValue>(&m_value);
+HttpMsgHeap::HttpMsgHeap(HttpMsgHeap && from) noexcept {
+    swap(from);
 }
 
 //===========================================================================
-auto HttpMsg::HdrName::end() -> ForwardListIterator<HdrValue> {
-    return ForwardListIterator<HdrValue>(nullptr);
+HttpMsgHeap::~HttpMsgHeap() {
+    clear();
 }
 
 //===========================================================================
-auto HttpMsg::HdrName::begin() const -> ForwardListIterator<const HdrValue> {
-    return ForwardListIterator<const HdrValue>(&m_value);
+HttpMsgHeap & HttpMsgHeap::operator=(HttpMsgHeap && from) noexcept {
+    clear();
+    swap(from);
+    return *this;
 }
 
 //===========================================================================
-auto HttpMsg::HdrName::end() const -> ForwardListIterator<const HdrValue> {
-    return ForwardListIterator<const HdrValue>(nullptr);
+void HttpMsgHeap::clear() {
+    auto & fl = t_freeBlocks;
+    auto blk = (HeapBlock *) m_buffer;
+    while (blk) {
+        auto next = blk->m_next;
+        if (blk->m_reserve == kHeapBlockSize
+            && fl.m_count < kMaxFreeHeapBlocks
+        ) {
+            blk->m_next = fl.m_first;
+            fl.m_first = blk;
+            fl.m_count += 1;
+            s_perfFree += 1;
+        } else {
+            free(blk);
+        }
+        blk = next;
+    }
+    m_buffer = nullptr;
+}
+
+//===========================================================================
+void HttpMsgHeap::swap(HttpMsgHeap & from) {
+    ::swap(m_buffer, from.m_buffer);
+}
+
+//===========================================================================
+void * HttpMsgHeap::do_allocate(size_t bytes, size_t alignment) {
+    constexpr unsigned kHeaderLen = sizeof(HeapBlock);
+    auto blk = (HeapBlock *) m_buffer;
+    if (blk) {
+        if (auto ptr = alignPtr(blk, bytes, alignment))
+            return ptr;
+    }
+
+    HeapBlock * tmp;
+    auto required = unsigned(bytes + alignment);
+    if (required > (kHeapBlockSize - kHeaderLen) / 3) {
+        // Large allocations get a block of their own that goes behind the
+        // current one, leaving the rest of it for more small ones.
+        tmp = (HeapBlock *) malloc(kHeaderLen + required);
+        assert(tmp != nullptr);
+        s_perfAllocs += 1;
+        tmp->m_avail = required;
+        tmp->m_reserve = kHeaderLen + required;
+        if (blk) {
+            tmp->m_next = blk->m_next;
+            blk->m_next = tmp;
+        } else {
+            tmp->m_next = nullptr;
+            m_buffer = tmp;
+        }
+    } else {
+        auto & fl = t_freeBlocks;
+        if (fl.m_first) {
+            tmp = fl.m_first;
+            fl.m_first = tmp->m_next;
+            fl.m_count -= 1;
+            s_perfFree -= 1;
+            s_perfReused += 1;
+        } else {
+            tmp = (HeapBlock *) malloc(kHeapBlockSize);
+            assert(tmp != nullptr);
+            s_perfAllocs += 1;
+        }
+        tmp->m_next = blk;
+        tmp->m_avail = kHeapBlockSize - kHeaderLen;
+        tmp->m_reserve = kHeapBlockSize;
+        m_buffer = tmp;
+    }
+    return alignPtr(tmp, bytes, alignment);
+}
+
+//===========================================================================
+void HttpMsgHeap::do_deallocate(void * ptr, size_t bytes, size_t alignment) {
+    // Resources freed only when the heap is cleared.
 }
 
 
@@ -167,25 +327,68 @@ auto HttpMsg::HdrName::end() const -> ForwardListIterator<const HdrValue> {
 *
 ***/
 
+//===========================================================================
+HttpMsg::HttpMsg(HttpMsg && from) noexcept {
+    swapBase(from);
+}
+
+//===========================================================================
+HttpMsg & HttpMsg::operator=(HttpMsg && from) noexcept {
+    clear();
+    swapBase(from);
+    return *this;
+}
+
 //===========================================================================
 void HttpMsg::clear() {
-    m_flags = {};
     m_data.clear();
     m_heap.clear();
-    m_firstHeader = nullptr;
+    m_fields = m_inline;
+    m_numFields = 0;
+    m_maxFields = kInlineFields;
+    m_numPseudo = 0;
+    m_ids = 0;
     m_stream = 0;
 }
 
+//===========================================================================
+void * HttpMsg::operator new(size_t bytes) {
+    return iHttpAlloc(bytes);
+}
+
+//===========================================================================
+void HttpMsg::operator delete(void * ptr, size_t bytes) {
+    iHttpFree(ptr, bytes);
+}
+
 //===========================================================================
 void HttpMsg::swap(HttpMsg & other) {
     // You can't swap a request with a response. They have different data and,
     // consequently, different memory layouts.
     assert(isRequest() == other.isRequest());
 
-    ::swap(m_flags, other.m_flags);
+    swapBase(other);
+}
+
+//===========================================================================
+void HttpMsg::swapBase(HttpMsg & other) {
     m_data.swap(other.m_data);
     m_heap.swap(other.m_heap);
-    ::swap(m_firstHeader, other.m_firstHeader);
+
+    // Fields allocated from the heap went with it, inline fields have to be
+    // moved and pointed at in their new home.
+    auto inl = m_fields == m_inline;
+    auto otherInl = other.m_fields == other.m_inline;
+    ::swap(m_inline, other.m_inline);
+    ::swap(m_fields, other.m_fields);
+    if (inl)
+        other.m_fields = other.m_inline;
+    if (otherInl)
+        m_fields = m_inline;
+    ::swap(m_numFields, other.m_numFields);
+    ::swap(m_maxFields, other.m_maxFields);
+    ::swap(m_numPseudo, other.m_numPseudo);
+    ::swap(m_ids, other.m_ids);
     ::swap(m_stream, other.m_stream);
 }
 
@@ -235,70 +438,37 @@ void HttpMsg::addHeader(const char name[], TimePoint time) {
     }
 }
 
-//===========================================================================
-HttpMsg::Flags HttpMsg::toHasFlag(HttpHdr id) const {
-    switch (id) {
-    case kHttp_Status: return fFlagHasStatus;
-    case kHttp_Method: return fFlagHasMethod;
-    case kHttp_Scheme: return fFlagHasScheme;
-    case kHttp_Authority: return fFlagHasAuthority;
-    case kHttp_Path: return fFlagHasPath;
-    default:
-        return {};
-    }
-}
-
 //===========================================================================
 void HttpMsg::addHeaderRef(HttpHdr id, const char name[], const char value[]) {
-    auto ni = m_firstHeader;
-    auto prev = (HdrName *) nullptr;
     auto pseudo = name[0] == ':';
-    for (;;) {
-        if (!ni) {
-            ni = m_heap.emplace<HdrName>();
-            if (pseudo)
-                m_flags |= toHasFlag(id);
-            break;
+    auto pos = pseudo ? m_numPseudo : m_numFields;
+    if (auto fld = findField(id, name)) {
+        // Goes after the last value the header already has.
+        pos = unsigned(fld - m_fields) + 1;
+        while (pos < m_numFields
+            && m_fields[pos].m_id == id
+            && (id || strcmp(m_fields[pos].m_name, name) == 0)
+        ) {
+            pos += 1;
         }
-        if (pseudo && ni->m_name[0] != ':') {
-            auto next = ni;
-            ni = m_heap.emplace<HdrName>();
-            ni->m_next = next;
-            m_flags |= toHasFlag(id);
-            break;
-        }
-        if (ni->m_id == id && (id || strcmp(ni->m_name, name) == 0))
-            goto ADD_VALUE;
-
-        prev = ni;
-        ni = ni->m_next;
     }
 
-    // update new header name info
-    if (!prev) {
-        // only header goes to front of list
-        m_firstHeader = ni;
-    } else {
-        // add regular headers to the back
-        prev->m_next = ni;
-    }
-    ni->m_id = id;
-    ni->m_name = name;
-
-ADD_VALUE:
-    auto vi = ni->m_value.m_prev;
-    if (!vi) {
-        vi = &ni->m_value;
-    } else {
-        vi = m_heap.emplace<HdrValue>();
-        vi->m_next = &ni->m_value;
-        if (auto pv = ni->m_value.m_prev) {
-            vi->m_prev = pv;
-            pv->m_next = vi;
-        }
-        vi->m_next->m_prev = vi;
+    if (m_numFields == m_maxFields) {
+        m_maxFields *= 2;
+        auto fields = m_heap.alloc<HdrField>(m_maxFields);
+        copy_n(m_fields, m_numFields, fields);
+        m_fields = fields;
     }
-    vi->m_value = value;
+    copy_backward(
+        m_fields + pos,
+        m_fields + m_numFields,
+        m_fields + m_numFields + 1
+    );
+    m_fields[pos] = {id, name, value};
+    m_numFields += 1;
+    if (pseudo)
+        m_numPseudo += 1;
+    m_ids |= idBit(id);
 }
 
 //===========================================================================
@@ -326,25 +496,25 @@ const char * HttpMsg::addRef(TimePoint time) {
 
 //===========================================================================
 bool HttpMsg::removeHeader(HttpHdr id, const char name[]) {
-    auto ni = m_firstHeader;
-    auto prev = (HdrName *) nullptr;
-    for (;;) {
-        if (!ni)
-            return false;
-        if (ni->m_id == id && (id || strcmp(ni->m_name, name) == 0))
-            break;
-        prev = ni;
-        ni = ni->m_next;
+    auto first = findField(id, name);
+    if (!first)
+        return false;
+
+    // All values of a header are adjacent.
+    auto pos = unsigned(first - m_fields);
+    auto last = pos + 1;
+    while (last < m_numFields
+        && m_fields[last].m_id == id
+        && (id || strcmp(m_fields[last].m_name, name) == 0)
+    ) {
+        last += 1;
     }
-
-    // Update list to skip header.
+    std::copy(m_fields + last, m_fields + m_numFields, m_fields + pos);
+    m_numFields -= last - pos;
     if (name[0] == ':')
-        m_flags.reset(toHasFlag(id));
-    if (!prev) {
-        m_firstHeader = ni->m_next;
-    } else {
-        prev->m_next = ni->m_next;
-    }
+        m_numPseudo -= last - pos;
+    if (id || !findField(kHttpInvalid, nullptr))
+        m_ids &= ~idBit(id);
     return true;
 }
 
@@ -361,52 +531,56 @@ bool HttpMsg::removeHeader(const char name[]) {
 }
 
 //===========================================================================
-HttpMsg::HdrList HttpMsg::headers() {
-    HdrList hl;
-    hl.m_firstHeader = m_firstHeader;
-    return hl;
+// Returns the first field of the header, headers without ids are matched by
+// name unless the name is null, then the first one is returned.
+const HttpMsg::HdrField * HttpMsg::findField(
+    HttpHdr id,
+    const char name[]
+) const {
+    if (~m_ids & idBit(id))
+        return nullptr;
+    auto last = m_fields + m_numFields;
+    for (auto ptr = m_fields; ptr != last; ++ptr) {
+        if (ptr->m_id == id
+            && (id || !name || strcmp(ptr->m_name, name) == 0)
+        ) {
+            return ptr;
+        }
+    }
+    return nullptr;
 }
 
 //===========================================================================
-const HttpMsg::HdrList HttpMsg::headers() const {
-    HdrList hl;
-    hl.m_firstHeader = m_firstHeader;
-    return hl;
+span<const HttpMsg::HdrField> HttpMsg::headers() const {
+    return {m_fields, m_numFields};
 }
 
 //===========================================================================
-HttpMsg::HdrName HttpMsg::headers(HttpHdr header) {
-    for (auto && hdr : headers()) {
-        if (hdr.m_id == header)
-            return hdr;
+HttpMsg::HdrField HttpMsg::headers(HttpHdr header) const {
+    if (header) {
+        if (auto fld = findField(header, nullptr))
+            return *fld;
     }
     return {};
 }
 
 //===========================================================================
-const HttpMsg::HdrName HttpMsg::headers(HttpHdr header) const {
-    return const_cast<HttpMsg *>(this)->headers(header);
-}
-
-//===========================================================================
-HttpMsg::HdrName HttpMsg::headers(const char name[]) {
-    HttpHdr id = s_hdrNameTbl.find(name, kHttpInvalid);
-    return headers(id);
-}
-
-//===========================================================================
-const HttpMsg::HdrName HttpMsg::headers(const char name[]) const {
-    return const_cast<HttpMsg *>(this)->headers(name);
+HttpMsg::HdrField HttpMsg::headers(const char name[]) const {
+    auto id = s_hdrNameTbl.find(name, kHttpInvalid);
+    if (auto fld = findField(id, name))
+        return *fld;
+    return {};
 }
 
 //===========================================================================
 bool HttpMsg::hasHeader(HttpHdr header) const {
-    return headers(header).m_id;
+    return header && (m_ids & idBit(header));
 }
 
 //===========================================================================
 bool HttpMsg::hasHeader(const char name[]) const {
-    return headers(name).m_id;
+    auto id = s_hdrNameTbl.find(name, kHttpInvalid);
+    return findField(id, name);
 }
 
 //===========================================================================
@@ -439,22 +613,22 @@ void HttpRequest::swap(HttpMsg & other) {
 
 //===========================================================================
 const char * HttpRequest::method() const {
-    return headers(kHttp_Method).begin()->m_value;
+    return headers(kHttp_Method).m_value;
 }
 
 //===========================================================================
 const char * HttpRequest::scheme() const {
-    return headers(kHttp_Scheme).begin()->m_value;
+    return headers(kHttp_Scheme).m_value;
 }
 
 //===========================================================================
 const char * HttpRequest::authority() const {
-    return headers(kHttp_Authority).begin()->m_value;
+    return headers(kHttp_Authority).m_value;
 }
 
 //===========================================================================
 const char * HttpRequest::pathRaw() const {
-    return headers(kHttp_Path).begin()->m_value;
+    return headers(kHttp_Path).m_value;
 }
 
 //===========================================================================
@@ -464,9 +638,10 @@ const HttpQuery & HttpRequest::query() const {
         self->m_query = urlParseHttpPath(pathRaw(), self->heap());
         if (!body().empty()) {
             auto hdr = headers(kHttpContentType);
-            if (auto val = hdr.m_value.m_value;
-                strcmp(val, "application/x-www-form-urlencoded") == 0
-            ) {
+            if (hdr && strcmp(
+                hdr.m_value,
+                "application/x-www-form-urlencoded"
+            ) == 0) {
                 urlAddQueryString(self->m_query, body().c_str(), self->heap());
             }
         }
@@ -476,8 +651,10 @@ const HttpQuery & HttpRequest::query() const {
 
 //===========================================================================
 bool HttpRequest::checkPseudoHeaders() const {
-    return m_flags.all(fFlagHasMethod | fFlagHasScheme | fFlagHasPath)
-        && !m_flags.any(fFlagHasStatus);
+    return hasHeader(kHttp_Method)
+        && hasHeader(kHttp_Scheme)
+        && hasHeader(kHttp_Path)
+        && !hasHeader(kHttp_Status);
 }
 
 //===========================================================================
@@ -507,14 +684,58 @@ HttpResponse::HttpResponse(
 
 //===========================================================================
 int HttpResponse::status() const {
-    auto val = headers(kHttp_Status).begin()->m_value;
+    auto val = headers(kHttp_Status).m_value;
     return strToInt(val);
 }
 
 //===========================================================================
 bool HttpResponse::checkPseudoHeaders() const {
-    return m_flags.all(fFlagHasStatus)
-        && !m_flags.any(fFlagHasMethod | fFlagHasScheme | fFlagHasAuthority);
+    return hasHeader(kHttp_Status)
+        && !hasHeader(kHttp_Method)
+        && !hasHeader(kHttp_Scheme)
+        && !hasHeader(kHttp_Authority);
+}
+
+
+/****************************************************************************
+*
+*   Internal API
+*
+***/
+
+//===========================================================================
+void * Dim::iHttpAlloc(size_t bytes) {
+    if (bytes && bytes <= kMaxPoolBlockSize) {
+        auto i = (bytes - 1) / kPoolGranularity;
+        if (auto blk = t_pool.m_first[i]) {
+            t_pool.m_first[i] = blk->m_next;
+            t_pool.m_count[i] -= 1;
+            s_perfFree -= 1;
+            s_perfReused += 1;
+            return blk;
+        }
+        bytes = (i + 1) * kPoolGranularity;
+    }
+    s_perfAllocs += 1;
+    return ::operator new(bytes);
+}
+
+//===========================================================================
+void Dim::iHttpFree(void * ptr, size_t bytes) {
+    if (!ptr)
+        return;
+    if (bytes && bytes <= kMaxPoolBlockSize) {
+        auto i = (bytes - 1) / kPoolGranularity;
+        if (t_pool.m_count[i] < kMaxFreePoolBlocks) {
+            auto blk = static_cast<PoolBlock *>(ptr);
+            blk->m_next = t_pool.m_first[i];
+            t_pool.m_first[i] = blk;
+            t_pool.m_count[i] += 1;
+            s_perfFree += 1;
+            return;
+        }
+    }
+    ::operator delete(ptr);
 }
 
 
@@ -549,6 +770,122 @@ HttpMethod Dim::httpMethodFromString(string_view name, HttpMethod def) {
     return s_methodNameTbl.find(name, def);
 }
 
+//===========================================================================
+const char * Dim::toReasonPhrase(HttpStatus status) {
+    switch (status) {
+    case kHttpStatusContinue: return "Continue";
+    case kHttpStatusSwitchingProtocols: return "Switching Protocols";
+    case kHttpStatusOk: return "OK";
+    case kHttpStatusCreated: return "Created";
+    case kHttpStatusAccepted: return "Accepted";
+    case kHttpStatusNonAuthoritative: return "Non-Authoritative Information";
+    case kHttpStatusNoContent: return "No Content";
+    case kHttpStatusResetContent: return "Reset Content";
+    case kHttpStatusPartialContent: return "Partial Content";
+    case kHttpStatusMultipleChoices: return "Multiple Choices";
+    case kHttpStatusMovedPermanently: return "Moved Permanently";
+    case kHttpStatusFound: return "Found";
+    case kHttpStatusSeeOther: return "See Other";
+    case kHttpStatusNotModified: return "Not Modified";
+    case kHttpStatusUseProxy: return "Use Proxy";
+    case kHttpStatusTemporaryRedirect: return "Temporary Redirect";
+    case kHttpStatusPermanentRedirect: return "Permanent Redirect";
+    case kHttpStatusBadRequest: return "Bad Request";
+    case kHttpStatusUnauthorized: return "Unauthorized";
+    case kHttpStatusPaymentRequired: return "Payment Required";
+    case kHttpStatusForbidden: return "Forbidden";
+    case kHttpStatusNotFound: return "Not Found";
+    case kHttpStatusMethodNotAllowed: return "Method Not Allowed";
+    case kHttpStatusNotAcceptable: return "Not Acceptable";
+    case kHttpStatusProxyAuthenticationRequired:
+        return "Proxy Authentication Required";
+    case kHttpStatusRequestTimeout: return "Request Timeout";
+    case kHttpStatusConflict: return "Conflict";
+    case kHttpStatusGone: return "Gone";
+    case kHttpStatusLengthRequired: return "Length Required";
+    case kHttpStatusPreconditionFailed: return "Precondition Failed";
+    case kHttpStatusPayloadTooLarge: return "Content Too Large";
+    case kHttpStatusUriTooLong: return "URI Too Long";
+    case kHttpStatusUnsupportedMediaType: return "Unsupported Media Type";
+    case kHttpStatusRangeNotSatisfiable: return "Range Not Satisfiable";
+    case kHttpStatusExpectationFailed: return "Expectation Failed";
+    case kHttpStatusMisdirectedRequest: return "Misdirected Request";
+    case kHttpStatusUpgradeRequired: return "Upgrade Required";
+    case kHttpStatusPreconditionRequired: return "Precondition Required";
+    case kHttpStatusTooManyRequests: return "Too Many Requests";
+    case kHttpStatusRequestHeaderFieldsTooLarge:
+        return "Request Header Fields Too Large";
+    case kHttpStatusUnavailableForLegalReasons:
+        return "Unavailable For Legal Reasons";
+    case kHttpStatusInternalServerError: return "Internal Server Error";
+    case kHttpStatusNotImplemented: return "Not Implemented";
+    case kHttpStatusBadGateway: return "Bad Gateway";
+    case kHttpStatusServiceUnavailable: return "Service Unavailable";
+    case kHttpStatusGatewayTimeout: return "Gateway Timeout";
+    case kHttpStatusHttpVersionNotSupported:
+        return "HTTP Version Not Supported";
+    case kHttpStatusVariantAlsoNegotiates: return "Variant Also Negotiates";
+    case kHttpStatusNotExtended: return "Not Extended";
+    case kHttpStatusNetworkAuthenticationRequired:
+        return "Network Authentication Required";
+    }
+    // The reason phrase is optional, and clients must ignore it anyway.
+    return "";
+}
+
+//===========================================================================
+bool Dim::httpMatchEtag(string_view tags, string_view etag) {
+    for (;;) {
+        auto pos = tags.find(',');
+        auto tag = trim(tags.substr(0, pos));
+        if (tag == "*")
+            return true;
+        if (tag.starts_with("W/"))
+            tag.remove_prefix(2);
+        if (tag == etag)
+            return true;
+        if (pos == string_view::npos)
+            return false;
+        tags.remove_prefix(pos + 1);
+    }
+}
+
+//===========================================================================
+bool Dim::httpParseRange(
+    uint64_t * first,
+    uint64_t * last,
+    string_view val,
+    uint64_t size
+) {
+    if (!val.starts_with("bytes="))
+        return false;
+    val.remove_prefix(6);
+    auto dash = val.find('-');
+    if (dash == string_view::npos || val.find(',') != string_view::npos)
+        return false;
+    auto from = trim(val.substr(0, dash));
+    auto to = trim(val.substr(dash + 1));
+    uint64_t a = 0;
+    uint64_t b = 0;
+    if (from.empty()) {
+        // suffix-range, last b bytes
+        if (!parse(&b, to))
+            return false;
+        if (!b) {
+            *first = size;
+        } else {
+            *first = size - min(b, size);
+            *last = size - 1;
+        }
+        return true;
+    }
+    if (!parse(&a, from) || !to.empty() && (!parse(&b, to) || b < a))
+        return false;
+    *first = a;
+    *last = to.empty() ? size - 1 : min(b, size - 1);
+    return true;
+}
+
 //===========================================================================
 bool httpParse(TimePoint * time, std::string_view val) {
     assert(!"httpTimeFromChar not implemented");
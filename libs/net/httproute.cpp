@@ -1,4 +1,4 @@
-// Copyright Glen Knowles 2017 - 2025.
+// Copyright Glen Knowles 2017 - 2026.
 // Distributed under the Boost Software License, Version 1.0.
 //
 // httproute.cpp - dim net
@@ -15,6 +15,21 @@ using namespace Dim;
 *
 ***/
 
+// Total size of the files kept mapped by the static file cache of each event
+// loop, and the largest file that is kept. Larger files are mapped only while
+// they're being sent.
+const size_t kFileCacheMaxBytes = 64 * 1024 * 1024;
+const size_t kFileCacheMaxFileBytes = 8 * 1024 * 1024;
+
+// Bytes of a file sent per event task, so a large file doesn't hold up
+// replies to other requests. The next window isn't sent until the connection
+// has passed the last one on.
+const size_t kFileReplyWindow = 256 * 1024;
+
+// Distinct Accept-Encoding values, along with the variants that were
+// available, for which each thread remembers the content coding chosen.
+const unsigned kCodingCacheEntries = 4;
+
 
 /****************************************************************************
 *
@@ -24,9 +39,23 @@ using namespace Dim;
 
 namespace {
 
+// Updated by every event loop that routes a request to the path. Kept out of
+// the packed route info, so the atomics keep their natural alignment.
+#pragma pack(push)
+#pragma pack()
+struct RouteStats {
+    atomic<unsigned> matched;
+    atomic<TimePoint> lastMatched;
+};
+#pragma pack(pop)
+
 struct PathInfo : HttpRouteInfo {
     size_t segs {};
 
+    // The matched and lastMatched members of the base are left unset, the
+    // counts are kept here instead.
+    unique_ptr<RouteStats> stats;
+
     // Internal data referenced by other members
     unique_ptr<char[]> data;
     unique_ptr<IHttpRouteNotify> notifyOwned;
@@ -36,11 +65,8 @@ class HttpSocket : public IAppSocketNotify {
 public:
     static void iReply(
         unsigned reqId,
-        const function<void(
-            shared_ptr<HttpConn> conn,
-            CharBuf * out,
-            int stream
-            )> & fn,
+        const function<void(HttpSocket * sock, CharBuf * out, int stream)> &
+            fn,
         bool more
     );
     static void reply(unsigned reqId, HttpResponse && msg, bool more);
@@ -48,26 +74,207 @@ public:
     static void reply(unsigned reqId, CharBuf && data, bool more);
     static void resetReply(unsigned reqId, bool internal);
 
+    // Pushes the task to the event loop of the request once the output
+    // already written for it, and by the socket as a whole, has been sent.
+    static void pushWhenWritable(unsigned reqId, ITaskNotify * task);
+
 public:
     ~HttpSocket ();
+    bool onSocketRead(AppSocketData & data) override;
+    void onSocketBufferChanged(const AppSocketBufferInfo & info) override;
+
+protected:
+    // Protocol specific framing of requests and replies.
+    virtual bool recv(
+        CharBuf * out,
+        vector<unique_ptr<HttpMsg>> * msgs,
+        const void * src,
+        size_t srcLen
+    ) = 0;
+    virtual string_view errmsg() = 0;
+    virtual void writeReply(
+        CharBuf * out,
+        int stream,
+        const HttpMsg & msg,
+        bool more
+    ) = 0;
+    virtual void writeData(
+        CharBuf * out,
+        int stream,
+        string_view data,
+        bool more
+    ) = 0;
+    virtual void writeData(
+        CharBuf * out,
+        int stream,
+        const CharBuf & data,
+        bool more
+    ) = 0;
+    virtual void writeReset(CharBuf * out, int stream, bool internal) = 0;
+
+    // Bytes written to the stream that the protocol is still holding back.
+    virtual size_t unsent(int stream) = 0;
+
+    // Appends the next turn of the held back data, returns true if there's
+    // more ready to go.
+    virtual bool writeUnsent(CharBuf * out) { return false; }
+
+    // True once all replies have been sent and the connection should be
+    // closed.
+    virtual bool closing() { return false; }
+
+    // True while no more input should be read until some of the replies
+    // have been sent.
+    virtual bool recvPaused() { return false; }
+
+    // True while output is waiting for the socket to drain.
+    bool writeWaiting() const { return m_sockWaiting; }
+
+    // Payload referenced, rather than copied, by the output being built.
+    vector<HttpDataRef> m_refs;
+
+private:
+    struct Blocked {
+        int stream;
+        unsigned reqId;
+        ITaskNotify * task;
+    };
+
+    // Returns false if the socket is being disconnected.
+    bool recvAndRoute(string_view data);
+    void write(const CharBuf & out);
+    void sendUnsent();
+    void resumeBlocked();
+    void resumeRecv();
+
+    vector<unsigned> m_reqIds;
+
+    // Tasks waiting for their streams, or the socket, to drain.
+    vector<Blocked> m_blocked;
+    bool m_sockWaiting{false};
+
+    // Reading stopped, by returning false from onSocketRead(), until the
+    // replies catch up with the requests.
+    bool m_recvPaused{false};
+
+    // Messages received by the current read, kept to reuse its capacity.
+    vector<unique_ptr<HttpMsg>> m_msgs;
+};
+
+class Http2Socket : public HttpSocket {
+public:
     bool onSocketAccept(const AppSocketConnectInfo & info) override;
     void onSocketDisconnect() override;
-    bool onSocketRead(AppSocketData & data) override;
 
 private:
+    bool recv(
+        CharBuf * out,
+        vector<unique_ptr<HttpMsg>> * msgs,
+        const void * src,
+        size_t srcLen
+    ) override;
+    string_view errmsg() override;
+    void writeReply(
+        CharBuf * out,
+        int stream,
+        const HttpMsg & msg,
+        bool more
+    ) override;
+    void writeData(
+        CharBuf * out,
+        int stream,
+        string_view data,
+        bool more
+    ) override;
+    void writeData(
+        CharBuf * out,
+        int stream,
+        const CharBuf & data,
+        bool more
+    ) override;
+    void writeReset(CharBuf * out, int stream, bool internal) override;
+    size_t unsent(int stream) override;
+    bool writeUnsent(CharBuf * out) override;
+
     shared_ptr<HttpConn> m_conn;
-    vector<unsigned> m_reqIds;
+};
+
+class Http1Socket : public HttpSocket {
+public:
+    bool onSocketAccept(const AppSocketConnectInfo & info) override;
+    void onSocketDisconnect() override;
+
+private:
+    bool recv(
+        CharBuf * out,
+        vector<unique_ptr<HttpMsg>> * msgs,
+        const void * src,
+        size_t srcLen
+    ) override;
+    string_view errmsg() override;
+    void writeReply(
+        CharBuf * out,
+        int stream,
+        const HttpMsg & msg,
+        bool more
+    ) override;
+    void writeData(
+        CharBuf * out,
+        int stream,
+        string_view data,
+        bool more
+    ) override;
+    void writeData(
+        CharBuf * out,
+        int stream,
+        const CharBuf & data,
+        bool more
+    ) override;
+    void writeReset(CharBuf * out, int stream, bool internal) override;
+    size_t unsent(int stream) override;
+    bool closing() override;
+    bool recvPaused() override;
+
+    shared_ptr<Http1Conn> m_conn;
+};
+
+// Node of the radix trie that routes are compiled into. Each edge is keyed
+// by the characters it consumes, because recursive routes match any path
+// that starts with them, whether or not they end at a segment boundary.
+struct RouteNode {
+    string key;
+
+    // Children, sorted by the first character of their key.
+    vector<pair<char, unsigned>> kids;
+
+    // Routes whose path ends at this node, as positions in s_paths in the
+    // order they were added.
+    vector<unsigned> exact;
+    vector<unsigned> recurse;
+
+    // Union of the methods of the routes in each list, so nodes without
+    // an applicable route are passed over without looking at them.
+    EnumFlags<HttpMethod> exactMethods;
+    EnumFlags<HttpMethod> recurseMethods;
 };
 
 struct RequestInfo {
     HttpSocket * sock {nullptr};
     int stream {0};
     PathInfo * pi {nullptr};
+    TimePoint started;
 
     RequestInfo();
     ~RequestInfo();
 };
 
+// Requests received by the connections of one event loop, only that loop
+// looks at them.
+struct LoopRequests {
+    unordered_map<unsigned, RequestInfo> infos;
+    unsigned nextId{};
+};
+
 } // namespace
 
 
@@ -77,10 +284,14 @@ struct RequestInfo {
 *
 ***/
 
-static vector<PathInfo> s_paths;
+// Routes may be added by any thread, with the lock held exclusively, and are
+// looked up by every event loop. Kept in a deque so the routes of requests in
+// progress stay put as more are added.
+static shared_mutex s_routeMut;
+static deque<PathInfo> s_paths;
+static vector<RouteNode> s_routeNodes;
 static bool s_initialized;
-static unordered_map<unsigned, RequestInfo> s_requests;
-static unsigned s_nextReqId;
+static atomic_size_t s_numRequests;
 
 static auto & s_perfRequests = uperf("http.requests");
 static auto & s_perfCurrent = uperf("http.requests (current)");
@@ -88,7 +299,12 @@ static auto & s_perfInvalid = uperf("http.protocol error");
 static auto & s_perfSuccess = uperf("http.reply success");
 static auto & s_perfError = uperf("http.reply error");
 static auto & s_perfReset = uperf("http.reply canceled");
-static auto & s_perfRejects = uperf("http.http1 requests rejected");
+static auto & s_perfLatency = hperf("http.request latency");
+static auto & s_perfFileHits = uperf("http.file cache hits");
+static auto & s_perfFileMisses = uperf("http.file cache misses");
+static auto & s_perfFileNotModified = uperf("http.file not modified");
+static auto & s_perfFileRanges = uperf("http.file ranges");
+static auto & s_perfFileEncoded = uperf("http.file precompressed");
 
 
 /****************************************************************************
@@ -97,27 +313,128 @@ static auto & s_perfRejects = uperf("http.http1 requests rejected");
 *
 ***/
 
+// The low bits of request ids are the event loop the request belongs to.
+constexpr unsigned kReqLoopMask = kTaskMaxEventLoops - 1;
+static_assert((kTaskMaxEventLoops & kReqLoopMask) == 0);
+
+//===========================================================================
+static LoopRequests & requests() {
+    thread_local LoopRequests t_requests;
+    return t_requests;
+}
+
+//===========================================================================
+static bool inReqLoop(unsigned reqId) {
+    return taskEventLoop() == int(reqId & kReqLoopMask);
+}
+
+//===========================================================================
+static TaskQueueHandle reqQueue(unsigned reqId) {
+    return taskEventLoopQueue(reqId & kReqLoopMask);
+}
+
 //===========================================================================
+// Returns the last added of the routes that also serve any of the methods.
+static PathInfo * findLast(
+    const vector<unsigned> & routes,
+    EnumFlags<HttpMethod> methods
+) {
+    for (auto i = routes.rbegin(); i != routes.rend(); ++i) {
+        auto & pi = s_paths[*i];
+        if (pi.methods.any(methods))
+            return &pi;
+    }
+    return nullptr;
+}
+
+//===========================================================================
+// Of the routes matching the path the best is the longest, and every match
+// is a prefix of the path, so it's also the one with the most segments.
+// When the same path is both a recursive and non-recursive route the
+// non-recursive one is preferred, after that the last added wins.
 static PathInfo * find(string_view path, EnumFlags<HttpMethod> methods) {
+    if (s_routeNodes.empty())
+        return nullptr;
     PathInfo * best = nullptr;
-    for (auto && pi : s_paths) {
-        if (!pi.methods.any(methods))
-            continue;
-        if (path == pi.path
-            || pi.recurse && path.compare(0, pi.path.size(), pi.path) == 0
-        ) {
-            if (!best
-                || pi.segs > best->segs
-                || pi.segs == best->segs && pi.path.size() > best->path.size()
-                || pi.segs == best->segs
-                    && pi.path == best->path
-                    && pi.recurse <= best->recurse
-            ) {
-                best = &pi;
-            }
+    auto node = &s_routeNodes.front();
+    for (;;) {
+        if (path.empty()) {
+            if (node->exactMethods.any(methods))
+                return findLast(node->exact, methods);
+            if (node->recurseMethods.any(methods))
+                return findLast(node->recurse, methods);
+            return best;
         }
+        if (node->recurseMethods.any(methods))
+            best = findLast(node->recurse, methods);
+        auto i = lower_bound(
+            node->kids.begin(),
+            node->kids.end(),
+            path[0],
+            [](auto & kid, char ch) { return kid.first < ch; }
+        );
+        if (i == node->kids.end() || i->first != path[0])
+            return best;
+        node = &s_routeNodes[i->second];
+        if (!path.starts_with(node->key))
+            return best;
+        path.remove_prefix(node->key.size());
+    }
+}
+
+//===========================================================================
+// Adds the route at the position in s_paths to the trie, splitting the edge
+// where its path diverges from those already there.
+static void addRouteNode(unsigned pos) {
+    if (s_routeNodes.empty())
+        s_routeNodes.emplace_back();
+    string_view path = s_paths[pos].path;
+    unsigned ni = 0;
+    while (!path.empty()) {
+        auto & kids = s_routeNodes[ni].kids;
+        auto i = lower_bound(
+            kids.begin(),
+            kids.end(),
+            path[0],
+            [](auto & kid, char ch) { return kid.first < ch; }
+        );
+        if (i == kids.end() || i->first != path[0]) {
+            auto next = (unsigned) s_routeNodes.size();
+            kids.insert(i, {path[0], next});
+            s_routeNodes.emplace_back().key = path;
+            ni = next;
+            break;
+        }
+        auto next = i->second;
+        auto & key = s_routeNodes[next].key;
+        auto len = (size_t) (
+            mismatch(key.begin(), key.end(), path.begin(), path.end()).first
+            - key.begin()
+        );
+        if (len < key.size()) {
+            // Split the edge, the new node takes over the leading part of
+            // the key and the existing one becomes its only child.
+            auto mid = (unsigned) s_routeNodes.size();
+            i->second = mid;
+            auto & split = s_routeNodes.emplace_back();
+            auto & old = s_routeNodes[next];
+            split.key = old.key.substr(0, len);
+            old.key.erase(0, len);
+            split.kids.push_back({old.key[0], next});
+            next = mid;
+        }
+        path.remove_prefix(len);
+        ni = next;
+    }
+    auto & node = s_routeNodes[ni];
+    auto & pi = s_paths[pos];
+    if (pi.recurse) {
+        node.recurse.push_back(pos);
+        node.recurseMethods |= pi.methods;
+    } else {
+        node.exact.push_back(pos);
+        node.exactMethods |= pi.methods;
     }
-    return best;
 }
 
 //===========================================================================
@@ -131,11 +448,15 @@ static void route(RequestInfo * ri, unsigned reqId, HttpRequest & req) {
             break;
         }
     }
-    auto pi = find(params.path, method);
+    PathInfo * pi;
+    {
+        shared_lock lk{s_routeMut};
+        pi = find(params.path, method);
+    }
     if (!pi)
         return httpRouteReplyNotFound(reqId, req);
-    pi->matched += 1;
-    pi->lastMatched = timeNow();
+    pi->stats->matched.fetch_add(1, memory_order_relaxed);
+    pi->stats->lastMatched.store(timeNow(), memory_order_relaxed);
     if (!pi->notify)
         return httpRouteReplyNotFound(reqId, req);
     ri->pi = pi;
@@ -153,9 +474,17 @@ MakeRequestInfo_ReturnType makeRequestInfo(
     HttpSocket * sock,
     int stream
 ) {
+    auto loop = taskEventLoop();
+    assert(loop >= 0);
+    auto & reqs = requests();
     for (;;) {
-        auto id = ++s_nextReqId;
-        auto & found = s_requests[id];
+        // The ids of a loop wrap after every 2^32 / kTaskMaxEventLoops
+        // requests. So those still held by long running requests are passed
+        // over, as is zero, which is never a valid request id.
+        unsigned id = ++reqs.nextId * kTaskMaxEventLoops + loop;
+        if (!id)
+            continue;
+        auto & found = reqs.infos[id];
         if (!found.sock) {
             found.sock = sock;
             found.stream = stream;
@@ -186,6 +515,7 @@ static vector<DefaultHeader> s_defaultHeaders;
 
 //===========================================================================
 static void setDefaultReplyHeader(const DefaultHeader & val) {
+    scoped_lock lk{s_routeMut};
     auto ii = equal_range(
         s_defaultHeaders.begin(),
         s_defaultHeaders.end(),
@@ -207,6 +537,7 @@ static void setDefaultReplyHeader(const DefaultHeader & val) {
 
 //===========================================================================
 static void addDefaultHeaders(HttpResponse & msg) {
+    shared_lock lk{s_routeMut};
     for (auto && h : s_defaultHeaders) {
         if (h.id) {
             if (!msg.hasHeader(h.id))
@@ -226,14 +557,19 @@ static void addDefaultHeaders(HttpResponse & msg) {
 ***/
 
 //===========================================================================
-RequestInfo::RequestInfo() {
+RequestInfo::RequestInfo()
+    : started{timeNow()}
+{
     s_perfRequests += 1;
     s_perfCurrent += 1;
+    s_numRequests += 1;
 }
 
 //===========================================================================
 RequestInfo::~RequestInfo() {
+    s_perfLatency.add(timeNow() - started);
     s_perfCurrent -= 1;
+    s_numRequests -= 1;
 }
 
 
@@ -250,7 +586,7 @@ struct ReplyTask : ITaskNotify {
     ReplyTask(unsigned reqId, bool more);
     void onTask() override;
 
-    function<void(shared_ptr<HttpConn> conn, CharBuf * out, int stream)> fn;
+    function<void(HttpSocket * sock, CharBuf * out, int stream)> fn;
     unsigned reqId;
     T data;
     bool more;
@@ -283,22 +619,19 @@ void ReplyTask<T>::onTask() {
 // static
 void HttpSocket::iReply(
     unsigned reqId,
-    const function<void(
-        shared_ptr<HttpConn> conn,
-        CharBuf * out,
-        int stream
-        )> & fn,
+    const function<void(HttpSocket * sock, CharBuf * out, int stream)> & fn,
     bool more
 ) {
-    auto it = s_requests.find(reqId);
-    if (it == s_requests.end())
+    auto & reqs = requests().infos;
+    auto it = reqs.find(reqId);
+    if (it == reqs.end())
         return;
     auto sock = it->second.sock;
     CharBuf out;
-    fn(sock->m_conn, &out, it->second.stream);
-    socketWrite(sock, out);
+    fn(sock, &out, it->second.stream);
+    sock->write(out);
     if (!more) {
-        s_requests.erase(it);
+        reqs.erase(it);
         auto & ids = sock->m_reqIds;
         for (auto & id : ids) {
             if (reqId < id)
@@ -308,6 +641,11 @@ void HttpSocket::iReply(
             break;
         }
     }
+    if (sock->closing()) {
+        socketDisconnect(sock);
+    } else {
+        sock->resumeRecv();
+    }
 }
 
 //===========================================================================
@@ -324,101 +662,161 @@ void HttpSocket::reply(unsigned reqId, HttpResponse && msg, bool more) {
         msg.addHeader(kHttpDate, now);
     }
 
-    if (taskInEventThread()) {
-        auto fn = [&](shared_ptr<HttpConn> conn, CharBuf * out, int stream) {
-            httpReply(out, conn, stream, msg, more);
+    if (inReqLoop(reqId)) {
+        auto fn = [&](HttpSocket * sock, CharBuf * out, int stream) {
+            sock->writeReply(out, stream, msg, more);
         };
         return iReply(reqId, fn, more);
     }
 
     auto task = new ReplyTask<HttpResponse>(reqId, more);
     task->data = move(msg);
-    task->fn = [task](shared_ptr<HttpConn> conn, CharBuf * out, int stream) {
-        httpReply(out, conn, stream, task->data, task->more);
+    task->fn = [task](HttpSocket * sock, CharBuf * out, int stream) {
+        sock->writeReply(out, stream, task->data, task->more);
     };
-    taskPushEvent(task);
+    taskPush(reqQueue(reqId), task);
 }
 
 //===========================================================================
 // static
 void HttpSocket::reply(unsigned reqId, string_view data, bool more) {
-    if (taskInEventThread()) {
-        auto fn = [&](auto conn, CharBuf * out, int stream) {
-            httpData(out, conn, stream, data, more);
+    if (inReqLoop(reqId)) {
+        auto fn = [&](HttpSocket * sock, CharBuf * out, int stream) {
+            sock->writeData(out, stream, data, more);
         };
         return iReply(reqId, fn, more);
     }
 
     auto task = new ReplyTask<string>(reqId, more);
     task->data = data;
-    task->fn = [task](auto conn, CharBuf * out, int stream) {
-        httpData(out, conn, stream, task->data, task->more);
+    task->fn = [task](HttpSocket * sock, CharBuf * out, int stream) {
+        sock->writeData(out, stream, string_view(task->data), task->more);
     };
-    taskPushEvent(task);
+    taskPush(reqQueue(reqId), task);
 }
 
 //===========================================================================
 // static
 void HttpSocket::reply(unsigned reqId, CharBuf && data, bool more) {
-    if (taskInEventThread()) {
-        auto fn = [&](auto conn, CharBuf * out, int stream) -> void {
-            httpData(out, conn, stream, data, more);
+    if (inReqLoop(reqId)) {
+        auto fn = [&](HttpSocket * sock, CharBuf * out, int stream) {
+            sock->writeData(out, stream, data, more);
         };
         return iReply(reqId, fn, more);
     }
 
     auto task = new ReplyTask<CharBuf>(reqId, more);
     task->data = move(data);
-    task->fn = [task](auto conn, CharBuf * out, int stream) -> void {
-        httpData(out, conn, stream, task->data, task->more);
+    task->fn = [task](HttpSocket * sock, CharBuf * out, int stream) {
+        sock->writeData(out, stream, task->data, task->more);
     };
-    taskPushEvent(task);
+    taskPush(reqQueue(reqId), task);
 }
 
 //===========================================================================
 // static
 void HttpSocket::resetReply(unsigned reqId, bool internal) {
     s_perfReset += 1;
-    auto fn = [&](auto conn, CharBuf * out, int stream) -> void {
-        httpResetStream(out, conn, stream, internal);
+    auto fn = [&](HttpSocket * sock, CharBuf * out, int stream) {
+        sock->writeReset(out, stream, internal);
     };
     iReply(reqId, fn, false);
 }
 
+//===========================================================================
+// static
+void HttpSocket::pushWhenWritable(unsigned reqId, ITaskNotify * task) {
+    auto & reqs = requests().infos;
+    auto it = reqs.find(reqId);
+    if (it == reqs.end())
+        return taskPush(reqQueue(reqId), task);
+    auto sock = it->second.sock;
+    sock->m_blocked.push_back({it->second.stream, reqId, task});
+    sock->resumeBlocked();
+}
+
 //===========================================================================
 HttpSocket::~HttpSocket () {
+    auto & reqs = requests().infos;
     for (auto && id : m_reqIds)
-        s_requests.erase(id);
+        reqs.erase(id);
+
+    // With their requests gone the tasks just clean up after themselves.
+    for (auto && blk : m_blocked)
+        taskPush(reqQueue(blk.reqId), blk.task);
 }
 
 //===========================================================================
-bool HttpSocket::onSocketAccept(const AppSocketConnectInfo & info) {
-    m_conn = httpAccept();
-    return true;
+void HttpSocket::resumeBlocked() {
+    if (m_sockWaiting)
+        return;
+    erase_if(m_blocked, [this](auto & blk) {
+        if (unsent(blk.stream))
+            return false;
+        taskPush(reqQueue(blk.reqId), blk.task);
+        return true;
+    });
 }
 
 //===========================================================================
-void HttpSocket::onSocketDisconnect() {
-    httpClose(m_conn);
-    m_conn = {};
+// Feeds the held back data to the socket a turn at a time for as long as it
+// keeps up. Once it falls behind the rest waits for it to drain, so replies
+// made in the meantime get their turn instead of queuing behind it all.
+void HttpSocket::sendUnsent() {
+    CharBuf out;
+    bool more = true;
+    while (more && !m_sockWaiting) {
+        more = writeUnsent(&out);
+        if (out.empty())
+            break;
+        socketWrite(this, out);
+        out.clear();
+    }
 }
 
 //===========================================================================
-bool HttpSocket::onSocketRead(AppSocketData & data) {
+// Writes the output with the payload it references spliced back in, so the
+// payload goes straight from where the handler left it to the socket.
+void HttpSocket::write(const CharBuf & out) {
+    size_t pos = 0;
+    for (auto && ref : m_refs) {
+        for (auto && v : out.views(pos, ref.pos - pos))
+            socketWrite(this, v);
+        socketWrite(this, ref.data);
+        pos = ref.pos;
+    }
+    m_refs.clear();
+    for (auto && v : out.views(pos))
+        socketWrite(this, v);
+    sendUnsent();
+    if (!m_blocked.empty())
+        resumeBlocked();
+}
+
+//===========================================================================
+// Parses the data, along with any input held back by the protocol, sends
+// what it replies with directly, and routes the requests.
+bool HttpSocket::recvAndRoute(string_view data) {
     CharBuf out;
-    vector<unique_ptr<HttpMsg>> msgs;
-    bool result = httpRecv(&out, &msgs, m_conn, data.data, data.bytes);
+    auto & msgs = m_msgs;
+    bool result = recv(&out, &msgs, data.data(), data.size());
     if (!out.empty())
         socketWrite(this, out);
+    sendUnsent();
+    if (!m_blocked.empty()) {
+        // Flow control updates may have let held back data go out.
+        resumeBlocked();
+    }
     if (!result) {
+        msgs.clear();
         s_perfInvalid += 1;
-        auto em = httpGetError(m_conn);
+        auto em = errmsg();
         if (em.empty())
             em = "no error";
         logMsgDebug() << "HttpSocket: " << em;
-        logHexDebug(string_view{data.data, (size_t) data.bytes}.substr(0, 128));
+        logHexDebug(data.substr(0, 128));
         socketDisconnect(this);
-        return true;
+        return false;
     }
     for (auto && msg : msgs) {
         if (msg->isRequest()) {
@@ -434,9 +832,220 @@ bool HttpSocket::onSocketRead(AppSocketData & data) {
         } else {
         }
     }
+    msgs.clear();
+    return true;
+}
+
+//===========================================================================
+bool HttpSocket::onSocketRead(AppSocketData & data) {
+    if (!recvAndRoute({data.data, (size_t) data.bytes}))
+        return true;
+    if (recvPaused()) {
+        // Too many requests are waiting on their replies, stop reading
+        // until they've been sent.
+        m_recvPaused = true;
+        return false;
+    }
     return true;
 }
 
+//===========================================================================
+// Called as replies are made and the socket drains, reads again once
+// enough of them have been sent.
+void HttpSocket::resumeRecv() {
+    if (!m_recvPaused || recvPaused())
+        return;
+
+    // Requests received, but left unparsed, go first. They may fill the
+    // queue up again before anything more is read.
+    m_recvPaused = false;
+    if (!recvAndRoute({}) || closing())
+        return;
+    if (recvPaused()) {
+        m_recvPaused = true;
+        return;
+    }
+    socketRead(this);
+}
+
+//===========================================================================
+void HttpSocket::onSocketBufferChanged(const AppSocketBufferInfo & info) {
+    m_sockWaiting = info.waiting > 0;
+    sendUnsent();
+    if (!m_blocked.empty())
+        resumeBlocked();
+    resumeRecv();
+}
+
+
+/****************************************************************************
+*
+*   Http2Socket
+*
+***/
+
+//===========================================================================
+bool Http2Socket::onSocketAccept(const AppSocketConnectInfo & info) {
+    m_conn = httpAccept();
+    return true;
+}
+
+//===========================================================================
+void Http2Socket::onSocketDisconnect() {
+    httpClose(m_conn);
+    m_conn = {};
+}
+
+//===========================================================================
+bool Http2Socket::recv(
+    CharBuf * out,
+    vector<unique_ptr<HttpMsg>> * msgs,
+    const void * src,
+    size_t srcLen
+) {
+    return httpRecv(out, msgs, m_conn, src, srcLen);
+}
+
+//===========================================================================
+string_view Http2Socket::errmsg() {
+    return httpGetError(m_conn);
+}
+
+//===========================================================================
+void Http2Socket::writeReply(
+    CharBuf * out,
+    int stream,
+    const HttpMsg & msg,
+    bool more
+) {
+    httpReply(out, &m_refs, m_conn, stream, msg, more);
+}
+
+//===========================================================================
+void Http2Socket::writeData(
+    CharBuf * out,
+    int stream,
+    string_view data,
+    bool more
+) {
+    httpData(out, &m_refs, m_conn, stream, data, more);
+}
+
+//===========================================================================
+void Http2Socket::writeData(
+    CharBuf * out,
+    int stream,
+    const CharBuf & data,
+    bool more
+) {
+    httpData(out, &m_refs, m_conn, stream, data, more);
+}
+
+//===========================================================================
+void Http2Socket::writeReset(CharBuf * out, int stream, bool internal) {
+    httpResetStream(out, m_conn, stream, internal);
+}
+
+//===========================================================================
+size_t Http2Socket::unsent(int stream) {
+    return httpUnsent(m_conn, stream);
+}
+
+//===========================================================================
+bool Http2Socket::writeUnsent(CharBuf * out) {
+    return httpWriteUnsent(out, m_conn);
+}
+
+
+/****************************************************************************
+*
+*   Http1Socket
+*
+***/
+
+//===========================================================================
+bool Http1Socket::onSocketAccept(const AppSocketConnectInfo & info) {
+    m_conn = http1Accept();
+    return true;
+}
+
+//===========================================================================
+void Http1Socket::onSocketDisconnect() {
+    http1Close(m_conn);
+    m_conn = {};
+}
+
+//===========================================================================
+bool Http1Socket::recv(
+    CharBuf * out,
+    vector<unique_ptr<HttpMsg>> * msgs,
+    const void * src,
+    size_t srcLen
+) {
+    // Once the last request has been received the connection is kept open
+    // until the replies to it, and to any requests pipelined ahead of it,
+    // have been sent.
+    http1Recv(out, msgs, m_conn, src, srcLen);
+    return !http1Closed(m_conn);
+}
+
+//===========================================================================
+string_view Http1Socket::errmsg() {
+    return http1GetError(m_conn);
+}
+
+//===========================================================================
+void Http1Socket::writeReply(
+    CharBuf * out,
+    int stream,
+    const HttpMsg & msg,
+    bool more
+) {
+    http1Reply(out, m_conn, stream, msg, more);
+}
+
+//===========================================================================
+void Http1Socket::writeData(
+    CharBuf * out,
+    int stream,
+    string_view data,
+    bool more
+) {
+    http1Data(out, m_conn, stream, data, more);
+}
+
+//===========================================================================
+void Http1Socket::writeData(
+    CharBuf * out,
+    int stream,
+    const CharBuf & data,
+    bool more
+) {
+    http1Data(out, m_conn, stream, data, more);
+}
+
+//===========================================================================
+void Http1Socket::writeReset(CharBuf * out, int stream, bool internal) {
+    http1ResetStream(out, m_conn, stream, internal);
+}
+
+//===========================================================================
+size_t Http1Socket::unsent(int stream) {
+    return http1Unsent(m_conn, stream);
+}
+
+//===========================================================================
+bool Http1Socket::closing() {
+    return http1Closed(m_conn);
+}
+
+//===========================================================================
+// Requests are read no faster than their replies are taken by the client,
+// or replies to a client that pipelines without reading would pile up.
+bool Http1Socket::recvPaused() {
+    return http1Paused(m_conn) || writeWaiting();
+}
+
 
 /****************************************************************************
 *
@@ -468,138 +1077,625 @@ AppSocket::MatchType Http2Match::onMatch(
     if (num == kPrefaceDataLen)
         return AppSocket::kPreferred;
 
-    return AppSocket::kUnknown;
+    return AppSocket::kUnknown;
+}
+
+
+/****************************************************************************
+*
+*   Http1Match
+*
+***/
+
+namespace {
+class Http1Match : public IAppSocketMatchNotify {
+    AppSocket::MatchType onMatch(
+        AppSocket::Family fam,
+        string_view view
+    ) override;
+};
+static Http1Match s_http1Match;
+} // namespace
+
+//===========================================================================
+AppSocket::MatchType Http1Match::onMatch(
+    AppSocket::Family fam,
+    string_view view
+) {
+    assert(fam == AppSocket::kHttp1);
+    auto ptr = view.data();
+    auto eptr = ptr + view.size();
+    while (isupper(*ptr)) {
+        if (++ptr == eptr)
+            return AppSocket::kUnknown;
+    }
+    if (*ptr != ' ')
+        return AppSocket::kUnsupported;
+    if (++ptr == eptr)
+        return AppSocket::kUnknown;
+    while (*ptr != ' ') {
+        if (!isprint(*ptr))
+            return AppSocket::kUnsupported;
+        if (++ptr == eptr)
+            return AppSocket::kUnknown;
+    }
+    ptr += 1;
+    const char kVersion[] = "HTTP/1.";
+    const size_t kVersionLen = size(kVersion) - 1;
+    size_t num = min(kVersionLen, size_t(eptr - ptr));
+    if (memcmp(ptr, kVersion, num) != 0)
+        return AppSocket::kUnsupported;
+    if (num == kVersionLen)
+        return AppSocket::kPreferred;
+
+    return AppSocket::kUnknown;
+}
+
+
+/****************************************************************************
+*
+*   MimeType
+*
+***/
+
+const MimeType s_mimeTypes[] = {
+    { ".css",  "text/css"                         },
+    { ".html", "text/html"                        },
+    { ".jpeg", "image/jpeg"                       },
+    { ".jpg",  "image/jpeg"                       },
+    { ".js",   "text/javascript"                  },
+    { ".png",  "image/png"                        },
+    { ".svg",  "image/svg+xml"                    },
+    { ".tsd",  "application/octet-stream"         },
+    { ".tsl",  "application/octet-stream"         },
+    { ".tsw",  "application/octet-stream"         },
+    { ".xml",  "application/xml",         "utf-8" },
+    { ".xsl",  "application/xslt+xml",    "utf-8" },
+    { ".vue",  "text/javascript"                  },
+};
+const unordered_map<string_view, MimeType> s_mimeTypeMap = []() {
+    unordered_map<string_view, MimeType> out;
+    for (auto&& mt : s_mimeTypes)
+        out[mt.fileExt] = mt;
+    return out;
+}();
+
+//===========================================================================
+auto MimeType::operator<=>(const MimeType & other) const {
+    return fileExt <=> other.fileExt;
+}
+
+//===========================================================================
+MimeType Dim::mimeTypeDefault(string_view path) {
+    Path tmp{path};
+    auto ext = tmp.extension();
+    auto i = s_mimeTypeMap.find(ext);
+    if (i == s_mimeTypeMap.end())
+        return {};
+    return i->second;
+}
+
+
+/****************************************************************************
+*
+*   Content coding negotiation
+*
+***/
+
+namespace {
+
+// Codings of precompressed variants, in order of preference when a client
+// accepts more than one equally.
+enum ContentCoding : unsigned {
+    kCodingBrotli,
+    kCodingGzip,
+    kCodings, // none, the content is sent as is
+};
+
+struct CodingInfo {
+    const char * name;
+    const char * fileExt;
+};
+
+// Remembers the coding chosen for the last few Accept-Encoding values, a
+// client sends the same one with every request.
+class CodingCache {
+public:
+    ContentCoding choose(string_view accept, unsigned avail);
+
+private:
+    struct Entry {
+        string accept;
+        unsigned avail{};
+        ContentCoding coding{kCodings};
+    };
+    Entry m_entries[kCodingCacheEntries];
+    unsigned m_next{};
+};
+
+} // namespace
+
+const CodingInfo s_codings[] = {
+    { "br",   ".br" },
+    { "gzip", ".gz" },
+};
+static_assert(size(s_codings) == kCodings);
+
+//===========================================================================
+// Returns the qvalue, scaled to 0 - 1000, of an Accept-Encoding element's
+// parameters. Anything that isn't a valid qvalue counts as 1.
+static unsigned parseQvalue(string_view params) {
+    for (;;) {
+        auto pos = params.find(';');
+        auto param = trim(params.substr(0, pos));
+        if (param.size() >= 3 && (param[0] | 0x20) == 'q' && param[1] == '=') {
+            param.remove_prefix(2);
+            if (param[0] != '0')
+                return 1000;
+            unsigned q = 0;
+            unsigned scale = 100;
+            if (param.size() > 2 && param[1] == '.') {
+                for (auto ch : param.substr(2, 3)) {
+                    if (ch < '0' || ch > '9')
+                        break;
+                    q += (ch - '0') * scale;
+                    scale /= 10;
+                }
+            }
+            return q;
+        }
+        if (pos == string_view::npos)
+            return 1000;
+        params.remove_prefix(pos + 1);
+    }
+}
+
+//===========================================================================
+// Returns the coding, of those with a bit set in avail, the Accept-Encoding
+// value gives the highest qvalue, or kCodings if none are acceptable.
+static ContentCoding chooseCoding(string_view accept, unsigned avail) {
+    int qvals[kCodings];
+    ranges::fill(qvals, -1);
+    int star = -1;
+    for (;;) {
+        auto pos = accept.find(',');
+        auto elem = accept.substr(0, pos);
+        auto semi = elem.find(';');
+        auto name = trim(elem.substr(0, semi));
+        int q = semi == string_view::npos
+            ? 1000
+            : parseQvalue(elem.substr(semi + 1));
+        if (name == "*") {
+            star = q;
+        } else if (equalNoCase(name, "x-gzip")) {
+            qvals[kCodingGzip] = q;
+        } else {
+            for (unsigned i = 0; i < kCodings; ++i) {
+                if (equalNoCase(name, s_codings[i].name))
+                    qvals[i] = q;
+            }
+        }
+        if (pos == string_view::npos)
+            break;
+        accept.remove_prefix(pos + 1);
+    }
+
+    auto best = kCodings;
+    int bestQ = 0;
+    for (unsigned i = 0; i < kCodings; ++i) {
+        if (~avail & (1u << i))
+            continue;
+        auto q = qvals[i] < 0 ? star : qvals[i];
+        if (q > bestQ) {
+            best = ContentCoding(i);
+            bestQ = q;
+        }
+    }
+    return best;
+}
+
+//===========================================================================
+ContentCoding CodingCache::choose(string_view accept, unsigned avail) {
+    for (auto && ent : m_entries) {
+        if (ent.avail == avail && ent.accept == accept)
+            return ent.coding;
+    }
+    auto & ent = m_entries[m_next];
+    m_next = (m_next + 1) % size(m_entries);
+    ent.accept = accept;
+    ent.avail = avail;
+    ent.coding = chooseCoding(accept, avail);
+    return ent.coding;
+}
+
+//===========================================================================
+// The choice depends only on the request and the variants available, so one
+// cache per thread serves every file without any locking.
+static ContentCoding chooseCachedCoding(string_view accept, unsigned avail) {
+    thread_local CodingCache t_cache;
+    return t_cache.choose(accept, avail);
 }
 
 
 /****************************************************************************
 *
-*   Http1 Rejection
+*   Static file cache
 *
 ***/
 
 namespace {
 
-class Http1Reject : public IAppSocketMatchNotify, public IAppSocketNotify {
-    AppSocket::MatchType onMatch(
-        AppSocket::Family fam,
-        string_view view
-    ) override;
+// File mapped into memory, along with what's needed to validate requests
+// for it without going back to disk.
+struct CachedFile {
+    string path;
+    string dir;             // as reported by the directory monitor
+    FileHandle file;
+    const char * view{};
+    uint64_t size{};
+    TimePoint mtime;
+    string etag;
+    MimeType mimeType;
+    list<shared_ptr<CachedFile>>::iterator lru;
+
+    // Precompressed sidecar files (path + ".br" or ".gz") at least as new
+    // as this one, and their sizes added to this one's, as counted against
+    // the cache limit.
+    shared_ptr<CachedFile> encoded[kCodings];
+    unsigned avail{};   // bit for each coding with a sidecar
+    uint64_t bytes{};
+
+    ~CachedFile();
+};
 
-    bool onSocketAccept(const AppSocketConnectInfo & info) override;
-    bool onSocketRead(AppSocketData & data) override;
+// Invalidates the cached files of monitored directories when they change.
+class FileCacheMonitor : public IFileChangeNotify {
+    void onFileChange(string_view fullpath) override;
+};
 
-private:
-    AppSocketConnectInfo m_info;
+// Files cached by one event loop, only that loop looks at them. Loops that
+// serve the same file each map their own view of it, backed by the same
+// pages.
+struct FileCache {
+    // Most recently used at the front.
+    list<shared_ptr<CachedFile>> lru;
+    unordered_map<string_view, shared_ptr<CachedFile>> files;
+    size_t bytes{};
+};
+
+// Parts of the request that affect the reply, copied so it can be made on
+// the event loop of the request, which has its own cache.
+struct FileRequest {
+    bool head{};
+    string acceptEncoding;
+    string ifNoneMatch;
+    string ifModifiedSince;
+    string range;
+    string ifRange;
+};
+
+// Sends the body of a reply, a window at a time, directly from the view, on
+// the event loop of the request. Each window waits for the one before it to
+// be sent, so a slow client doesn't get the whole file queued up for it.
+struct FileReplyTask : ITaskNotify {
+    void onTask() override;
+
+    unsigned reqId{};
+    shared_ptr<CachedFile> file;
+    uint64_t pos{};
+    uint64_t end{};
 };
 
 } // namespace
 
-static Http1Reject s_http1Match;
+// Monitors of directories with files cached by any of the loops, by
+// directory name as given. Directories that couldn't be monitored keep a null
+// handle, so they aren't tried again by every request for a file in them.
+static mutex s_fileDirMut;
+static unordered_map<string, FileMonitorHandle> s_fileDirs;
+static FileCacheMonitor s_fileCacheMonitor;
 
 //===========================================================================
-AppSocket::MatchType Http1Reject::onMatch(
-    AppSocket::Family fam,
-    string_view view
-) {
-    assert(fam == AppSocket::kHttp1);
-    auto ptr = view.data();
-    auto eptr = ptr + view.size();
-    while (isupper(*ptr)) {
-        if (++ptr == eptr)
-            return AppSocket::kUnknown;
+static FileCache & fileCache() {
+    assert(taskInEventLoop());
+    thread_local FileCache t_cache;
+    return t_cache;
+}
+
+//===========================================================================
+CachedFile::~CachedFile() {
+    if (view)
+        fileCloseView(file, view);
+    if (file)
+        fileClose(file);
+}
+
+//===========================================================================
+static void eraseCachedFile(FileCache & fc, CachedFile * cf) {
+    fc.bytes -= cf->bytes;
+    fc.files.erase(cf->path);
+    fc.lru.erase(cf->lru);
+}
+
+//===========================================================================
+// Every loop drops its own copies of the directory's files.
+void FileCacheMonitor::onFileChange(string_view fullpath) {
+    taskPushEventLoops([dir = string(fullpath)]() {
+        auto & fc = fileCache();
+        for (auto i = fc.lru.begin(); i != fc.lru.end();) {
+            auto cf = (i++)->get();
+            if (cf->dir == dir)
+                eraseCachedFile(fc, cf);
+        }
+    });
+}
+
+//===========================================================================
+// Returns the monitored name of the directory, or an empty string if it
+// can't be monitored, in which case files in it must not be cached.
+static string_view monitorFileDir(string_view path) {
+    scoped_lock lk{s_fileDirMut};
+    auto [it, inserted] = s_fileDirs.try_emplace(
+        string(Path(path).parentPath())
+    );
+    auto & h = it->second;
+    if (inserted
+        && !fileMonitorDir(&h, it->first, false, &s_fileCacheMonitor)
+    ) {
+        logMsgDebug() << "HttpRoute: not caching files in " << it->first;
+        h = {};
     }
-    if (*ptr != ' ')
-        return AppSocket::kUnsupported;
-    if (++ptr == eptr)
-        return AppSocket::kUnknown;
-    while (*ptr != ' ') {
-        if (!isprint(*ptr))
-            return AppSocket::kUnsupported;
-        if (++ptr == eptr)
-            return AppSocket::kUnknown;
+    return h ? fileMonitorPath(h) : string_view{};
+}
+
+//===========================================================================
+static shared_ptr<CachedFile> loadFile(string_view path) {
+    using enum Dim::File::OpenMode;
+
+    auto cf = make_shared<CachedFile>();
+    cf->path = path;
+    if (fileOpen(&cf->file, path, fReadOnly | fDenyNone)
+        || fileSize(&cf->size, cf->file)
+        || fileLastWriteTime(&cf->mtime, cf->file)
+    ) {
+        return {};
+    }
+    if (cf->size
+        && fileOpenView(cf->view, cf->file, File::View::kReadOnly)
+    ) {
+        return {};
     }
-    ptr += 1;
-    const char kVersion[] = "HTTP/1.";
-    const size_t kVersionLen = size(kVersion) - 1;
-    size_t num = min(kVersionLen, size_t(eptr - ptr));
-    if (memcmp(ptr, kVersion, num) != 0)
-        return AppSocket::kUnsupported;
-    if (num == kVersionLen)
-        return AppSocket::kPreferred;
 
-    return AppSocket::kUnknown;
+    // Strong validator, it changes whenever the file is rewritten.
+    cf->etag.append("\"")
+        .append(toHexChars(cf->mtime.time_since_epoch().count()).view())
+        .append("-")
+        .append(toHexChars(cf->size).view())
+        .append("\"");
+    cf->mimeType = mimeTypeDefault(path);
+    cf->bytes = cf->size;
+    return cf;
 }
 
 //===========================================================================
-bool Http1Reject::onSocketAccept(const AppSocketConnectInfo & info) {
-    m_info = info;
-    return true;
+// Attaches the precompressed sidecars of the file. A sidecar older than the
+// file was made from a previous version of it and is ignored.
+static void loadSidecars(CachedFile * cf) {
+    for (unsigned i = 0; i < kCodings; ++i) {
+        auto path = cf->path + s_codings[i].fileExt;
+        bool found = false;
+        if (fileExists(&found, path) || !found)
+            continue;
+        auto sc = loadFile(path);
+        if (!sc || sc->mtime < cf->mtime)
+            continue;
+        cf->bytes += sc->size;
+        cf->encoded[i] = move(sc);
+        cf->avail |= 1u << i;
+    }
 }
 
 //===========================================================================
-bool Http1Reject::onSocketRead(AppSocketData & data) {
-    s_perfRejects += 1;
-
-    const char kBody[] = R"(
-<html><body>
-<h1>505 Version Not Supported</h1>
-<p>This service requires use of the HTTP/2 protocol</p>
-</body></html>
-)";
-    const auto kBodyLen = size(kBody) - 1;
-    ostringstream os;
-    os << "HTTP/1.1 505 Version Not Supported\r\n"
-        "Content-Length: " << kBodyLen << "\r\n"
-        "Content-Type: text/html\r\n"
-        "\r\n"
-        << kBody;
-    socketWrite(this, os.view());
-    return true;
+static shared_ptr<CachedFile> openCachedFile(string_view path) {
+    auto & fc = fileCache();
+    if (auto i = fc.files.find(path); i != fc.files.end()) {
+        s_perfFileHits += 1;
+        auto & cf = i->second;
+        fc.lru.splice(fc.lru.begin(), fc.lru, cf->lru);
+        return cf;
+    }
+
+    s_perfFileMisses += 1;
+    auto cf = loadFile(path);
+    if (!cf)
+        return {};
+    loadSidecars(cf.get());
+
+    if (cf->bytes <= kFileCacheMaxFileBytes) {
+        cf->dir = monitorFileDir(path);
+        if (!cf->dir.empty()) {
+            cf->lru = fc.lru.insert(fc.lru.begin(), cf);
+            fc.files[cf->path] = cf;
+            fc.bytes += cf->bytes;
+            while (fc.bytes > kFileCacheMaxBytes)
+                eraseCachedFile(fc, fc.lru.back().get());
+        }
+    }
+    return cf;
 }
 
+//===========================================================================
+static void closeFileCache() {
+    taskPushEventLoops([]() {
+        auto & fc = fileCache();
+        fc.files.clear();
+        fc.lru.clear();
+        fc.bytes = 0;
+    });
+    scoped_lock lk{s_fileDirMut};
+    for (auto && [dir, h] : s_fileDirs) {
+        if (h)
+            fileMonitorCloseWait(h);
+    }
+    s_fileDirs.clear();
+}
 
-/****************************************************************************
-*
-*   MimeType
-*
-***/
+//===========================================================================
+void FileReplyTask::onTask() {
+    if (!requests().infos.contains(reqId)) {
+        // Request was canceled or its connection is gone.
+        delete this;
+        return;
+    }
+    auto len = min((uint64_t) kFileReplyWindow, end - pos);
+    pos += len;
+    auto more = pos < end;
+    HttpSocket::reply(
+        reqId,
+        string_view(file->view + pos - len, (size_t) len),
+        more
+    );
+    if (more) {
+        HttpSocket::pushWhenWritable(reqId, this);
+    } else {
+        delete this;
+    }
+}
 
-const MimeType s_mimeTypes[] = {
-    { ".css",  "text/css"                         },
-    { ".html", "text/html"                        },
-    { ".jpeg", "image/jpeg"                       },
-    { ".jpg",  "image/jpeg"                       },
-    { ".js",   "text/javascript"                  },
-    { ".png",  "image/png"                        },
-    { ".svg",  "image/svg+xml"                    },
-    { ".tsd",  "application/octet-stream"         },
-    { ".tsl",  "application/octet-stream"         },
-    { ".tsw",  "application/octet-stream"         },
-    { ".xml",  "application/xml",         "utf-8" },
-    { ".xsl",  "application/xslt+xml",    "utf-8" },
-    { ".vue",  "text/javascript"                  },
-};
-const unordered_map<string_view, MimeType> s_mimeTypeMap = []() {
-    unordered_map<string_view, MimeType> out;
-    for (auto&& mt : s_mimeTypes)
-        out[mt.fileExt] = mt;
+//===========================================================================
+static FileRequest makeFileRequest(const HttpRequest & req) {
+    FileRequest out;
+    out.head = req.method() == "HEAD"sv;
+    auto copy = [&req](string * out, HttpHdr id) {
+        if (auto hdr = req.headers(id))
+            *out = hdr.m_value;
+    };
+    copy(&out.acceptEncoding, kHttpAcceptEncoding);
+    copy(&out.ifNoneMatch, kHttpIfNoneMatch);
+    copy(&out.ifModifiedSince, kHttpIfModifiedSince);
+    copy(&out.range, kHttpRange);
+    copy(&out.ifRange, kHttpIfRange);
     return out;
-}();
+}
 
 //===========================================================================
-auto MimeType::operator<=>(const MimeType & other) const {
-    return fileExt <=> other.fileExt;
+static void replyWithFileView(
+    unsigned reqId,
+    const FileRequest & req,
+    shared_ptr<CachedFile> cf,
+    ContentCoding coding
+) {
+    // With precompressed sidecars the reply depends on Accept-Encoding, and
+    // is made from the chosen sidecar, with the original's content type.
+    HttpResponse msg;
+    auto mimeType = cf->mimeType;
+    if (cf->avail) {
+        msg.addHeaderRef(kHttpVary, "accept-encoding");
+        if (coding != kCodings) {
+            s_perfFileEncoded += 1;
+            msg.addHeaderRef(kHttpContentEncoding, s_codings[coding].name);
+            cf = cf->encoded[coding];
+        }
+    }
+
+    string_view lastModified;
+    if (auto lm = msg.addRef(cf->mtime)) {
+        msg.addHeaderRef(kHttpLastModified, lm);
+        lastModified = lm;
+    }
+    msg.addHeaderRef(kHttpETag, cf->etag.c_str());
+    msg.addHeaderRef(kHttpAcceptRanges, "bytes");
+
+    // Dates are only ever compared to what would be sent as the last
+    // modified time, a client that got it from anywhere else gets the whole
+    // file.
+    bool notModified = !req.ifNoneMatch.empty()
+        ? httpMatchEtag(req.ifNoneMatch, cf->etag)
+        : !req.ifModifiedSince.empty() && req.ifModifiedSince == lastModified;
+    if (notModified) {
+        s_perfFileNotModified += 1;
+        msg.addHeaderRef(kHttp_Status, "304");
+        return httpRouteReply(reqId, move(msg));
+    }
+
+    uint64_t first = 0;
+    uint64_t last = cf->size - 1;
+    if (!req.range.empty()
+        && (req.ifRange.empty()
+            || req.ifRange == cf->etag
+            || req.ifRange == lastModified)
+        && httpParseRange(&first, &last, req.range, cf->size)
+    ) {
+        auto cr = "bytes "s;
+        if (first >= cf->size) {
+            msg.addHeaderRef(kHttp_Status, "416");
+            cr.append("*/").append(toChars(cf->size).view());
+            msg.addHeader(kHttpContentRange, cr);
+            return httpRouteReply(reqId, move(msg));
+        }
+        s_perfFileRanges += 1;
+        msg.addHeaderRef(kHttp_Status, "206");
+        cr.append(toChars(first).view())
+            .append("-")
+            .append(toChars(last).view())
+            .append("/")
+            .append(toChars(cf->size).view());
+        msg.addHeader(kHttpContentRange, cr);
+    }
+    if (!msg.hasHeader(kHttp_Status))
+        msg.addHeaderRef(kHttp_Status, "200");
+    if (!mimeType.type.empty()) {
+        auto val = string{mimeType.type};
+        if (!mimeType.charSet.empty()) {
+            val += ";charset=";
+            val += mimeType.charSet;
+        }
+        msg.addHeader(kHttpContentType, val);
+    }
+
+    auto len = cf->size ? last - first + 1 : 0;
+    msg.addHeader(kHttpContentLength, toChars(len).view());
+    if (req.head || len <= kFileReplyWindow) {
+        if (!req.head)
+            msg.body().append(cf->view + first, (size_t) len);
+        return httpRouteReply(reqId, move(msg));
+    }
+
+    // Too big to send at once.
+    httpRouteReply(reqId, move(msg), true);
+    auto task = new FileReplyTask;
+    task->reqId = reqId;
+    task->file = move(cf);
+    task->pos = first;
+    task->end = first + len;
+    task->onTask();
 }
 
 //===========================================================================
-MimeType Dim::mimeTypeDefault(string_view path) {
-    Path tmp{path};
-    auto ext = tmp.extension();
-    auto i = s_mimeTypeMap.find(ext);
-    if (i == s_mimeTypeMap.end())
-        return {};
-    return i->second;
+// Made by the event loop of the request, from that loop's cache.
+static void replyWithCachedFile(
+    unsigned reqId,
+    FileRequest && req,
+    string_view path
+) {
+    if (!inReqLoop(reqId)) {
+        return taskPush(
+            reqQueue(reqId),
+            [reqId, req = move(req), path = string(path)]() mutable {
+                replyWithCachedFile(reqId, move(req), path);
+            }
+        );
+    }
+
+    auto cf = openCachedFile(path);
+    if (!cf) {
+        HttpResponse msg(kHttpStatusNotFound);
+        return httpRouteReply(reqId, move(msg), false);
+    }
+    auto coding = cf->avail
+        ? chooseCachedCoding(req.acceptEncoding, cf->avail)
+        : kCodings;
+    replyWithFileView(reqId, req, move(cf), coding);
 }
 
 
@@ -618,9 +1714,12 @@ static ShutdownNotify s_cleanup;
 
 //===========================================================================
 void ShutdownNotify::onShutdownConsole(bool firstTry) {
-    if (!s_requests.empty())
+    if (s_numRequests)
         return shutdownIncomplete();
+    scoped_lock lk{s_routeMut};
     s_paths.clear();
+    s_routeNodes.clear();
+    closeFileCache();
     s_initialized = false;
 }
 
@@ -633,12 +1732,16 @@ void ShutdownNotify::onShutdownConsole(bool firstTry) {
 
 //===========================================================================
 static void startListen() {
-    sockMgrListen<HttpSocket>(
+    sockMgrListen<Http2Socket>(
         "httpRoute",
         AppSocket::kHttp2,
         AppSocket::fMgrConsole
     );
-    sockMgrListen<Http1Reject>("http1Reject", AppSocket::kHttp1);
+    sockMgrListen<Http1Socket>(
+        "http1Route",
+        AppSocket::kHttp1,
+        AppSocket::fMgrConsole
+    );
 }
 
 //===========================================================================
@@ -646,9 +1749,14 @@ void Dim::iHttpRouteInitialize() {
     shutdownMonitor(&s_cleanup);
     socketAddFamily(AppSocket::kHttp2, &s_http2Match);
     socketAddFamily(AppSocket::kHttp1, &s_http1Match);
-    if (!s_paths.empty())
+    bool listen;
+    {
+        scoped_lock lk{s_routeMut};
+        listen = !s_paths.empty();
+        s_initialized = true;
+    }
+    if (listen)
         startListen();
-    s_initialized = true;
 }
 
 
@@ -746,26 +1854,127 @@ void HttpRouteDirListNotify::onHttpRequest(
 
 namespace {
 
+// Precompressed variants of a file route's content, from the routes of the
+// same path with ".br" or ".gz" appended.
+struct FileVariants {
+    string_view encoded[kCodings];
+    unsigned avail{};   // bit for each coding with a variant
+};
+
 struct FileRouteNotify : IHttpRouteNotify {
     void onHttpRequest(unsigned reqId, HttpRequest & msg) override;
+    void addEncoded(ContentCoding coding, string_view content);
 
     TimePoint m_mtime;
     string_view m_content;
     string_view m_mimeType;
     string_view m_charSet;
+
+    // Variants are added with s_routeMut held, each time as a new set that
+    // is never changed, so event loops replying with an earlier one aren't
+    // disturbed. Replaced sets are kept until the route is destroyed.
+    atomic<const FileVariants *> m_variants{};
+    vector<unique_ptr<FileVariants>> m_variantSets;
 };
 
 } // namespace
 
+//===========================================================================
+static void addFileHeaders(
+    HttpResponse * msg,
+    TimePoint mtime,
+    string_view mimeType,
+    string_view charSet
+) {
+    msg->addHeader(kHttp_Status, "200");
+    msg->addHeader(kHttpLastModified, mtime);
+    if (!mimeType.empty()) {
+        auto val = string{mimeType};
+        if (!charSet.empty()) {
+            val += ";charset=";
+            val += charSet;
+        }
+        msg->addHeader(kHttpContentType, val);
+    }
+}
+
+//===========================================================================
+// Sends the content as data following the headers, rather than copying it
+// into the body. On the event loop of the request it's referenced in place
+// until written to the socket.
+static void replyWithContent(
+    unsigned reqId,
+    HttpResponse && msg,
+    string_view content
+) {
+    msg.addHeader(kHttpContentLength, toChars(content.size()).view());
+    httpRouteReply(reqId, move(msg), true);
+    httpRouteReply(reqId, content, false);
+}
+
 //===========================================================================
 void FileRouteNotify::onHttpRequest(unsigned reqId, HttpRequest & msg) {
-    httpRouteReplyWithFile(
-        reqId,
-        m_mtime,
-        m_content,
-        m_mimeType,
-        m_charSet
-    );
+    HttpResponse res;
+    addFileHeaders(&res, m_mtime, m_mimeType, m_charSet);
+    auto content = m_content;
+    if (auto vars = m_variants.load(memory_order_acquire)) {
+        res.addHeaderRef(kHttpVary, "accept-encoding");
+        auto accept = msg.headers(kHttpAcceptEncoding);
+        auto coding = chooseCachedCoding(
+            accept ? accept.m_value : "",
+            vars->avail
+        );
+        if (coding != kCodings) {
+            res.addHeaderRef(kHttpContentEncoding, s_codings[coding].name);
+            content = vars->encoded[coding];
+        }
+    }
+    replyWithContent(reqId, move(res), content);
+}
+
+//===========================================================================
+void FileRouteNotify::addEncoded(ContentCoding coding, string_view content) {
+    auto vars = m_variantSets.empty()
+        ? make_unique<FileVariants>()
+        : make_unique<FileVariants>(*m_variantSets.back());
+    vars->encoded[coding] = content;
+    vars->avail |= 1u << coding;
+    m_variants.store(vars.get(), memory_order_release);
+    m_variantSets.push_back(move(vars));
+}
+
+//===========================================================================
+// Returns the file route with exactly the path, if there is one.
+static FileRouteNotify * findFileRoute(string_view path) {
+    auto pi = find(path, fHttpMethodGet);
+    if (!pi || pi->path != path)
+        return nullptr;
+    return dynamic_cast<FileRouteNotify *>(pi->notify);
+}
+
+//===========================================================================
+// Connects a newly added file route with its precompressed variants, or,
+// if it's a variant, with the route it's a variant of. Whichever is added
+// first, they end up linked.
+static void linkFileRoute(const PathInfo & pi) {
+    auto notify = dynamic_cast<FileRouteNotify *>(pi.notify);
+    if (!notify)
+        return;
+    auto path = pi.path;
+    for (unsigned i = 0; i < kCodings; ++i) {
+        if (path.ends_with(s_codings[i].fileExt)) {
+            path.remove_suffix(strlen(s_codings[i].fileExt));
+            if (auto base = findFileRoute(path))
+                base->addEncoded(ContentCoding(i), notify->m_content);
+            return;
+        }
+    }
+    string sidecar;
+    for (unsigned i = 0; i < kCodings; ++i) {
+        sidecar.assign(path).append(s_codings[i].fileExt);
+        if (auto var = findFileRoute(sidecar))
+            notify->addEncoded(ContentCoding(i), var->m_content);
+    }
 }
 
 
@@ -788,7 +1997,7 @@ struct AliasRouteNotify : IHttpRouteNotify {
 
 //===========================================================================
 void AliasRouteNotify::onHttpRequest(unsigned reqId, HttpRequest & msg) {
-    auto & ri = s_requests[reqId];
+    auto & ri = requests().infos[reqId];
     string opath = msg.pathRaw();
     opath.replace(0, ri.pi->path.size(), m_path);
     msg.removeHeader(kHttp_Method);
@@ -810,24 +2019,27 @@ static void routeAdd(PathInfo && pi) {
     assert(!pi.path.empty());
     assert(!pi.matched && empty(pi.lastMatched));
 
-    if (!taskInEventThread()) {
-        struct RouteAddTask : ITaskNotify {
-            PathInfo m_pi;
+    pi.stats = make_unique<RouteStats>();
+    bool listen;
+    {
+        scoped_lock lk{s_routeMut};
+        listen = s_paths.empty() && s_initialized;
+        s_paths.emplace_back(move(pi));
 
-            void onTask() override {
-                routeAdd(move(m_pi));
-                delete this;
-            }
-        };
-        auto fn = new RouteAddTask;
-        fn->m_pi = move(pi);
-        taskPushEvent(fn);
-        return;
+        // Linked first, so a file route is found with its variants in place.
+        linkFileRoute(s_paths.back());
+        addRouteNode(unsigned(s_paths.size() - 1));
     }
 
-    if (s_paths.empty() && s_initialized)
-        startListen();
-    s_paths.emplace_back(move(pi));
+    // Socket managers are set up by the event thread, this happens once, for
+    // the first route.
+    if (listen) {
+        if (taskInEventThread()) {
+            startListen();
+        } else {
+            taskPushEvent(startListen);
+        }
+    }
 }
 
 //===========================================================================
@@ -934,6 +2146,22 @@ void Dim::httpRouteAddFileRef(
     addFileRouteRefs({}, path, mtime, content, mimeType, charSet);
 }
 
+//===========================================================================
+void Dim::httpRouteAddFileEncodingRef(
+    string_view path,
+    string_view encoding,
+    string_view content
+) {
+    for (unsigned i = 0; i < kCodings; ++i) {
+        if (encoding == s_codings[i].name) {
+            scoped_lock lk{s_routeMut};
+            if (auto notify = findFileRoute(path))
+                notify->addEncoded(ContentCoding(i), content);
+            return;
+        }
+    }
+}
+
 
 /****************************************************************************
 *
@@ -941,14 +2169,25 @@ void Dim::httpRouteAddFileRef(
 *
 ***/
 
+//===========================================================================
+// Copy of the route with its counts, which other event loops may be updating.
+static HttpRouteInfo routeInfo(const PathInfo & pi) {
+    HttpRouteInfo out = pi;
+    if (pi.stats) {
+        out.matched = pi.stats->matched.load(memory_order_relaxed);
+        out.lastMatched = pi.stats->lastMatched.load(memory_order_relaxed);
+    }
+    return out;
+}
+
 //===========================================================================
 HttpRouteInfo Dim::httpRouteGetInfo(unsigned reqId) {
-    assert(taskInEventThread());
+    assert(inReqLoop(reqId));
     HttpRouteInfo ri = {};
-    auto it = s_requests.find(reqId);
-    if (it != s_requests.end()) {
-        auto pi = it->second.pi;
-        ri = *pi;
+    auto & reqs = requests().infos;
+    auto it = reqs.find(reqId);
+    if (it != reqs.end()) {
+        ri = routeInfo(*it->second.pi);
     }
     return ri;
 }
@@ -977,7 +2216,7 @@ void Dim::httpRouteReply(unsigned reqId, string_view view, bool more) {
 
 //===========================================================================
 static void routeReset(unsigned reqId, bool internal) {
-    if (taskInEventThread())
+    if (inReqLoop(reqId))
         return HttpSocket::resetReply(reqId, internal);
 
     struct Task : ITaskNotify {
@@ -991,7 +2230,7 @@ static void routeReset(unsigned reqId, bool internal) {
     auto task = new Task;
     task->m_reqId = reqId;
     task->m_internal = internal;
-    taskPushEvent(task);
+    taskPush(reqQueue(reqId), task);
 }
 
 //===========================================================================
@@ -1164,35 +2403,17 @@ struct ReplyWithFileNotify : IFileReadNotify {
 } // namespace
 
 //===========================================================================
-static void addFileHeaders(
-    HttpResponse * msg,
-    TimePoint mtime,
-    string_view mimeType,
-    string_view charSet
-) {
-    msg->addHeader(kHttp_Status, "200");
-    msg->addHeader(kHttpLastModified, mtime);
-    if (!mimeType.empty()) {
-        auto val = string{mimeType};
-        if (!charSet.empty()) {
-            val += ";charset=";
-            val += charSet;
-        }
-        msg->addHeader(kHttpContentType, val);
-    }
+void Dim::httpRouteReplyWithFile(unsigned reqId, string_view path) {
+    replyWithCachedFile(reqId, {}, path);
 }
 
 //===========================================================================
-void Dim::httpRouteReplyWithFile(unsigned reqId, string_view path) {
-    using enum Dim::File::OpenMode;
-
-    FileHandle file;
-    auto ec = fileOpen(&file, path, fReadOnly | fDenyNone);
-    if (ec) {
-        HttpResponse msg(kHttpStatusNotFound);
-        return httpRouteReply(reqId, move(msg), false);
-    }
-    return httpRouteReplyWithFile(reqId, file);
+void Dim::httpRouteReplyWithFile(
+    unsigned reqId,
+    const HttpRequest & req,
+    string_view path
+) {
+    replyWithCachedFile(reqId, makeFileRequest(req), path);
 }
 
 //===========================================================================
@@ -1225,8 +2446,7 @@ void Dim::httpRouteReplyWithFile(
 ) {
     HttpResponse msg;
     addFileHeaders(&msg, mtime, mimeType, charSet);
-    msg.body() = content;
-    httpRouteReply(reqId, move(msg));
+    replyWithContent(reqId, move(msg), content);
 }
 
 
@@ -1238,13 +2458,23 @@ void Dim::httpRouteReplyWithFile(
 
 //===========================================================================
 vector<HttpRouteInfo> Dim::httpRouteGetRoutes() {
-    assert(taskInEventThread());
+    assert(taskInEventLoop());
+    shared_lock lk{s_routeMut};
     vector<HttpRouteInfo> out;
     for (auto&& p : s_paths)
-        out.emplace_back(p);
+        out.push_back(routeInfo(p));
     return out;
 }
 
+//===========================================================================
+HttpRouteInfo Dim::httpRouteFind(string_view path, HttpMethod method) {
+    assert(taskInEventLoop());
+    shared_lock lk{s_routeMut};
+    if (auto pi = find(path, method))
+        return routeInfo(*pi);
+    return {};
+}
+
 //===========================================================================
 void Dim::httpRouteWrite(
     IJBuilder * out,
@@ -103,6 +103,9 @@ void httpRouteAdd(const HttpRouteInfo & route);
 void httpRouteAdd(std::initializer_list<HttpRouteInfo> routes);
 void httpRouteAdd(std::span<const HttpRouteInfo> routes);
 
+// Routes added for the same path with ".br" or ".gz" appended are taken to
+// be precompressed versions of the file. They're sent in its place, along
+// with Content-Encoding and Vary, to clients whose Accept-Encoding allows.
 void httpRouteAddFile(
     std::string_view path,
     TimePoint mtime,
@@ -117,6 +120,13 @@ void httpRouteAddFileRef(
     std::string_view mimeType = {},
     std::string_view charSet = {}
 );
+// Adds a precompressed version of a file route's content. The encoding is
+// "br" or "gzip", and the route must already have been added.
+void httpRouteAddFileEncodingRef(
+    std::string_view path,
+    std::string_view encoding,
+    std::string_view content
+);
 void httpRouteAddAlias(
     const HttpRouteInfo & alias,
     std::string_view targetPath,
@@ -289,6 +299,15 @@ void httpRouteCancel(unsigned reqId);
 void httpRouteInternalError(unsigned reqId);
 
 void httpRouteReplyWithFile(unsigned reqId, std::string_view path);
+
+// Replies from the static file cache, honoring conditional (If-None-Match,
+// If-Modified-Since) and Range requests. A precompressed sidecar of the file
+// (path + ".br" or ".gz") is sent instead if Accept-Encoding allows.
+void httpRouteReplyWithFile(
+    unsigned reqId,
+    const HttpRequest & req,
+    std::string_view path
+);
 void httpRouteReplyWithFile(unsigned reqId, Dim::FileHandle file);
 void httpRouteReplyWithFile(
     unsigned reqId,
@@ -345,6 +364,10 @@ struct MimeType {
 MimeType mimeTypeDefault(std::string_view path);
 
 std::vector<HttpRouteInfo> httpRouteGetRoutes();
+
+// Returns the route a request for the path would be dispatched to, or an
+// empty route if there isn't one.
+HttpRouteInfo httpRouteFind(std::string_view path, HttpMethod method);
 void httpRouteWrite(
     IJBuilder * out,
     const HttpRouteInfo & ri,
@@ -1,4 +1,4 @@
-// Copyright Glen Knowles 2016 - 2021.
+// Copyright Glen Knowles 2016 - 2026.
 // Distributed under the Boost Software License, Version 1.0.
 //
 // pch.h - dim net
@@ -17,6 +17,7 @@
 
 // Standard headers
 #include <algorithm>
+#include <atomic>
 #include <cassert>
 #include <cstring>
 #include <deque>
@@ -28,6 +29,8 @@
 #include <ostream>
 #include <ranges>
 #include <shared_mutex>
+#include <string_view>
+#include <unordered_map>
 #include <vector>
 
 // Platform headers
@@ -1,4 +1,4 @@
-// Copyright Glen Knowles 2015 - 2025.
+// Copyright Glen Knowles 2015 - 2026.
 // Distributed under the Boost Software License, Version 1.0.
 //
 // socket.h - dim net
@@ -131,6 +131,9 @@ std::string_view toString(ISocketNotify::Mode mode);
 *       1. onSocketConnectFailed
 *       2. onSocketDestroy
 *
+*   Must be called from the event thread, which is also where the callbacks
+*   are made.
+*
 ***/
 
 //===========================================================================
@@ -159,6 +162,13 @@ void socketConnect(
 *       3. onSocketDisconnect
 *       4. onSocketDestroy
 *
+*   Accepted sockets are dealt out in turn to the event loops, see
+*   taskSetEventLoops(). The notifier is constructed on the loop the socket
+*   was given to, all of its callbacks are made there, and all calls for it
+*   must be made from there.
+*
+*   Listening must be started and stopped from the event thread.
+*
 ***/
 
 //===========================================================================
@@ -18,6 +18,57 @@ using namespace Dim;
 static HandleMap<SockMgrHandle, ISockMgrBase> s_mgrs;
 
 
+/****************************************************************************
+*
+*   SockMgrLoop
+*
+***/
+
+//===========================================================================
+void SockMgrLoop::touch(ISockMgrSocket * sock) {
+    sock->m_lastTouched = timeNow();
+    unique_lock lk{m_mut};
+    auto first = !m_socks;
+    m_socks.link(sock);
+    lk.unlock();
+    if (first)
+        timerUpdate(this, m_mgr.m_inactiveTimeout);
+}
+
+//===========================================================================
+void SockMgrLoop::unlink(ISockMgrSocket * sock) {
+    scoped_lock lk{m_mut};
+    m_socks.unlink(sock);
+}
+
+//===========================================================================
+void SockMgrLoop::updateTimer() {
+    unique_lock lk{m_mut};
+    if (auto sock = m_socks.front()) {
+        auto wait = sock->m_lastTouched + m_mgr.m_inactiveTimeout.load() - timeNow();
+        lk.unlock();
+        timerUpdate(this, wait);
+    }
+}
+
+//===========================================================================
+Duration SockMgrLoop::onTimer(TimePoint now) {
+    auto expire = now - m_mgr.m_inactiveTimeout.load();
+    unique_lock lk{m_mut};
+    while (auto sock = m_socks.front()) {
+        auto wait = sock->m_lastTouched - expire;
+        if (wait > 0s)
+            return wait;
+        sock->m_lastTouched = now;
+        m_socks.link(sock);
+        lk.unlock();
+        sock->onTimer(now);
+        lk.lock();
+    }
+    return kTimerInfinite;
+}
+
+
 /****************************************************************************
 *
 *   ISockMgrSocket
@@ -31,7 +82,17 @@ ISockMgrSocket::ISockMgrSocket(
 )
     : IAppSocket(notify.release())
     , m_mgr(mgr)
-{}
+{
+    // Counted from the start, not from when it's first touched, so the
+    // manager outlives sockets that are still being accepted on other loops.
+    m_mgr.m_numSockets += 1;
+}
+
+//===========================================================================
+ISockMgrSocket::~ISockMgrSocket() {
+    m_mgr.unlink(this);
+    m_mgr.m_numSockets -= 1;
+}
 
 //===========================================================================
 SocketInfo ISockMgrSocket::getInfo() const {
@@ -87,7 +148,8 @@ ISockMgrBase::ISockMgrBase(
     , m_cliSockFact{fact}
     , m_family{fam}
     , m_mgrFlags{flags}
-    , m_inactivity{inactiveTimeout}
+    , m_inactiveTimeout{inactiveTimeout}
+    , m_inactiveMinWait{min(kTimerDefaultMinWait, inactiveTimeout)}
 {}
 
 //===========================================================================
@@ -97,22 +159,50 @@ void ISockMgrBase::init() {
 
 //===========================================================================
 ISockMgrBase::~ISockMgrBase() {
-    assert(!m_inactivity.values());
+    assert(!m_numSockets);
+    for (auto && ptr : m_loops)
+        delete ptr.load();
+}
+
+//===========================================================================
+// Inactivity list of the current event loop.
+SockMgrLoop & ISockMgrBase::loop() {
+    auto i = taskEventLoop();
+    assert(i >= 0);
+    auto ptr = m_loops[i].load();
+    if (!ptr) {
+        // Created here, so that its timer fires on this loop.
+        ptr = new SockMgrLoop(*this);
+        m_loops[i] = ptr;
+    }
+    return *ptr;
 }
 
 //===========================================================================
 void ISockMgrBase::touch(ISockMgrSocket * sock) {
-    m_inactivity.touch(sock);
+    if (!sock->m_loop) {
+        sock->m_loop = &loop();
+    }
+    assert(sock->m_loop == &loop());
+    sock->m_loop->touch(sock);
 }
 
 //===========================================================================
 void ISockMgrBase::unlink(ISockMgrSocket * sock) {
-    m_inactivity.unlink(sock);
+    if (auto ptr = sock->m_loop) {
+        ptr->unlink(sock);
+        sock->m_loop = nullptr;
+    }
 }
 
 //===========================================================================
 void ISockMgrBase::setInactiveTimeout(Duration timeout) {
-    m_inactivity.setTimeout(timeout);
+    m_inactiveTimeout = timeout;
+    m_inactiveMinWait = min(kTimerDefaultMinWait, timeout);
+    taskPushEventLoops([this]() {
+        if (auto ptr = m_loops[taskEventLoop()].load())
+            ptr->updateTimer();
+    });
 }
 
 //===========================================================================
@@ -136,8 +226,8 @@ SockMgrInfo ISockMgrBase::info() const {
     out.addrs = m_addrs;
     out.mgrFlags = m_mgrFlags;
     out.confFlags = m_confFlags;
-    out.inactiveTimeout = m_inactivity.timeout();
-    out.inactiveMinWait = m_inactivity.minWait();
+    out.inactiveTimeout = m_inactiveTimeout;
+    out.inactiveMinWait = m_inactiveMinWait;
     return out;
 }
 
@@ -146,16 +236,24 @@ size_t Dim::ISockMgrBase::getSockInfos(
     vector<SocketInfo> * out,
     size_t limit
 ) const {
+    // Sockets of other event loops may be active while their info is read,
+    // it's only a snapshot for reporting.
     size_t found = 0;
-    for (auto&& sock : m_inactivity.values()) {
-        if (limit) {
-            limit -= 1;
-            auto & info = out->emplace_back(sock.getInfo());
-            info.dir = listening()
-                ? SocketDir::kInbound
-                : SocketDir::kOutbound;
+    for (auto && ptr : m_loops) {
+        auto loop = ptr.load();
+        if (!loop)
+            continue;
+        scoped_lock lk{loop->m_mut};
+        for (auto&& sock : loop->m_socks) {
+            if (limit) {
+                limit -= 1;
+                auto & info = out->emplace_back(sock.getInfo());
+                info.dir = listening()
+                    ? SocketDir::kInbound
+                    : SocketDir::kOutbound;
+            }
+            found += 1;
         }
-        found += 1;
     }
     return found;
 }
@@ -62,7 +62,6 @@ public:
     AcceptManager & mgr() override;
     void disconnect(AppSocket::Disconnect why) override;
 
-    // Inherited via ITimerListNotify
     void onTimer(TimePoint now) override;
 
     // Inherited via IAppSocketNotify
@@ -165,10 +164,15 @@ bool AcceptManager::onShutdown(bool firstTry) {
     if (firstTry) {
         for (auto&& addr : m_addrs)
             socketCloseWait(this, addr, m_family);
-        for (auto&& sock : m_inactivity.values())
-            sock.disconnect(AppSocket::Disconnect::kAppRequest);
+        // Sockets are disconnected by the event loops they belong to.
+        taskPushEventLoops([this]() {
+            if (auto loop = m_loops[taskEventLoop()].load()) {
+                for (auto&& sock : loop->m_socks)
+                    sock.disconnect(AppSocket::Disconnect::kAppRequest);
+            }
+        });
     }
-    return !m_inactivity.values();
+    return !m_numSockets;
 }
 
 //===========================================================================
@@ -85,8 +85,9 @@ public:
     // Inherited via ISockMgrSocket
     ConnectManager & mgr() override;
 
-    // Inherited via ITimerListNotify
     void onTimer(TimePoint now) override;
+
+    // Inherited via ITimerListNotify
     void onTimer(TimePoint now, RecentLink*) override;
 
     // Inherited via IAppSocket
@@ -22,9 +22,10 @@ enum ConfFlags : unsigned {
 }
 
 class ISockMgrBase;
+class SockMgrLoop;
 
 class ISockMgrSocket
-    : public ITimerListNotify<>
+    : public ListLink<>
     , public IAppSocket
     , public IAppSocketNotify
 {
@@ -33,9 +34,14 @@ public:
         ISockMgrBase & mgr,
         std::unique_ptr<IAppSocketNotify> notify
     );
+    ~ISockMgrSocket();
 
     virtual ISockMgrBase & mgr() { return m_mgr; }
 
+    // Called when the socket hasn't been touched for the inactivity timeout
+    // of its manager.
+    virtual void onTimer(TimePoint now) = 0;
+
     // Inherited via IAppSocket
     SocketInfo getInfo() const override;
     void disconnect(AppSocket::Disconnect why) override = 0;
@@ -50,7 +56,14 @@ public:
     void onSocketBufferChanged(const AppSocketBufferInfo & info) override;
 
 private:
+    friend class ISockMgrBase;
+    friend class SockMgrLoop;
     ISockMgrBase & m_mgr;
+
+    // Inactivity list of the event loop the socket belongs to, set when it
+    // is first touched.
+    SockMgrLoop * m_loop{};
+    TimePoint m_lastTouched;
 };
 
 class ISockMgrBase : public IConfigNotify, public HandleContent {
@@ -89,7 +102,37 @@ protected:
     EnumFlags<AppSocket::ConfFlags> m_confFlags;
 
     RunMode m_mode{kRunRunning};
-    TimerList<ISockMgrSocket> m_inactivity;
+
+    // Each event loop keeps its own sockets, ordered by when they were last
+    // touched, created by the loop the first time it touches one.
+    std::atomic<SockMgrLoop *> m_loops[kTaskMaxEventLoops] = {};
+    std::atomic_size_t m_numSockets;
+    std::atomic<Duration> m_inactiveTimeout;
+    std::atomic<Duration> m_inactiveMinWait;
+
+private:
+    friend class ISockMgrSocket;
+    friend class SockMgrLoop;
+    SockMgrLoop & loop();
+};
+
+// Sockets of a manager that belong to one event loop. Only that loop changes
+// the list, the mutex is for others walking it to report on the sockets.
+class SockMgrLoop : public ITimerNotify {
+public:
+    explicit SockMgrLoop(ISockMgrBase & mgr) : m_mgr(mgr) {}
+
+    void touch(ISockMgrSocket * sock);
+    void unlink(ISockMgrSocket * sock);
+    void updateTimer();
+
+    mutable std::mutex m_mut;
+    List<ISockMgrSocket> m_socks;
+
+private:
+    Duration onTimer(TimePoint now) override;
+
+    ISockMgrBase & m_mgr;
 };
 
 // Adds manager to handle set.
@@ -106,7 +106,7 @@ ExecToolResult Dim::execToolWait(
     ExecToolResult out;
     latch lat(1);
     auto tmpOpts = opts;
-    tmpOpts.hq = taskInEventThread()
+    tmpOpts.hq = taskInEventLoop()
         ? taskComputeQueue()
         : taskEventQueue();
     execTool(
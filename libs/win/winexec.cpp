@@ -779,7 +779,7 @@ bool Dim::execProgramWait(
 ) {
     auto opts = rawOpts;
     if (!opts.hq)
-        opts.hq = taskInEventThread() ? taskComputeQueue() : taskEventQueue();
+        opts.hq = taskInEventLoop() ? taskComputeQueue() : taskEventQueue();
 
     latch lat(1);
     out->cmdline = cmdline;
@@ -1,4 +1,4 @@
-// Copyright Glen Knowles 2015 - 2025.
+// Copyright Glen Knowles 2015 - 2026.
 // Distributed under the Boost Software License, Version 1.0.
 //
 // winsock.cpp - dim windows platform
@@ -129,8 +129,9 @@ void SocketBase::disconnect(ISocketNotify * notify) {
 }
 
 //===========================================================================
-SocketBase::SocketBase(ISocketNotify * notify)
-    : m_notify(notify)
+SocketBase::SocketBase(ISocketNotify * notify, TaskQueueHandle hq)
+    : IWinOverlappedNotify(hq)
+    , m_notify(notify)
 {
     s_numSockets += 1;
 }
@@ -496,7 +497,7 @@ bool SocketBase::onWrite(SocketRequest * task) {
 *
 ***/
 
-thread_local bool t_socketRunning;
+static atomic_bool s_socketRunning;
 
 namespace {
 
@@ -516,7 +517,7 @@ void ShutdownNotify::onShutdownConsole(bool firstTry) {
     // close windows sockets
     if (WSACleanup())
         logMsgError() << "WSACleanup: " << WinError{};
-    t_socketRunning = false;
+    s_socketRunning = false;
 }
 
 
@@ -530,15 +531,15 @@ static WSAPROTOCOL_INFOW s_protocolInfo;
 
 //===========================================================================
 void Dim::iSocketCheckThread() {
-    if (!t_socketRunning) {
-        logMsgFatal() << "Socket services must be called on the event thread "
-            " and must be running.";
+    if (!s_socketRunning || !taskInEventLoop()) {
+        logMsgFatal() << "Socket services must be called on an event loop "
+            "and must be running.";
     }
 }
 
 //===========================================================================
 void Dim::iSocketInitialize() {
-    t_socketRunning = true;
+    s_socketRunning = true;
 
     WSADATA data = {};
     WinError err = WSAStartup(WINSOCK_VERSION, &data);
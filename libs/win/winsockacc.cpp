@@ -1,4 +1,4 @@
-// Copyright Glen Knowles 2015 - 2024.
+// Copyright Glen Knowles 2015 - 2026.
 // Distributed under the Boost Software License, Version 1.0.
 //
 // winsockacc.cpp - dim windows platform
@@ -24,10 +24,14 @@ public:
     static bool accept(ListenSocket * notify);
 
 public:
-    using SocketBase::SocketBase;
+    explicit AcceptSocket(unsigned loop);
     ~AcceptSocket();
 
     void onAccept(ListenSocket * listen, WinError xferError, int xferBytes);
+    void onAcceptLoop(IFactory<ISocketNotify> * factory);
+
+private:
+    unsigned m_loop;
 };
 
 class ListenSocket
@@ -61,6 +65,9 @@ public:
 ***/
 
 static List<ListenSocket> s_listeners;
+static unsigned s_nextLoop;
+// Accepted sockets queued to other event loops and not yet taken up there.
+static atomic_size_t s_numHandoffs;
 
 static auto & s_perfAccepts = uperf("sock.accepts");
 static auto & s_perfCurAccepts = uperf("sock.accepts (current)");
@@ -134,7 +141,9 @@ static void closeListen(ListenSocket * listen) {
 bool AcceptSocket::accept(ListenSocket * listen) {
     assert(!listen->m_socket);
 
-    auto sock = make_unique<AcceptSocket>(nullptr);
+    // Connections are dealt out to the event loops in turn, the completions
+    // of the accepted socket all go to the one it's given.
+    auto sock = make_unique<AcceptSocket>(s_nextLoop++ % taskEventLoops());
     sock->m_handle = iSocketCreate();
     if (sock->m_handle == INVALID_SOCKET)
         return closeListenHandle(listen);
@@ -170,6 +179,12 @@ bool AcceptSocket::accept(ListenSocket * listen) {
     return closeListenHandle(listen);
 }
 
+//===========================================================================
+AcceptSocket::AcceptSocket(unsigned loop)
+    : SocketBase(nullptr, taskEventLoopQueue(loop))
+    , m_loop(loop)
+{}
+
 //===========================================================================
 AcceptSocket::~AcceptSocket() {
     if (mode() == Mode::kClosed)
@@ -240,7 +255,26 @@ void AcceptSocket::onAccept(
         return;
     }
 
-    m_notify = listen->m_notify->onFactoryCreate().release();
+    // The rest of the accept is done by the event loop that gets the socket.
+    auto factory = listen->m_notify;
+    hostage.release();
+    if ((int) m_loop == taskEventLoop())
+        return onAcceptLoop(factory);
+    s_numHandoffs += 1;
+    taskPush(
+        taskEventLoopQueue(m_loop),
+        [this, factory]() {
+            onAcceptLoop(factory);
+            s_numHandoffs -= 1;
+        }
+    );
+}
+
+//===========================================================================
+void AcceptSocket::onAcceptLoop(IFactory<ISocketNotify> * factory) {
+    unique_ptr<AcceptSocket> hostage(this);
+
+    m_notify = factory->onFactoryCreate().release();
 
     // create read/write queue
     if (createQueue()) {
@@ -274,7 +308,7 @@ static ShutdownNotify s_cleanup;
 
 //===========================================================================
 void ShutdownNotify::onShutdownConsole(bool firstTry) {
-    if (s_listeners)
+    if (s_listeners || s_numHandoffs)
         return shutdownIncomplete();
 }
 
@@ -303,6 +337,7 @@ void Dim::socketListen(
     const SockAddr & local
 ) {
     iSocketCheckThread();
+    assert(taskInEventThread());
 
     auto hostage = make_unique<ListenSocket>(factory, local);
     auto sock = hostage.get();
@@ -332,6 +367,7 @@ void Dim::socketCloseWait(
     const SockAddr & local
 ) {
     iSocketCheckThread();
+    assert(taskInEventThread());
 
     for (auto && ls : s_listeners) {
         if (ls.m_notify == factory && ls.m_localAddr == local) {
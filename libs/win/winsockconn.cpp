@@ -1,4 +1,4 @@
-// Copyright Glen Knowles 2015 - 2024.
+// Copyright Glen Knowles 2015 - 2026.
 // Distributed under the Boost Software License, Version 1.0.
 //
 // winsockconn.cpp - dim windows platform
@@ -364,5 +364,6 @@ void Dim::socketConnect(
     Duration timeout
 ) {
     iSocketCheckThread();
+    assert(taskInEventThread());
     ConnSocket::connect(notify, remote, local, data, timeout);
 }
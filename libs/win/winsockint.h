@@ -1,4 +1,4 @@
-// Copyright Glen Knowles 2015 - 2023.
+// Copyright Glen Knowles 2015 - 2026.
 // Distributed under the Boost Software License, Version 1.0.
 //
 // winsockint.h - dim windows platform
@@ -38,7 +38,10 @@ public:
     static void read(ISocketNotify * notify);
 
 public:
-    SocketBase(ISocketNotify * notify);
+    // Completions are delivered to the queue, the event queue if it's not
+    // set. It's the event loop that owns the socket, and the only thread that
+    // may make calls on it.
+    SocketBase(ISocketNotify * notify, TaskQueueHandle hq = {});
     virtual ~SocketBase();
 
     void hardClose();
@@ -17,6 +17,9 @@ using namespace Dim;
 
 const VersionInfo kVersion = { 1 };
 
+// Header blocks encoded, cycling through the corpus, when benchmarking.
+const size_t kBenchBlocks = 1'000'000;
+
 
 /****************************************************************************
 *
@@ -54,6 +57,12 @@ struct Test {
     bool result;
     vector<NameValue> headers;
     vector<NameValue> dynTable;
+
+    // Encoding the headers, with every field indexed and a 256 byte table,
+    // reproduces the input exactly. Or reproduces 'encoded' instead, where
+    // the example uses Huffman for strings it doesn't shorten.
+    bool encodes{};
+    const char * encoded{};
 };
 
 } // namespace
@@ -171,7 +180,8 @@ const Test s_tests[] = {
      },
      {
          {":authority", "www.example.com"},
-     }},
+     },
+     true},
     {"C.4.2",
      false,
      // ....X....d..
@@ -187,7 +197,8 @@ const Test s_tests[] = {
      {
          {"cache-control", "no-cache"},
          {":authority", "www.example.com"},
-     }},
+     },
+     true},
     {"C.4.3",
      false,
      // ....@.%.I.[.}..%
@@ -206,7 +217,8 @@ const Test s_tests[] = {
          {"custom-key", "custom-value"},
          {"cache-control", "no-cache"},
          {":authority", "www.example.com"},
-     }},
+     },
+     true},
     {"C.5.1",
      true,
      // H.302X.privatea.
@@ -303,7 +315,8 @@ const Test s_tests[] = {
          {"date", "Mon, 21 Oct 2013 20:13:21 GMT"},
          {"cache-control", "private"},
          {":status", "302"},
-     }},
+     },
+     true},
     {"C.6.2",
      false,
      // H.d.....
@@ -320,7 +333,10 @@ const Test s_tests[] = {
          {"location", "https://www.example.com"},
          {"date", "Mon, 21 Oct 2013 20:13:21 GMT"},
          {"cache-control", "private"},
-     }},
+     },
+     true,
+     // H.307...
+     "\x48\x03\x33\x30\x37\xc1\xc0\xbf"},
     {"C.6.3",
      false,
      // ..a..z...T.D. ..
@@ -348,7 +364,154 @@ const Test s_tests[] = {
           "foo=ASDJKHQKBZXOQWEOPIUAXQWEOIU; max-age=3600; version=1"},
          {"content-encoding", "gzip"},
          {"date", "Mon, 21 Oct 2013 20:13:22 GMT"},
+     },
+     true},
+
+    // Huffman padding and EOS, rfc7541 5.2
+    {"padding",
+     true,
+     // ...c
+     "\x04\x81\x63",
+     true,
+     {
+         {":path", "/"},
      }},
+    {"padding not EOS",
+     true,
+     // ...`
+     "\x04\x81\x60",
+     false},
+    {"padding over 7 bits",
+     true,
+     // ...c.
+     "\x04\x82\x63\xff",
+     false},
+    {"EOS in string",
+     true,
+     // ......
+     "\x04\x84\xff\xff\xff\xff",
+     false},
+};
+
+
+// Requests as a typical browser sends them, and responses as a typical
+// server sends them, each cycled through in order to simulate a connection
+// fetching a page and its resources.
+const vector<NameValue> s_requests[] = {
+    {
+        {":method", "GET"},
+        {":scheme", "https"},
+        {":authority", "www.example.com"},
+        {":path", "/"},
+        {"accept", "text/html,application/xhtml+xml,application/xml;q=0.9,"
+            "*/*;q=0.8"},
+        {"accept-encoding", "gzip, deflate, br"},
+        {"accept-language", "en-US,en;q=0.5"},
+        {"user-agent", "Mozilla/5.0 (X11; Linux x86_64; rv:131.0) "
+            "Gecko/20100101 Firefox/131.0"},
+        {"upgrade-insecure-requests", "1"},
+    },
+    {
+        {":method", "GET"},
+        {":scheme", "https"},
+        {":authority", "www.example.com"},
+        {":path", "/static/css/site.3f9a2c.css"},
+        {"accept", "text/css,*/*;q=0.1"},
+        {"accept-encoding", "gzip, deflate, br"},
+        {"accept-language", "en-US,en;q=0.5"},
+        {"referer", "https://www.example.com/"},
+        {"user-agent", "Mozilla/5.0 (X11; Linux x86_64; rv:131.0) "
+            "Gecko/20100101 Firefox/131.0"},
+        {"if-none-match", "\"5f2a-18b9c0e1\""},
+    },
+    {
+        {":method", "GET"},
+        {":scheme", "https"},
+        {":authority", "www.example.com"},
+        {":path", "/static/js/app.c81e44.js"},
+        {"accept", "*/*"},
+        {"accept-encoding", "gzip, deflate, br"},
+        {"accept-language", "en-US,en;q=0.5"},
+        {"referer", "https://www.example.com/"},
+        {"user-agent", "Mozilla/5.0 (X11; Linux x86_64; rv:131.0) "
+            "Gecko/20100101 Firefox/131.0"},
+    },
+    {
+        {":method", "POST"},
+        {":scheme", "https"},
+        {":authority", "www.example.com"},
+        {":path", "/api/v1/events?session=7f3e9b2c41d84a6e&seq=17"},
+        {"accept", "application/json"},
+        {"accept-encoding", "gzip, deflate, br"},
+        {"content-type", "application/json"},
+        {"content-length", "214"},
+        {"cookie", "session=7f3e9b2c41d84a6e; theme=dark; tz=Europe%2FBerlin"},
+        {"origin", "https://www.example.com"},
+        {"user-agent", "Mozilla/5.0 (X11; Linux x86_64; rv:131.0) "
+            "Gecko/20100101 Firefox/131.0"},
+    },
+};
+
+const vector<NameValue> s_responses[] = {
+    {
+        {":status", "200"},
+        {"server", "dimapp/1.0"},
+        {"date", "Fri, 16 Oct 2026 17:02:11 GMT"},
+        {"content-type", "text/html; charset=utf-8"},
+        {"content-length", "18210"},
+        {"cache-control", "no-cache"},
+        {"strict-transport-security", "max-age=31536000; includeSubDomains"},
+        {"x-content-type-options", "nosniff"},
+        {"vary", "accept-encoding"},
+        {"content-encoding", "gzip"},
+    },
+    {
+        {":status", "200"},
+        {"server", "dimapp/1.0"},
+        {"date", "Fri, 16 Oct 2026 17:02:11 GMT"},
+        {"content-type", "text/css"},
+        {"content-length", "4711"},
+        {"cache-control", "public, max-age=86400"},
+        {"etag", "\"5f2a-18b9c0e1\""},
+        {"last-modified", "Tue, 06 Oct 2026 09:14:52 GMT"},
+        {"strict-transport-security", "max-age=31536000; includeSubDomains"},
+        {"x-content-type-options", "nosniff"},
+        {"vary", "accept-encoding"},
+        {"content-encoding", "gzip"},
+    },
+    {
+        {":status", "200"},
+        {"server", "dimapp/1.0"},
+        {"date", "Fri, 16 Oct 2026 17:02:12 GMT"},
+        {"content-type", "application/javascript"},
+        {"content-length", "52391"},
+        {"cache-control", "public, max-age=86400"},
+        {"etag", "\"cca7-18b9c0e2\""},
+        {"last-modified", "Tue, 06 Oct 2026 09:14:53 GMT"},
+        {"strict-transport-security", "max-age=31536000; includeSubDomains"},
+        {"x-content-type-options", "nosniff"},
+        {"vary", "accept-encoding"},
+        {"content-encoding", "gzip"},
+    },
+    {
+        {":status", "304"},
+        {"server", "dimapp/1.0"},
+        {"date", "Fri, 16 Oct 2026 17:02:12 GMT"},
+        {"cache-control", "public, max-age=86400"},
+        {"etag", "\"1e0c4-18b9c0e3\""},
+        {"strict-transport-security", "max-age=31536000; includeSubDomains"},
+    },
+    {
+        {":status", "200"},
+        {"server", "dimapp/1.0"},
+        {"date", "Fri, 16 Oct 2026 17:02:12 GMT"},
+        {"content-type", "application/json"},
+        {"content-length", "731"},
+        {"cache-control", "private, no-store"},
+        {"set-cookie", "session=7f3e9b2c41d84a6e; Path=/; Secure; HttpOnly"},
+        {"strict-transport-security", "max-age=31536000; includeSubDomains"},
+        {"x-content-type-options", "nosniff"},
+    },
 };
 
 
@@ -360,6 +523,7 @@ const Test s_tests[] = {
 
 static bool s_verbose;
 static bool s_test;
+static bool s_bench;
 
 
 /****************************************************************************
@@ -403,17 +567,12 @@ void Reader::onHpackHeader(
 
 /****************************************************************************
 *
-*   Application
+*   Tests
 *
 ***/
 
 //===========================================================================
-static void app(Cli & cli) {
-    if (!s_test) {
-        cout << "No tests run." << endl;
-        return appSignalShutdown(EX_OK);
-    }
-
+static void decodeTests() {
     TempHeap heap;
     HpackDecode decode(256);
     Reader out;
@@ -442,7 +601,255 @@ static void app(Cli & cli) {
             logMsgError() << "dynamic table mismatch (FAILED)";
         }
     }
+}
+
+//===========================================================================
+static void encodeTests() {
+    // Byte for byte against the rfc7541 appendix C examples.
+    unique_ptr<HpackEncode> encode;
+    CharBuf out;
+    for (auto && test : s_tests) {
+        if (!test.encodes)
+            continue;
+        if (s_verbose)
+            cout << "Encode test - " << test.name << endl;
+        if (test.reset) {
+            encode = make_unique<HpackEncode>(256);
+            encode->setIndexPolicy(kHpackIndexAll);
+        }
+        out.clear();
+        encode->startBlock(&out);
+        for (auto && hdr : test.headers)
+            encode->header(hdr.name, hdr.value, hdr.flags);
+        encode->endBlock();
+        if (out.view() != (test.encoded ? test.encoded : test.input))
+            logMsgError() << "encoded output mismatch (FAILED)";
+        if (!equal(
+            test.dynTable.begin(),
+            test.dynTable.end(),
+            encode->dynamicTable().begin(),
+            encode->dynamicTable().end(),
+            ::operator==
+        )) {
+            logMsgError() << "encoder dynamic table mismatch (FAILED)";
+        }
+    }
 
+    // Round trip the corpus under each policy, shrinking the table part way
+    // through to force a size update and evictions.
+    for (auto policy : {kHpackIndexNone, kHpackIndexDefault, kHpackIndexAll}) {
+        HpackEncode encode(4096);
+        encode.setIndexPolicy(policy);
+        HpackDecode decode(4096);
+        TempHeap heap;
+        Reader rdr;
+        for (auto i = 0; i < 2 * size(s_responses); ++i) {
+            if (i == size(s_responses)) {
+                encode.setTableSize(0);
+                encode.setTableSize(300);
+            }
+            auto & hdrs = s_responses[i % size(s_responses)];
+            out.clear();
+            encode.startBlock(&out);
+            for (auto && hdr : hdrs)
+                encode.header(hdr.name, hdr.value, hdr.flags);
+            encode.endBlock();
+            rdr.headers.clear();
+            auto str = out.view();
+            if (!decode.parse(&rdr, &heap, str.data(), str.size()))
+                logMsgError() << "decode of encoded block failed (FAILED)";
+            if (rdr.headers != hdrs)
+                logMsgError() << "round trip headers mismatch (FAILED)";
+            if (!ranges::equal(
+                encode.dynamicTable(),
+                decode.dynamicTable(),
+                [](auto & a, auto & b) {
+                    return a.name == b.name && a.value == b.value;
+                }
+            )) {
+                logMsgError() << "round trip dynamic table mismatch (FAILED)";
+            }
+        }
+    }
+
+    // Sensitive fields are never indexed and are reported as such.
+    HpackEncode encode2(4096);
+    HpackDecode decode(4096);
+    TempHeap heap;
+    Reader rdr;
+    out.clear();
+    encode2.startBlock(&out);
+    encode2.header("authorization", "Basic c2VjcmV0", fNeverIndexed);
+    encode2.endBlock();
+    auto str = out.view();
+    if (!decode.parse(&rdr, &heap, str.data(), str.size())
+        || size(rdr.headers) != 1
+        || rdr.headers[0].flags != fNeverIndexed
+        || !encode2.dynamicTable().empty()
+    ) {
+        logMsgError() << "never indexed field mismatch (FAILED)";
+    }
+}
+
+
+/****************************************************************************
+*
+*   Benchmarks
+*
+***/
+
+//===========================================================================
+// Size of the block as the encoder used to write it, every field as a raw
+// literal without indexing.
+static size_t literalSize(const vector<NameValue> & hdrs) {
+    auto intSize = [](size_t len) {
+        return len < 127 ? 1 : len - 127 < 128 ? 2 : 3;
+    };
+    size_t bytes = 0;
+    for (auto && hdr : hdrs) {
+        auto nlen = strlen(hdr.name);
+        auto vlen = strlen(hdr.value);
+        bytes += 1 + intSize(nlen) + nlen + intSize(vlen) + vlen;
+    }
+    return bytes;
+}
+
+//===========================================================================
+static void benchEncode() {
+    struct Policy {
+        const char * name;
+        HpackIndexPolicy policy;
+    } policies[] = {
+        {"none", kHpackIndexNone},
+        {"default", kHpackIndexDefault},
+        {"all", kHpackIndexAll},
+    };
+    size_t fields = 0;
+    for (auto i = 0; i < kBenchBlocks; ++i)
+        fields += size(s_responses[i % size(s_responses)]);
+
+    cout << "Header block bytes (" << size(s_responses) << " blocks cycled "
+        << kBenchBlocks << " times)\n";
+    size_t literal = 0;
+    for (auto i = 0; i < kBenchBlocks; ++i)
+        literal += literalSize(s_responses[i % size(s_responses)]);
+    cout << left << setw(12) << "literal" << right << setw(16) << literal
+        << endl;
+    CharBuf out;
+    for (auto && pol : policies) {
+        HpackEncode encode(4096);
+        encode.setIndexPolicy(pol.policy);
+        size_t bytes = 0;
+        for (auto i = 0; i < kBenchBlocks; ++i) {
+            out.clear();
+            encode.startBlock(&out);
+            for (auto && hdr : s_responses[i % size(s_responses)])
+                encode.header(hdr.name, hdr.value);
+            encode.endBlock();
+            bytes += out.size();
+        }
+        cout << left << setw(12) << pol.name << right << setw(16) << bytes
+            << setw(8) << fixed << setprecision(1)
+            << 100.0 * bytes / literal << "%" << endl;
+    }
+
+    cout << "Encoded per second\n";
+    for (auto && pol : policies) {
+        HpackEncode encode(4096);
+        encode.setIndexPolicy(pol.policy);
+        auto start = timeNow();
+        for (auto i = 0; i < kBenchBlocks; ++i) {
+            out.clear();
+            encode.startBlock(&out);
+            for (auto && hdr : s_responses[i % size(s_responses)])
+                encode.header(hdr.name, hdr.value);
+            encode.endBlock();
+        }
+        chrono::duration<double> elapsed = timeNow() - start;
+        cout << left << setw(12) << pol.name << right
+            << setw(16) << (uint64_t) (kBenchBlocks / elapsed.count())
+            << " blocks"
+            << setw(16) << (uint64_t) (fields / elapsed.count())
+            << " fields" << endl;
+    }
+}
+
+//===========================================================================
+static void benchDecode() {
+    struct Corpus {
+        const char * name;
+        span<const vector<NameValue>> blocks;
+    } corpora[] = {
+        {"requests", s_requests},
+        {"responses", s_responses},
+    };
+
+    cout << "Decoded per second\n";
+    for (auto && corpus : corpora) {
+        // Encoded without the dynamic table, so every block stands on its
+        // own and most strings are Huffman literals.
+        HpackEncode encode(4096);
+        encode.setIndexPolicy(kHpackIndexNone);
+        vector<CharBuf> blocks(size(corpus.blocks));
+        size_t fields = 0;
+        size_t bytes = 0;
+        for (auto i = 0; i < size(blocks); ++i) {
+            encode.startBlock(&blocks[i]);
+            for (auto && hdr : corpus.blocks[i])
+                encode.header(hdr.name, hdr.value);
+            encode.endBlock();
+        }
+        for (auto i = 0; i < kBenchBlocks; ++i) {
+            fields += size(corpus.blocks[i % size(blocks)]);
+            bytes += size(blocks[i % size(blocks)]);
+        }
+
+        HpackDecode decode(4096);
+        TempHeap heap;
+        Reader rdr;
+        auto start = timeNow();
+        for (auto i = 0; i < kBenchBlocks; ++i) {
+            auto str = blocks[i % size(blocks)].view();
+            rdr.headers.clear();
+            heap.clear();
+            if (!decode.parse(&rdr, &heap, str.data(), str.size())) {
+                logMsgError() << "decode failed";
+                return;
+            }
+        }
+        chrono::duration<double> elapsed = timeNow() - start;
+        cout << left << setw(12) << corpus.name << right
+            << setw(16) << (uint64_t) (kBenchBlocks / elapsed.count())
+            << " blocks"
+            << setw(16) << (uint64_t) (fields / elapsed.count())
+            << " fields"
+            << setw(16) << (uint64_t) (bytes / elapsed.count())
+            << " bytes" << endl;
+    }
+}
+
+
+/****************************************************************************
+*
+*   Application
+*
+***/
+
+//===========================================================================
+static void app(Cli & cli) {
+    if (!s_test && !s_bench) {
+        cout << "No tests run." << endl;
+        return appSignalShutdown(EX_OK);
+    }
+
+    if (s_test) {
+        decodeTests();
+        encodeTests();
+    }
+    if (s_bench) {
+        benchEncode();
+        benchDecode();
+    }
     testSignalShutdown();
 }
 
@@ -459,6 +866,8 @@ int main(int argc, char * argv[]) {
     cli.helpNoArgs().action(app);
     cli.opt(&s_verbose, "v verbose.")
         .desc("Display details of what's happening during processing.");
+    cli.opt(&s_bench, "b bench.")
+        .desc("Benchmark compression ratio and encode and decode throughput.");
     cli.opt(&s_test, "test", false)
         .desc("Run internal unit tests.");
     return appRun(argc, argv, kVersion, {}, fAppTest);
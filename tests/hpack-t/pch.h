@@ -1,4 +1,4 @@
-// Copyright Glen Knowles 2016 - 2022.
+// Copyright Glen Knowles 2016 - 2026.
 // Distributed under the Boost Software License, Version 1.0.
 //
 // pch.h - dim test hpack
@@ -15,7 +15,14 @@
 #include "tools/tools.h"
 
 // Standard headers
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
 #include <iostream>
+#include <memory>
+#include <ranges>
+#include <span>
+#include <vector>
 
 // Platform headers
 // External library internal headers
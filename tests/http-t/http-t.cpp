@@ -1,4 +1,4 @@
-// Copyright Glen Knowles 2016 - 2025.
+// Copyright Glen Knowles 2016 - 2026.
 // Distributed under the Boost Software License, Version 1.0.
 //
 // http-t.cpp - dim test http
@@ -17,6 +17,34 @@ using namespace Dim;
 
 const VersionInfo kVersion = { 1 };
 
+// Loopback port the HTTP/1.1 benchmark server listens on.
+const unsigned kPort = 41'235;
+
+// Requests sent over each benchmark connection, and how many of them are
+// pipelined ahead of their replies.
+const size_t kBenchRequests = 200'000;
+const size_t kBenchPipeline = 32;
+
+// Concurrent benchmark connections.
+const size_t kBenchConns = 4;
+
+// Routes added, and lookups made, by the route matching benchmark.
+const size_t kBenchRoutes = 2'000;
+const size_t kBenchLookups = 2'000'000;
+
+// Port the route server listens on, it's left at its default.
+const unsigned kRoutePort = 41'000;
+
+// How long a fetch from the route server waits for the reply, and how many
+// times it's tried, while the server starts listening or a changed file is
+// dropped from its cache.
+const Duration kFetchTimeout = 5s;
+const Duration kFetchRetryDelay = 100ms;
+const unsigned kFetchAttempts = 50;
+
+// Time between writing files that must have different modification times.
+const Duration kMtimeStep = 100ms;
+
 
 /****************************************************************************
 *
@@ -48,6 +76,73 @@ struct Test {
     vector<TestMsg> msgs;
 };
 
+// Reply to an HTTP/1.1 request, or more of its body if there's no status.
+struct H1Reply {
+    int stream;
+    const char * status;
+    const char * body;
+    bool more;
+};
+
+struct H1Test {
+    const char * name;
+    string input;
+    bool result;
+    vector<TestMsg> msgs;
+    vector<H1Reply> replies;
+    string output;
+};
+
+// Replies to every request with a short fixed body.
+class BenchServer : public ISocketNotify {
+    void onSocketConnect(const SocketConnectInfo & info) override;
+    bool onSocketRead(SocketData & data) override;
+
+    shared_ptr<Http1Conn> m_conn;
+};
+
+// Sends requests, keeping a number of them pipelined, and disconnects once
+// all of their replies have arrived.
+class BenchClient : public ISocketNotify {
+    void onSocketConnect(const SocketConnectInfo & info) override;
+    void onSocketConnectFailed() override;
+    bool onSocketRead(SocketData & data) override;
+    void onSocketDisconnect() override;
+
+    void send();
+
+    size_t m_sent{};
+    size_t m_recv{};
+    size_t m_bytes{};
+};
+
+// Sends a request on its own connection and keeps everything received until
+// the server disconnects.
+class FetchClient : public ISocketNotify {
+public:
+    explicit FetchClient(string request);
+
+private:
+    void onSocketConnect(const SocketConnectInfo & info) override;
+    void onSocketConnectFailed() override;
+    bool onSocketRead(SocketData & data) override;
+    void onSocketDisconnect() override;
+
+    string m_request;
+    string m_reply;
+};
+
+struct FetchReply {
+    unsigned status{};  // zero if no reply was received
+    unordered_map<string, string> headers;  // by lowercase name
+    string body;
+};
+
+// Serves the files of the test directory from the static file cache.
+class TestFileNotify : public IHttpRouteNotify {
+    void onHttpRequest(unsigned reqId, HttpRequest & msg) override;
+};
+
 } // namespace
 
 
@@ -59,6 +154,18 @@ struct Test {
 
 static bool s_verbose;
 static bool s_test;
+static bool s_bench;
+
+static mutex s_mut;
+static condition_variable s_cv;
+static size_t s_clientsRunning;
+static size_t s_clientsFailed;
+static size_t s_replyLen;
+
+static Path s_fileDir;
+static TestFileNotify s_fileNotify;
+static bool s_fetchDone;
+static string s_fetchReply;
 
 
 /****************************************************************************
@@ -102,6 +209,220 @@ const Test s_tests[] = {
         }
     },
 };
+
+const char kGetA[] = "GET /a HTTP/1.1\r\nHost: example.org\r\n\r\n";
+const char kGetB[] = "GET /b HTTP/1.1\r\nHost: example.org\r\n\r\n";
+
+const H1Test s_h1Tests[] = {
+    {
+        "pipelined replies in request order",
+        string(kGetA) + kGetB,
+        true,
+        {
+            {
+                {
+                    {":method", "GET"},
+                    {":scheme", "http"},
+                    {":path", "/a"},
+                    {":authority", "example.org"},
+                },
+                ""
+            },
+            {
+                {
+                    {":method", "GET"},
+                    {":scheme", "http"},
+                    {":path", "/b"},
+                    {":authority", "example.org"},
+                },
+                ""
+            },
+        },
+        {{2, "200", "bb"}, {1, "404", "a"}},
+        "HTTP/1.1 404 Not Found\r\n"
+            "content-length: 1\r\n\r\na"
+            "HTTP/1.1 200 OK\r\n"
+            "content-length: 2\r\n\r\nbb"
+    },
+    {
+        "chunked request and reply",
+        "POST /c HTTP/1.1\r\n"
+            "Host: example.org\r\n"
+            "Transfer-Encoding: chunked\r\n"
+            "Content-Type: text/plain\r\n\r\n"
+            "5;ext=1\r\nhello\r\n"
+            "6\r\n world\r\n"
+            "0\r\ntrailer: x\r\n\r\n",
+        true,
+        {
+            {
+                {
+                    {":method", "POST"},
+                    {":scheme", "http"},
+                    {":path", "/c"},
+                    {":authority", "example.org"},
+                    {"content-type", "text/plain"},
+                },
+                "hello world"
+            },
+        },
+        {{1, "200", "abc", true}, {1, nullptr, "0123456789", false}},
+        "HTTP/1.1 200 OK\r\n"
+            "transfer-encoding: chunked\r\n\r\n"
+            "3\r\nabc\r\n"
+            "a\r\n0123456789\r\n"
+            "0\r\n\r\n"
+    },
+    {
+        "content-length and connection close",
+        "PUT /d HTTP/1.1\r\n"
+            "host: example.org\r\n"
+            "content-length: 4\r\n"
+            "connection: close\r\n\r\n"
+            "data" + string(kGetA),
+        false,
+        {
+            {
+                {
+                    {":method", "PUT"},
+                    {":scheme", "http"},
+                    {":path", "/d"},
+                    {":authority", "example.org"},
+                    {"content-length", "4"},
+                },
+                "data"
+            },
+        },
+        {{1, "204", ""}},
+        "HTTP/1.1 204 No Content\r\n"
+            "connection: close\r\n\r\n"
+    },
+    {
+        "HTTP/1.0 keep-alive",
+        "HEAD http://example.org/e HTTP/1.0\r\n"
+            "Connection: keep-alive\r\n\r\n",
+        true,
+        {
+            {
+                {
+                    {":method", "HEAD"},
+                    {":scheme", "http"},
+                    {":authority", "example.org"},
+                    {":path", "/e"},
+                },
+                ""
+            },
+        },
+        {{1, "200", "body"}},
+        "HTTP/1.1 200 OK\r\n"
+            "content-length: 4\r\n"
+            "connection: keep-alive\r\n\r\n"
+    },
+    {
+        "missing host",
+        "GET / HTTP/1.1\r\n\r\n",
+        false,
+        {},
+        {},
+        "HTTP/1.1 400 Bad Request\r\n"
+            "connection: close\r\n"
+            "content-length: 0\r\n\r\n"
+    },
+    {
+        "unsupported version",
+        "GET / HTTP/1.2\r\nHost: example.org\r\n\r\n",
+        false,
+        {},
+        {},
+        "HTTP/1.1 505 HTTP Version Not Supported\r\n"
+            "connection: close\r\n"
+            "content-length: 0\r\n\r\n"
+    },
+    {
+        "chunked with content-length",
+        "POST / HTTP/1.1\r\n"
+            "Host: example.org\r\n"
+            "Content-Length: 5\r\n"
+            "Transfer-Encoding: chunked\r\n\r\n",
+        false,
+        {},
+        {},
+        "HTTP/1.1 400 Bad Request\r\n"
+            "connection: close\r\n"
+            "content-length: 0\r\n\r\n"
+    },
+    {
+        "chunk sizes with every digit",
+        "POST /f HTTP/1.1\r\n"
+            "Host: example.org\r\n"
+            "Transfer-Encoding: chunked\r\n\r\n"
+            "4\r\nabcd\r\n"
+            "000000000000000000001\t;x\r\ne\r\n"
+            "0\r\n\r\n",
+        true,
+        {
+            {
+                {
+                    {":method", "POST"},
+                    {":scheme", "http"},
+                    {":path", "/f"},
+                    {":authority", "example.org"},
+                },
+                "abcde"
+            },
+        },
+        {{1, "204", ""}},
+        "HTTP/1.1 204 No Content\r\n\r\n"
+    },
+    {
+        "chunk size too large",
+        "POST / HTTP/1.1\r\n"
+            "Host: example.org\r\n"
+            "Transfer-Encoding: chunked\r\n\r\n"
+            "123456789abcdef0123456789\r\n",
+        false,
+        {},
+        {},
+        "HTTP/1.1 413 Content Too Large\r\n"
+            "connection: close\r\n"
+            "content-length: 0\r\n\r\n"
+    },
+    {
+        "null after chunk size",
+        "POST / HTTP/1.1\r\n"
+            "Host: example.org\r\n"
+            "Transfer-Encoding: chunked\r\n\r\n"
+            + string("5\0\r\nhello\r\n0\r\n\r\n", 16),
+        false,
+        {},
+        {},
+        "HTTP/1.1 400 Bad Request\r\n"
+            "connection: close\r\n"
+            "content-length: 0\r\n\r\n"
+    },
+    {
+        "error after pipelined request",
+        string(kGetA) + "GET /\r\n\r\n",
+        false,
+        {
+            {
+                {
+                    {":method", "GET"},
+                    {":scheme", "http"},
+                    {":path", "/a"},
+                    {":authority", "example.org"},
+                },
+                ""
+            },
+        },
+        {{1, "200", "a"}},
+        "HTTP/1.1 200 OK\r\n"
+            "content-length: 1\r\n\r\na"
+            "HTTP/1.1 400 Bad Request\r\n"
+            "connection: close\r\n"
+            "content-length: 0\r\n\r\n"
+    },
+};
 // clang-format on
 
 
@@ -111,6 +432,51 @@ const Test s_tests[] = {
 *
 ***/
 
+//===========================================================================
+static void checkMsgs(
+    const vector<unique_ptr<HttpMsg>> & msgs,
+    const vector<TestMsg> & tmsgs
+) {
+    auto tmi = tmsgs.begin();
+    for (auto && msg : msgs) {
+        if (tmi == tmsgs.end()) {
+            logMsgError() << "too many messages (FAILED)";
+            break;
+        }
+        if (msg->body().compare(tmi->body) != 0)
+            logMsgError() << "body mismatch (FAILED)";
+        auto thi = tmi->headers.begin(), ethi = tmi->headers.end();
+        for (auto && hdr : msg->headers()) {
+            if (thi == ethi) {
+                logMsgError() << "expected fewer headers";
+                break;
+            }
+            if (strcmp(thi->name, hdr.m_name) != 0
+                || strcmp(thi->value, hdr.m_value) != 0) {
+                logMsgError() << "header mismatch, '" << hdr.m_name
+                              << ": " << hdr.m_value << "', expected '"
+                              << thi->name << ": " << thi->value
+                              << "' (FAILED)";
+            }
+            ++thi;
+        }
+        if (thi != ethi)
+            logMsgError() << "expected more headers (FAILED)";
+        ++tmi;
+    }
+    if (tmi != tmsgs.end())
+        logMsgError() << "too few messages (FAILED)";
+}
+
+//===========================================================================
+// Writes all of the held back data that flow control allows, the way a
+// socket that never falls behind would ask for it.
+static void drain(CharBuf * out, shared_ptr<HttpConn> conn) {
+    while (httpWriteUnsent(out, conn)) {
+        // keep going until there's nothing more flow control allows
+    }
+}
+
 //===========================================================================
 void oldTest() {
     CharBuf output;
@@ -132,35 +498,7 @@ void oldTest() {
         }
         if (output.compare(test.output) != 0)
             logMsgError() << "headers mismatch (FAILED)";
-        auto tmi = test.msgs.begin();
-        for (auto && msg : msgs) {
-            if (tmi == test.msgs.end()) {
-                logMsgError() << "too many messages (FAILED)";
-                break;
-            }
-            if (msg->body().compare(tmi->body) != 0)
-                logMsgError() << "body mismatch (FAILED)";
-            auto thi = tmi->headers.begin(), ethi = tmi->headers.end();
-            for (auto && hdr : msg->headers()) {
-                for (auto && hv : hdr) {
-                    if (thi == ethi) {
-                        logMsgError() << "expected fewer headers";
-                        goto FINISHED_HEADERS;
-                    }
-                    if (strcmp(thi->name, hdr.m_name) != 0
-                        || strcmp(thi->value, hv.m_value) != 0) {
-                        logMsgError() << "header mismatch, '" << hdr.m_name
-                                      << ": " << hv.m_value << "', expected '"
-                                      << thi->name << ": " << thi->value
-                                      << "' (FAILED)";
-                    }
-                    ++thi;
-                }
-            }
-        FINISHED_HEADERS:
-            if (thi != ethi)
-                logMsgError() << "expected more headers (FAILED)";
-        }
+        checkMsgs(msgs, test.msgs);
         msgs.clear();
     }
     httpClose(conn);
@@ -203,6 +541,1096 @@ static void localTest() {
 }
 
 
+//===========================================================================
+// Adds more header fields than are kept inline and checks their order and
+// lookup, before and after the message is moved.
+static void headerTest() {
+    if (s_verbose)
+        cout << "Test - headers" << endl;
+
+    HttpResponse msg(kHttpStatusOk);
+    msg.addHeaderRef("x-one", "1");
+    msg.addHeaderRef(kHttpVary, "a");
+    msg.addHeaderRef("x-two", "2");
+    msg.addHeaderRef("x-one", "11");
+    msg.addHeaderRef(kHttpVary, "b");
+    for (auto i = 0; i < 40; ++i)
+        msg.addHeader(kHttpVia, toChars(i).view());
+    vector<string> names;
+    for (auto && hdr : msg.headers())
+        names.push_back(hdr.m_name);
+    auto vias = count(names.begin(), names.end(), "via");
+    names.erase(remove(names.begin(), names.end(), "via"), names.end());
+    if (vias != 40
+        || names != vector<string>{
+            ":status", "x-one", "x-one", "vary", "vary", "x-two"
+        }
+    ) {
+        logMsgError() << "headers: wrong order (FAILED)";
+    }
+
+    HttpResponse moved(move(msg));
+    if (strcmp(moved.headers("x-two").m_value, "2") != 0
+        || strcmp(moved.headers(kHttpVary).m_value, "a") != 0
+        || moved.status() != kHttpStatusOk
+    ) {
+        logMsgError() << "headers: lookup failed (FAILED)";
+    }
+    if (!moved.removeHeader("x-one")
+        || moved.hasHeader("x-one")
+        || !moved.hasHeader("x-two")
+        || moved.headers().size() != 44
+    ) {
+        logMsgError() << "headers: remove failed (FAILED)";
+    }
+}
+
+//===========================================================================
+// Messages and their header heaps freed by a thread are reused by the next
+// ones it creates.
+static void poolTest() {
+    if (s_verbose)
+        cout << "Test - pooled messages" << endl;
+
+    auto msg = make_unique<HttpRequest>();
+    msg->addHeader("x-long", string(100, 'x'));
+    auto ptr = (void *) msg.get();
+    auto val = (void *) msg->headers("x-long").m_value;
+    msg.reset();
+    msg = make_unique<HttpRequest>();
+    msg->addHeader("x-long", string(100, 'x'));
+    if (msg.get() != ptr || msg->headers("x-long").m_value != val)
+        logMsgError() << "pool: memory not reused (FAILED)";
+}
+
+//===========================================================================
+// Replies on several streams with more than the initial flow control window
+// allows and checks the order in which the replies complete.
+static void priorityTest() {
+    if (s_verbose)
+        cout << "Test - priority" << endl;
+
+    vector<unique_ptr<HttpMsg>> msgs;
+    CharBuf cbuf;
+    CharBuf sbuf;
+    auto hsrv = httpAccept();
+    auto hcli = httpConnect(&cbuf);
+    auto request = [&](const char path[], const char priority[]) {
+        HttpRequest msg;
+        msg.addHeaderRef(kHttp_Method, "GET");
+        msg.addHeaderRef(kHttp_Scheme, "https");
+        msg.addHeaderRef(kHttp_Authority, "example.org");
+        msg.addHeaderRef(kHttp_Path, path);
+        if (*priority)
+            msg.addHeaderRef("priority", priority);
+        return httpRequest(&cbuf, hcli, msg);
+    };
+    auto big = request("/big", "");
+    auto small = request("/small", "");
+    auto bulk = request("/bulk", "u=7");
+    httpRecv(&sbuf, &msgs, hsrv, cbuf.data(), cbuf.size());
+    cbuf.clear();
+    if (msgs.size() != 3)
+        logMsgError() << "priority: requests not received (FAILED)";
+    msgs.clear();
+
+    auto reply = [&](int stream, size_t len) {
+        HttpResponse msg(kHttpStatusOk);
+        msg.body().append(len, 'x');
+        httpReply(&sbuf, hsrv, stream, msg);
+    };
+    reply(big, 200'000);
+    reply(small, 1'000);
+    reply(bulk, 1'000);
+    drain(&sbuf, hsrv);
+
+    // The small reply is interleaved with the large one that came before
+    // it, while the one marked least urgent waits for both.
+    vector<int> done;
+    while (!sbuf.empty()) {
+        httpRecv(&cbuf, &msgs, hcli, sbuf.data(), sbuf.size());
+        sbuf.clear();
+        for (auto && msg : msgs)
+            done.push_back(msg->stream());
+        msgs.clear();
+        httpRecv(&sbuf, &msgs, hsrv, cbuf.data(), cbuf.size());
+        cbuf.clear();
+        drain(&sbuf, hsrv);
+    }
+    if (done != vector{small, big, bulk})
+        logMsgError() << "priority: replies out of order (FAILED)";
+    httpClose(hsrv);
+    httpClose(hcli);
+}
+
+//===========================================================================
+// Gives the second of two streams the largest weight, 256, which a PRIORITY
+// frame sends as 255. Both replies are longer than the flow control window,
+// and the heavier one finishes first even though it's started second.
+static void priorityWeightTest() {
+    if (s_verbose)
+        cout << "Test - priority weight" << endl;
+
+    vector<unique_ptr<HttpMsg>> msgs;
+    CharBuf cbuf;
+    CharBuf sbuf;
+    auto hsrv = httpAccept();
+    auto hcli = httpConnect(&cbuf);
+    HttpRequest req;
+    req.addHeaderRef(kHttp_Method, "GET");
+    req.addHeaderRef(kHttp_Scheme, "https");
+    req.addHeaderRef(kHttp_Authority, "example.org");
+    req.addHeaderRef(kHttp_Path, "/");
+    auto light = httpRequest(&cbuf, hcli, req);
+    auto heavy = httpRequest(&cbuf, hcli, req);
+    const char priority[] = {
+        0, 0, 5,                // length
+        2,                      // type
+        0,                      // flags
+        0, 0, 0, (char) heavy,  // stream
+        0, 0, 0, 0,             // dependency
+        (char) 255,             // weight - 1
+    };
+    cbuf.append(priority, size(priority));
+    if (!httpRecv(&sbuf, &msgs, hsrv, cbuf.data(), cbuf.size())
+        || msgs.size() != 2
+    ) {
+        logMsgError() << "priority weight: requests not received (FAILED)";
+    }
+    cbuf.clear();
+    msgs.clear();
+
+    HttpResponse msg(kHttpStatusOk);
+    msg.body().append(100'000, 'x');
+    httpReply(&sbuf, hsrv, light, msg);
+    httpReply(&sbuf, hsrv, heavy, msg);
+    drain(&sbuf, hsrv);
+    vector<int> done;
+    while (!sbuf.empty()) {
+        httpRecv(&cbuf, &msgs, hcli, sbuf.data(), sbuf.size());
+        sbuf.clear();
+        for (auto && msg : msgs)
+            done.push_back(msg->stream());
+        msgs.clear();
+        httpRecv(&sbuf, &msgs, hsrv, cbuf.data(), cbuf.size());
+        cbuf.clear();
+        drain(&sbuf, hsrv);
+    }
+    if (done != vector{heavy, light})
+        logMsgError() << "priority weight: replies out of order (FAILED)";
+    httpClose(hsrv);
+    httpClose(hcli);
+}
+
+//===========================================================================
+// Replies on two streams whose flow control windows are both open. Only a
+// turn of the first reply is framed before the second is made, so their
+// data frames take turns instead of the first going out all at once.
+static void interleaveTest() {
+    if (s_verbose)
+        cout << "Test - interleave" << endl;
+
+    vector<unique_ptr<HttpMsg>> msgs;
+    CharBuf cbuf;
+    CharBuf sbuf;
+    auto hsrv = httpAccept();
+    auto hcli = httpConnect(&cbuf);
+    HttpRequest req;
+    req.addHeaderRef(kHttp_Method, "GET");
+    req.addHeaderRef(kHttp_Scheme, "https");
+    req.addHeaderRef(kHttp_Authority, "example.org");
+    req.addHeaderRef(kHttp_Path, "/");
+    auto first = httpRequest(&cbuf, hcli, req);
+    auto second = httpRequest(&cbuf, hcli, req);
+    httpRecv(&sbuf, &msgs, hsrv, cbuf.data(), cbuf.size());
+    cbuf.clear();
+    msgs.clear();
+
+    // The server's settings frames are kept ahead of the replies for the
+    // client, which rejects a connection that doesn't start with them.
+    auto start = sbuf.size();
+    HttpResponse msg(kHttpStatusOk);
+    msg.body().append(30'000, 'x');
+    httpReply(&sbuf, hsrv, first, msg);
+    httpReply(&sbuf, hsrv, second, msg);
+    drain(&sbuf, hsrv);
+
+    // Streams of the data frames, in the order they were written.
+    vector<int> frames;
+    auto raw = sbuf.data();
+    for (size_t pos = start; pos + 9 <= sbuf.size();) {
+        auto hdr = raw + pos;
+        if (hdr[3] == 0) // DATA
+            frames.push_back(ntoh32(hdr + 5) & 0x7fff'ffff);
+        pos += 9 + ntoh24(hdr);
+    }
+    // The second reply starts before the first one finishes.
+    auto firstDone = find(frames.rbegin(), frames.rend(), first).base();
+    auto secondStarted = find(frames.begin(), frames.end(), second);
+    if (secondStarted >= firstDone)
+        logMsgError() << "interleave: frames not interleaved (FAILED)";
+
+    httpRecv(&cbuf, &msgs, hcli, sbuf.data(), sbuf.size());
+    if (msgs.size() != 2
+        || msgs[0]->body().size() != 30'000
+        || msgs[1]->body().size() != 30'000
+    ) {
+        logMsgError() << "interleave: replies not received (FAILED)";
+    }
+    httpClose(hsrv);
+    httpClose(hcli);
+}
+
+//===========================================================================
+// Resets a stream whose reply is held back by flow control. Nothing more is
+// sent on it after the RST_STREAM, even once the window opens again.
+static void resetUnsentTest() {
+    if (s_verbose)
+        cout << "Test - reset unsent" << endl;
+
+    vector<unique_ptr<HttpMsg>> msgs;
+    CharBuf cbuf;
+    CharBuf sbuf;
+    auto hsrv = httpAccept();
+    auto hcli = httpConnect(&cbuf);
+    HttpRequest req;
+    req.addHeaderRef(kHttp_Method, "GET");
+    req.addHeaderRef(kHttp_Scheme, "https");
+    req.addHeaderRef(kHttp_Authority, "example.org");
+    req.addHeaderRef(kHttp_Path, "/");
+    auto stream = httpRequest(&cbuf, hcli, req);
+    httpRecv(&sbuf, &msgs, hsrv, cbuf.data(), cbuf.size());
+    cbuf.clear();
+    msgs.clear();
+
+    HttpResponse msg(kHttpStatusOk);
+    msg.body().append(100'000, 'x');
+    httpReply(&sbuf, hsrv, stream, msg);
+    drain(&sbuf, hsrv);
+    if (!httpUnsent(hsrv, stream))
+        logMsgError() << "reset unsent: reply not held back (FAILED)";
+    httpResetStream(&sbuf, hsrv, stream, false);
+    if (httpUnsent(hsrv, stream))
+        logMsgError() << "reset unsent: data kept after reset (FAILED)";
+
+    // The client opens the windows for the data it got before the reset.
+    httpRecv(&cbuf, &msgs, hcli, sbuf.data(), sbuf.size());
+    sbuf.clear();
+    msgs.clear();
+    httpRecv(&sbuf, &msgs, hsrv, cbuf.data(), cbuf.size());
+    drain(&sbuf, hsrv);
+    auto raw = sbuf.data();
+    for (size_t pos = 0; pos + 9 <= sbuf.size();) {
+        auto hdr = raw + pos;
+        if (hdr[3] == 0) { // DATA
+            logMsgError() << "reset unsent: data sent after reset (FAILED)";
+            break;
+        }
+        pos += 9 + ntoh24(hdr);
+    }
+    httpClose(hsrv);
+    httpClose(hcli);
+}
+
+//===========================================================================
+// Replies with the data frame payload referenced instead of copied, and
+// checks that splicing it back in gives the same bytes as copying.
+static void dataRefTest() {
+    if (s_verbose)
+        cout << "Test - data refs" << endl;
+
+    vector<unique_ptr<HttpMsg>> msgs;
+    CharBuf cbuf;
+    auto hcli = httpConnect(&cbuf);
+    HttpRequest req;
+    req.addHeaderRef(kHttp_Method, "GET");
+    req.addHeaderRef(kHttp_Scheme, "https");
+    req.addHeaderRef(kHttp_Authority, "example.org");
+    req.addHeaderRef(kHttp_Path, "/");
+    auto stream = httpRequest(&cbuf, hcli, req);
+
+    string body(40'000, 'x');
+    HttpResponse msg(kHttpStatusOk);
+    msg.body().append(body.substr(0, 30'000));
+    CharBuf copied;
+    auto hsrv = httpAccept();
+    httpRecv(&copied, &msgs, hsrv, cbuf.data(), cbuf.size());
+    httpReply(&copied, hsrv, stream, msg, true);
+    httpData(&copied, hsrv, stream, string_view(body).substr(30'000));
+    drain(&copied, hsrv);
+    httpClose(hsrv);
+
+    CharBuf out;
+    vector<HttpDataRef> refs;
+    hsrv = httpAccept();
+    httpRecv(&out, &msgs, hsrv, cbuf.data(), cbuf.size());
+    httpReply(&out, &refs, hsrv, stream, msg, true);
+    httpData(&out, &refs, hsrv, stream, string_view(body).substr(30'000));
+    drain(&out, hsrv);
+    httpClose(hsrv);
+    httpClose(hcli);
+
+    CharBuf spliced;
+    size_t pos = 0;
+    for (auto && ref : refs) {
+        spliced.append(out, pos, ref.pos - pos);
+        spliced.append(ref.data);
+        pos = ref.pos;
+    }
+    spliced.append(out, pos);
+    if (refs.empty() || spliced != copied)
+        logMsgError() << "data refs: output mismatch (FAILED)";
+}
+
+//===========================================================================
+static void h1Test() {
+    for (auto && test : s_h1Tests) {
+        if (s_verbose)
+            cout << "Test - " << test.name << endl;
+        auto conn = http1Accept();
+        CharBuf output;
+        vector<unique_ptr<HttpMsg>> msgs;
+
+        // Fed a byte at a time, so every partial state of the parser is
+        // resumed from.
+        bool result = true;
+        for (auto i = 0; result && i < test.input.size(); ++i)
+            result = http1Recv(&output, &msgs, conn, &test.input[i], 1);
+        if (result != test.result) {
+            logMsgError() << test.name << ": result: " << result << " != "
+                << test.result << " (FAILED)";
+        }
+        checkMsgs(msgs, test.msgs);
+        for (auto && rep : test.replies) {
+            if (rep.status) {
+                HttpResponse msg;
+                msg.addHeaderRef(kHttp_Status, rep.status);
+                msg.body().append(rep.body);
+                http1Reply(&output, conn, rep.stream, msg, rep.more);
+            } else {
+                http1Data(&output, conn, rep.stream, rep.body, rep.more);
+            }
+        }
+        if (output.compare(test.output) != 0) {
+            logMsgError() << test.name << ": output mismatch (FAILED)";
+            if (s_verbose)
+                cout << output << endl;
+        }
+        if (http1Closed(conn) == test.result)
+            logMsgError() << test.name << ": not closed (FAILED)";
+        http1Close(conn);
+    }
+}
+
+//===========================================================================
+// Replies that can't be completed, or can't be sent as given, still get a
+// status before the connection is closed, instead of a bare end of stream.
+static void h1ErrorTest() {
+    if (s_verbose)
+        cout << "Test - HTTP/1.1 reset before reply" << endl;
+
+    const char kError[] = "HTTP/1.1 500 Internal Server Error\r\n"
+        "connection: close\r\n"
+        "content-length: 0\r\n\r\n";
+    for (auto internal : {true, false}) {
+        auto conn = http1Accept();
+        CharBuf output;
+        vector<unique_ptr<HttpMsg>> msgs;
+        http1Recv(&output, &msgs, conn, kGetA, size(kGetA) - 1);
+        http1ResetStream(&output, conn, 1, internal);
+        if (output.compare(kError) != 0 || !http1Closed(conn)) {
+            logMsgError() << "h1 reset, internal " << internal
+                << ": no error reply (FAILED)";
+        }
+        http1Close(conn);
+    }
+
+    if (s_verbose)
+        cout << "Test - HTTP/1.1 line break in reply field" << endl;
+
+    // Written as is, these would split the reply in two.
+    const pair<const char *, const char *> kBadFields[] = {
+        {"location", "/x\r\n\r\nHTTP/1.1 200 OK"},
+        {"location", "/x\nset-cookie: a=b"},
+        {"x-bad\r\nset-cookie", "a=b"},
+    };
+    for (auto && [name, value] : kBadFields) {
+        auto conn = http1Accept();
+        CharBuf output;
+        vector<unique_ptr<HttpMsg>> msgs;
+        http1Recv(&output, &msgs, conn, kGetA, size(kGetA) - 1);
+        HttpResponse msg(kHttpStatusOk);
+        msg.addHeaderRef(name, value);
+        if (http1Reply(&output, conn, 1, msg)
+            || output.compare(kError) != 0
+            || !http1Closed(conn)
+        ) {
+            logMsgError() << "h1 reply field: not rejected (FAILED)";
+        }
+        http1Close(conn);
+    }
+}
+
+//===========================================================================
+// Requests pipelined past the limit, or behind replies held back for those
+// ahead of them, are left unparsed until the replies go out.
+static void h1PipelineTest() {
+    if (s_verbose)
+        cout << "Test - HTTP/1.1 pipelining limit" << endl;
+
+    const size_t kRequests = 40;
+    auto conn = http1Accept();
+    CharBuf output;
+    vector<unique_ptr<HttpMsg>> msgs;
+    string input;
+    for (size_t i = 0; i < kRequests; ++i)
+        input += kGetA;
+    http1Recv(&output, &msgs, conn, input.data(), input.size());
+    if (msgs.size() == kRequests || !http1Paused(conn))
+        logMsgError() << "h1 pipeline: requests not held (FAILED)";
+    HttpResponse msg(kHttpStatusOk);
+    size_t received = 0;
+    while (!msgs.empty()) {
+        received += msgs.size();
+        for (auto && req : msgs)
+            http1Reply(&output, conn, req->stream(), msg);
+        msgs.clear();
+        if (http1Paused(conn))
+            logMsgError() << "h1 pipeline: still held after replies (FAILED)";
+        http1Recv(&output, &msgs, conn, nullptr, 0);
+    }
+    if (received != kRequests)
+        logMsgError() << "h1 pipeline: requests lost (FAILED)";
+    http1Close(conn);
+
+    conn = http1Accept();
+    input = string(kGetA) + kGetB;
+    http1Recv(&output, &msgs, conn, input.data(), input.size());
+    msgs.clear();
+    msg.body().append(1024 * 1024, 'x');
+    http1Reply(&output, conn, 2, msg);
+    http1Recv(&output, &msgs, conn, kGetA, size(kGetA) - 1);
+    if (!msgs.empty() || !http1Paused(conn))
+        logMsgError() << "h1 pipeline: held reply not counted (FAILED)";
+    msg.body().clear();
+    http1Reply(&output, conn, 1, msg);
+    http1Recv(&output, &msgs, conn, nullptr, 0);
+    if (msgs.size() != 1)
+        logMsgError() << "h1 pipeline: request not resumed (FAILED)";
+    http1Close(conn);
+}
+
+
+//===========================================================================
+static void routeTest() {
+    if (s_verbose)
+        cout << "Test - route precedence" << endl;
+
+    // Routes have no notify, they're only found, never dispatched to.
+    httpRouteAdd({
+        {.path = "/rt/", .recurse = true, .name = "rt/*"},
+        {.path = "/rt/a", .name = "rt/a"},
+        {.path = "/rt/a", .recurse = true, .name = "rt/a*"},
+        {
+            .path = "/rt/a/b",
+            .methods = fHttpMethodPost,
+            .recurse = true,
+            .name = "rt/a/b*"
+        },
+        {.path = "/rt/ab", .name = "rt/ab"},
+        {.path = "/rt/c", .name = "rt/c first"},
+        {.path = "/rt/c", .name = "rt/c"},
+    });
+    struct {
+        const char * path;
+        HttpMethod method;
+        const char * name;
+    } tests[] = {
+        {"/rt/a", fHttpMethodGet, "rt/a"},
+        {"/rt/a/x", fHttpMethodGet, "rt/a*"},
+        {"/rt/a/b/c", fHttpMethodGet, "rt/a*"},
+        {"/rt/a/b/c", fHttpMethodPost, "rt/a/b*"},
+        {"/rt/ab", fHttpMethodGet, "rt/ab"},
+        {"/rt/abc", fHttpMethodGet, "rt/a*"},
+        {"/rt/c", fHttpMethodGet, "rt/c"},
+        {"/rt/z", fHttpMethodGet, "rt/*"},
+        {"/rt/a", fHttpMethodPut, ""},
+        {"/rt", fHttpMethodGet, ""},
+    };
+    for (auto && t : tests) {
+        auto ri = httpRouteFind(t.path, t.method);
+        if (ri.name != t.name) {
+            logMsgError() << "route " << t.path << ": '" << ri.name
+                << "', expected '" << t.name << "' (FAILED)";
+        }
+    }
+}
+
+//===========================================================================
+static void conditionalTest() {
+    if (s_verbose)
+        cout << "Test - etags and ranges" << endl;
+
+    struct {
+        const char * tags;
+        bool match;
+    } etags[] = {
+        {"\"a1\"", true},
+        {"W/\"a1\"", true},
+        {"\"b2\", \"a1\"", true},
+        {" \"b2\" ,W/\"a1\" ", true},
+        {"*", true},
+        {"\"b2\"", false},
+        {"\"a\"", false},
+        {"a1", false},
+        {"", false},
+    };
+    for (auto && t : etags) {
+        if (httpMatchEtag(t.tags, "\"a1\"") != t.match) {
+            logMsgError() << "etag '" << t.tags << "': " << !t.match
+                << ", expected " << t.match << " (FAILED)";
+        }
+    }
+
+    // Ranges of a 1000 byte representation, a first of 1000 or more means
+    // it can't be satisfied.
+    struct {
+        const char * range;
+        bool result;
+        uint64_t first;
+        uint64_t last;
+    } byteRanges[] = {
+        {"bytes=0-499", true, 0, 499},
+        {"bytes=500-", true, 500, 999},
+        {"bytes=900-2000", true, 900, 999},
+        {"bytes=-100", true, 900, 999},
+        {"bytes=-2000", true, 0, 999},
+        {"bytes= 10 - 19 ", true, 10, 19},
+        {"bytes=1000-", true, 1000, 0},
+        {"bytes=-0", true, 1000, 0},
+        {"bytes=0-1,5-6", false},
+        {"bytes=5-4", false},
+        {"bytes=x-", false},
+        {"bytes=-", false},
+        {"bytes=10", false},
+        {"items=0-10", false},
+    };
+    for (auto && t : byteRanges) {
+        uint64_t first = 0;
+        uint64_t last = 0;
+        auto result = httpParseRange(&first, &last, t.range, 1000);
+        if (result != t.result
+            || result && t.first >= 1000 && first < 1000
+            || result && t.first < 1000
+                && (first != t.first || last != t.last)
+        ) {
+            logMsgError() << "range '" << t.range << "': " << result
+                << ", " << first << "-" << last << " (FAILED)";
+        }
+    }
+}
+
+
+/****************************************************************************
+*
+*   BenchServer
+*
+***/
+
+//===========================================================================
+static void write(ISocketNotify * notify, const CharBuf & data) {
+    for (auto && view : data.views()) {
+        while (!view.empty()) {
+            auto buf = socketGetBuffer();
+            auto bytes = min(view.size(), (size_t) buf->capacity);
+            memcpy(buf->data, view.data(), bytes);
+            socketWrite(notify, move(buf), bytes);
+            view.remove_prefix(bytes);
+        }
+    }
+}
+
+//===========================================================================
+static bool benchReply(CharBuf * out, shared_ptr<Http1Conn> conn, int stream) {
+    HttpResponse msg;
+    msg.addHeaderRef(kHttp_Status, "200");
+    msg.addHeaderRef(kHttpContentType, "text/plain");
+    msg.body().append("Hello world!");
+    return http1Reply(out, conn, stream, msg);
+}
+
+//===========================================================================
+void BenchServer::onSocketConnect(const SocketConnectInfo & info) {
+    m_conn = http1Accept();
+}
+
+//===========================================================================
+bool BenchServer::onSocketRead(SocketData & data) {
+    CharBuf out;
+    vector<unique_ptr<HttpMsg>> msgs;
+    string_view src(data.data, data.bytes);
+    for (;;) {
+        bool more = http1Recv(&out, &msgs, m_conn, src.data(), src.size());
+        if (!more)
+            socketDisconnect(this);
+        if (msgs.empty())
+            break;
+        for (auto && msg : msgs)
+            benchReply(&out, m_conn, msg->stream());
+        msgs.clear();
+        if (!more)
+            break;
+
+        // Requests pipelined past the limit are parsed once the replies
+        // ahead of them have been made.
+        src = {};
+    }
+    write(this, out);
+    return true;
+}
+
+
+/****************************************************************************
+*
+*   BenchClient
+*
+***/
+
+//===========================================================================
+void BenchClient::onSocketConnect(const SocketConnectInfo & info) {
+    send();
+}
+
+//===========================================================================
+void BenchClient::onSocketConnectFailed() {
+    onSocketDisconnect();
+}
+
+//===========================================================================
+bool BenchClient::onSocketRead(SocketData & data) {
+    // Every reply is the same length, so counting bytes is enough.
+    m_bytes += data.bytes;
+    m_recv = m_bytes / s_replyLen;
+    if (m_recv == kBenchRequests) {
+        socketDisconnect(this);
+    } else {
+        send();
+    }
+    return true;
+}
+
+//===========================================================================
+void BenchClient::onSocketDisconnect() {
+    scoped_lock lk{s_mut};
+    if (m_recv != kBenchRequests || m_bytes != m_recv * s_replyLen)
+        s_clientsFailed += 1;
+    if (!--s_clientsRunning)
+        s_cv.notify_all();
+}
+
+//===========================================================================
+void BenchClient::send() {
+    CharBuf out;
+    for (; m_sent < kBenchRequests && m_sent - m_recv < kBenchPipeline;
+        ++m_sent
+    ) {
+        out.append("GET /bench HTTP/1.1\r\nHost: localhost\r\n\r\n");
+    }
+    write(this, out);
+}
+
+
+/****************************************************************************
+*
+*   FetchClient
+*
+***/
+
+//===========================================================================
+FetchClient::FetchClient(string request)
+    : m_request(move(request))
+{}
+
+//===========================================================================
+void FetchClient::onSocketConnect(const SocketConnectInfo & info) {
+    CharBuf out;
+    out.append(m_request);
+    write(this, out);
+}
+
+//===========================================================================
+void FetchClient::onSocketConnectFailed() {
+    onSocketDisconnect();
+}
+
+//===========================================================================
+bool FetchClient::onSocketRead(SocketData & data) {
+    m_reply.append(data.data, data.bytes);
+    return true;
+}
+
+//===========================================================================
+void FetchClient::onSocketDisconnect() {
+    scoped_lock lk{s_mut};
+    s_fetchReply = move(m_reply);
+    s_fetchDone = true;
+    s_cv.notify_all();
+}
+
+
+/****************************************************************************
+*
+*   Static files
+*
+***/
+
+//===========================================================================
+void TestFileNotify::onHttpRequest(unsigned reqId, HttpRequest & msg) {
+    auto path = s_fileDir;
+    path /= string_view(msg.query().path).substr(size("/files/") - 1);
+    httpRouteReplyWithFile(reqId, msg, path.view());
+}
+
+//===========================================================================
+static FetchReply parseReply(string_view src) {
+    FetchReply out;
+    auto eoh = src.find("\r\n\r\n");
+    if (!src.starts_with("HTTP/1.1 ") || eoh == string_view::npos)
+        return out;
+    out.body = src.substr(eoh + 4);
+    auto hdrs = src.substr(0, eoh);
+    auto eol = hdrs.find("\r\n");
+    if (!parse(&out.status, hdrs.substr(9, 3)))
+        out.status = 0;
+    while (eol != string_view::npos) {
+        hdrs.remove_prefix(eol + 2);
+        eol = hdrs.find("\r\n");
+        auto field = hdrs.substr(0, eol);
+        auto colon = field.find(':');
+        if (colon == string_view::npos)
+            continue;
+        string name;
+        for (auto ch : field.substr(0, colon))
+            name += (char) tolower((unsigned char) ch);
+        out.headers[name] = trim(field.substr(colon + 1));
+    }
+    return out;
+}
+
+//===========================================================================
+// Gets the path from the route server over HTTP/1.1, the extra headers are
+// each followed by CRLF. Must not be called from the event thread, which
+// the request passes through.
+static FetchReply fetch(string_view path, string_view headers = {}) {
+    SockAddr addr;
+    addr.addr.ipv4(0x7f000001);
+    addr.port = kRoutePort;
+    auto req = "GET "s;
+    req.append(path)
+        .append(" HTTP/1.1\r\nHost: localhost\r\nConnection: close\r\n")
+        .append(headers)
+        .append("\r\n");
+
+    // An empty reply means the connection failed, which it does until the
+    // route server is listening.
+    string reply;
+    for (unsigned i = 0; reply.empty() && i < kFetchAttempts; ++i) {
+        if (i)
+            this_thread::sleep_for(kFetchRetryDelay);
+        unique_lock lk{s_mut};
+        s_fetchDone = false;
+        taskPushEvent([req, addr]() {
+            socketConnect(new FetchClient(req), addr);
+        });
+        if (!s_cv.wait_for(lk, kFetchTimeout, []() { return s_fetchDone; }))
+            break;
+        reply = move(s_fetchReply);
+    }
+    return parseReply(reply);
+}
+
+//===========================================================================
+static void checkReply(
+    string_view name,
+    const FetchReply & rep,
+    unsigned status,
+    string_view body,
+    string_view contentRange = {}
+) {
+    if (rep.status != status) {
+        logMsgError() << "file " << name << ": status " << rep.status
+            << ", expected " << status << " (FAILED)";
+    } else if (rep.body != body) {
+        logMsgError() << "file " << name << ": body mismatch (FAILED)";
+    } else if (!contentRange.empty()) {
+        auto i = rep.headers.find("content-range");
+        if (i == rep.headers.end() || i->second != contentRange) {
+            logMsgError() << "file " << name << ": content range, expected "
+                << contentRange << " (FAILED)";
+        }
+    }
+}
+
+//===========================================================================
+// Must not be called from the event thread.
+static void fileTest() {
+    if (s_verbose)
+        cout << "Test - static files" << endl;
+
+    appDataPath(&s_fileDir, "http-t", false);
+    fileRemove(s_fileDir, true);
+    fileCreateDirs(s_fileDir);
+    auto save = [](string_view name, string_view content) {
+        auto path = s_fileDir;
+        path /= name;
+        fileSaveBinaryWait(path.view(), content);
+    };
+    string content;
+    for (auto i = 0; i < 1000; ++i)
+        content += char('a' + i % 26);
+    save("a.txt", content);
+    httpRouteAdd({.notify = &s_fileNotify, .path = "/files/", .recurse = true});
+
+    auto rep = fetch("/files/a.txt");
+    checkReply("whole", rep, 200, content);
+    auto etag = rep.headers["etag"];
+    auto lastModified = rep.headers["last-modified"];
+    if (etag.empty() || lastModified.empty())
+        logMsgError() << "file: no validators (FAILED)";
+
+    // Conditional requests
+    rep = fetch("/files/a.txt", "If-None-Match: \"x\", " + etag + "\r\n");
+    checkReply("if-none-match", rep, 304, {});
+    rep = fetch("/files/a.txt", "If-None-Match: W/" + etag + "\r\n");
+    checkReply("if-none-match weak", rep, 304, {});
+    rep = fetch("/files/a.txt", "If-None-Match: \"x\"\r\n");
+    checkReply("if-none-match changed", rep, 200, content);
+    rep = fetch(
+        "/files/a.txt",
+        "If-Modified-Since: " + lastModified + "\r\n"
+    );
+    checkReply("if-modified-since", rep, 304, {});
+
+    // Ranges
+    rep = fetch("/files/a.txt", "Range: bytes=10-19\r\n");
+    checkReply("range", rep, 206, content.substr(10, 10), "bytes 10-19/1000");
+    rep = fetch("/files/a.txt", "Range: bytes=-10\r\n");
+    checkReply("suffix", rep, 206, content.substr(990), "bytes 990-999/1000");
+    rep = fetch("/files/a.txt", "Range: bytes=995-\r\n");
+    checkReply("open", rep, 206, content.substr(995), "bytes 995-999/1000");
+    rep = fetch("/files/a.txt", "Range: bytes=0-1,5-6\r\n");
+    checkReply("multiple ranges", rep, 200, content);
+    rep = fetch("/files/a.txt", "Range: bytes=1000-\r\n");
+    checkReply("unsatisfiable", rep, 416, {}, "bytes */1000");
+    rep = fetch(
+        "/files/a.txt",
+        "Range: bytes=0-9\r\nIf-Range: " + etag + "\r\n"
+    );
+    checkReply("if-range", rep, 206, content.substr(0, 10), "bytes 0-9/1000");
+    rep = fetch("/files/a.txt", "Range: bytes=0-9\r\nIf-Range: \"x\"\r\n");
+    checkReply("if-range changed", rep, 200, content);
+
+    // Larger than a reply window, so sent a window at a time.
+    string big;
+    for (auto i = 0; i < 1'000'000; ++i)
+        big += char('a' + i % 23);
+    save("big.txt", big);
+    rep = fetch("/files/big.txt");
+    checkReply("windowed", rep, 200, big);
+
+    // Rewriting the file drops it from the cache, once the directory monitor
+    // has reported the change.
+    auto changed = content.substr(0, 500);
+    save("a.txt", changed);
+    rep = fetch("/files/a.txt");
+    for (unsigned i = 0; i < kFetchAttempts && rep.body != changed; ++i) {
+        this_thread::sleep_for(kFetchRetryDelay);
+        rep = fetch("/files/a.txt");
+    }
+    checkReply("changed", rep, 200, changed);
+    if (rep.headers["etag"] == etag)
+        logMsgError() << "file changed: etag unchanged (FAILED)";
+}
+
+//===========================================================================
+static void checkCoding(
+    string_view name,
+    FetchReply & rep,
+    string_view body,
+    string_view coding,
+    bool vary
+) {
+    checkReply(name, rep, 200, body);
+    if (rep.headers["content-encoding"] != coding) {
+        logMsgError() << "coding " << name << ": '"
+            << rep.headers["content-encoding"] << "', expected '" << coding
+            << "' (FAILED)";
+    }
+    if (rep.headers.contains("vary") != vary)
+        logMsgError() << "coding " << name << ": vary (FAILED)";
+}
+
+//===========================================================================
+// Must not be called from the event thread, or before fileTest.
+static void sidecarTest() {
+    if (s_verbose)
+        cout << "Test - precompressed sidecars" << endl;
+
+    // A sidecar older than its file was made from an earlier version and is
+    // ignored.
+    auto save = [](string_view name, string_view content) {
+        auto path = s_fileDir;
+        path /= name;
+        fileSaveBinaryWait(path.view(), content);
+        this_thread::sleep_for(kMtimeStep);
+    };
+    save("stale.txt.gz", "gz");
+    save("stale.txt", "plain");
+    save("fresh.txt", "plain");
+    save("fresh.txt.gz", "gz");
+
+    const char * gzip = "Accept-Encoding: gzip\r\n";
+    auto rep = fetch("/files/stale.txt", gzip);
+    checkCoding("stale sidecar", rep, "plain", {}, false);
+    rep = fetch("/files/fresh.txt", gzip);
+    checkCoding("sidecar", rep, "gz", "gzip", true);
+    rep = fetch("/files/fresh.txt", "Accept-Encoding: br\r\n");
+    checkCoding("sidecar not accepted", rep, "plain", {}, true);
+}
+
+//===========================================================================
+// Must not be called from the event thread.
+static void variantTest() {
+    if (s_verbose)
+        cout << "Test - content coding" << endl;
+
+    // Variants are linked to the file route whether they're added before or
+    // after it.
+    auto mtime = timeNow();
+    httpRouteAddFile("/coding/v.txt.br", mtime, "br");
+    httpRouteAddFile("/coding/v.txt", mtime, "plain");
+    httpRouteAddFile("/coding/v.txt.gz", mtime, "gz");
+
+    struct {
+        const char * accept;    // null to leave out Accept-Encoding
+        const char * body;
+        const char * coding;
+    } const tests[] = {
+        {nullptr, "plain", ""},
+        {"identity", "plain", ""},
+        {"gzip, br", "br", "br"},
+        {"br;q=0.5, gzip", "gz", "gzip"},
+        {"GZIP", "gz", "gzip"},
+        {"x-gzip", "gz", "gzip"},
+        {"*", "br", "br"},
+        {"*, br;q=0", "gz", "gzip"},
+        {"gzip;q=0, *", "br", "br"},
+        {"gzip;q=0.5, br;q=0.4", "gz", "gzip"},
+        {"gzip;q=0.500, br;q=0.5", "br", "br"},
+        {"gzip;q=0, br;q=0", "plain", ""},
+        {"br;q=0.x, gzip;q=0.001", "gz", "gzip"},
+        {"br;q=abc, gzip", "br", "br"},
+        {"br;level=1;q=0, gzip", "gz", "gzip"},
+    };
+    for (auto && t : tests) {
+        string hdrs;
+        if (t.accept)
+            hdrs.append("Accept-Encoding: ").append(t.accept).append("\r\n");
+        auto rep = fetch("/coding/v.txt", hdrs);
+        checkCoding(t.accept ? t.accept : "none", rep, t.body, t.coding, true);
+    }
+}
+
+
+/****************************************************************************
+*
+*   Benchmark
+*
+***/
+
+//===========================================================================
+static SockAddr serverAddr() {
+    SockAddr addr;
+    addr.addr.ipv4(0x7f000001);
+    addr.port = kPort;
+    return addr;
+}
+
+//===========================================================================
+// Must be called from the event thread, where routes are found.
+static void routeBench() {
+    vector<string> paths;
+    for (auto i = 0; i < kBenchRoutes; ++i) {
+        string path = "/bench/v";
+        path.append(toChars(i % 4).view())
+            .append("/svc")
+            .append(toChars(i / 4).view())
+            .append("/items");
+        HttpRouteInfo ri = {.path = path, .recurse = i % 3 == 0};
+        httpRouteAdd(ri);
+        if (ri.recurse)
+            path += "/123";
+        paths.push_back(path);
+    }
+
+    size_t found = 0;
+    auto start = timeNow();
+    for (auto i = 0; i < kBenchLookups; ++i) {
+        if (httpRouteFind(paths[i % paths.size()], fHttpMethodGet))
+            found += 1;
+    }
+    chrono::duration<double> elapsed = timeNow() - start;
+    cout << "Route lookup, " << kBenchRoutes << " routes\n"
+        << left << setw(12) << "lookups/s" << right
+        << setw(16) << (uint64_t) (kBenchLookups / elapsed.count())
+        << endl;
+    if (found != kBenchLookups)
+        logMsgError() << "Routes not found: " << kBenchLookups - found;
+}
+
+//===========================================================================
+static void bench() {
+    // Length of the reply to each request.
+    {
+        auto conn = http1Accept();
+        CharBuf out;
+        vector<unique_ptr<HttpMsg>> msgs;
+        const char req[] = "GET / HTTP/1.1\r\nHost: localhost\r\n\r\n";
+        http1Recv(&out, &msgs, conn, req, size(req) - 1);
+        benchReply(&out, conn, msgs.front()->stream());
+        s_replyLen = out.size();
+    }
+
+    // Socket events are dispatched on the event thread, the clients are
+    // waited for from here.
+    s_clientsRunning = kBenchConns;
+    auto start = timeNow();
+    taskPushEvent([]() {
+        socketListen<BenchServer>(serverAddr());
+        for (auto i = 0; i < kBenchConns; ++i)
+            socketConnect(new BenchClient, serverAddr());
+    });
+    {
+        unique_lock lk{s_mut};
+        while (s_clientsRunning)
+            s_cv.wait(lk);
+    }
+    chrono::duration<double> elapsed = timeNow() - start;
+    taskPushEvent([]() { socketCloseWait<BenchServer>(serverAddr()); });
+
+    auto reqs = kBenchConns * kBenchRequests;
+    cout << "HTTP/1.1 loopback, " << kBenchConns << " connections, "
+        << kBenchPipeline << " pipelined\n"
+        << left << setw(12) << "requests/s" << right
+        << setw(16) << (uint64_t) (reqs / elapsed.count()) << '\n'
+        << left << setw(12) << "bytes/s" << right
+        << setw(16) << (uint64_t) (reqs * s_replyLen / elapsed.count())
+        << endl;
+    if (s_clientsFailed)
+        logMsgError() << "Clients failed: " << s_clientsFailed;
+}
+
+
 /****************************************************************************
 *
 *   Application
@@ -211,14 +1639,41 @@ static void localTest() {
 
 //===========================================================================
 static void app(Cli & cli) {
-    if (!s_test) {
+    if (!s_test && !s_bench) {
         cout << "No tests run." << endl;
         return appSignalShutdown(EX_OK);
     }
 
-    oldTest();
-    localTest();
-    testSignalShutdown();
+    if (s_test) {
+        oldTest();
+        localTest();
+        headerTest();
+        poolTest();
+        priorityTest();
+        priorityWeightTest();
+        interleaveTest();
+        resetUnsentTest();
+        dataRefTest();
+        h1Test();
+        h1ErrorTest();
+        h1PipelineTest();
+        routeTest();
+        conditionalTest();
+    }
+    if (s_bench)
+        routeBench();
+
+    // The rest wait for replies that pass through the event thread.
+    taskPushOnce("Http Test", []() {
+        if (s_test) {
+            fileTest();
+            sidecarTest();
+            variantTest();
+        }
+        if (s_bench)
+            bench();
+        testSignalShutdown();
+    });
 }
 
 
@@ -234,6 +1689,8 @@ int main(int argc, char * argv[]) {
     cli.helpNoArgs().action(app);
     cli.opt(&s_verbose, "v verbose.")
         .desc("Show names of tests as they are processed.");
+    cli.opt(&s_bench, "b bench.")
+        .desc("Benchmark route lookups and HTTP/1.1 requests per second.");
     cli.opt(&s_test, "test", false)
         .desc("Run internal unit tests.");
     return appRun(argc, argv, kVersion, {}, fAppTest);
@@ -1,19 +1,29 @@
-// Copyright Glen Knowles 2016 - 2022.
+// Copyright Glen Knowles 2016 - 2026.
 // Distributed under the Boost Software License, Version 1.0.
 //
 // pch.h - dim test http
 
 // Public header
 #include "net/http.h"
+#include "net/net.h"
 
 // External library public headers
 #include "app/app.h"
 #include "core/core.h"
+#include "file/file.h"
 #include "system/system.h"
 #include "tools/tools.h"
 
 // Standard headers
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <iomanip>
 #include <iostream>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
 
 // Platform headers
 // External library internal headers
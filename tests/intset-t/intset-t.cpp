@@ -9,6 +9,29 @@ using namespace std;
 using namespace Dim;
 
 
+/****************************************************************************
+*
+*   Tuning parameters
+*
+***/
+
+// Values in the sets combined by the kernel benchmarks are drawn from
+// [0, kBenchRange), each operation is timed this many times.
+const unsigned kBenchRange = 10'000'000;
+const int kBenchReps = 10;
+
+// The pagination benchmark fetches this many randomly chosen pages from a set
+// of kBenchPageValues values.
+const size_t kBenchPageValues = 10'000'000;
+const size_t kBenchPageSize = 100;
+const int kBenchPages = 20;
+
+// The parallel benchmark merges kBenchLists posting lists, each with one of
+// every 2 to 30 values, and intersects kBenchDense sets with half the values.
+const size_t kBenchLists = 100;
+const size_t kBenchDense = 8;
+
+
 /****************************************************************************
 *
 *   Declarations
@@ -28,7 +51,20 @@ static int s_passed;
 
 /****************************************************************************
 *
-*   Application
+*   Variables
+*
+***/
+
+static bool s_test;
+static bool s_bench;
+
+// Results of benchmarked queries, so they aren't optimized away.
+static size_t s_benchHits;
+
+
+/****************************************************************************
+*
+*   Tests
 *
 ***/
 
@@ -102,6 +138,40 @@ static void vectorTest() {
     expect(a, "1-200");
 }
 
+//===========================================================================
+// Test searching backwards through Node::kSmVector and Node::kVector nodes,
+// where each value found must be the key itself when it's present.
+template <typename T>
+static void rfindTest() {
+    int line = 0;
+    IntegralSet<T> a;
+
+    // Few enough for kSmVector.
+    a.assign("3-4");
+    EXPECT(*a.findLessEqual(4) == 4);
+    EXPECT(*a.findLess(4) == 3);
+    vector<T> v(a.rbegin(), a.rend());
+    EXPECT(v == vector<T>{{4, 3}});
+
+    // Too many for kSmVector, with too few runs for kRuns.
+    vector<T> vals;
+    for (T i = 0; i < 100; i += 2) {
+        vals.push_back(i);
+        if (i == 50)
+            vals.push_back(51);
+    }
+    a.clear();
+    a.insert(vals.begin(), vals.end());
+    for (auto && val : vals) {
+        EXPECT(*a.findLessEqual(val) == val);
+        if (!a.contains(val + 1)) {
+            EXPECT(*a.findLessEqual(val + 1) == val);
+        }
+    }
+    v.assign(a.rbegin(), a.rend());
+    EXPECT(v == vector<T>(vals.rbegin(), vals.rend()));
+}
+
 //===========================================================================
 template <typename T>
 static void containTest() {
@@ -255,6 +325,7 @@ static void miscTest() {
     tmp.erase(2, 4999);
     tmp.erase(10002, 4999);
     tmp.erase(20002, 4999);
+    tmp.assertCounts();
     size_t cnt = tmp.count();
     EXPECT(cnt == 3);
     cnt = 0;
@@ -263,19 +334,776 @@ static void miscTest() {
     EXPECT(cnt == 3);
 }
 
+//===========================================================================
+// Combine sets with bitmap nodes (every third value) and vector nodes (every
+// 50th or 70th value).
+template <typename T>
+static void kernelTest() {
+    int line = 0;
+    IntegralSet<T> thirds, fifties, seventies, tmp;
+    for (T i = 0; i < 8192; ++i) {
+        if (i % 3 == 0)
+            thirds.insert(i);
+        if (i % 50 == 0)
+            fifties.insert(i);
+        if (i % 70 == 0)
+            seventies.insert(i);
+    }
+    auto count = [](size_t step) { return (8191 + step) / step; };
+
+    // vector and bitmap
+    tmp = fifties;
+    tmp.intersect(thirds);
+    EXPECT(tmp.size() == count(150));
+    EXPECT(*tmp.begin() == 0 && tmp.back() == 8100);
+    EXPECT(thirds.contains(tmp));
+    EXPECT(!thirds.contains(fifties));
+    EXPECT(thirds.intersects(fifties));
+    tmp = fifties;
+    tmp.erase(thirds);
+    EXPECT(tmp.size() == count(50) - count(150));
+    EXPECT(!tmp.intersects(thirds));
+    tmp = thirds;
+    tmp.intersect(fifties);
+    EXPECT(tmp.size() == count(150));
+
+    // vector and vector
+    tmp = fifties;
+    tmp.intersect(seventies);
+    EXPECT(tmp.size() == count(350));
+    tmp = fifties;
+    tmp.insert(seventies);
+    EXPECT(tmp.size() == count(50) + count(70) - count(350));
+    EXPECT(tmp.contains(fifties) && tmp.contains(seventies));
+
+    // bitmap and bitmap
+    IntegralSet<T> evens, odds;
+    for (T i = 0; i < 4096; ++i)
+        (i % 2 ? odds : evens).insert(i);
+    tmp = evens;
+    EXPECT(!tmp.intersects(odds));
+    tmp.insert(odds);
+    expect(tmp, "0-4095");
+    tmp.erase(evens);
+    EXPECT(tmp == odds);
+    tmp.intersect(thirds);
+    EXPECT(tmp.size() == 683);
+    EXPECT(thirds.contains(tmp) && odds.contains(tmp));
+    tmp.assertCounts();
+}
+
+//===========================================================================
+template <typename T>
+static void serialTest() {
+    int line = 0;
+    IntegralSet<T> set;
+    set.insert(5);
+    for (T i = 10'000; i < 14'000; i += 2)
+        set.insert(i);
+    set.insert(100'000, 50'000);
+    set.insert(1'000'000, 3);
+
+    CharBuf buf;
+    set.save(&buf);
+    auto data = toString(buf);
+    IntegralSet<T> out(1, 2);
+    EXPECT(out.load(data));
+    EXPECT(out == set);
+
+    IntegralSetView<T> view;
+    EXPECT(view.parse(data));
+    EXPECT(view.size() == set.size());
+    vector<T> v1(set.begin(), set.end());
+    vector<T> v2(view.begin(), view.end());
+    EXPECT(v1 == v2);
+    for (T val : { 0, 5, 6, 9'999, 10'001, 13'998, 100'000, 150'000 }) {
+        line = __LINE__;
+        EXPECT(view.contains(val) == set.contains(val));
+        auto vi = view.lowerBound(val);
+        auto si = set.lowerBound(val);
+        EXPECT(bool(vi) == bool(si) && (!vi || *vi == *si));
+        vi = view.upperBound(val);
+        si = set.upperBound(val);
+        EXPECT(bool(vi) == bool(si) && (!vi || *vi == *si));
+    }
+    line = 0;
+
+    // Truncated data is rejected, and the set left unchanged.
+    data.pop_back();
+    EXPECT(!out.load(data));
+    EXPECT(out == set);
+    EXPECT(!view.parse(data));
+
+    // As is a set of the same width but the other signedness.
+    using Other = conditional_t<
+        is_signed_v<T>,
+        make_unsigned_t<T>,
+        make_signed_t<T>
+    >;
+    IntegralSet<Other> other;
+    EXPECT(!other.load(toString(buf)));
+    EXPECT(other.empty());
+    IntegralSetView<Other> otherView;
+    EXPECT(!otherView.parse(toString(buf)));
+
+    set.clear();
+    buf.clear();
+    set.save(&buf);
+    EXPECT(out.load(toString(buf)));
+    EXPECT(out.empty());
+}
+
+//===========================================================================
+// Sets made of a few long ranges, kept by Node::kRuns nodes.
+template <typename T>
+static void runsTest() {
+    int line = 0;
+    IntegralSet<T> a;
+    IntegralSet<T> b;
+
+    // Merge and split.
+    a.insert(100, 1000);
+    a.insert(2000, 100);
+    expect(a, "100-1099 2000-2099");
+    a.insert(1100, 900);
+    expect(a, "100-2099");
+    a.erase(500, 10);
+    expect(a, "100-499 510-2099");
+    a.insert(90, 10);
+    a.insert(2100);
+    expect(a, "90-499 510-2100");
+    a.erase(90);
+    a.erase(2100);
+    a.erase(300);
+    expect(a, "91-299 301-499 510-2099");
+    EXPECT(a.size() == 1998);
+    EXPECT(a.count(400, 200) == 190);
+    EXPECT(*a.firstContiguous(a.find(600)) == 510);
+    EXPECT(*a.lastContiguous(a.find(600)) == 2099);
+    EXPECT(*a.lastContiguous(a.find(200)) == 299);
+    EXPECT(*a.lowerBound(500) == 510);
+    EXPECT(*a.upperBound(299) == 301);
+    vector<T> v(a.rbegin(), a.rend());
+    EXPECT(v.size() == 1998 && v[0] == 2099 && v[1] == 2098);
+    a.erase(91, 2009);
+    EXPECT(a.empty());
+
+    // More separate ranges than a node holds.
+    for (T i = 0; i < 100; ++i)
+        a.insert(i * 10, 2);
+    EXPECT(a.size() == 200);
+    auto r = a.ranges();
+    EXPECT(distance(r.begin(), r.end()) == 100);
+    for (T i = 0; i < 100; ++i)
+        a.erase(i * 10 + 1);
+    EXPECT(a.size() == 100);
+
+    // Splitting a run when the node is already at its limit.
+    a.clear();
+    a.insert(0, 130);
+    for (T i = 3; i < 128; i += 2)
+        a.erase(i);
+    a.erase(1);
+    EXPECT(a.size() == 66);
+    EXPECT(!a.count(1) && a.count(128, 2) == 2);
+    a.clear();
+    for (T i = 0; i < 100; ++i)
+        a.insert(i * 100, 50);
+    EXPECT(a.size() == 5000);
+    r = a.ranges();
+    EXPECT(distance(r.begin(), r.end()) == 100);
+
+    // Holes in a full set.
+    a.clear();
+    a.insert(0, 100'000);
+    a.erase(5000, 10);
+    a.erase(70'000);
+    expect(a, "0-4999 5010-69999 70001-99999");
+    a.insert(5000, 10);
+    a.insert(70'000);
+    expect(a, "0-99999");
+    a.assertCounts();
+
+    // Combined with other node types.
+    a.assign("1000-1999 3000-3999");
+    b.assign("1500 2500 3500");
+    EXPECT(!a.contains(b));
+    EXPECT(a.intersects(b));
+    EXPECT(a.compare(b) < 0);
+    auto tmp = a;
+    tmp.intersect(b);
+    expect(tmp, "1500 3500");
+    EXPECT(a.contains(tmp) && !tmp.contains(a));
+    tmp = a;
+    tmp.erase(b);
+    expect(tmp, "1000-1499 1501-1999 3000-3499 3501-3999");
+    tmp = b;
+    tmp.insert(a);
+    expect(tmp, "1000-1999 2500 3000-3999");
+    b.clear();
+    for (T i = 0; i < 4096; i += 3)
+        b.insert(i);
+    tmp = a;
+    tmp.intersect(b);
+    EXPECT(tmp.size() == 667);
+    EXPECT(b.contains(tmp));
+    tmp = b;
+    tmp.erase(a);
+    EXPECT(tmp.size() == b.size() - 667);
+    EXPECT(!tmp.intersects(a));
+    b.assign("0-9999 20000-29999");
+    EXPECT(b.contains(a));
+    tmp = b;
+    tmp.intersect(a);
+    EXPECT(tmp == a);
+    tmp = a;
+    tmp.insert(b);
+    EXPECT(tmp == b);
+    b.assign("1000-1999 3000-4000");
+    EXPECT(a.compare(b) < 0 && b.compare(a) > 0);
+    b.erase(4000);
+    EXPECT(a == b);
+    b.assertCounts();
+}
+
+//===========================================================================
+template <typename T>
+static void rankTest() {
+    int line = 0;
+    IntegralSet<T> set;
+    EXPECT(set.rank(5) == 0);
+    EXPECT(!set.select(0));
+    set.assign("3 5 7");
+    EXPECT(set.rank(3) == 0 && set.rank(4) == 1 && set.rank(8) == 3);
+    EXPECT(*set.select(2) == 7 && !set.select(3));
+
+    // Bitmap, run, and full nodes under meta nodes.
+    set.clear();
+    for (T i = 0; i < 10'000; i += 2)
+        set.insert(i);
+    set.insert(100'000, 50'000);
+    set.insert(1'000'000, 3);
+    EXPECT(set.size() == 55'003);
+    EXPECT(set.rank(101) == 51);
+    EXPECT(set.rank(100'000) == 5000);
+    EXPECT(set.rank(120'000) == 25'000);
+    EXPECT(set.rank(1'000'001) == 55'001);
+    EXPECT(*set.select(50) == 100);
+    EXPECT(*set.select(5000) == 100'000);
+    EXPECT(*set.select(55'002) == 1'000'002);
+    EXPECT(!set.select(55'003));
+    size_t pos = 0;
+    for (auto val : set) {
+        if (set.rank(val) != pos || *set.select(pos) != val)
+            break;
+        pos += 1;
+    }
+    EXPECT(pos == set.size());
+
+    // Counts follow changes made by erase and by combining sets.
+    set.erase(0, 5000);
+    set.assertCounts();
+    EXPECT(set.size() == 52'503);
+    EXPECT(*set.select(0) == 5000);
+    auto tmp = set;
+    tmp.intersect(IntegralSet<T>(100'000, 10));
+    EXPECT(tmp.size() == 10 && tmp.rank(100'005) == 5);
+    tmp.insert(IntegralSet<T>(0, 100));
+    EXPECT(tmp.size() == 110 && *tmp.select(100) == 100'000);
+    tmp.erase(set);
+    tmp.assertCounts();
+    EXPECT(tmp.size() == 100 && tmp.rank(1'000'000) == 100);
+
+    // Sets combined as rvalues are left empty, with the nodes taken from them
+    // counted by the result.
+    auto src = set;
+    tmp.insert(move(src));
+    EXPECT(src.empty() && tmp.size() == 52'603);
+    tmp.assertCounts();
+    src = set;
+    tmp.intersect(move(src));
+    EXPECT(src.empty() && tmp == set);
+    tmp.assertCounts();
+}
+
+//===========================================================================
+// Sets large enough to be split into pieces run on the compute queue give the
+// same results as the serial operations.
+template <typename T>
+static void parallelTest() {
+    int line = 0;
+    IntegralSet<T> a;
+    IntegralSet<T> b;
+    for (T i = 0; i < 1'000'000; i += 3)
+        a.insert(i);
+    for (T i = 0; i < 1'000'000; i += 5)
+        b.insert(i);
+    b.insert(2'000'000, 100'000);
+
+    auto x = a;
+    auto y = a;
+    x.parallelInsert(b);
+    y.insert(b);
+    EXPECT(x == y && x.size() == y.size());
+    x.assertCounts();
+    x = a;
+    y = a;
+    x.parallelErase(b);
+    y.erase(b);
+    EXPECT(x == y && x.size() == y.size());
+    x.assertCounts();
+    x = a;
+    y = a;
+    x.parallelIntersect(b);
+    y.intersect(b);
+    EXPECT(x == y && x.size() == 66'667);
+    x.assertCounts();
+
+    // Multiples of 2 through 7.
+    vector<IntegralSet<T>> sets(6);
+    vector<const IntegralSet<T> *> ptrs;
+    for (T step = 2; auto && set : sets) {
+        for (T i = 0; i < 1'000'000; i += step)
+            set.insert(i);
+        ptrs.push_back(&set);
+        step += 1;
+    }
+    x.unionAll(ptrs);
+    y.clear();
+    for (auto && set : sets)
+        y.insert(set);
+    EXPECT(x == y && x.size() == y.size());
+    x.assertCounts();
+    x.intersectAll(ptrs);
+    x.assertCounts();
+    EXPECT(x.size() == 2381 && *x.select(1) == 420);
+    ptrs.push_back(&x);
+    x.unionAll(ptrs);
+    EXPECT(x == y);
+    x.intersectAll({});
+    EXPECT(x.empty());
+}
+
+//===========================================================================
+// Query a saved set through a memory mapping of the file it was saved to.
+static void mappedTest() {
+    using enum File::OpenMode;
+    int line = 0;
+
+    UnsignedSet set;
+    for (unsigned i = 0; i < 100'000; i += 3)
+        set.insert(i);
+    CharBuf buf;
+    set.save(&buf);
+    auto data = toString(buf);
+
+    FileHandle file;
+    if (auto ec = fileCreateTemp(&file, fRemove | fBlocking)) {
+        logMsgError() << "Create temp file failed, " << ec;
+        return;
+    }
+    fileRemoveOnClose(file);
+    fileWriteWait(nullptr, file, 0, data);
+    const char * base;
+    if (auto ec = fileOpenView(base, file, File::View::kReadOnly)) {
+        logMsgError() << "Open view failed, " << ec;
+    } else {
+        UnsignedSetView view;
+        EXPECT(view.parse({base, data.size()}));
+        EXPECT(view.size() == set.size());
+        EXPECT(view.contains(99'999) && !view.contains(99'998));
+        EXPECT(*view.lowerBound(50'000) == 50'001);
+        fileCloseView(file, base);
+    }
+    fileClose(file);
+}
+
 //===========================================================================
 template <typename T>
 static void allTests() {
     memleakTest<T>();
     miscTest<T>();
     vectorTest<T>();
+    rfindTest<T>();
     containTest<T>();
+    kernelTest<T>();
+    serialTest<T>();
+    runsTest<T>();
+    rankTest<T>();
+    parallelTest<T>();
+}
+
+
+/****************************************************************************
+*
+*   Benchmark
+*
+***/
+
+//===========================================================================
+// Returns set where each value has a 1 in "spacing" chance of being present,
+// so 2 gives bitmap nodes and 96 gives vectors.
+static UnsignedSet benchSet(unsigned seed, unsigned spacing) {
+    mt19937 rng(seed);
+    vector<unsigned> vals;
+    for (unsigned i = 0; i < kBenchRange; ++i) {
+        if (rng() % spacing == 0)
+            vals.push_back(i);
+    }
+    UnsignedSet out;
+    out.insert(vals.data(), vals.data() + vals.size());
+    return out;
+}
+
+//===========================================================================
+static void benchKernels() {
+    using Fn = void(UnsignedSet * left, const UnsignedSet & right);
+    auto dense1 = benchSet(1, 2);
+    auto dense2 = benchSet(2, 2);
+    auto sparse1 = benchSet(3, 96);
+    auto sparse2 = benchSet(4, 96);
+    struct Op {
+        const char * name;
+        const UnsignedSet & left;
+        const UnsignedSet & right;
+        Fn * fn;
+    } ops[] = {
+        { "bitmap or", dense1, dense2,
+            [](UnsignedSet * l, const UnsignedSet & r) { l->insert(r); } },
+        { "bitmap and", dense1, dense2,
+            [](UnsignedSet * l, const UnsignedSet & r) { l->intersect(r); } },
+        { "bitmap andnot", dense1, dense2,
+            [](UnsignedSet * l, const UnsignedSet & r) { l->erase(r); } },
+        { "bitmap contains", dense1, dense1,
+            [](UnsignedSet * l, const UnsignedSet & r) {
+                s_benchHits += l->contains(r);
+            } },
+        { "vector or", sparse1, sparse2,
+            [](UnsignedSet * l, const UnsignedSet & r) { l->insert(r); } },
+        { "vector and", sparse1, sparse2,
+            [](UnsignedSet * l, const UnsignedSet & r) { l->intersect(r); } },
+        { "vector probe", sparse1, dense1,
+            [](UnsignedSet * l, const UnsignedSet & r) { l->intersect(r); } },
+        { "vector contains", dense1, sparse1,
+            [](UnsignedSet * l, const UnsignedSet & r) {
+                s_benchHits += l->contains(r);
+            } },
+    };
+    struct Level {
+        IntSetSimd simd;
+        const char * name;
+    } levels[] = {
+        { IntSetSimd::kScalar, "scalar" },
+        { IntSetSimd::kSse42, "sse4.2" },
+        { IntSetSimd::kAvx2, "avx2" },
+    };
+
+    // Only the instruction sets the CPU supports.
+    auto best = intSetSimd();
+    auto numLevels = size(levels);
+    while (levels[numLevels - 1].simd > best)
+        numLevels -= 1;
+
+    cout << "IntegralSet kernels, millions of values per second\n"
+        << setw(16) << "";
+    for (size_t i = 0; i < numLevels; ++i)
+        cout << setw(12) << levels[i].name;
+    cout << '\n';
+    for (auto && op : ops) {
+        cout << left << setw(16) << op.name << right;
+        auto values = double(op.left.size() + op.right.size()) * kBenchReps;
+        for (size_t i = 0; i < numLevels; ++i) {
+            intSetSetSimd(levels[i].simd);
+            Duration elapsed = {};
+            for (auto rep = 0; rep < kBenchReps; ++rep) {
+                auto tmp = op.left;
+                auto start = timeNow();
+                op.fn(&tmp, op.right);
+                elapsed += timeNow() - start;
+            }
+            chrono::duration<double> secs = elapsed;
+            cout << setw(12) << (uint64_t) (values / secs.count() / 1e6);
+        }
+        cout << endl;
+    }
+    intSetSetSimd(best);
+}
+
+//===========================================================================
+// Compare restoring a set from its text form with loading it from the binary
+// format, and with querying the binary format in place.
+static void benchLoad() {
+    auto set = benchSet(1, 2);
+    set.insert(benchSet(3, 96));
+    ostringstream os;
+    os << set;
+    auto text = os.str();
+    CharBuf buf;
+    set.save(&buf);
+    auto data = toString(buf);
+
+    cout << "IntegralSet load, millions of values per second\n";
+    auto report = [&](const char name[], size_t bytes, auto && fn) {
+        auto start = timeNow();
+        for (auto rep = 0; rep < kBenchReps; ++rep)
+            fn();
+        chrono::duration<double> elapsed = timeNow() - start;
+        auto values = double(set.size()) * kBenchReps;
+        cout << left << setw(16) << name << right
+            << setw(12) << (uint64_t) (values / elapsed.count() / 1e6)
+            << setw(12) << bytes << " bytes" << endl;
+    };
+    report("text", text.size(), [&]() {
+        UnsignedSet tmp(text);
+        s_benchHits += tmp.size();
+    });
+    report("binary", data.size(), [&]() {
+        UnsignedSet tmp;
+        if (tmp.load(data))
+            s_benchHits += tmp.size();
+    });
+    report("view contains", data.size(), [&]() {
+        UnsignedSetView view;
+        if (view.parse(data)) {
+            for (unsigned i = 0; i < set.size(); ++i)
+                s_benchHits += view.contains(i * 7 % kBenchRange);
+        }
+    });
+}
+
+//===========================================================================
+namespace {
+
+// Tracks the bytes the sets it's given to have allocated.
+class CountingHeap : public pmr::memory_resource {
+public:
+    size_t bytes() const { return m_bytes; }
+
+private:
+    // Inherited via std::pmr::memory_resource
+    void * do_allocate(size_t bytes, size_t alignment) override;
+    void do_deallocate(void * ptr, size_t bytes, size_t alignment) override;
+    bool do_is_equal(const memory_resource & other) const noexcept override;
+
+    size_t m_bytes = 0;
+};
+
+} // namespace
+
+//===========================================================================
+void * CountingHeap::do_allocate(size_t bytes, size_t alignment) {
+    m_bytes += bytes;
+    return pmr::new_delete_resource()->allocate(bytes, alignment);
+}
+
+//===========================================================================
+void CountingHeap::do_deallocate(
+    void * ptr,
+    size_t bytes,
+    size_t alignment
+) {
+    m_bytes -= bytes;
+    pmr::new_delete_resource()->deallocate(ptr, bytes, alignment);
+}
+
+//===========================================================================
+bool CountingHeap::do_is_equal(
+    const memory_resource & other
+) const noexcept {
+    return this == &other;
+}
+
+//===========================================================================
+// Memory used by sets that are mostly long ranges of values.
+static void benchRuns() {
+    using PmrSet = IntegralSet<unsigned, pmr::polymorphic_allocator<unsigned>>;
+    cout << "IntegralSet ranges, memory\n"
+        << left << setw(16) << "" << right
+        << setw(12) << "ranges" << setw(12) << "bytes"
+        << setw(12) << "per range" << '\n';
+    auto report = [](const char name[], auto && fn) {
+        CountingHeap heap;
+        PmrSet set(&heap);
+        fn(&set);
+        auto r = set.ranges();
+        auto num = (size_t) distance(r.begin(), r.end());
+        cout << left << setw(16) << name << right
+            << setw(12) << num
+            << setw(12) << heap.bytes()
+            << setw(12) << heap.bytes() / max(num, (size_t) 1) << endl;
+    };
+    mt19937 rng(5);
+
+    // Free pages of a page heap, alternating free and allocated spans.
+    report("free spans", [&](PmrSet * set) {
+        for (unsigned pos = 0; pos < kBenchRange; ) {
+            auto len = 1 + rng() % 200;
+            set->insert(pos, len);
+            pos += len + 1 + rng() % 200;
+        }
+    });
+    // Few long ranges at random positions.
+    report("long ranges", [&](PmrSet * set) {
+        for (auto i = 0; i < 1000; ++i)
+            set->insert(rng() % kBenchRange, 1 + rng() % 10'000);
+    });
+    // Everything except for scattered holes.
+    report("full w/ holes", [&](PmrSet * set) {
+        set->insert(0, kBenchRange);
+        for (auto i = 0; i < 1000; ++i)
+            set->erase(rng() % kBenchRange);
+    });
+}
+
+//===========================================================================
+// Fetch pages of a large set, at random offsets, by walking to each with an
+// iterator and by jumping to it with select().
+static void benchPages() {
+    mt19937 rng(6);
+    vector<unsigned> vals;
+    for (unsigned i = 0; i < kBenchPageValues; ++i)
+        vals.push_back(2 * i + rng() % 2);
+    UnsignedSet set;
+    set.insert(vals.data(), vals.data() + vals.size());
+    vector<size_t> pages(kBenchPages);
+    for (auto && page : pages)
+        page = rng() % (kBenchPageValues / kBenchPageSize);
+
+    cout << "IntegralSet pages of " << kBenchPageSize << " from "
+        << set.size() << " values, microseconds per page\n";
+    auto report = [&](const char name[], auto && fn) {
+        auto start = timeNow();
+        for (auto page : pages) {
+            auto i = fn(page * kBenchPageSize);
+            for (size_t n = 0; n < kBenchPageSize && i; ++n, ++i)
+                s_benchHits += *i;
+        }
+        chrono::duration<double, micro> elapsed = timeNow() - start;
+        cout << left << setw(16) << name << right
+            << setw(12) << (uint64_t) (elapsed.count() / kBenchPages)
+            << endl;
+    };
+    report("iterate", [&](size_t pos) {
+        auto i = set.begin();
+        for (; pos && i; --pos)
+            ++i;
+        return i;
+    });
+    report("select", [&](size_t pos) { return set.select(pos); });
+}
+
+//===========================================================================
+// Combine large sets a pair at a time on the calling thread, and with the
+// parallel and many set versions that spread the work over the compute queue.
+static void benchParallel() {
+    using Fn = void(UnsignedSet * out);
+    vector<UnsignedSet> dense;
+    for (unsigned i = 0; i < kBenchDense; ++i)
+        dense.push_back(benchSet(10 + i, 2));
+    vector<UnsignedSet> lists(kBenchLists);
+    mt19937 rng(7);
+    for (auto && list : lists) {
+        auto spacing = 2 + rng() % 29;
+        for (auto i = rng() % spacing; i < kBenchRange; ) {
+            list.insert(i);
+            i += 1 + rng() % (2 * spacing - 1);
+        }
+    }
+
+    cout << "IntegralSet parallel, milliseconds\n"
+        << left << setw(16) << "" << right
+        << setw(12) << "serial" << setw(12) << "parallel" << '\n';
+    auto report = [](
+        const char name[],
+        const UnsignedSet & init,
+        const function<Fn> & serial,
+        const function<Fn> & parallel
+    ) {
+        auto time = [&](const function<Fn> & fn) {
+            Duration elapsed = {};
+            for (auto rep = 0; rep < kBenchReps; ++rep) {
+                auto tmp = init;
+                auto start = timeNow();
+                fn(&tmp);
+                elapsed += timeNow() - start;
+                s_benchHits += tmp.size();
+            }
+            chrono::duration<double, milli> ms = elapsed;
+            return (uint64_t) (ms.count() / kBenchReps);
+        };
+        cout << left << setw(16) << name << right
+            << setw(12) << time(serial)
+            << setw(12) << time(parallel) << endl;
+    };
+    auto & left = dense[0];
+    auto & right = dense[1];
+    report("insert", left,
+        [&](UnsignedSet * out) { out->insert(right); },
+        [&](UnsignedSet * out) { out->parallelInsert(right); });
+    report("erase", left,
+        [&](UnsignedSet * out) { out->erase(right); },
+        [&](UnsignedSet * out) { out->parallelErase(right); });
+    report("intersect", left,
+        [&](UnsignedSet * out) { out->intersect(right); },
+        [&](UnsignedSet * out) { out->parallelIntersect(right); });
+
+    vector<const UnsignedSet *> ptrs;
+    for (auto && list : lists)
+        ptrs.push_back(&list);
+    report("union all", {},
+        [&](UnsignedSet * out) {
+            for (auto && list : lists)
+                out->insert(list);
+        },
+        [&](UnsignedSet * out) { out->unionAll(ptrs); });
+    ptrs.clear();
+    for (auto && set : dense)
+        ptrs.push_back(&set);
+    report("intersect all", dense[0],
+        [&](UnsignedSet * out) {
+            for (auto && set : dense)
+                out->intersect(set);
+        },
+        [&](UnsignedSet * out) { out->intersectAll(ptrs); });
 }
 
+
+/****************************************************************************
+*
+*   Application
+*
+***/
+
 //===========================================================================
 static void app(Cli & cli) {
-    allTests<int>();
-    allTests<unsigned>();
+    if (!s_test && !s_bench) {
+        cout << "No tests run." << endl;
+        return appSignalShutdown(EX_OK);
+    }
+
+    if (s_test) {
+        // Once with each instruction set the set operation kernels can use.
+        auto best = intSetSimd();
+        for (auto simd : {
+            IntSetSimd::kScalar,
+            IntSetSimd::kSse42,
+            IntSetSimd::kAvx2
+        }) {
+            if (intSetSetSimd(simd) != simd)
+                break;
+            allTests<int>();
+            allTests<unsigned>();
+        }
+        intSetSetSimd(best);
+        mappedTest();
+    }
+    if (s_bench) {
+        benchKernels();
+        benchLoad();
+        benchRuns();
+        benchPages();
+        benchParallel();
+    }
     testSignalShutdown();
 }
 
@@ -288,6 +1116,13 @@ static void app(Cli & cli) {
 
 //===========================================================================
 int main(int argc, char * argv[]) {
-    Cli().action(app);
+    Cli cli;
+    cli.helpNoArgs().action(app);
+    cli.opt(&s_bench, "b bench.")
+        .desc("Benchmark set operation kernels, loading saved sets, memory "
+            "used by ranges, paging through large sets, and parallel set "
+            "operations.");
+    cli.opt(&s_test, "test", false)
+        .desc("Run internal unit tests.");
     return appRun(argc, argv, fAppTest);
 }
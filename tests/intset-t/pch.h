@@ -1,4 +1,4 @@
-// Copyright Glen Knowles 2017 - 2025.
+// Copyright Glen Knowles 2017 - 2026.
 // Distributed under the Boost Software License, Version 1.0.
 //
 // pch.h - dim test intset
@@ -9,11 +9,15 @@
 // External library public headers
 #include "app/app.h"
 #include "core/log.h"
+#include "file/file.h"
 #include "system/console.h"
 #include "tools/tools.h"
 
 // Standard headers
+#include <chrono>
+#include <iomanip>
 #include <iostream>
+#include <random>
 #include <regex>
 
 // Platform headers
@@ -1,4 +1,4 @@
-// Copyright Glen Knowles 2022.
+// Copyright Glen Knowles 2022 - 2026.
 // Distributed under the Boost Software License, Version 1.0.
 //
 // pch.h - dim test perf
@@ -13,7 +13,10 @@
 #include "tools/tools.h"
 
 // Standard headers
+#include <chrono>
 #include <iostream>
+#include <thread>
+#include <vector>
 
 // Platform headers
 // External library internal headers
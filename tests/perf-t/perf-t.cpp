@@ -1,4 +1,4 @@
-// Copyright Glen Knowles 2022 - 2025.
+// Copyright Glen Knowles 2022 - 2026.
 // Distributed under the Boost Software License, Version 1.0.
 //
 // perf-t.cpp - dim test perf
@@ -23,6 +23,11 @@ using namespace Dim;
 #define EXPECT_VAL(cnt, name, val, expected) \
     testValue(line ? line : __LINE__, cnt, name, val, expected);
 
+template <typename T>
+concept Incrementable = requires(T & v) { ++v; };
+template <typename T>
+concept Decrementable = requires(T & v) { --v; };
+
 
 /****************************************************************************
 *
@@ -43,15 +48,15 @@ static string_view getValue(string_view name) {
 }
 
 //===========================================================================
-template<typename T, typename U>
-requires is_convertible_v<U, T>
+template<typename C, typename U>
 static void testValue(
     int line,
-    atomic<T> & cnt,
+    C & cnt,
     string_view name,
     U val,
     string_view expected
 ) {
+    using T = decltype(cnt.load());
     cnt = (T) val;
     auto pval = getValue(name);
     EXPECT(pval == expected);
@@ -125,6 +130,22 @@ static void app(Cli & cli) {
     EXPECT_VAL(umc, name, 1'000'000, "1000000");
     EXPECT_VAL(umc, name, -1, "4294967295");
 
+    //-----------------------------------------------------------------------
+    // 64-bit unsigned counters
+    auto & u64def = u64perf("test.uint64.default");
+    auto & u64si = u64perf("test.uint64.siUnits", PerfFormat::kSiUnits);
+
+    name = "test.uint64.default";
+    EXPECT_VAL(u64def, name, 5'000'000'000, "5,000,000,000");
+    name = "test.uint64.siUnits";
+    EXPECT_VAL(u64si, name, 1'100'001, "1.1M");
+    EXPECT_VAL(u64si, name, 5'000'000'000, "5G");
+
+    // Totals carry past where an unsigned would wrap.
+    u64def = 0xffff'ffff;
+    u64def += 0xffff'ffff;
+    EXPECT(u64def == 0x1'ffff'fffe);
+
     //-----------------------------------------------------------------------
     // Floating point counters
     auto & fdef = fperf("test.float.default");
@@ -152,6 +173,69 @@ static void app(Cli & cli) {
     name = "test.float.machine";
     EXPECT_VAL(fmc, name, 1'000'000, "1e+06");
 
+    //-----------------------------------------------------------------------
+    // Sharded counters sum the updates made from every thread
+    auto & ushard = uperf("test.unsigned.sharded");
+    vector<thread> threads;
+    for (auto i = 0; i < 8; ++i) {
+        threads.emplace_back([&]() {
+            for (auto j = 0; j < 10'000; ++j) {
+                ushard += 2;
+                ushard -= 1;
+            }
+        });
+    }
+    for (auto && thr : threads)
+        thr.join();
+    EXPECT(ushard == 80'000u);
+    EXPECT(getValue("test.unsigned.sharded") == "80,000");
+    ushard = 5;
+    EXPECT(ushard == 5u);
+
+    // The subtract lands in this thread's shard, not necessarily the one
+    // holding the 5, and only the sum of all of them comes out zero. A read
+    // is a snapshot of that sum, not the result of any one update, so there
+    // are no ++ or -- operators to tempt use as a latch.
+    ushard -= 5;
+    EXPECT(ushard == 0u);
+    static_assert(!Incrementable<PerfCounter<unsigned>>);
+    static_assert(!Decrementable<PerfCounter<unsigned>>);
+
+    //-----------------------------------------------------------------------
+    // Histograms
+    auto & hist = hperf("test.hist");
+    EXPECT(getValue("test.hist (count)") == "0");
+    EXPECT(hist.percentile(0.5) == 0s);
+    for (auto i = 1; i <= 1000; ++i)
+        hist.add(i * 1ms);
+    EXPECT(hist.count() == 1000);
+    EXPECT(getValue("test.hist (count)") == "1,000");
+
+    // Reported values are the top of their bucket, never less than and
+    // within 12.5% of the exact percentile.
+    struct {
+        double fraction;
+        Duration exact;
+    } const pcts[] = {
+        { 0.5, 500ms },
+        { 0.99, 990ms },
+        { 0.999, 999ms },
+        { 1, 1000ms },
+    };
+    for (auto && pct : pcts) {
+        auto val = hist.percentile(pct.fraction);
+        EXPECT(val >= pct.exact && val <= pct.exact * 1.125);
+    }
+    hist.add(-1s);
+    hist.add(7min);
+    EXPECT(hist.overflow() == 0);
+    EXPECT(hist.percentile(0) == 0s);
+    EXPECT(hist.percentile(1) > 6min && hist.percentile(1) < 8min);
+    hist.add(24h);
+    EXPECT(hist.overflow() == 1);
+    EXPECT(hist.count() == 1003);
+    EXPECT(hist.percentile(1) == Duration::max());
+
     testSignalShutdown();
 }
 
@@ -191,6 +191,21 @@ static void testCopy() {
     }
 }
 
+//===========================================================================
+static void testCase() {
+    int line = 0;
+
+    EXPECT(toLower("AbC-1") == "abc-1");
+    EXPECT(toUpper("AbC-1") == "ABC-1");
+    EXPECT(equalNoCase("Keep-Alive", "keep-alive"));
+    EXPECT(equalNoCase("", ""));
+    EXPECT(!equalNoCase("chunked", "chunk"));
+    EXPECT(!equalNoCase("gzip", "gzid"));
+    // Only letters fold, '@' and '`' differ from 'A' and 'a' by 0x20 too.
+    EXPECT(!equalNoCase("@", "`"));
+    EXPECT(!equalNoCase("[", "{"));
+}
+
 //===========================================================================
 static void testInterp() {
     using enum InterpFlag;
@@ -218,6 +233,7 @@ static void app(Cli & cli) {
     testToChars();
     testSplit();
     testCopy();
+    testCase();
     testInterp();
 
     testSignalShutdown();
@@ -0,0 +1,6 @@
+// Copyright Glen Knowles 2026.
+// Distributed under the Boost Software License, Version 1.0.
+//
+// pch.cpp - dim test task
+#include "pch.h"
+#pragma hdrstop
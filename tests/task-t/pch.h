@@ -0,0 +1,33 @@
+// Copyright Glen Knowles 2026.
+// Distributed under the Boost Software License, Version 1.0.
+//
+// pch.h - dim test task
+
+// Public header
+#include "core/task.h"
+
+// External library public headers
+#include "dimcli/cli.h"
+
+#include "app/app.h"
+#include "core/log.h"
+#include "core/time.h"
+#include "system/system.h"
+#include "tools/tools.h"
+
+// Standard headers
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <ranges>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Platform headers
+// External library internal headers
+// Internal headers
@@ -0,0 +1,494 @@
+// Copyright Glen Knowles 2026.
+// Distributed under the Boost Software License, Version 1.0.
+//
+// task-t.cpp - dim test task
+#include "pch.h"
+#pragma hdrstop
+
+using namespace std;
+using namespace Dim;
+
+
+/****************************************************************************
+*
+*   Tuning parameters
+*
+***/
+
+const VersionInfo kVersion = { 1 };
+
+// Tasks pushed by each producer thread when benchmarking.
+const size_t kBenchTasks = 200'000;
+
+// Depth of the binary tree of tasks spawned when benchmarking fork/join.
+const unsigned kForkDepth = 20;
+
+
+/****************************************************************************
+*
+*   Declarations
+*
+***/
+
+#define EXPECT(...)                                                         \
+    if (!bool(__VA_ARGS__)) {                                               \
+        logMsgError() << "Line " << (line ? line : __LINE__) << ": EXPECT(" \
+                      << #__VA_ARGS__ << ") failed";                        \
+    }
+
+namespace {
+
+// Tasks completed for a single producer, padded so that producers don't
+// share cache lines with each other.
+struct alignas(64) Lane {
+    atomic<size_t> remaining;
+};
+
+class CountTask : public ITaskNotify {
+public:
+    Lane * lane{};
+
+private:
+    void onTask() override;
+};
+
+// Binary tree of tasks, each spawning two more until the leaves are reached.
+class ForkTask : public ITaskNotify {
+public:
+    ForkTask(TaskQueueHandle q, unsigned depth);
+
+private:
+    void onTask() override;
+
+    TaskQueueHandle m_q;
+    unsigned m_depth;
+};
+
+// Counts itself as run and reports to its group that it's done.
+class GroupTask : public ITaskNotify {
+public:
+    TaskGroup * group{};
+    atomic<int> * num{};
+
+private:
+    void onTask() override;
+};
+
+// Heap that counts the allocations it makes on behalf of coroutine frames.
+class CountHeap : public IHeap {
+public:
+    size_t allocs{};
+
+private:
+    void * do_allocate(size_t bytes, size_t alignment) override;
+    void do_deallocate(void * ptr, size_t bytes, size_t alignment) override;
+
+    TempHeap m_heap;
+};
+
+} // namespace
+
+
+/****************************************************************************
+*
+*   Variables
+*
+***/
+
+static bool s_verbose;
+static bool s_test;
+static unsigned s_bench;
+
+static mutex s_mut;
+static condition_variable s_cv;
+static size_t s_lanesRunning;
+static atomic<size_t> s_leavesRunning;
+static CountHeap s_coroHeap;
+
+
+/****************************************************************************
+*
+*   CountTask
+*
+***/
+
+//===========================================================================
+void CountTask::onTask() {
+    if (lane->remaining.fetch_sub(1) == 1) {
+        scoped_lock lk{s_mut};
+        if (!--s_lanesRunning)
+            s_cv.notify_all();
+    }
+}
+
+
+/****************************************************************************
+*
+*   ForkTask
+*
+***/
+
+//===========================================================================
+ForkTask::ForkTask(TaskQueueHandle q, unsigned depth)
+    : m_q{q}
+    , m_depth{depth}
+{}
+
+//===========================================================================
+void ForkTask::onTask() {
+    if (m_depth) {
+        ITaskNotify * tasks[] = {
+            new ForkTask(m_q, m_depth - 1),
+            new ForkTask(m_q, m_depth - 1),
+        };
+        taskPush(m_q, tasks, size(tasks));
+    } else if (!--s_leavesRunning) {
+        scoped_lock lk{s_mut};
+        s_cv.notify_all();
+    }
+    delete this;
+}
+
+
+/****************************************************************************
+*
+*   GroupTask
+*
+***/
+
+//===========================================================================
+void GroupTask::onTask() {
+    *num += 1;
+    group->done();
+}
+
+
+/****************************************************************************
+*
+*   CountHeap
+*
+***/
+
+//===========================================================================
+void * CountHeap::do_allocate(size_t bytes, size_t alignment) {
+    allocs += 1;
+    return m_heap.allocate(bytes, alignment);
+}
+
+//===========================================================================
+void CountHeap::do_deallocate(void * ptr, size_t bytes, size_t alignment) {
+    m_heap.deallocate(ptr, bytes, alignment);
+}
+
+
+/****************************************************************************
+*
+*   Helpers
+*
+***/
+
+//===========================================================================
+// Runs numThreads producer threads, each pushing count tasks. If shared, all
+// producers push to a single queue with numThreads threads, otherwise each
+// producer gets its own single threaded queue. Returns tasks per second.
+static double runLanes(
+    size_t numThreads,
+    bool shared,
+    size_t count,
+    size_t batch = 1
+) {
+    vector<TaskQueueHandle> qs;
+    if (shared) {
+        qs.push_back(taskCreateQueue("Shared", (int) numThreads));
+    } else {
+        for (auto i = 0; i < numThreads; ++i)
+            qs.push_back(taskCreateQueue("Lane", 1));
+    }
+    vector<Lane> lanes(numThreads);
+    vector<vector<CountTask>> tasks(numThreads);
+    for (auto i = 0; i < numThreads; ++i) {
+        lanes[i].remaining = count;
+        tasks[i].resize(count);
+        for (auto && task : tasks[i])
+            task.lane = &lanes[i];
+    }
+    s_lanesRunning = numThreads;
+
+    auto start = timeNow();
+    vector<thread> producers;
+    for (auto i = 0; i < numThreads; ++i) {
+        producers.emplace_back([&, i]() {
+            auto q = qs[shared ? 0 : i];
+            vector<ITaskNotify *> ptrs(batch);
+            auto & lt = tasks[i];
+            for (size_t pos = 0; pos < lt.size(); pos += batch) {
+                auto num = min(batch, lt.size() - pos);
+                for (auto j = 0; j < num; ++j)
+                    ptrs[j] = &lt[pos + j];
+                taskPush(q, ptrs.data(), num);
+            }
+        });
+    }
+    for (auto && thr : producers)
+        thr.join();
+    {
+        unique_lock lk{s_mut};
+        while (s_lanesRunning)
+            s_cv.wait(lk);
+    }
+    chrono::duration<double> elapsed = timeNow() - start;
+
+    for (auto && q : qs)
+        taskSetQueueThreads(q, 0);
+    return numThreads * count / elapsed.count();
+}
+
+//===========================================================================
+// Runs a tree of fork tasks of the requested depth on the queue and returns
+// tasks per second.
+static double runForkJoin(TaskQueueHandle q, unsigned depth) {
+    s_leavesRunning = size_t{1} << depth;
+    auto start = timeNow();
+    taskPush(q, new ForkTask(q, depth));
+    {
+        unique_lock lk{s_mut};
+        while (s_leavesRunning)
+            s_cv.wait(lk);
+    }
+    chrono::duration<double> elapsed = timeNow() - start;
+    return ((size_t{2} << depth) - 1) / elapsed.count();
+}
+
+
+/****************************************************************************
+*
+*   Tests
+*
+***/
+
+//===========================================================================
+static void internalTests() {
+    int line = 0;
+
+    // Every task is run exactly once, whether the producers share a queue
+    // or not and whether pushed individually or in batches.
+    for (auto shared : {false, true}) {
+        for (auto batch : {1, 7}) {
+            if (s_verbose) {
+                cout << "Lanes - shared: " << shared << ", batch: " << batch
+                    << endl;
+            }
+            auto rate = runLanes(4, shared, 10'000, batch);
+            EXPECT(rate > 0);
+        }
+    }
+
+    // Queues with no threads hold their tasks until threads are added.
+    atomic<int> num = 0;
+    auto q = taskCreateQueue("Paused", 1);
+    taskSetQueueThreads(q, 0);
+    for (auto i = 0; i < 10; ++i)
+        taskPush(q, [&]() { num += 1; });
+    EXPECT(num == 0);
+    taskSetQueueThreads(q, 2);
+    while (num < 10)
+        this_thread::yield();
+    taskSetQueueThreads(q, 0);
+    EXPECT(num == 10);
+
+    // A thread waiting on a group runs the group's tasks even when they're
+    // queued behind a request for a thread to end, here its own.
+    num = 0;
+    atomic<bool> waited = false;
+    q = taskCreateQueue("Shrink", 1);
+    taskPush(q, [&]() {
+        TaskGroup group(q);
+        taskSetQueueThreads(q, 0);
+        vector<GroupTask> gtasks(10);
+        for (auto && task : gtasks) {
+            task.group = &group;
+            task.num = &num;
+            group.push(&task);
+        }
+        group.wait();
+        waited = true;
+    });
+    while (!waited)
+        this_thread::yield();
+    EXPECT(num == 10);
+
+    // Compute queue steals work between its threads, tasks spawned by tasks
+    // all complete regardless of the number of threads.
+    auto cq = taskComputeQueue();
+    for (auto threads : {1, 3, 5}) {
+        taskSetQueueThreads(cq, threads);
+        auto rate = runForkJoin(cq, 12);
+        EXPECT(rate > 0);
+    }
+
+    // Batches pushed from outside the compute queue are spread across its
+    // threads and every task is run.
+    Lane lane;
+    lane.remaining = 100;
+    vector<CountTask> tasks(100);
+    vector<ITaskNotify *> ptrs;
+    for (auto && task : tasks) {
+        task.lane = &lane;
+        ptrs.push_back(&task);
+    }
+    s_lanesRunning = 1;
+    taskPushCompute(ptrs.data(), ptrs.size());
+    {
+        unique_lock lk{s_mut};
+        while (s_lanesRunning)
+            s_cv.wait(lk);
+    }
+    EXPECT(lane.remaining == 0);
+
+    // Parallel for visits every value exactly once, whether fn takes values
+    // or subranges.
+    vector<atomic<int>> visits(10'000);
+    taskParallelFor(0, visits.size(), 100, [&](size_t i) { visits[i] += 1; });
+    taskParallelFor(0, visits.size(), 7, [&](size_t first, size_t last) {
+        for (; first < last; ++first)
+            visits[first] += 1;
+    });
+    EXPECT(ranges::all_of(visits, [](auto & a) { return a == 2; }));
+
+    // Empty and single subrange ranges run on the calling thread.
+    num = 0;
+    taskParallelFor(5, 5, 1, [&](size_t) { num += 1; });
+    EXPECT(num == 0);
+    taskParallelFor(5, 8, 10, [&](size_t) { num += 1; });
+    EXPECT(num == 3);
+
+    // Partial results are combined in range order.
+    auto sum = taskParallelReduce(
+        1,
+        100'001,
+        1000,
+        uint64_t{0},
+        [](size_t i) { return (uint64_t) i; }
+    );
+    EXPECT(sum == 5'000'050'000);
+    auto digits = taskParallelReduce(
+        0,
+        20,
+        3,
+        string{},
+        [](size_t i) { return string(1, char('a' + i)); }
+    );
+    EXPECT(digits == "abcdefghijklmnopqrst");
+
+    // Nested loops from within compute threads don't exhaust the queue, the
+    // waiting threads help run the inner loops.
+    atomic<size_t> inner = 0;
+    taskParallelFor(0, 50, 1, [&](size_t) {
+        taskParallelFor(0, 100, 10, [&](size_t) { inner += 1; });
+    });
+    EXPECT(inner == 5000);
+}
+
+//===========================================================================
+// Runs on the event thread, which must be free for the timers to fire, so
+// the test finishes by shutting down rather than being waited on.
+static CoTask coroTests(allocator_arg_t, IHeap * heap) {
+    int line = 0;
+
+    auto eventId = this_thread::get_id();
+    co_await taskOn(taskComputeQueue());
+    EXPECT(this_thread::get_id() != eventId);
+
+    // Timers resume on the event queue unless told otherwise.
+    auto start = timeNow();
+    co_await timerSleep(5ms);
+    EXPECT(timeNow() - start >= 5ms);
+    EXPECT(this_thread::get_id() == eventId);
+    co_await timerSleep(1ms, taskComputeQueue());
+    EXPECT(this_thread::get_id() != eventId);
+    co_await timerSleep(0ms);
+    co_await taskOn(taskEventQueue());
+
+    // Frame came from the heap that was passed in.
+    EXPECT(s_coroHeap.allocs == 1);
+
+    testSignalShutdown();
+}
+
+//===========================================================================
+static void bench(unsigned maxThreads) {
+    cout << "Tasks per second (" << kBenchTasks << " per producer)\n"
+        << "threads  separate queues  shared queue\n";
+    for (unsigned i = 1; i <= maxThreads; i *= 2) {
+        auto sep = runLanes(i, false, kBenchTasks);
+        auto shr = runLanes(i, true, kBenchTasks);
+        cout << setw(7) << i
+            << setw(17) << (uint64_t) sep
+            << setw(14) << (uint64_t) shr
+            << endl;
+    }
+
+    cout << "\nFork/join tasks per second (depth " << kForkDepth << ")\n"
+        << "threads  work stealing  shared fifo\n";
+    auto cq = taskComputeQueue();
+    for (unsigned i = 1; i <= maxThreads; i *= 2) {
+        taskSetQueueThreads(cq, i);
+        auto stl = runForkJoin(cq, kForkDepth);
+        auto fq = taskCreateQueue("Fifo", i);
+        auto fifo = runForkJoin(fq, kForkDepth);
+        taskSetQueueThreads(fq, 0);
+        cout << setw(7) << i
+            << setw(15) << (uint64_t) stl
+            << setw(13) << (uint64_t) fifo
+            << endl;
+    }
+    taskSetQueueThreads(cq, 5);
+}
+
+
+/****************************************************************************
+*
+*   Application
+*
+***/
+
+//===========================================================================
+static void app(Cli & cli) {
+    if (!s_test && !s_bench) {
+        cout << "No tests run." << endl;
+        return appSignalShutdown(EX_OK);
+    }
+
+    if (s_test)
+        internalTests();
+    if (s_bench)
+        bench(s_bench);
+
+    if (s_test) {
+        coroTests(allocator_arg, &s_coroHeap);
+    } else {
+        testSignalShutdown();
+    }
+}
+
+
+/****************************************************************************
+*
+*   External
+*
+***/
+
+//===========================================================================
+int main(int argc, char * argv[]) {
+    cout.imbue(locale(""));
+    Cli cli;
+    cli.helpNoArgs().action(app);
+    cli.opt(&s_verbose, "v verbose.")
+        .desc("Display details of what's happening during processing.");
+    cli.opt(&s_bench, "b bench", 0)
+        .desc("Benchmark push/pop throughput from 1 up to this many "
+            "producer threads, doubling each round.");
+    cli.opt(&s_test, "test", false)
+        .desc("Run internal unit tests.");
+    return appRun(argc, argv, kVersion, {}, fAppTest);
+}
@@ -0,0 +1,32 @@
+// Copyright Glen Knowles 2026.
+// Distributed under the Boost Software License, Version 1.0.
+//
+// pch.h - dim test timer
+
+// Public header
+#include "core/timer.h"
+
+// External library public headers
+#include "dimcli/cli.h"
+
+#include "app/app.h"
+#include "core/log.h"
+#include "core/task.h"
+#include "core/time.h"
+#include "system/system.h"
+#include "tools/tools.h"
+
+// Standard headers
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <vector>
+
+// Platform headers
+// External library internal headers
+// Internal headers
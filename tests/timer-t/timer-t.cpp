@@ -0,0 +1,254 @@
+// Copyright Glen Knowles 2026.
+// Distributed under the Boost Software License, Version 1.0.
+//
+// timer-t.cpp - dim test timer
+#include "pch.h"
+#pragma hdrstop
+
+using namespace std;
+using namespace Dim;
+
+
+/****************************************************************************
+*
+*   Tuning parameters
+*
+***/
+
+const VersionInfo kVersion = { 1 };
+
+// Timers kept alive when benchmarking.
+const size_t kBenchTimers = 1'000'000;
+
+// Reschedules, spread at random across the timers, when benchmarking.
+const size_t kBenchUpdates = 10'000'000;
+
+
+/****************************************************************************
+*
+*   Declarations
+*
+***/
+
+#define EXPECT(...)                                                         \
+    if (!bool(__VA_ARGS__)) {                                               \
+        logMsgError() << "Line " << (line ? line : __LINE__) << ": EXPECT(" \
+                      << #__VA_ARGS__ << ") failed";                        \
+    }
+
+namespace {
+
+// Counts calls, asking to be called again until the repeat count runs out.
+class CountTimer : public ITimerNotify {
+public:
+    TimePoint expected;
+    unsigned repeat{};
+    unsigned fired{};
+    bool early{};
+
+private:
+    Duration onTimer(TimePoint now) override;
+};
+
+} // namespace
+
+
+/****************************************************************************
+*
+*   Variables
+*
+***/
+
+static bool s_verbose;
+static bool s_test;
+static bool s_bench;
+
+static mutex s_mut;
+static condition_variable s_cv;
+static size_t s_timersRunning;
+
+
+/****************************************************************************
+*
+*   CountTimer
+*
+***/
+
+//===========================================================================
+Duration CountTimer::onTimer(TimePoint now) {
+    if (now < expected)
+        early = true;
+    fired += 1;
+    if (repeat) {
+        repeat -= 1;
+        expected = now + 1ms;
+        return 1ms;
+    }
+    scoped_lock lk{s_mut};
+    if (!--s_timersRunning)
+        s_cv.notify_all();
+    return kTimerInfinite;
+}
+
+
+/****************************************************************************
+*
+*   Helpers
+*
+***/
+
+//===========================================================================
+static void waitForTimers() {
+    unique_lock lk{s_mut};
+    while (s_timersRunning)
+        s_cv.wait(lk);
+}
+
+//===========================================================================
+static void start(CountTimer * timer, Duration wait) {
+    timer->expected = timeNow() + wait;
+    timerUpdate(timer, wait);
+}
+
+
+/****************************************************************************
+*
+*   Tests
+*
+***/
+
+//===========================================================================
+static void internalTests() {
+    int line = 0;
+
+    // Fires once, no sooner than asked.
+    CountTimer t1;
+    s_timersRunning = 1;
+    start(&t1, 5ms);
+    waitForTimers();
+    EXPECT(t1.fired == 1 && !t1.early);
+
+    // Cancelled by updating to infinite or by closing.
+    CountTimer t2, t3, t4;
+    s_timersRunning = 1;
+    start(&t2, 5ms);
+    timerUpdate(&t2, kTimerInfinite);
+    start(&t3, 5ms);
+    timerCloseWait(&t3);
+    start(&t4, 20ms);
+    waitForTimers();
+    EXPECT(!t2.fired && !t3.fired && t4.fired == 1);
+
+    // Only moved earlier when onlyIfSooner is set.
+    CountTimer t5;
+    s_timersRunning = 1;
+    auto expire = timerUpdate(&t5, 1h);
+    EXPECT(timerUpdate(&t5, 2h, true) == expire);
+    t5.expected = timeNow() + 5ms;
+    EXPECT(timerUpdate(&t5, 5ms, true) < expire);
+    waitForTimers();
+    EXPECT(t5.fired == 1 && !t5.early);
+
+    // Rescheduled by the wait returned from the callback.
+    CountTimer t6;
+    t6.repeat = 4;
+    s_timersRunning = 1;
+    start(&t6, 0ms);
+    waitForTimers();
+    EXPECT(t6.fired == 5 && !t6.early);
+
+    // Many timers spread over the low and upper levels of the wheel, and
+    // some rescheduled before they fire, all fire exactly once and never
+    // early.
+    default_random_engine reng;
+    uniform_int_distribution<int> dist(100, 400);
+    vector<CountTimer> timers(10'000);
+    s_timersRunning = timers.size();
+    for (auto && t : timers)
+        start(&t, dist(reng) * 1ms);
+    for (auto i = 0; i < timers.size(); i += 3)
+        start(&timers[i], dist(reng) * 1ms);
+    waitForTimers();
+    EXPECT(ranges::all_of(timers, [](auto & t) {
+        return t.fired == 1 && !t.early;
+    }));
+    if (s_verbose)
+        cout << "Timers fired: " << timers.size() << endl;
+}
+
+//===========================================================================
+static void bench() {
+    default_random_engine reng;
+    uniform_int_distribution<int> waits(60, 3600);
+    uniform_int_distribution<size_t> which(0, kBenchTimers - 1);
+    auto timers = make_unique<CountTimer[]>(kBenchTimers);
+
+    cout << "Timer operations per second (" << kBenchTimers << " timers)\n";
+    auto report = [](const char name[], size_t ops, TimePoint start) {
+        chrono::duration<double> elapsed = timeNow() - start;
+        cout << left << setw(12) << name << right
+            << setw(14) << (uint64_t) (ops / elapsed.count())
+            << endl;
+    };
+
+    auto start = timeNow();
+    for (auto i = 0; i < kBenchTimers; ++i)
+        timerUpdate(&timers[i], waits(reng) * 1s);
+    report("insert", kBenchTimers, start);
+
+    start = timeNow();
+    for (auto i = 0; i < kBenchUpdates; ++i)
+        timerUpdate(&timers[which(reng)], waits(reng) * 1s);
+    report("reschedule", kBenchUpdates, start);
+
+    start = timeNow();
+    for (auto i = 0; i < kBenchTimers; ++i)
+        timerCloseWait(&timers[i]);
+    report("close", kBenchTimers, start);
+}
+
+
+/****************************************************************************
+*
+*   Application
+*
+***/
+
+//===========================================================================
+static void app(Cli & cli) {
+    if (!s_test && !s_bench) {
+        cout << "No tests run." << endl;
+        return appSignalShutdown(EX_OK);
+    }
+
+    // Timers are dispatched on the event thread, so wait for them from
+    // somewhere else.
+    taskPushOnce("Timer Tests", []() {
+        if (s_test)
+            internalTests();
+        if (s_bench)
+            bench();
+        testSignalShutdown();
+    });
+}
+
+
+/****************************************************************************
+*
+*   External
+*
+***/
+
+//===========================================================================
+int main(int argc, char * argv[]) {
+    cout.imbue(locale(""));
+    Cli cli;
+    cli.helpNoArgs().action(app);
+    cli.opt(&s_verbose, "v verbose.")
+        .desc("Display details of what's happening during processing.");
+    cli.opt(&s_bench, "b bench.")
+        .desc("Benchmark insert, reschedule, and close of a million timers.");
+    cli.opt(&s_test, "test", false)
+        .desc("Run internal unit tests.");
+    return appRun(argc, argv, kVersion, {}, fAppTest);
+}
@@ -145,6 +145,11 @@ static auto & s_perfUpdateByRule = uperf("cmtupd rule triggered updates");
 static auto & s_perfUnchangedFiles = uperf("cmtupd files unchanged");
 static auto & s_perfUpdatedFiles = uperf("cmtupd files updated");
 
+// Files still being processed, the final report is made by whoever takes it
+// to zero. Kept apart from s_perfQueuedFiles because the perf counter is
+// sharded and its value is only a snapshot.
+static atomic<unsigned> s_queuedFiles;
+
 static mutex s_progressMut;
 static Result s_result;
 const string s_currentYear = []() {
@@ -600,7 +605,7 @@ static void showConfig(const Config * cfg) {
 
 //===========================================================================
 static void finalReport(const Config * cfg) {
-    assert(!s_perfQueuedFiles);
+    assert(!s_queuedFiles);
 
     if (s_opts.verbose > 1
         || s_opts.verbose && s_perfScannedFiles
@@ -796,6 +801,7 @@ static void processFiles(const Config * cfg) {
     vector<string> dateArgs = {
         "git", "-C", cfg->gitRoot.str(), "log", "--format=%aI", "-n1", ""
     };
+    s_queuedFiles += 1;
     s_perfQueuedFiles += 1;
     for (auto&& f : fnames) {
         f = trim(f);
@@ -813,12 +819,14 @@ static void processFiles(const Config * cfg) {
             continue;
         }
 
+        s_queuedFiles += 1;
         s_perfQueuedFiles += 1;
         dateArgs.back() = f;
         execTool(
             [cfg, grps, fname](auto && res) {
                 processFile(cfg, grps, fname, res.output);
-                if (!--s_perfQueuedFiles)
+                s_perfQueuedFiles -= 1;
+                if (!--s_queuedFiles)
                     finalReport(cfg);
             },
             Cli::toCmdline(dateArgs),
@@ -829,7 +837,8 @@ static void processFiles(const Config * cfg) {
     }
 
     // Decrement queued file count and report if none remaining.
-    if (!--s_perfQueuedFiles)
+    s_perfQueuedFiles -= 1;
+    if (!--s_queuedFiles)
         finalReport(cfg);
 }
 
@@ -16,6 +16,7 @@
 #include "tools/tools.h"
 
 // Standard headers
+#include <atomic>
 #include <cstdio>
 #include <cstdlib>
 #include <forward_list>
@@ -0,0 +1,636 @@
+// Copyright Glen Knowles 2026.
+// Distributed under the Boost Software License, Version 1.0.
+//
+// h2bench.cpp - h2bench
+#include "pch.h"
+#pragma hdrstop
+
+using namespace std;
+using namespace Dim;
+
+
+/****************************************************************************
+*
+*   Tuning parameters
+*
+***/
+
+const VersionInfo kVersion = { 1, 0 };
+
+// How long requests still in flight when the run ends are waited for before
+// they're counted as incomplete.
+constexpr Duration kDrainTimeout = 5s;
+
+// Bounds on how long the rate timer sleeps between sending batches of
+// requests, short enough to keep the rate smooth without waking for every
+// request.
+constexpr Duration kMinRateWait = 1ms;
+constexpr Duration kMaxRateWait = 100ms;
+
+
+/****************************************************************************
+*
+*   Declarations
+*
+***/
+
+enum {
+    kExitConnectFailed = EX__APPBASE,
+    kExitRequestsFailed,
+};
+
+namespace {
+
+enum RunState {
+    kStarting,  // waiting for all connections
+    kRunning,   // sending requests
+    kDraining,  // waiting for the replies to requests already sent
+    kDone,
+};
+
+struct Target {
+    string path;
+    unsigned weight{1};
+};
+
+// Connection with up to s_numStreams requests in flight, as streams of a single
+// HTTP/2 connection.
+class BenchConn : public IAppSocketNotify {
+public:
+    // Adds a request that was due to be sent at the time, it's sent as soon
+    // as there's a free stream.
+    void queue(TimePoint due);
+    void send();
+
+private:
+    void onSocketConnect(const AppSocketConnectInfo & info) override;
+    void onSocketConnectFailed() override;
+    void onSocketDisconnect() override;
+    bool onSocketRead(AppSocketData & data) override;
+
+    void request(CharBuf * out, TimePoint start);
+
+    shared_ptr<HttpConn> m_conn;
+    unordered_map<int, TimePoint> m_started;    // by stream id
+    deque<TimePoint> m_backlog;
+};
+
+class AddrQuery : public ISockAddrNotify {
+    void onSockAddrFound(const SockAddr * ptr, int count) override;
+};
+
+// Sends requests as they come due when running at a fixed rate, and ends the
+// run when its time is up.
+class RunTimer : public ITimerNotify {
+    Duration onTimer(TimePoint now) override;
+};
+
+} // namespace
+
+
+/****************************************************************************
+*
+*   Variables
+*
+***/
+
+static string s_target;
+static string s_authority;
+static unsigned s_numConns;
+static unsigned s_numStreams;
+static unsigned s_numRequests;
+static unsigned s_seconds;
+static double s_rate;
+static vector<string> s_paths;
+static bool s_json;
+
+static int s_cancelAddrId;
+static AddrQuery s_addrQuery;
+static RunTimer s_runTimer;
+static vector<Target> s_targets;
+static unsigned s_totalWeight;
+static vector<SockMgrHandle> s_mgrs;
+static vector<BenchConn *> s_conns;     // connected
+
+static RunState s_state{kStarting};
+static TimePoint s_start;
+static TimePoint s_last;
+static uint64_t s_scheduled;
+static uint64_t s_sent;
+static uint64_t s_outstanding;
+static uint64_t s_succeeded;
+static uint64_t s_failed;
+static uint64_t s_bytes;
+static uint64_t s_statuses[6];          // by status / 100, 0 for invalid
+static vector<Duration> s_latencies;
+
+
+/****************************************************************************
+*
+*   Helpers
+*
+***/
+
+static void finish();
+
+//===========================================================================
+// Target chosen for the nth request, the targets take turns in proportion
+// to their weights.
+static const Target & target(uint64_t n) {
+    auto pos = unsigned(n % s_totalWeight);
+    for (auto && t : s_targets) {
+        if (pos < t.weight)
+            return t;
+        pos -= t.weight;
+    }
+    return s_targets.back();
+}
+
+//===========================================================================
+// Returns true if more requests are to be scheduled.
+static bool scheduling(TimePoint now) {
+    if (s_state != kRunning)
+        return false;
+    if (s_seconds)
+        return now < s_start + chrono::seconds(s_seconds);
+    return s_scheduled < s_numRequests;
+}
+
+//===========================================================================
+// Stops scheduling requests, the run is finished once the replies to those
+// already scheduled are back.
+static void stopScheduling() {
+    if (s_state != kRunning)
+        return;
+    s_state = kDraining;
+    timerUpdate(&s_runTimer, kDrainTimeout);
+    if (!s_outstanding)
+        finish();
+}
+
+//===========================================================================
+static void completed(TimePoint now, TimePoint start, int status) {
+    s_outstanding -= 1;
+    s_last = now;
+    s_latencies.push_back(now - start);
+    s_statuses[status >= 100 && status < 600 ? status / 100 : 0] += 1;
+    if (status >= 200 && status < 400) {
+        s_succeeded += 1;
+    } else {
+        s_failed += 1;
+    }
+}
+
+//===========================================================================
+static void start() {
+    s_state = kRunning;
+    s_start = timeNow();
+    s_last = s_start;
+    if (s_rate) {
+        timerUpdate(&s_runTimer, 0ms);
+        return;
+    }
+    if (s_seconds)
+        timerUpdate(&s_runTimer, chrono::seconds(s_seconds));
+    for (auto && conn : s_conns)
+        conn->send();
+}
+
+
+/****************************************************************************
+*
+*   BenchConn
+*
+***/
+
+//===========================================================================
+void BenchConn::queue(TimePoint due) {
+    m_backlog.push_back(due);
+    send();
+}
+
+//===========================================================================
+void BenchConn::send() {
+    CharBuf out;
+    auto now = timeNow();
+    while (m_conn && m_started.size() < s_numStreams) {
+        if (!m_backlog.empty()) {
+            request(&out, m_backlog.front());
+            m_backlog.pop_front();
+        } else if (!s_rate && scheduling(now)) {
+            s_scheduled += 1;
+            s_outstanding += 1;
+            request(&out, now);
+        } else {
+            break;
+        }
+    }
+    if (!out.empty())
+        socketWrite(this, out);
+    if (!s_rate && !s_seconds && !scheduling(now))
+        stopScheduling();
+}
+
+//===========================================================================
+void BenchConn::request(CharBuf * out, TimePoint start) {
+    auto & t = target(s_sent++);
+    HttpRequest msg;
+    msg.addHeaderRef(kHttp_Method, "GET");
+    msg.addHeaderRef(kHttp_Scheme, "http");
+    msg.addHeaderRef(kHttp_Authority, s_authority.c_str());
+    msg.addHeaderRef(kHttp_Path, t.path.c_str());
+    auto stream = httpRequest(out, m_conn, msg);
+    m_started[stream] = start;
+}
+
+//===========================================================================
+void BenchConn::onSocketConnect(const AppSocketConnectInfo & info) {
+    CharBuf out;
+    m_conn = httpConnect(&out);
+    socketWrite(this, out);
+    s_conns.push_back(this);
+    if (s_state == kStarting) {
+        if (s_conns.size() == s_numConns)
+            start();
+    } else {
+        send();
+    }
+}
+
+//===========================================================================
+void BenchConn::onSocketConnectFailed() {
+    if (s_state == kStarting) {
+        logMsgError() << "Connect to " << s_target << " failed";
+        s_state = kDone;
+        appSignalShutdown(kExitConnectFailed);
+    }
+}
+
+//===========================================================================
+void BenchConn::onSocketDisconnect() {
+    // Requests that were sent, or were waiting to be, are lost along with
+    // the connection.
+    auto lost = m_started.size() + m_backlog.size();
+    s_failed += lost;
+    s_outstanding -= lost;
+    m_started.clear();
+    m_backlog.clear();
+    httpClose(m_conn);
+    m_conn = {};
+    erase(s_conns, this);
+    if (s_state == kDraining && !s_outstanding)
+        finish();
+}
+
+//===========================================================================
+bool BenchConn::onSocketRead(AppSocketData & data) {
+    CharBuf out;
+    vector<unique_ptr<HttpMsg>> msgs;
+    auto more = httpRecv(&out, &msgs, m_conn, data.data, data.bytes);
+    if (!out.empty())
+        socketWrite(this, out);
+
+    auto now = timeNow();
+    for (auto && msg : msgs) {
+        if (msg->isRequest())
+            continue;
+        auto it = m_started.find(msg->stream());
+        if (it == m_started.end())
+            continue;
+        s_bytes += msg->body().size();
+        auto & res = static_cast<HttpResponse &>(*msg);
+        completed(now, it->second, res.status());
+        m_started.erase(it);
+    }
+
+    if (!more) {
+        logMsgError() << "Protocol error: " << httpGetError(m_conn);
+        socketDisconnect(this);
+        return true;
+    }
+    if (s_state == kRunning) {
+        send();
+    } else if (s_state == kDraining && !s_outstanding) {
+        finish();
+    }
+    return true;
+}
+
+
+/****************************************************************************
+*
+*   AddrQuery
+*
+***/
+
+//===========================================================================
+void AddrQuery::onSockAddrFound(const SockAddr * ptr, int count) {
+    if (!count) {
+        logMsgError() << "Host not found: " << s_target;
+        return appSignalShutdown(kExitConnectFailed);
+    }
+    if (appStopping())
+        return;
+
+    // A socket manager keeps one connection to each address, so there's a
+    // manager for each connection.
+    for (unsigned i = 0; i < s_numConns; ++i) {
+        auto name = "h2bench."s.append(toChars(i).view());
+        auto mgr = sockMgrConnect<BenchConn>(name);
+        sockMgrSetAddresses(mgr, ptr, 1);
+        s_mgrs.push_back(mgr);
+    }
+}
+
+
+/****************************************************************************
+*
+*   RunTimer
+*
+***/
+
+//===========================================================================
+Duration RunTimer::onTimer(TimePoint now) {
+    if (s_state == kDraining) {
+        // Out of patience, the replies still to come aren't counted.
+        finish();
+        return kTimerInfinite;
+    }
+    if (s_state != kRunning)
+        return kTimerInfinite;
+    if (!s_rate) {
+        stopScheduling();
+        return kTimerInfinite;
+    }
+
+    // Requests are handed out to the connections in turn, and if one has
+    // no stream free it's held until there is.
+    chrono::duration<double> elapsed = now - s_start;
+    auto due = (uint64_t) (elapsed.count() * s_rate);
+    if (!s_seconds)
+        due = min(due, (uint64_t) s_numRequests);
+    auto interval = chrono::duration<double>(1 / s_rate);
+    while (s_scheduled < due && scheduling(now) && !s_conns.empty()) {
+        auto at = s_start
+            + chrono::duration_cast<Duration>(interval * (double) s_scheduled);
+        auto conn = s_conns[s_scheduled % s_conns.size()];
+        s_scheduled += 1;
+        s_outstanding += 1;
+        conn->queue(at);
+    }
+    if (!scheduling(now)) {
+        stopScheduling();
+        return s_state == kDraining ? kDrainTimeout : kTimerInfinite;
+    }
+    return clamp(
+        chrono::duration_cast<Duration>(interval),
+        kMinRateWait,
+        kMaxRateWait
+    );
+}
+
+
+/****************************************************************************
+*
+*   Report
+*
+***/
+
+const char * const kLatencyNames[] = {
+    "min", "mean", "p50", "p90", "p99", "p99.9", "max",
+};
+const double kPercentiles[] = { 50, 90, 99, 99.9 };
+
+namespace {
+
+struct Summary {
+    Duration elapsed;
+    double reqPerSec;
+    double bytesPerSec;
+    uint64_t incomplete;
+    double latencyMs[size(kLatencyNames)];
+};
+
+} // namespace
+
+//===========================================================================
+static double toMs(Duration val) {
+    return chrono::duration<double, milli>(val).count();
+}
+
+//===========================================================================
+static Summary summarize() {
+    Summary out = {};
+    out.elapsed = s_last - s_start;
+    chrono::duration<double> secs = out.elapsed;
+    if (secs.count() > 0) {
+        out.reqPerSec = (s_succeeded + s_failed) / secs.count();
+        out.bytesPerSec = s_bytes / secs.count();
+    }
+    out.incomplete = s_outstanding;
+
+    auto & lat = s_latencies;
+    if (!lat.empty()) {
+        ranges::sort(lat);
+        Duration total{};
+        for (auto && val : lat)
+            total += val;
+        out.latencyMs[0] = toMs(lat.front());
+        out.latencyMs[1] = toMs(total / lat.size());
+        for (unsigned i = 0; i < size(kPercentiles); ++i) {
+            auto pos = (size_t) (kPercentiles[i] / 100 * lat.size());
+            out.latencyMs[i + 2] = toMs(lat[min(pos, lat.size() - 1)]);
+        }
+        out.latencyMs[6] = toMs(lat.back());
+    }
+    return out;
+}
+
+//===========================================================================
+static void writeText(const Summary & sum) {
+    cout << fixed << setprecision(3);
+    cout << "Requests: " << s_succeeded + s_failed + sum.incomplete
+        << " total, " << s_succeeded << " succeeded, " << s_failed
+        << " failed, " << sum.incomplete << " incomplete\n";
+    cout << "Status codes:";
+    for (unsigned i = 1; i < size(s_statuses); ++i)
+        cout << ' ' << i << "xx " << s_statuses[i];
+    if (s_statuses[0])
+        cout << ", invalid " << s_statuses[0];
+    cout << '\n';
+    cout << "Elapsed: " << toMs(sum.elapsed) / 1000 << " s\n";
+    cout << setprecision(0)
+        << "Throughput: " << sum.reqPerSec << " req/s, "
+        << sum.bytesPerSec << " bytes/s\n";
+    cout << setprecision(3) << "Latency (ms):\n";
+    for (unsigned i = 0; i < size(kLatencyNames); ++i) {
+        cout << "  " << left << setw(8) << kLatencyNames[i] << right
+            << setw(12) << sum.latencyMs[i] << '\n';
+    }
+    cout.flush();
+}
+
+//===========================================================================
+static void writeJson(const Summary & sum) {
+    CharBuf buf;
+    JBuilder bld(&buf);
+    bld.object();
+    bld.member("target", s_target)
+        .member("connections", s_numConns)
+        .member("streams", s_numStreams)
+        .member("rate", s_rate)
+        .member("seconds", toMs(sum.elapsed) / 1000)
+        .member("requests", s_succeeded + s_failed + sum.incomplete)
+        .member("succeeded", s_succeeded)
+        .member("failed", s_failed)
+        .member("incomplete", sum.incomplete)
+        .member("bytes", s_bytes)
+        .member("reqPerSec", sum.reqPerSec)
+        .member("bytesPerSec", sum.bytesPerSec);
+    bld.member("statuses").object();
+    for (unsigned i = 1; i < size(s_statuses); ++i) {
+        auto name = to_string(i) + "xx";
+        bld.member(name, s_statuses[i]);
+    }
+    bld.member("invalid", s_statuses[0]);
+    bld.end();
+    bld.member("latencyMs").object();
+    for (unsigned i = 0; i < size(kLatencyNames); ++i)
+        bld.member(kLatencyNames[i], sum.latencyMs[i]);
+    bld.end();
+    bld.end();
+    cout << buf << endl;
+}
+
+//===========================================================================
+static void finish() {
+    if (s_state == kDone)
+        return;
+    s_state = kDone;
+    timerUpdate(&s_runTimer, kTimerInfinite);
+    auto sum = summarize();
+    if (s_json) {
+        writeJson(sum);
+    } else {
+        writeText(sum);
+    }
+    appSignalShutdown(s_failed || sum.incomplete
+        ? kExitRequestsFailed
+        : EX_OK);
+}
+
+
+/****************************************************************************
+*
+*   ShutdownNotify
+*
+***/
+
+namespace {
+class ShutdownNotify : public IShutdownNotify {
+    void onShutdownClient(bool firstTry) override;
+};
+} // namespace
+static ShutdownNotify s_cleanup;
+
+//===========================================================================
+void ShutdownNotify::onShutdownClient(bool firstTry) {
+    if (firstTry) {
+        addressCancelQuery(s_cancelAddrId);
+        timerCloseWait(&s_runTimer);
+    }
+}
+
+
+/****************************************************************************
+*
+*   Application
+*
+***/
+
+//===========================================================================
+// Parses each path, optionally prefixed by a weight ("3:/index.html"), into
+// the targets requests are made to.
+static bool parseTargets(Cli & cli) {
+    if (s_paths.empty())
+        s_paths.push_back("/");
+    for (auto && path : s_paths) {
+        auto & t = s_targets.emplace_back();
+        auto pos = path.find(':');
+        if (pos != string::npos && path[0] != '/') {
+            if (!parse(&t.weight, string_view(path).substr(0, pos))
+                || !t.weight
+            ) {
+                cli.badUsage("Invalid path weight", path);
+                return false;
+            }
+            t.path = path.substr(pos + 1);
+        } else {
+            t.path = path;
+        }
+        if (t.path.empty() || t.path[0] != '/') {
+            cli.badUsage("Path must start with '/'", path);
+            return false;
+        }
+        s_totalWeight += t.weight;
+    }
+    return true;
+}
+
+//===========================================================================
+static void app(Cli & cli) {
+    if (!parseTargets(cli))
+        return;
+    if (s_authority.empty())
+        s_authority = s_target;
+    if (!s_seconds)
+        s_latencies.reserve(s_numRequests);
+
+    shutdownMonitor(&s_cleanup);
+    consoleCatchCtrlC();
+    addressQuery(&s_cancelAddrId, &s_addrQuery, s_target, 80);
+    cli.fail(EX_PENDING);
+}
+
+
+/****************************************************************************
+*
+*   Externals
+*
+***/
+
+//===========================================================================
+int main(int argc, char * argv[]) {
+    Cli cli;
+    cli.helpNoArgs();
+    cli.header(cli.header() + " HTTP/2 load generator");
+    cli.opt(&s_target, "<server address>")
+        .desc("Address of server to send requests to, port 80 is used if "
+            "no port is specified.");
+    cli.opt(&s_numConns, "c connections", 1)
+        .range(1, 10'000)
+        .desc("Connections to open.");
+    cli.opt(&s_numStreams, "m streams", 10)
+        .range(1, 1'000)
+        .desc("Requests in flight at once on each connection.");
+    cli.opt(&s_numRequests, "n requests", 10'000)
+        .desc("Requests to make, ignored if duration is set.");
+    cli.opt(&s_seconds, "d duration", 0)
+        .valueDesc("SECONDS")
+        .desc("Time to keep making requests.");
+    cli.opt(&s_rate, "r rate", 0.0)
+        .desc("Requests per second, across all connections, to send "
+            "whether or not earlier ones have been answered. By default "
+            "each reply is followed by another request.");
+    cli.optVec(&s_paths, "p path")
+        .valueDesc("[WEIGHT:]PATH")
+        .desc("Path to request, may be given more than once to make a mix "
+            "of requests, each in proportion to its weight (default 1).");
+    cli.opt(&s_authority, "host")
+        .desc("Value of the :authority header, defaults to the server "
+            "address.");
+    cli.opt(&s_json, "json.")
+        .desc("Report results as JSON.");
+    cli.action(app);
+    return appRun(argc, argv, kVersion, "h2bench");
+}
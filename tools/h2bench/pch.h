@@ -0,0 +1,29 @@
+// Copyright Glen Knowles 2026.
+// Distributed under the Boost Software License, Version 1.0.
+//
+// pch.h - h2bench
+
+// Public header
+// External library public headers
+#include "dimcli/cli.h"
+
+#define DIMAPP_LIB_KEEP_MACROS
+#include "app/app.h"
+#include "core/core.h"
+#include "json/json.h"
+#include "net/net.h"
+#include "system/system.h"
+
+// Standard headers
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <deque>
+#include <iomanip>
+#include <iostream>
+#include <unordered_map>
+#include <vector>
+
+// Platform headers
+// External library internal headers
+// Internal headers